@@ -0,0 +1,629 @@
+/* *
+ * bench.c
+ *
+ * Microbenchmarks of the shell's hot paths.
+ *
+ * usage: tinysh-bench [--format=csv|json] [--rev=REV] [--shell=PATH] [--quick]
+ *
+ * Each benchmark runs its operation a fixed number of times per repetition, and reports the
+ * median and minimum over BENCH_REPS repetitions (after one warm-up repetition), so that results
+ * are comparable from run to run.  Results go to stdout as CSV (the default) or JSON, tagged with
+ * REV (e.g. the commit being measured) so that runs from different commits can be compared.
+ *
+ * The benchmarks call into the shell's own code: this program is linked with the shell's objects,
+ * built with the shell's main renamed (see the bench target in the Makefile.)
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "tinysh.h"
+#include "pipeline.h"
+#include "optimize.h"
+#include "stats.h"
+#include "cmdhash.h"
+#include "mem.h"
+#include "arith.h"
+#include "vars.h"
+#include "expand.h"
+#include "interp.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#define BENCH_REPS 5
+
+#define TOKENIZER_LINE "ls -l /usr/bin | grep sh | sort -r | head -n 5 > out.txt"
+#define ARITH_EXPR     "i = (i + 1) % 1000, j += i * 2 + 1"
+#define EXPAND_VALUE   "/usr/local/lib/libfoo.so.1"
+#define READ_LINES     10000
+#define ARRAY_SIZE     1000
+#define LOOP_COUNT     10000
+
+/*
+ * A command line for the optimizer benchmark, run with or without the optimizer.
+ */
+struct opt_line {
+  const char *name;
+  char **cmd;
+  int optimize;
+};
+
+/*
+ * A file for the read benchmark, and the builtin that reads it (read or mapfile.)
+ */
+struct read_run {
+  const char *file;
+  const char *builtin;
+};
+
+static const char *rev = "unknown";
+static const char *shell_path = "bin/tinysh";
+static int json_flag;
+static int quick_flag;
+static size_t num_results;
+
+static double run_reps(double (*fn)(long, const void *), long iterations, const void *arg,
+                       double *min);
+static void report(const char *name, const char *param, long iterations, double median, double min,
+                   const char *unit);
+static double bench_tokenizer(long iterations, const void *arg);
+static double bench_dispatch(long iterations, const void *arg);
+static double bench_arith(long iterations, const void *arg);
+static double bench_expand(long iterations, const void *arg);
+static double bench_splice(long iterations, const void *arg);
+static double bench_loop(long iterations, const void *arg);
+static double bench_read(long iterations, const void *arg);
+static double bench_exec(long iterations, const void *arg);
+static double bench_pipeline(long iterations, const void *arg);
+static double bench_redirect(long iterations, const void *arg);
+static double bench_optimizer(long iterations, const void *arg);
+static size_t pipeline_forks(struct opt_line *line);
+static double bench_startup(long iterations, const void *arg);
+
+int main(int argc, char *argv[]) {
+  int i;
+  long n;
+  size_t stages;
+  double median, min;
+  char param[32], bytes[32], loop_line[64], tmp_file[] = "/tmp/tinysh-bench-XXXXXX";
+  char read_file[] = "/tmp/tinysh-bench-XXXXXX";
+  struct read_run read_runs[] = { {read_file, "read"}, {read_file, "mapfile"} };
+  FILE *file;
+  int fd;
+  char *dispatch_brief[] = { "brief", NULL };
+  char *dispatch_stats[] = { "stats", "-r", NULL };
+  char *dispatch_true[] = { "true", NULL };
+  char *dispatch_test[] = { "test", "1", "-lt", "2", NULL };
+  char *dispatch_glob[] = { "[[", "libfoo.so.1", "==", "*.so.*", "]]", NULL };
+  char *dispatch_regex[] = { "[[", "abc123", "=~", "^[a-z]+[0-9]+$", "]]", NULL };
+  const char *expand_words[] = {
+    "${f##*/}", "${f%.*}", "${f:5:3}", "${f//o/0}", "${a[500]}", "${m[key500]}", NULL
+  };
+  char *declare_cmd[] = { "declare", "-A", "m", NULL };
+  const char *subshell_lines[] = {
+    "( true; true ) > /dev/null", "( cd .; true ) > /dev/null", NULL
+  };
+  char *cat_wc[] = { "cat", "/etc/passwd", "|", "wc", "-l", ">", "/dev/null", NULL };
+  char *pwd_chain[] = { "pwd", "|", "pwd", "|", "cat", ">", "/dev/null", NULL };
+  struct opt_line opt_lines[] = {
+    {"cat | wc", cat_wc, 0}, {"pwd | pwd | cat", pwd_chain, 0}
+  };
+  size_t num_tokens = 0;
+  char **tokens;
+
+  for(i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--format=json") == 0)
+      json_flag = 1;
+    else if(strcmp(argv[i], "--format=csv") == 0)
+      json_flag = 0;
+    else if(strncmp(argv[i], "--rev=", 6) == 0 && argv[i][6] != '\0')
+      rev = argv[i] + 6;
+    else if(strncmp(argv[i], "--shell=", 8) == 0)
+      shell_path = argv[i] + 8;
+    else if(strcmp(argv[i], "--quick") == 0)
+      quick_flag = 1;
+    else {
+      fprintf(stderr, "usage: %s [--format=csv|json] [--rev=REV] [--shell=PATH] [--quick]\n",
+              argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  n = quick_flag ? 10 : 1;
+
+  if(json_flag)
+    printf("[");
+  else
+    printf("rev,benchmark,param,iterations,median,min,unit\n");
+
+  // Tokenizing, per token.
+  if((tokens = tokenizer(TOKENIZER_LINE, CMD_DELIMITERS, &num_tokens)) != NULL) {
+    char **temp = tokens;
+    while(*temp)
+      mem_free(MEM_PARSE, *temp++);
+    mem_free(MEM_PARSE, tokens);
+  }
+  median = run_reps(bench_tokenizer, 100000 / n, NULL, &min);
+  snprintf(param, sizeof(param), "%zu tokens", num_tokens);
+  report("tokenizer", param, 100000 / n, median / num_tokens, min / num_tokens, "ns/token");
+
+  // Builtin dispatch, for a builtin near the front and one near the end of the dispatch chain.
+  median = run_reps(bench_dispatch, 1000000 / n, dispatch_brief, &min);
+  report("dispatch", "brief", 1000000 / n, median, min, "ns/call");
+  median = run_reps(bench_dispatch, 1000000 / n, dispatch_stats, &min);
+  report("dispatch", "stats -r", 1000000 / n, median, min, "ns/call");
+  // In-process builtins, against the fork and exec of exec_dispatch below.
+  median = run_reps(bench_dispatch, 1000000 / n, dispatch_true, &min);
+  report("dispatch", "true", 1000000 / n, median, min, "ns/call");
+  median = run_reps(bench_dispatch, 1000000 / n, dispatch_test, &min);
+  report("dispatch", "test 1 -lt 2", 1000000 / n, median, min, "ns/call");
+  // [[ ]] with a cached pattern and a cached regex.
+  median = run_reps(bench_dispatch, 1000000 / n, dispatch_glob, &min);
+  report("dispatch", "[[ == *.so.* ]]", 1000000 / n, median, min, "ns/call");
+  median = run_reps(bench_dispatch, 1000000 / n, dispatch_regex, &min);
+  report("dispatch", "[[ =~ ^[a-z]+[0-9]+$ ]]", 1000000 / n, median, min, "ns/call");
+
+  // Arithmetic, with the compiled expression cached and compiled for every evaluation.
+  for(i = 1; i >= 0; i--) {
+    median = run_reps(bench_arith, 1000000 / n, &i, &min);
+    report("arith", i ? "cached" : "uncached", 1000000 / n, median, min, "ns/eval");
+  }
+
+  // Parameter expansion string operators and array elements, on a word that is copied and
+  // expanded each time.
+  vars_set("f", EXPAND_VALUE);
+  declare_handle(declare_cmd, 3);
+  for(i = 0; i < ARRAY_SIZE; i++) {
+    snprintf(param, sizeof(param), "key%d", i);
+    vars_array_set("a", i, param, strlen(param));
+    vars_assoc_set("m", param, strlen(param), param + 3, strlen(param + 3));
+  }
+  for(i = 0; expand_words[i] != NULL; i++) {
+    median = run_reps(bench_expand, 1000000 / n, expand_words[i], &min);
+    report("expand", expand_words[i], 1000000 / n, median, min, "ns/word");
+  }
+  // ${a[@]} as an argument list.
+  median = run_reps(bench_splice, 10000 / n, "${a[@]}", &min);
+  snprintf(param, sizeof(param), "${a[@]} of %d elements", ARRAY_SIZE);
+  report("expand", param, 10000 / n, median / ARRAY_SIZE, min / ARRAY_SIZE, "ns/word");
+  // Brace expansion into argv, and a for loop stepping through a sequence without expanding it.
+  snprintf(param, sizeof(param), "{1..%d}", ARRAY_SIZE);
+  median = run_reps(bench_splice, 10000 / n, param, &min);
+  report("expand", param, 10000 / n, median / ARRAY_SIZE, min / ARRAY_SIZE, "ns/word");
+  snprintf(loop_line, sizeof(loop_line), "for i in {1..%d}; do true; done", LOOP_COUNT);
+  snprintf(param, sizeof(param), "for i in {1..%d}", LOOP_COUNT);
+  median = run_reps(bench_loop, 100 / n, loop_line, &min);
+  report("loop", param, 100 / n, median / LOOP_COUNT, min / LOOP_COUNT, "ns/iteration");
+  // The same loop calling a function with a local variable on each iteration.
+  bench_loop(1, "f() { local x=$1; true; }");
+  snprintf(loop_line, sizeof(loop_line), "for i in {1..%d}; do f $i; done", LOOP_COUNT);
+  median = run_reps(bench_loop, 100 / n, loop_line, &min);
+  report("call", "f $i with local x=$1", 100 / n, median / LOOP_COUNT, min / LOOP_COUNT, "ns/call");
+  // A subshell that only groups a redirection runs in the shell process; one with a cd forks.
+  for(i = 0; subshell_lines[i] != NULL; i++) {
+    median = run_reps(bench_loop, 1000 / n, subshell_lines[i], &min);
+    report("subshell", subshell_lines[i], 1000 / n, median, min, "ns/line");
+  }
+
+  // Reading a file of READ_LINES lines, a line per read and all of it with one mapfile.
+  if((fd = mkstemp(read_file)) < 0 || (file = fdopen(fd, "w")) == NULL) {
+    perror("Error creating temporary file.");
+  }
+  else {
+    for(i = 0; i < READ_LINES; i++)
+      fprintf(file, "%d %s\n", i, EXPAND_VALUE);
+    fclose(file);
+    for(i = 0; i < (int) (sizeof(read_runs) / sizeof(read_runs[0])); i++) {
+      median = run_reps(bench_read, 10 / n, &read_runs[i], &min);
+      snprintf(param, sizeof(param), "%s %d lines", read_runs[i].builtin, READ_LINES);
+      report("read", param, 10 / n, median / READ_LINES, min / READ_LINES, "ns/line");
+    }
+    unlink(read_file);
+  }
+
+  // Fork, exec, and wait of a trivial program.
+  median = run_reps(bench_exec, 200 / n, NULL, &min);
+  report("exec_dispatch", "true", 200 / n, median / 1000, min / 1000, "us/command");
+
+  // Pipeline throughput.
+  for(stages = 2; stages <= 16; stages *= 2) {
+    median = run_reps(bench_pipeline, 1, &stages, &min);
+    snprintf(param, sizeof(param), "%zu stages", stages);
+    report("pipeline", param, 1, median, min, "MB/s");
+  }
+
+  // Redirection write throughput.
+  if(mkstemp(tmp_file) < 0) {
+    perror("Error creating temporary file.");
+  }
+  else {
+    median = run_reps(bench_redirect, 1, tmp_file, &min);
+    snprintf(bytes, sizeof(bytes), "%d MB", quick_flag ? 4 : 64);
+    report("redirect", bytes, 1, median, min, "MB/s");
+    unlink(tmp_file);
+  }
+
+  // Optimized pipelines against the same pipelines as written, in time and in processes forked.
+  for(i = 0; i < (int) (sizeof(opt_lines) / sizeof(opt_lines[0])); i++) {
+    cmdhash_warm(opt_lines[i].cmd);
+    for(opt_lines[i].optimize = 0; opt_lines[i].optimize <= 1; opt_lines[i].optimize++) {
+      median = run_reps(bench_optimizer, 200 / n, &opt_lines[i], &min);
+      snprintf(param, sizeof(param), "%s (%s)", opt_lines[i].name,
+               opt_lines[i].optimize ? "optimized" : "as written");
+      report("optimizer", param, 200 / n, median / 1000, min / 1000, "us/line");
+      median = min = pipeline_forks(&opt_lines[i]);
+      report("optimizer", param, 1, median, min, "forks/line");
+    }
+  }
+
+  // Shell startup and exit.
+  if(access(shell_path, X_OK) == 0) {
+    median = run_reps(bench_startup, 50 / n, NULL, &min);
+    report("startup", shell_path, 50 / n, median / 1000, min / 1000, "us/start");
+  }
+  else {
+    fprintf(stderr, "Skipping the startup benchmark: %s is not executable.\n", shell_path);
+  }
+
+  if(json_flag)
+    printf("\n]\n");
+  return EXIT_SUCCESS;
+}
+
+/* *
+ * Runs fn once to warm up, then BENCH_REPS times, setting min to the smallest result.
+ *
+ * Returns - The median result.
+ * */
+static double run_reps(double (*fn)(long, const void *), long iterations, const void *arg,
+                       double *min) {
+  int i, j;
+  double results[BENCH_REPS], t;
+  fn(iterations, arg);
+  for(i = 0; i < BENCH_REPS; i++) {
+    t = fn(iterations, arg);
+    // Insertion sort, since there are only a handful of results.
+    for(j = i; j > 0 && results[j - 1] > t; j--)
+      results[j] = results[j - 1];
+    results[j] = t;
+  }
+  *min = results[0];
+  return results[BENCH_REPS / 2];
+}
+
+/* *
+ * Prints one result as a CSV row or JSON object.
+ * */
+static void report(const char *name, const char *param, long iterations, double median, double min,
+                   const char *unit) {
+  if(json_flag) {
+    printf("%s\n  {\"rev\": \"%s\", \"benchmark\": \"%s\", \"param\": \"%s\", \"iterations\": %ld, "
+           "\"median\": %.3f, \"min\": %.3f, \"unit\": \"%s\"}",
+           num_results ? "," : "", rev, name, param, iterations, median, min, unit);
+  }
+  else {
+    printf("%s,%s,%s,%ld,%.3f,%.3f,%s\n", rev, name, param, iterations, median, min, unit);
+  }
+  num_results++;
+}
+
+/* *
+ * Returns - The average time in nanoseconds to tokenize TOKENIZER_LINE.
+ * */
+static double bench_tokenizer(long iterations, const void *arg) {
+  long i;
+  size_t num;
+  uint64_t start;
+  char **tokens, **temp;
+  (void) arg;
+  start = stats_now();
+  for(i = 0; i < iterations; i++) {
+    num = sizeof(TOKENIZER_LINE) - 1;
+    tokens = tokenizer(TOKENIZER_LINE, CMD_DELIMITERS, &num);
+    for(temp = tokens; *temp; temp++)
+      mem_free(MEM_PARSE, *temp);
+    mem_free(MEM_PARSE, tokens);
+  }
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* *
+ * Returns - The average time in nanoseconds to dispatch the builtin command line arg.
+ * */
+static double bench_dispatch(long iterations, const void *arg) {
+  long i;
+  size_t num;
+  int exit_flag = 0;
+  uint64_t start;
+  char **cmd = (char **) arg;
+  for(num = 0; cmd[num] != NULL; num++)
+    ;
+  start = stats_now();
+  for(i = 0; i < iterations; i++)
+    cmd_dispatch(cmd, num, &exit_flag);
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* *
+ * Returns - The average time in nanoseconds to evaluate ARITH_EXPR, using the cache of compiled
+ *           expressions if arg points to 1.
+ * */
+static double bench_arith(long iterations, const void *arg) {
+  long i;
+  long long result;
+  uint64_t start;
+  int cached = *(const int *) arg;
+  start = stats_now();
+  for(i = 0; i < iterations; i++) {
+    if(!cached)
+      arith_clear();
+    arith_eval(ARITH_EXPR, &result);
+  }
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* *
+ * Returns - The average time in nanoseconds to expand the word arg, with f set to EXPAND_VALUE.
+ * */
+static double bench_expand(long iterations, const void *arg) {
+  long i;
+  size_t num;
+  uint64_t start;
+  char *line[2];
+  char **words = line;
+  start = stats_now();
+  for(i = 0; i < iterations; i++) {
+    line[0] = mem_strdup(MEM_PARSE, arg);
+    line[1] = NULL;
+    num = 1;
+    expand_line(&words, &num);
+    if(num > 0)
+      mem_free(MEM_PARSE, line[0]);
+  }
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* *
+ * Returns - The average time in nanoseconds to expand the line "echo arg" into argv, where arg
+ *           makes ARRAY_SIZE words.
+ * */
+static double bench_splice(long iterations, const void *arg) {
+  long i;
+  size_t num, j;
+  uint64_t start;
+  char **line;
+  start = stats_now();
+  for(i = 0; i < iterations; i++) {
+    // expand_line grows the line, so it has to be allocated as the tokenizer's are.
+    if((line = mem_malloc(MEM_PARSE, 3 * sizeof(*line))) == NULL)
+      return 0;
+    line[0] = mem_strdup(MEM_PARSE, "echo");
+    line[1] = mem_strdup(MEM_PARSE, arg);
+    line[2] = NULL;
+    num = 2;
+    expand_line(&line, &num);
+    for(j = 0; j < num; j++)
+      mem_free(MEM_PARSE, line[j]);
+    mem_free(MEM_PARSE, line);
+  }
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* *
+ * Returns - The average time in nanoseconds to tokenize and run the command line arg with the
+ *           interpreter.
+ * */
+static double bench_loop(long iterations, const void *arg) {
+  long i;
+  size_t num, j;
+  int exit_flag = 0;
+  uint64_t start;
+  char **line;
+  start = stats_now();
+  for(i = 0; i < iterations; i++) {
+    num = strlen(arg);
+    if((line = tokenizer(arg, CMD_DELIMITERS, &num)) == NULL)
+      return 0;
+    interp_line(&line, &num, NULL, &exit_flag);
+    for(j = 0; j < num; j++)
+      mem_free(MEM_PARSE, line[j]);
+    mem_free(MEM_PARSE, line);
+  }
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* *
+ * Returns - The average time in nanoseconds to read the file of the read_run arg, with
+ *           "read -r -u fd line" until it fails, or with one "mapfile -t -u fd lines".
+ * */
+static double bench_read(long iterations, const void *arg) {
+  long i;
+  int fd, exit_flag = 0;
+  uint64_t start, elapsed = 0;
+  char fd_str[16];
+  char *read_cmd[] = { "read", "-r", "-u", fd_str, "line", NULL };
+  char *mapfile_cmd[] = { "mapfile", "-t", "-u", fd_str, "lines", NULL };
+  const struct read_run *run = arg;
+  for(i = 0; i < iterations; i++) {
+    if((fd = open(run->file, O_RDONLY)) < 0) {
+      perror("Error opening the file to read.");
+      return 0;
+    }
+    snprintf(fd_str, sizeof(fd_str), "%d", fd);
+    start = stats_now();
+    if(strcmp(run->builtin, "read") == 0) {
+      while(cmd_dispatch(read_cmd, 5, &exit_flag) == 0)
+        ;
+    }
+    else {
+      cmd_dispatch(mapfile_cmd, 5, &exit_flag);
+    }
+    elapsed += stats_now() - start;
+    close(fd);
+  }
+  return (double) elapsed / iterations;
+}
+
+/* *
+ * Returns - The average time in nanoseconds to run "true" through exec_dispatch.
+ * */
+static double bench_exec(long iterations, const void *arg) {
+  long i;
+  uint64_t start;
+  char *cmd[] = { "true", NULL };
+  (void) arg;
+  start = stats_now();
+  for(i = 0; i < iterations; i++)
+    exec_dispatch(cmd, 1);
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* *
+ * Returns - The throughput in MB/s of a pipeline of *arg stages: head reading from /dev/zero,
+ *           followed by cats, with the last writing to /dev/null.
+ * */
+static double bench_pipeline(long iterations, const void *arg) {
+  size_t i, stages, num;
+  long bytes;
+  char count[32];
+  char **cmd;
+  struct pipeline pl;
+  uint64_t start, elapsed;
+  (void) iterations;
+
+  stages = *(const size_t *) arg;
+  bytes = (quick_flag ? 4L : 64L) << 20;
+  snprintf(count, sizeof(count), "%ld", bytes);
+  if((cmd = malloc((2 * stages + 6) * sizeof(*cmd))) == NULL) {
+    perror("Error allocating memory.");
+    exit(EXIT_FAILURE);
+  }
+  num = 0;
+  cmd[num++] = "head";
+  cmd[num++] = "-c";
+  cmd[num++] = count;
+  cmd[num++] = "/dev/zero";
+  for(i = 1; i < stages; i++) {
+    cmd[num++] = "|";
+    cmd[num++] = "cat";
+  }
+  cmd[num++] = ">";
+  cmd[num++] = "/dev/null";
+  cmd[num] = NULL;
+
+  cmdhash_warm(cmd);
+  if(pipeline_parse(cmd, &pl, 0) == -1)
+    exit(EXIT_FAILURE);
+  start = stats_now();
+  pipeline_run(&pl);
+  elapsed = stats_now() - start;
+  pipeline_free(&pl);
+  free(cmd);
+  return (double) bytes / (1 << 20) / (elapsed / 1e9);
+}
+
+/* *
+ * Returns - The throughput in MB/s of "head -c N /dev/zero > FILE", with FILE = arg.
+ * */
+static double bench_redirect(long iterations, const void *arg) {
+  long bytes;
+  size_t num;
+  char line[PATH_MAX + 64];
+  char **cmd, **temp;
+  uint64_t start, elapsed;
+  (void) iterations;
+  bytes = (quick_flag ? 4L : 64L) << 20;
+  // The shell's child frees the command list, so it has to come from the tokenizer.
+  snprintf(line, sizeof(line), "head -c %ld /dev/zero > %s", bytes, (const char *) arg);
+  num = strlen(line);
+  cmd = tokenizer(line, CMD_DELIMITERS, &num);
+  start = stats_now();
+  exec_dispatch(cmd, num);
+  elapsed = stats_now() - start;
+  for(temp = cmd; *temp; temp++)
+    mem_free(MEM_PARSE, *temp);
+  mem_free(MEM_PARSE, cmd);
+  return (double) bytes / (1 << 20) / (elapsed / 1e9);
+}
+
+/* *
+ * Returns - The average time in nanoseconds to parse and run the opt_line arg as a flat pipeline,
+ *           optimized if arg asks for it.
+ * */
+static double bench_optimizer(long iterations, const void *arg) {
+  long i;
+  uint64_t start;
+  struct pipeline pl;
+  const struct opt_line *line = arg;
+  start = stats_now();
+  for(i = 0; i < iterations; i++) {
+    if(pipeline_parse(line->cmd, &pl, 0) == -1)
+      exit(EXIT_FAILURE);
+    if(line->optimize)
+      optimize_pipeline(&pl, NULL);
+    pipeline_run(&pl);
+    pipeline_free(&pl);
+  }
+  return (double) (stats_now() - start) / iterations;
+}
+
+/* *
+ * Returns - The number of processes the pipeline of line forks.
+ * */
+static size_t pipeline_forks(struct opt_line *line) {
+  size_t i, forks;
+  struct pipeline pl;
+  if(pipeline_parse(line->cmd, &pl, 0) == -1)
+    return 0;
+  if(line->optimize)
+    optimize_pipeline(&pl, NULL);
+  forks = 0;
+  for(i = 0; i < pl.num_stages; i++)
+    forks += !pl.stages[i].chained;
+  pipeline_free(&pl);
+  return forks;
+}
+
+/* *
+ * Returns - The average time in nanoseconds for the shell to start, read "exit", and exit.
+ * */
+static double bench_startup(long iterations, const void *arg) {
+  long i;
+  int p_id, null_fd, input[2];
+  uint64_t start;
+  (void) arg;
+  start = stats_now();
+  for(i = 0; i < iterations; i++) {
+    if(pipe(input) < 0) {
+      perror("Error creating pipe.");
+      exit(EXIT_FAILURE);
+    }
+    if((p_id = fork()) < 0) {
+      perror("Error forking a process.");
+      exit(EXIT_FAILURE);
+    }
+    if(p_id == 0) {
+      null_fd = open("/dev/null", O_WRONLY);
+      dup2(input[0], STDIN_FILENO);
+      dup2(null_fd, STDOUT_FILENO);
+      close(input[0]);
+      close(input[1]);
+      close(null_fd);
+      execl(shell_path, shell_path, (char *) NULL);
+      _Exit(EXIT_FAILURE);
+    }
+    close(input[0]);
+    if(write(input[1], "exit\n", 5) != 5)
+      perror("Error writing to the shell.");
+    close(input[1]);
+    waitpid(p_id, NULL, 0);
+  }
+  return (double) (stats_now() - start) / iterations;
+}
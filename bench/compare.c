@@ -0,0 +1,338 @@
+/* *
+ * compare.c
+ *
+ * Comparative benchmarks of tinysh against the reference shells installed on this machine.
+ *
+ * usage: tinysh-compare [--shell=PATH] [--runs=N] [--scale=N]
+ *
+ * Every workload below is written out as a script that repeats one command line and fed on
+ * standard input to tinysh and to each of dash, bash, and busybox sh that can be found in the path.
+ * Most workloads repeat a single command so that each line pays the full read, parse, and dispatch
+ * cost; the loop workload instead measures the shell's own while loop.  For each run the harness
+ * records the wall time, the number of processes created (from the "processes" counter in
+ * /proc/stat, so other activity on the machine adds noise), and the peak resident set size
+ * reported by wait4.  The median of the runs is printed in a side-by-side table.
+ *
+ * The while_status workload doubles as a check of exit statuses: its condition is a program that
+ * fails with its output redirected, so a shell that took that for success would loop forever.
+ *
+ * Workloads that need a feature a shell lacks (e.g. pathname globbing) are skipped for that shell,
+ * as detected by a probe script run before the workloads.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+
+#define MAX_SHELLS  4
+#define MAX_RUNS    15
+#define PROBE_FILE  "probe.txt"
+
+struct shell {
+  const char *name;      // Name in the results table.
+  char path[PATH_MAX];   // Executable.
+  const char *arg;       // Extra argument (e.g. "sh" for busybox), or NULL.
+  int has_glob;          // 1 if the shell expands pathname patterns.
+};
+
+struct workload {
+  const char *name;
+  const char *line;      // Command line repeated to make the script.
+  int reps;              // Number of repetitions, before scaling.
+  int needs_glob;
+};
+
+static const struct workload workloads[] = {
+  {"builtins", "cd .", 5000, 0},
+  {"test", "[ 1 -lt 2 ]", 5000, 0},
+  {"arith", "true $(( (7 * 6 + 1) % 5 ))", 5000, 0},
+  {"strings", "true ${PATH##*:} ${PATH%%:*} ${#PATH}", 5000, 0},
+  {"loop", "i=0; while [ $i -lt 5000 ]; do i=$((i + 1)); done", 1, 0},
+  {"while_status", "while /bin/false > log.txt; do true; done", 500, 0},
+  {"fork", "/bin/true", 500, 0},
+  {"pipeline", "seq 200 | cat | cat | cat | cat | cat | cat | wc -l > /dev/null", 50, 0},
+  {"redirection", "echo redirected >> log.txt", 500, 0},
+  {"cat_pipe", "cat /etc/passwd | wc -l | cat > /dev/null", 500, 0},
+  {"glob", "ls -d /usr/bin/* > /dev/null", 50, 1},
+};
+
+#define NUM_WORKLOADS (sizeof(workloads) / sizeof(workloads[0]))
+
+struct measurement {
+  double wall_ms;
+  long forks;
+  long maxrss_kb;
+  int skipped;
+};
+
+static char work_dir[] = "/tmp/tinysh-compare-XXXXXX";
+
+static int find_in_path(const char *name, char *buf);
+static int write_script(const char *file, const char *line, int reps);
+static int run_script(const struct shell *sh, const char *script, double *wall_ms, long *forks,
+                      long *maxrss_kb);
+static long processes_created(void);
+static int probe_glob(const struct shell *sh);
+static int cmp_double(const void *a, const void *b);
+static int cmp_long(const void *a, const void *b);
+
+int main(int argc, char *argv[]) {
+  int i, r, num_shells, runs, scale;
+  size_t w;
+  char script[PATH_MAX];
+  double walls[MAX_RUNS];
+  long forks[MAX_RUNS], rss[MAX_RUNS];
+  struct shell shells[MAX_SHELLS];
+  struct measurement results[NUM_WORKLOADS][MAX_SHELLS];
+  const char *tinysh = "bin/tinysh";
+  static const char *refs[] = { "dash", "bash", "busybox" };
+
+  runs = 3;
+  scale = 1;
+  for(i = 1; i < argc; i++) {
+    if(strncmp(argv[i], "--shell=", 8) == 0)
+      tinysh = argv[i] + 8;
+    else if(strncmp(argv[i], "--runs=", 7) == 0 && (runs = atoi(argv[i] + 7)) > 0 && runs <= MAX_RUNS)
+      ;
+    else if(strncmp(argv[i], "--scale=", 8) == 0 && (scale = atoi(argv[i] + 8)) > 0)
+      ;
+    else {
+      fprintf(stderr, "usage: %s [--shell=PATH] [--runs=1-%d] [--scale=N]\n", argv[0], MAX_RUNS);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // tinysh first, then every reference shell that is installed.
+  memset(shells, 0, sizeof(shells));
+  if(realpath(tinysh, shells[0].path) == NULL || access(shells[0].path, X_OK) < 0) {
+    fprintf(stderr, "Error:  %s is not executable; run make first.\n", tinysh);
+    return EXIT_FAILURE;
+  }
+  shells[0].name = "tinysh";
+  num_shells = 1;
+  for(i = 0; i < (int) (sizeof(refs) / sizeof(refs[0])); i++) {
+    if(!find_in_path(refs[i], shells[num_shells].path))
+      continue;
+    shells[num_shells].name = refs[i];
+    shells[num_shells].arg = strcmp(refs[i], "busybox") == 0 ? "sh" : NULL;
+    num_shells++;
+  }
+
+  if(mkdtemp(work_dir) == NULL || chdir(work_dir) < 0) {
+    perror("Error creating a working directory.");
+    return EXIT_FAILURE;
+  }
+  for(i = 0; i < num_shells; i++)
+    shells[i].has_glob = probe_glob(&shells[i]);
+
+  for(w = 0; w < NUM_WORKLOADS; w++) {
+    snprintf(script, sizeof(script), "%s.sh", workloads[w].name);
+    if(write_script(script, workloads[w].line, workloads[w].reps * scale) == -1)
+      return EXIT_FAILURE;
+    for(i = 0; i < num_shells; i++) {
+      memset(&results[w][i], 0, sizeof(results[w][i]));
+      if(workloads[w].needs_glob && !shells[i].has_glob) {
+        results[w][i].skipped = 1;
+        continue;
+      }
+      for(r = 0; r < runs; r++) {
+        if(run_script(&shells[i], script, &walls[r], &forks[r], &rss[r]) == -1)
+          return EXIT_FAILURE;
+      }
+      qsort(walls, runs, sizeof(*walls), cmp_double);
+      qsort(forks, runs, sizeof(*forks), cmp_long);
+      qsort(rss, runs, sizeof(*rss), cmp_long);
+      results[w][i].wall_ms = walls[runs / 2];
+      results[w][i].forks = forks[runs / 2];
+      results[w][i].maxrss_kb = rss[runs - 1];
+    }
+    unlink(script);
+  }
+  unlink("log.txt");
+  if(chdir("/") == 0)
+    rmdir(work_dir);
+
+  // Side-by-side table: one block of rows per workload, one column per shell.
+  printf("%-12s %-10s", "workload", "metric");
+  for(i = 0; i < num_shells; i++)
+    printf(" %10s", shells[i].name);
+  printf("\n");
+  for(w = 0; w < NUM_WORKLOADS; w++) {
+    printf("%-12s %-10s", workloads[w].name, "wall_ms");
+    for(i = 0; i < num_shells; i++) {
+      if(results[w][i].skipped)
+        printf(" %10s", "n/a");
+      else
+        printf(" %10.1f", results[w][i].wall_ms);
+    }
+    printf("\n%-12s %-10s", "", "forks");
+    for(i = 0; i < num_shells; i++) {
+      if(results[w][i].skipped)
+        printf(" %10s", "n/a");
+      else
+        printf(" %10ld", results[w][i].forks);
+    }
+    printf("\n%-12s %-10s", "", "maxrss_kb");
+    for(i = 0; i < num_shells; i++) {
+      if(results[w][i].skipped)
+        printf(" %10s", "n/a");
+      else
+        printf(" %10ld", results[w][i].maxrss_kb);
+    }
+    printf("\n");
+  }
+  return EXIT_SUCCESS;
+}
+
+/* *
+ * Searches PATH for an executable called name, writing its path into buf.
+ *
+ * Returns - 1 if found, 0 if not.
+ * */
+static int find_in_path(const char *name, char *buf) {
+  size_t len;
+  const char *dir, *env;
+  if((env = getenv("PATH")) == NULL)
+    env = "/bin:/usr/bin";
+  for(dir = env; ; dir += len + 1) {
+    len = strcspn(dir, ":");
+    if(len > 0 && snprintf(buf, PATH_MAX, "%.*s/%s", (int) len, dir, name) < PATH_MAX
+       && access(buf, X_OK) == 0)
+      return 1;
+    if(dir[len] == '\0')
+      return 0;
+  }
+}
+
+/* *
+ * Writes line, reps times, to file.
+ * */
+static int write_script(const char *file, const char *line, int reps) {
+  int i;
+  FILE *fp;
+  if((fp = fopen(file, "w")) == NULL) {
+    perror("Error creating a script.");
+    return -1;
+  }
+  for(i = 0; i < reps; i++)
+    fprintf(fp, "%s\n", line);
+  if(fclose(fp) != 0) {
+    perror("Error writing a script.");
+    return -1;
+  }
+  return 0;
+}
+
+/* *
+ * Runs the shell sh with script as its standard input and its output discarded, measuring the
+ * wall time, processes created, and peak resident set size.
+ * */
+static int run_script(const struct shell *sh, const char *script, double *wall_ms, long *forks,
+                      long *maxrss_kb) {
+  int p_id, status, in_fd, null_fd;
+  long before;
+  struct timespec start, end;
+  struct rusage usage;
+
+  before = processes_created();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if((p_id = fork()) < 0) {
+    perror("Error forking a process.");
+    return -1;
+  }
+  if(p_id == 0) {
+    if((in_fd = open(script, O_RDONLY)) < 0 || (null_fd = open("/dev/null", O_WRONLY)) < 0) {
+      perror("Error opening a script.");
+      _Exit(EXIT_FAILURE);
+    }
+    dup2(in_fd, STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+    close(in_fd);
+    close(null_fd);
+    if(sh->arg != NULL)
+      execl(sh->path, sh->path, sh->arg, (char *) NULL);
+    else
+      execl(sh->path, sh->path, (char *) NULL);
+    _Exit(127);
+  }
+  if(wait4(p_id, &status, 0, &usage) < 0) {
+    perror("Error waiting for a process.");
+    return -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  *wall_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+  // Don't count the fork of the shell itself.
+  *forks = processes_created() - before - 1;
+  *maxrss_kb = usage.ru_maxrss;
+  return 0;
+}
+
+/* *
+ * Returns - The number of processes created since boot, or 0 if /proc/stat can't be read.
+ * */
+static long processes_created(void) {
+  long count = 0;
+  char line[256];
+  FILE *fp;
+  if((fp = fopen("/proc/stat", "r")) == NULL)
+    return 0;
+  while(fgets(line, sizeof(line), fp) != NULL) {
+    if(sscanf(line, "processes %ld", &count) == 1)
+      break;
+  }
+  fclose(fp);
+  return count;
+}
+
+/* *
+ * Returns - 1 if sh expands "/u*" to (at least) /usr, 0 if not.
+ * */
+static int probe_glob(const struct shell *sh) {
+  double wall_ms;
+  long forks, rss;
+  char buf[256];
+  ssize_t n;
+  int fd, found;
+  if(write_script("probe.sh", "ls -d /u* > " PROBE_FILE, 1) == -1)
+    return 0;
+  unlink(PROBE_FILE);
+  run_script(sh, "probe.sh", &wall_ms, &forks, &rss);
+  found = 0;
+  if((fd = open(PROBE_FILE, O_RDONLY)) >= 0) {
+    if((n = read(fd, buf, sizeof(buf) - 1)) > 0) {
+      buf[n] = '\0';
+      found = strstr(buf, "/usr") != NULL;
+    }
+    close(fd);
+  }
+  unlink(PROBE_FILE);
+  unlink("probe.sh");
+  return found;
+}
+
+/* *
+ * Orders doubles, and longs, for qsort.
+ * */
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+static int cmp_long(const void *a, const void *b) {
+  long x = *(const long *) a, y = *(const long *) b;
+  return (x > y) - (x < y);
+}
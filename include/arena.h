@@ -0,0 +1,42 @@
+/*
+ * arena.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+
+struct arena_block;
+
+/*
+ * A bump allocator: blocks of memory handed out in pieces, and freed all at once.
+ */
+struct arena {
+  struct arena_block *blocks;  // Newest block first.
+  size_t bytes;                // Bytes handed out, over all blocks.
+};
+
+/*
+ * A point in the life of an arena that it can be released back to, freeing everything allocated
+ * since.
+ */
+struct arena_mark {
+  struct arena_block *block;  // Newest block at the time, or NULL.
+  struct arena_block *next;   // The block that was behind it.
+  size_t used;                // Bytes used in it.
+  size_t bytes;
+};
+
+char* arena_alloc(struct arena *arena, size_t size);
+void* arena_alloc_object(struct arena *arena, size_t size);
+char* arena_strndup(struct arena *arena, const char *str, size_t len);
+int arena_adopt(struct arena *arena, char *data, size_t size);
+void arena_mark(struct arena *arena, struct arena_mark *mark);
+void arena_release(struct arena *arena, const struct arena_mark *mark);
+void arena_free(struct arena *arena);
+
+#endif /* !ARENA_H */
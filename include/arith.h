@@ -0,0 +1,18 @@
+/*
+ * arith.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <stdlib.h>
+
+int arith_eval(const char *expr, long long *result);
+int arith_number(const char *str, size_t len, long long *num);
+void arith_clear(void);
+int let_handle(char **cmd, size_t num_cmd);
+
+#endif /* !ARITH_H */
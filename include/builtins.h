@@ -0,0 +1,38 @@
+/*
+ * builtins.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <stdlib.h>
+
+typedef int (*builtin_handler)(char **cmd, size_t num_cmd);
+
+struct func;
+
+/*
+ * What a command name runs in the shell process: a builtin, a function, or both, in which case the
+ * function overrides the builtin.
+ */
+struct command {
+  const char *name;
+  builtin_handler handler;  // NULL if the name is only a function's.
+  struct func *func;        // NULL if no function has the name.
+};
+
+builtin_handler builtin_lookup(const char *name);
+const struct command* command_lookup(const char *name);
+int command_define(const char *name, struct func *func, struct func **old);
+void command_clear(void);
+int echo_handle(char **cmd, size_t num_cmd);
+int printf_handle(char **cmd, size_t num_cmd);
+int test_handle(char **cmd, size_t num_cmd);
+int cond_handle(char **cmd, size_t num_cmd);
+int true_handle(char **cmd, size_t num_cmd);
+int false_handle(char **cmd, size_t num_cmd);
+
+#endif /* !BUILTINS_H */
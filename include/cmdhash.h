@@ -0,0 +1,19 @@
+/*
+ * cmdhash.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef CMDHASH_H
+#define CMDHASH_H
+
+#include <stdlib.h>
+
+const char* cmdhash_lookup(const char *name);
+void cmdhash_warm(char **cmd);
+void cmdhash_forget(const char *name);
+void cmdhash_clear(void);
+int hash_handle(char **cmd, size_t num_cmd);
+
+#endif /* !CMDHASH_H */
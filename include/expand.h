@@ -0,0 +1,31 @@
+/*
+ * expand.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include <stdlib.h>
+
+#define EXPAND_SEQ_SIZE 24  // Size of a formatted value of a brace sequence.
+
+/*
+ * A brace sequence, {first..last..incr}: count values starting at first, step apart, formatted as
+ * letters if chars is set and otherwise as integers padded with zeros to width.
+ */
+struct expand_seq {
+  long long first;
+  long long step;
+  unsigned long long count;
+  int width;
+  int chars;
+};
+
+int expand_line(char ***cmds, size_t *num_cmds);
+int expand_seq(const char *word, struct expand_seq *seq);
+size_t expand_seq_format(const struct expand_seq *seq, unsigned long long i, char *buf);
+
+#endif /* !EXPAND_H */
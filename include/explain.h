@@ -0,0 +1,15 @@
+/*
+ * explain.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef EXPLAIN_H
+#define EXPLAIN_H
+
+#include <stdlib.h>
+
+int explain_handle(char **cmd, size_t num_cmd);
+
+#endif /* !EXPLAIN_H */
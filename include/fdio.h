@@ -0,0 +1,16 @@
+/*
+ * fdio.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef FDIO_H
+#define FDIO_H
+
+#include <stdlib.h>
+
+int fd_read_all(int fd, void *buf, size_t len);
+int fd_write_all(int fd, const void *buf, size_t len);
+
+#endif /* !FDIO_H */
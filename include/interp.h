@@ -0,0 +1,24 @@
+/*
+ * interp.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct func;
+
+int interp_wants(char **cmds);
+int interp_line(char ***cmds, size_t *num_cmds, FILE *more, int *exit_flag);
+int interp_forks(char **cmds, size_t num_cmds, int *redirected);
+int interp_call(struct func *func, char **cmds, size_t num_cmds, int *exit_flag);
+char** interp_params(size_t *num);
+int return_handle(char **cmd, size_t num_cmd);
+void interp_clear(void);
+
+#endif /* !INTERP_H */
@@ -0,0 +1,65 @@
+/*
+ * mem.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef MEM_H
+#define MEM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * The parts of the shell whose allocations are counted separately.
+ */
+enum mem_subsystem {
+  MEM_PARSE,    // Command lines and their tokens.
+  MEM_PATH,     // The paths read from the path file.
+  MEM_EXEC,     // Argument lists built to run commands and pipelines.
+  MEM_HASH,     // The command hash.
+  MEM_STATS,    // Command statistics.
+  MEM_TRACE,    // Trace buffers.
+  MEM_VARS,     // Shell variables, compiled arithmetic, and patterns.
+  MEM_NUM_SUBSYSTEMS
+};
+
+/*
+ * The functions every allocation goes through.  usable_size returns the number of bytes actually
+ * reserved for a block, which is what the counters count, so that a block is always freed with
+ * the same size it was allocated with.
+ */
+struct mem_allocator {
+  void* (*malloc)(size_t size);
+  void* (*realloc)(void *ptr, size_t size);
+  void (*free)(void *ptr);
+  size_t (*usable_size)(void *ptr);
+};
+
+/*
+ * Allocation counters of one subsystem.
+ */
+struct mem_counters {
+  uint64_t calls;        // Calls that allocated or resized a block.
+  uint64_t frees;        // Calls that freed a block.
+  uint64_t total_bytes;  // Bytes allocated over the life of the shell.
+  size_t blocks;         // Blocks currently allocated.
+  size_t bytes;          // Bytes currently allocated.
+  size_t peak_bytes;     // High-water mark of bytes.
+};
+
+void mem_set_allocator(const struct mem_allocator *alloc);
+void* mem_malloc(int subsys, size_t size);
+void* mem_calloc(int subsys, size_t num, size_t size);
+void* mem_realloc(int subsys, void *ptr, size_t size);
+char* mem_strdup(int subsys, const char *str);
+void mem_free(int subsys, void *ptr);
+ssize_t mem_getline(int subsys, char **line, size_t *size, FILE *fp);
+void mem_line_report(void);
+int mem_leak_report(void);
+int mem_handle(char **cmd, size_t num_cmd);
+
+#endif /* !MEM_H */
@@ -0,0 +1,16 @@
+/*
+ * memo.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdlib.h>
+
+int memo_handle(char **cmd, size_t num_cmd);
+int memo_run(char **cmd);
+
+#endif /* !MEMO_H */
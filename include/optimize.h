@@ -0,0 +1,17 @@
+/*
+ * optimize.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "pipeline.h"
+
+int optimize_line(char **cmds, struct pipeline *pl, void (*note)(const char *rewrite));
+int optimize_pipeline(struct pipeline *pl, void (*note)(const char *rewrite));
+int optimize_devnull(void);
+
+#endif /* !OPTIMIZE_H */
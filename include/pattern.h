@@ -0,0 +1,27 @@
+/*
+ * pattern.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdlib.h>
+#include <regex.h>
+
+struct pattern;
+
+const struct pattern* pattern_compile(const char *text, size_t len);
+int pattern_match(const struct pattern *pat, const char *str, size_t len);
+int pattern_prefix(const struct pattern *pat, const char *str, size_t len, int longest,
+                   size_t *match_len);
+int pattern_suffix(const struct pattern *pat, const char *str, size_t len, int longest,
+                   size_t *match_len);
+int pattern_find(const struct pattern *pat, const char *str, size_t len, size_t *start,
+                 size_t *match_len);
+const regex_t* pattern_regex(const char *text, char *error, size_t size);
+void pattern_clear(void);
+
+#endif /* !PATTERN_H */
@@ -0,0 +1,50 @@
+/*
+ * pipeline.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/*
+ * One command of a pipeline, along with what became of it.
+ */
+struct stage {
+  char **argv;           // Null-terminated arguments, pointing into the parsed command line.
+  pid_t pid;             // Process running the stage, or 0 if it was not started.
+  int status;            // Wait status of the stage.
+  uint64_t end_ns;       // Time the stage was reaped, from stats_now.
+  struct rusage usage;   // Resource usage of the stage, from wait4.
+  int (*builtin)(char **argv, size_t num_argv);  // Handler to run in place of argv, or NULL.
+  int chained;           // 1 to run in the next stage's process, with the output discarded.
+};
+
+/*
+ * A command line of the form "cmd1 [< file] | cmd2 | ... | cmdN [> file | >> file]".
+ */
+struct pipeline {
+  struct stage *stages;
+  size_t num_stages;
+  const char *in_file;   // File the first stage's input is redirected from, or NULL.
+  const char *out_file;  // File the last stage's output is redirected to, or NULL.
+  int out_fd;            // Open descriptor to use in place of opening out_file, or -1.
+  int append;            // 1 to append to out_file, 0 to overwrite it.
+  int dropped_cat;       // 1 if the optimizer dropped a trailing cat, whose status of 0 is used.
+  uint64_t start_ns;     // Time the first stage was started.
+  uint64_t end_ns;       // Time the last stage was reaped.
+};
+
+int pipeline_parse(char **cmds, struct pipeline *pl, int quiet);
+int pipeline_run(struct pipeline *pl);
+int pipeline_dispatch(struct pipeline *pl);
+void pipeline_free(struct pipeline *pl);
+int time_handle(char **cmd, size_t num_cmd);
+
+#endif /* !PIPELINE_H */
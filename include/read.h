@@ -0,0 +1,18 @@
+/*
+ * read.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef READ_H
+#define READ_H
+
+#include <stdlib.h>
+
+int read_handle(char **cmd, size_t num_cmd);
+int mapfile_handle(char **cmd, size_t num_cmd);
+void read_clear(void);
+int read_redirect_stdin(int redirected);
+
+#endif /* !READ_H */
@@ -0,0 +1,25 @@
+/*
+ * redirect.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef REDIRECT_H
+#define REDIRECT_H
+
+/*
+ * A redirection made in the shell process, for a command (or a list) that runs there.
+ */
+struct redirect {
+  int fd;         // Descriptor redirected, or -1 if there is nothing to undo.
+  int saved;      // Close-on-exec copy of the shell's own descriptor, put back afterwards.
+  int stdin_was;  // Whether stdin was already redirected, for read (see read_redirect_stdin.)
+};
+
+int redirect_op(const char *word);
+int redirect_only(char **cmds);
+int redirect_open(const char *op, const char *file, struct redirect *r);
+void redirect_restore(struct redirect *r);
+
+#endif /* !REDIRECT_H */
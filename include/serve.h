@@ -0,0 +1,32 @@
+/*
+ * serve.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdlib.h>
+
+/*
+ * Daemon mode wire protocol, shared by the shell and tinysh-client.
+ *
+ * Every message is a frame: a one byte frame type, a four byte payload length in network byte
+ * order, and the payload.  The client sends a single SERVE_FRAME_CMD frame holding a command
+ * line.  The shell answers with any number of SERVE_FRAME_STDOUT and SERVE_FRAME_STDERR frames
+ * carrying the command's output as it is produced, then one SERVE_FRAME_EXIT frame whose payload
+ * is the command's exit status as a four byte integer in network byte order.
+ */
+#define SERVE_FRAME_CMD     'C'
+#define SERVE_FRAME_STDOUT  'O'
+#define SERVE_FRAME_STDERR  'E'
+#define SERVE_FRAME_EXIT    'X'
+
+#define SERVE_HEADER_SIZE   5
+#define SERVE_MAX_CMD       65536   // Longest command line the shell accepts.
+
+int serve_run(const char *sock_path);
+
+#endif /* !SERVE_H */
@@ -0,0 +1,31 @@
+/*
+ * stats.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/resource.h>
+
+/*
+ * One run of a command, as measured by the shell.  All times are in nanoseconds.
+ */
+struct stats_sample {
+  uint64_t spawn_ns;     // Time taken to fork (or to hand the command to the zygote.)
+  uint64_t exec_ns;      // Time from the fork until the program was executed, or 0 if unknown.
+  uint64_t wall_ns;      // Time from the fork until the command finished.
+  struct rusage usage;   // Resource usage of the command, from wait4.
+};
+
+uint64_t stats_now(void);
+void stats_parsed(uint64_t parse_ns);
+void stats_record(const char *name, const struct stats_sample *sample);
+void stats_clear(void);
+int stats_handle(char **cmd, size_t num_cmd);
+
+#endif /* !STATS_H */
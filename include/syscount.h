@@ -0,0 +1,15 @@
+/*
+ * syscount.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef SYSCOUNT_H
+#define SYSCOUNT_H
+
+#include <stdlib.h>
+
+int syscount_handle(char **cmd, size_t num_cmd);
+
+#endif /* !SYSCOUNT_H */
@@ -8,12 +8,22 @@
 #ifndef TINYSH_H
 #define TINYSH_H
 
+#include "verbose.h"
 #include <stdlib.h>
 
+#define CMD_DELIMITERS " \t\n"  // Command and argument delimiters.
+
+extern int last_status;
+
 int set_path(char *file_path);
+char** path_dirs(void);
 int driver(void);
+int cmd_dispatch(char **cmds, size_t num_cmds, int *exit_flag);
+int is_builtin(char **cmds);
 char** tokenizer(const char *input, const char *delim, size_t *tok_num);
 int exec_dispatch(char **cmd, size_t num_cmd);
+int child_handle(char **cmd, size_t num_cmd);
+int wait_status_handle(int status);
 int is_special_feature(char **cmd);
 int exec(char **cmd);
 int pwd_handle(char **cmd, size_t num_cmd);
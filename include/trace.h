@@ -0,0 +1,34 @@
+/*
+ * trace.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+extern int trace_fd;
+
+/*
+ * Instrumentation helpers.  TRACE_BEGIN stamps the start of an operation into t, and TRACE_END
+ * records it as a complete event lasting until now.  TRACE_MARK records an instant event, for
+ * operations such as exec that never return.  All three cost a single branch when tracing is off.
+ */
+#define TRACE_BEGIN(t) \
+  ((t) = trace_fd >= 0 ? trace_now() : 0)
+#define TRACE_END(name, cat, t, detail) \
+  do { if(trace_fd >= 0) trace_event((name), (cat), (t), (detail)); } while(0)
+#define TRACE_MARK(name, cat, detail) \
+  do { if(trace_fd >= 0) trace_instant((name), (cat), (detail)); } while(0)
+
+int trace_open(const char *file);
+void trace_close(void);
+void trace_flush(void);
+uint64_t trace_now(void);
+void trace_event(const char *name, const char *cat, uint64_t start, const char *detail);
+void trace_instant(const char *name, const char *cat, const char *detail);
+
+#endif /* !TRACE_H */
@@ -0,0 +1,49 @@
+/*
+ * vars.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef VARS_H
+#define VARS_H
+
+#include "arena.h"
+#include <stdlib.h>
+
+struct saved_var;
+
+/*
+ * The variables made local to a function call: what each was before, kept in the arena of the
+ * scopes past mark, which is released when the call returns.
+ */
+struct vars_scope {
+  struct saved_var *saved;  // Most recently saved first.
+  struct arena_mark mark;
+  struct vars_scope *outer;
+};
+
+const char* vars_get(const char *name);
+int vars_get_int(const char *name, long long *num);
+int vars_set(const char *name, const char *value);
+int vars_set_len(const char *name, const char *value, size_t len);
+int vars_set_int(const char *name, long long num);
+const char* vars_array_get(const char *name, long long index);
+char** vars_array_items(const char *name, size_t *num);
+char** vars_array_keys(const char *name, size_t *num);
+int vars_array_set(const char *name, long long index, const char *value, size_t len);
+int vars_array_adopt(const char *name, char **items, size_t num, char *data, size_t size);
+int vars_is_assoc(const char *name);
+const char* vars_assoc_get(const char *name, const char *key, size_t key_len);
+int vars_assoc_set(const char *name, const char *key, size_t key_len, const char *value,
+                   size_t len);
+size_t vars_name_len(const char *str);
+int vars_assignments(char **cmd);
+void vars_clear(void);
+int assign_handle(char **cmd, size_t num_cmd);
+int declare_handle(char **cmd, size_t num_cmd);
+void vars_push_scope(struct vars_scope *s);
+void vars_pop_scope(void);
+int local_handle(char **cmd, size_t num_cmd);
+
+#endif /* !VARS_H */
@@ -0,0 +1,58 @@
+/*
+ * verbose.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef VERBOSE_H
+#define VERBOSE_H
+
+#include <stdlib.h>
+
+/*
+ * Verbose mode categories.  Each narration message belongs to one of them, and the verbose builtin
+ * can enable any combination (e.g. "verbose fd,proc".)
+ */
+#define V_PROC  0x1   // Forks, waits, execs, and builtins.
+#define V_FD    0x2   // Pipes, opens, dup2s, and closes.
+#define V_MEM   0x4   // Allocations and deallocations.
+#define V_PARSE 0x8   // Tokenizing and splitting command lines.
+#define V_ALL   (V_PROC | V_FD | V_MEM | V_PARSE)
+#define V_NUM_CATEGORIES 4
+
+/*
+ * Verbose mode levels.  Level 1 narrates each step the shell takes; level 2 adds the details of
+ * each step.
+ */
+#define V_LEVEL_STEPS   1
+#define V_LEVEL_DETAILS 2
+#define V_MAX_LEVEL     V_LEVEL_DETAILS
+
+/*
+ * verbose_flag holds one bit per (level, category) pair, with the categories of level n in bits
+ * V_NUM_CATEGORIES * (n - 1) and up, so that checking a message's level and category together is
+ * a single test against a constant mask.
+ */
+#define VERBOSE_MASK(level, cat) ((cat) << (V_NUM_CATEGORIES * ((level) - 1)))
+
+/*
+ * VERBOSE(cat) is true if step messages of any category in cat are enabled, and VERBOSE_AT(level,
+ * cat) does the same for the given level.  Building with -DNVERBOSE (make release) turns both into
+ * the constant 0, so the compiler drops every verbose message and the code that prints it.
+ */
+#ifdef NVERBOSE
+#define VERBOSE_AT(level, cat) 0
+#else
+#define VERBOSE_AT(level, cat) \
+  __builtin_expect((verbose_flag & VERBOSE_MASK((level), (cat))) != 0, 0)
+#endif
+#define VERBOSE(cat) VERBOSE_AT(V_LEVEL_STEPS, (cat))
+
+extern int verbose_flag;
+
+int verbose_enable(const char *categories, int level);
+int verbose_handle(char **cmd, size_t num_cmd);
+int brief_handle(char **cmd, size_t num_cmd);
+
+#endif /* !VERBOSE_H */
@@ -0,0 +1,18 @@
+/*
+ * writer.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdlib.h>
+
+int writer_write(int fd, const char *data, size_t len);
+int writer_puts(int fd, const char *str);
+int writer_printf(int fd, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int writer_flush(int fd);
+
+#endif /* !WRITER_H */
@@ -0,0 +1,19 @@
+/*
+ * zygote.h
+ * Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <stdlib.h>
+#include <sys/resource.h>
+
+int zygote_start(void);
+int zygote_active(void);
+int zygote_spawn(char **cmd, int *status, struct rusage *usage);
+void zygote_stop(void);
+
+#endif /* !ZYGOTE_H */
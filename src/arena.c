@@ -0,0 +1,200 @@
+/* *
+ * arena.c
+ *
+ * Arenas: bump allocators for many small strings that are freed together, such as the elements
+ * of an array variable.
+ *
+ * Each piece is carved out of the newest block, and a new block (of ARENA_BLOCK_SIZE, or larger
+ * for a large piece) is allocated when it runs out, so storing a string costs a pointer bump
+ * rather than a malloc, and the strings of an array sit next to each other in memory.  Pieces
+ * are never freed one at a time; the owner of an arena frees it, or builds a new one and copies
+ * over what is still in use.
+ *
+ * NOTES:
+ *   - Strings are packed with no padding between them.  A structure (such as a saved variable or
+ *     a parsed command) is allocated with arena_alloc_object, which aligns it.
+ *   - An arena used as a stack (such as the scopes of function calls) is marked before each push
+ *     and released back to the mark on each pop, so that it reuses its newest block rather than
+ *     allocating one for each push.
+ *   - A buffer that was filled some other way (e.g. a whole file read by mapfile) can be adopted
+ *     as a block, so that strings cut out of it in place need not be copied.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "arena.h"
+#include "mem.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE 4096  // Usual size of a block.
+#define ARENA_ALIGN      sizeof(long long)  // Alignment of the structures in an arena.
+
+/*
+ * A block of an arena.  The data of a block allocated here follows the header; the data of an
+ * adopted block is a separate allocation.
+ */
+struct arena_block {
+  struct arena_block *next;
+  char *data;
+  size_t used;
+  size_t size;
+};
+
+static void free_block(struct arena_block *block);
+
+/* *
+ * Allocates size bytes from arena.
+ *
+ * Returns - The bytes, valid until the arena is freed, or NULL if they could not be allocated.
+ * */
+char* arena_alloc(struct arena *arena, size_t size) {
+  struct arena_block *block = arena->blocks;
+  size_t block_size;
+
+  if(block == NULL || block->size - block->used < size) {
+    block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    if((block = mem_malloc(MEM_VARS, sizeof(*block) + block_size)) == NULL) {
+      perror("Error allocating memory for an arena.");
+      return NULL;
+    }
+    block->data = (char *) (block + 1);
+    block->used = 0;
+    block->size = block_size;
+    // A large piece gets a block of its own, behind the current one, which may still have room.
+    if(size > ARENA_BLOCK_SIZE && arena->blocks != NULL) {
+      block->next = arena->blocks->next;
+      arena->blocks->next = block;
+    }
+    else {
+      block->next = arena->blocks;
+      arena->blocks = block;
+    }
+  }
+  block->used += size;
+  arena->bytes += size;
+  return block->data + block->used - size;
+}
+
+/* *
+ * Allocates size bytes from arena for a structure, aligned to ARENA_ALIGN.  The data of a new
+ * block is aligned already, so only the current block needs padding.
+ *
+ * Returns - The bytes, valid until the arena is freed, or NULL if they could not be allocated.
+ * */
+void* arena_alloc_object(struct arena *arena, size_t size) {
+  struct arena_block *block = arena->blocks;
+  size_t pad;
+
+  if(block != NULL) {
+    pad = (ARENA_ALIGN - (uintptr_t) (block->data + block->used) % ARENA_ALIGN) % ARENA_ALIGN;
+    if(block->size - block->used >= pad + size) {
+      block->used += pad;
+      arena->bytes += pad;
+    }
+  }
+  return arena_alloc(arena, size);
+}
+
+/* *
+ * Copies the len characters of str into arena, null-terminated.
+ *
+ * Returns - The copy, or NULL if it could not be allocated.
+ * */
+char* arena_strndup(struct arena *arena, const char *str, size_t len) {
+  char *copy;
+  if((copy = arena_alloc(arena, len + 1)) == NULL)
+    return NULL;
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+/* *
+ * Makes data, a block of size bytes allocated with mem_malloc against MEM_VARS, part of arena, so
+ * that it is freed with it.  Nothing more is allocated from it.
+ *
+ * Returns - 0 on success, or -1 (with data freed) on failure.
+ * */
+int arena_adopt(struct arena *arena, char *data, size_t size) {
+  struct arena_block *block;
+  if((block = mem_malloc(MEM_VARS, sizeof(*block))) == NULL) {
+    perror("Error allocating memory for an arena.");
+    mem_free(MEM_VARS, data);
+    return -1;
+  }
+  block->data = data;
+  block->used = size;
+  block->size = size;
+  // Behind the current block, so that allocations keep using its room.
+  if(arena->blocks != NULL) {
+    block->next = arena->blocks->next;
+    arena->blocks->next = block;
+  }
+  else {
+    block->next = NULL;
+    arena->blocks = block;
+  }
+  arena->bytes += size;
+  return 0;
+}
+
+/* *
+ * Records in mark the point arena has reached, for arena_release.
+ * */
+void arena_mark(struct arena *arena, struct arena_mark *mark) {
+  mark->block = arena->blocks;
+  mark->next = arena->blocks != NULL ? arena->blocks->next : NULL;
+  mark->used = arena->blocks != NULL ? arena->blocks->used : 0;
+  mark->bytes = arena->bytes;
+}
+
+/* *
+ * Frees everything allocated from arena since mark was recorded.  Marks recorded after it are no
+ * longer valid.
+ * */
+void arena_release(struct arena *arena, const struct arena_mark *mark) {
+  struct arena_block *block, *next;
+  for(block = arena->blocks; block != mark->block; block = next) {
+    next = block->next;
+    free_block(block);
+  }
+  if(block != NULL) {
+    // Large pieces and adopted buffers are put behind the newest block.
+    for(block = mark->block->next; block != mark->next; block = next) {
+      next = block->next;
+      free_block(block);
+    }
+    mark->block->next = mark->next;
+    mark->block->used = mark->used;
+  }
+  arena->blocks = mark->block;
+  arena->bytes = mark->bytes;
+}
+
+/* *
+ * Frees every block of arena.
+ * */
+void arena_free(struct arena *arena) {
+  struct arena_block *block, *next;
+  for(block = arena->blocks; block != NULL; block = next) {
+    next = block->next;
+    free_block(block);
+  }
+  arena->blocks = NULL;
+  arena->bytes = 0;
+}
+
+/* *
+ * Frees block and its data.
+ * */
+static void free_block(struct arena_block *block) {
+  if(block->data != (char *) (block + 1))
+    mem_free(MEM_VARS, block->data);
+  mem_free(MEM_VARS, block);
+}
@@ -0,0 +1,756 @@
+/* *
+ * arith.c
+ *
+ * Arithmetic: the expressions of $(( )) and the let builtin.
+ *
+ * An expression is compiled by a Pratt (top down operator precedence) parser into a short
+ * program for a stack machine, which is then run over 64-bit integers.  The operators are those of
+ * C, with C's precedence and associativity: ++ and -- (before or after a variable), unary + - ! ~,
+ * * / %, + -, << >>, < <= > >=, == !=, &, ^, |, &&, ||, ?:, the assignments = *= /= %= += -=
+ * <<= >>= &= ^= |=, and the comma.  Numbers are decimal, octal (0NNN), hexadecimal (0xNNN), or
+ * in any base from 2 to 36 (BASE#NNN), and variables are named without a $.  A variable whose value
+ * is not a number is evaluated as an expression in turn, so e.g. a variable holding the name of
+ * another variable has that variable's value.
+ *
+ * NOTES:
+ *   - Compiled programs are cached, keyed on the text of the expression, so an expression that is
+ *     evaluated over and over (e.g. a loop counter) is parsed once.  Variables are referred to by
+ *     name, so the program does not depend on their values.  The cache is emptied when it is full.
+ *   - Arithmetic on variables goes through their integer values (see vars.c), so a counter is
+ *     neither parsed nor formatted as a string from one evaluation to the next.
+ *   - As in C, && and || evaluate their right operand, and ?: the branch, only when needed, so
+ *     e.g. "x != 0 && y / x" does not divide by zero.  Overflow wraps around.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "arith.h"
+#include "vars.h"
+#include "tinysh.h"
+#include "mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARITH_STACK         64    // Most values an expression may have on the stack at once.
+#define ARITH_BUCKETS       256   // Buckets of the cache.  Must be a power of two.
+#define ARITH_CACHE_LIMIT   1024  // Most expressions kept in the cache.
+#define ARITH_MAX_RECURSION 16    // Most variables whose values are expressions, evaluated in turn.
+
+/*
+ * Binding powers of the operators, from the loosest to the tightest.
+ */
+enum {
+  BP_NONE, BP_COMMA, BP_ASSIGN, BP_TERNARY, BP_OR, BP_AND, BP_BITOR, BP_XOR, BP_BITAND, BP_EQUAL,
+  BP_COMPARE, BP_SHIFT, BP_ADD, BP_MULTIPLY, BP_UNARY
+};
+
+/*
+ * Tokens of an expression.
+ */
+enum {
+  TOK_END, TOK_INVALID, TOK_NUMBER, TOK_NAME, TOK_LPAREN, TOK_RPAREN, TOK_INC, TOK_DEC, TOK_NOT,
+  TOK_BITNOT, TOK_QUESTION, TOK_COLON, TOK_COMMA, TOK_AND, TOK_OR,
+  // Binary operators that are also instructions, in the same order as the OP_ ones.
+  TOK_MUL, TOK_DIV, TOK_MOD, TOK_ADD, TOK_SUB, TOK_SHL, TOK_SHR, TOK_LT, TOK_LE, TOK_GT, TOK_GE,
+  TOK_EQ, TOK_NE, TOK_BITAND, TOK_XOR, TOK_BITOR,
+  // Assignments, with the compound ones in the same order as the binary operators (leaving gaps
+  // for the comparisons, which have none.)
+  TOK_ASSIGN, TOK_MUL_ASSIGN, TOK_DIV_ASSIGN, TOK_MOD_ASSIGN, TOK_ADD_ASSIGN, TOK_SUB_ASSIGN,
+  TOK_SHL_ASSIGN, TOK_SHR_ASSIGN, TOK_BITAND_ASSIGN = TOK_SHR_ASSIGN + 7, TOK_XOR_ASSIGN,
+  TOK_BITOR_ASSIGN
+};
+
+#define IS_BINARY(tok) ((tok) >= TOK_MUL && (tok) <= TOK_BITOR)
+#define IS_ASSIGN(tok) ((tok) >= TOK_ASSIGN && (tok) <= TOK_BITOR_ASSIGN)
+
+/*
+ * Instructions of the stack machine.
+ */
+enum {
+  OP_NUMBER,     // Push num.
+  OP_LOAD,       // Push the variable name.
+  OP_STORE,      // Set the variable name to the top of the stack, leaving it there.
+  OP_PRE_INC,    // Add num to the variable name and push the result.
+  OP_POST_INC,   // Push the variable name, then add num to it.
+  OP_NEGATE, OP_NOT, OP_BITNOT,
+  // Binary operators, in the same order as the TOK_ ones.
+  OP_MUL, OP_DIV, OP_MOD, OP_ADD, OP_SUB, OP_SHL, OP_SHR, OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+  OP_BITAND, OP_XOR, OP_BITOR,
+  OP_BOOL,       // Replace the top of the stack with 1 if it is not 0.
+  OP_AND_JUMP,   // Pop; if it was 0, push 0 and jump to num.
+  OP_OR_JUMP,    // Pop; if it was not 0, push 1 and jump to num.
+  OP_JUMP_ZERO,  // Pop; if it was 0, jump to num.
+  OP_JUMP,       // Jump to num.
+  OP_POP         // Pop.
+};
+
+/*
+ * An instruction.
+ */
+struct arith_op {
+  int op;
+  long long num;     // Operand of OP_NUMBER, OP_PRE_INC, OP_POST_INC, and the jumps.
+  const char *name;  // Variable of OP_LOAD, OP_STORE, OP_PRE_INC, and OP_POST_INC.
+};
+
+/*
+ * A compiled expression, in the cache.
+ */
+struct arith_code {
+  char *text;               // Text of the expression.
+  struct arith_op *ops;
+  size_t num_ops;
+  char *names;              // The variable names of ops, each null-terminated.  A name appears
+                            // at most twice (in a compound assignment), so this is allocated
+                            // with twice the length of text.
+  struct arith_code *next;  // Next expression in the same bucket.
+};
+
+/*
+ * State of the compiler.
+ */
+struct arith_parser {
+  const char *pos;        // Next character to read.
+  int tok;                // Current token.
+  const char *tok_start;  // Text of the current token.
+  size_t tok_len;
+  long long num;          // Value of a TOK_NUMBER.
+  struct arith_code *code;
+  size_t ops_size;        // Instructions allocated in code.
+  size_t names_len;       // Bytes used in code->names.
+  int depth;              // Depth of nested subexpressions.
+  int stack;              // Values on the stack at this point of the program.
+  const char *error;      // The first error found, or NULL.
+};
+
+/*
+ * Operators and the tokens they are, longest first.
+ */
+static const struct {
+  const char *text;
+  int tok;
+} operators[] = {
+  {"<<=", TOK_SHL_ASSIGN}, {">>=", TOK_SHR_ASSIGN}, {"++", TOK_INC}, {"--", TOK_DEC},
+  {"<<", TOK_SHL}, {">>", TOK_SHR}, {"<=", TOK_LE}, {">=", TOK_GE}, {"==", TOK_EQ},
+  {"!=", TOK_NE}, {"&&", TOK_AND}, {"||", TOK_OR}, {"*=", TOK_MUL_ASSIGN},
+  {"/=", TOK_DIV_ASSIGN}, {"%=", TOK_MOD_ASSIGN}, {"+=", TOK_ADD_ASSIGN}, {"-=", TOK_SUB_ASSIGN},
+  {"&=", TOK_BITAND_ASSIGN}, {"^=", TOK_XOR_ASSIGN}, {"|=", TOK_BITOR_ASSIGN}, {"(", TOK_LPAREN},
+  {")", TOK_RPAREN}, {"!", TOK_NOT}, {"~", TOK_BITNOT}, {"?", TOK_QUESTION}, {":", TOK_COLON},
+  {",", TOK_COMMA}, {"*", TOK_MUL}, {"/", TOK_DIV}, {"%", TOK_MOD}, {"+", TOK_ADD},
+  {"-", TOK_SUB}, {"<", TOK_LT}, {">", TOK_GT}, {"&", TOK_BITAND}, {"^", TOK_XOR},
+  {"|", TOK_BITOR}, {"=", TOK_ASSIGN}, {NULL, TOK_END}
+};
+
+static struct arith_code *cache[ARITH_BUCKETS];
+static size_t cached;
+
+static struct arith_code* compile(const char *expr);
+static int parse(struct arith_parser *p, int rbp);
+static int parse_prefix(struct arith_parser *p, int rbp);
+static int parse_infix(struct arith_parser *p, int tok);
+static int binding_power(int tok);
+static void next_token(struct arith_parser *p);
+static size_t emit(struct arith_parser *p, int op, long long num, const char *name, size_t len);
+static void code_free(struct arith_code *code);
+static int run(const struct arith_code *code, long long *result);
+static int load(const struct arith_code *code, const char *name, long long *num);
+static unsigned long expr_hash(const char *expr);
+
+/* *
+ * Evaluates the arithmetic expression expr into result, compiling it if it is not in the cache.
+ * Errors are printed.
+ *
+ * Returns - 0 on success, or -1 if expr is not a valid expression or cannot be evaluated.
+ * */
+int arith_eval(const char *expr, long long *result) {
+  unsigned long bucket;
+  struct arith_code *code;
+
+  bucket = expr_hash(expr) & (ARITH_BUCKETS - 1);
+  for(code = cache[bucket]; code != NULL; code = code->next) {
+    if(strcmp(code->text, expr) == 0)
+      return run(code, result);
+  }
+  if(cached >= ARITH_CACHE_LIMIT)
+    arith_clear();
+  if((code = compile(expr)) == NULL)
+    return -1;
+  if(VERBOSE_AT(V_LEVEL_DETAILS, V_PARSE))
+    printf("  Compiled the expression %s into %zu instructions.\n", expr, code->num_ops);
+  code->next = cache[bucket];
+  cache[bucket] = code;
+  cached++;
+  return run(code, result);
+}
+
+/* *
+ * Reads the len characters of str, surrounded by any blanks and preceded by an optional sign, as
+ * a decimal, octal (0NNN), hexadecimal (0xNNN), or base BASE (BASE#NNN) integer into num.
+ *
+ * Returns - 0 on success, or -1 if str is not an integer.
+ * */
+int arith_number(const char *str, size_t len, long long *num) {
+  const char *end = str + len;
+  unsigned long long value, base;
+  int digit, negative;
+
+  for(; str < end && (*str == ' ' || *str == '\t' || *str == '\n'); str++)
+    ;
+  for(; end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n'); end--)
+    ;
+  negative = 0;
+  if(str < end && (*str == '-' || *str == '+'))
+    negative = *str++ == '-';
+  if(str == end)
+    return -1;
+
+  base = 10;
+  if(end - str > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+    base = 16;
+    str += 2;
+  }
+  else if(end - str > 1 && str[0] == '0') {
+    base = 8;
+    str++;
+  }
+  else if(memchr(str, '#', end - str) != NULL) {
+    for(base = 0; *str != '#'; str++) {
+      if(*str < '0' || *str > '9' || (base = base * 10 + (*str - '0')) > 36)
+        return -1;
+    }
+    if(base < 2 || ++str == end)
+      return -1;
+  }
+  for(value = 0; str < end; str++) {
+    if(*str >= '0' && *str <= '9')
+      digit = *str - '0';
+    else if(*str >= 'a' && *str <= 'z')
+      digit = *str - 'a' + 10;
+    else if(*str >= 'A' && *str <= 'Z')
+      digit = *str - 'A' + 10;
+    else
+      return -1;
+    if((unsigned long long) digit >= base)
+      return -1;
+    value = value * base + digit;
+  }
+  *num = (long long) (negative ? -value : value);
+  return 0;
+}
+
+/* *
+ * Forgets every compiled expression.
+ * */
+void arith_clear(void) {
+  size_t i;
+  struct arith_code *code, *next;
+  for(i = 0; i < ARITH_BUCKETS; i++) {
+    for(code = cache[i]; code != NULL; code = next) {
+      next = code->next;
+      code_free(code);
+    }
+    cache[i] = NULL;
+  }
+  cached = 0;
+}
+
+/* *
+ * Handler for the let builtin.
+ *
+ * let expr [expr ...]
+ *
+ * Evaluates each arithmetic expression in turn.  The exit status is 0 if the value of the last one
+ * is not 0, and 1 if it is 0 or an expression is invalid.
+ * */
+int let_handle(char **cmd, size_t num_cmd) {
+  size_t i;
+  long long result;
+  if(num_cmd < 2) {
+    fprintf(stderr, "let: expression expected\n");
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  for(i = 1; i < num_cmd; i++) {
+    if(arith_eval(cmd[i], &result) == -1) {
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+  }
+  last_status = result != 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  return result != 0 ? 0 : -1;
+}
+
+/* *
+ * Compiles expr.  Errors are printed.
+ *
+ * Returns - The compiled expression, or NULL if expr is not valid.
+ * */
+static struct arith_code* compile(const char *expr) {
+  size_t len;
+  struct arith_parser p;
+  struct arith_code *code;
+
+  len = strlen(expr);
+  if((code = mem_calloc(MEM_VARS, 1, sizeof(*code))) == NULL
+     || (code->text = mem_strdup(MEM_VARS, expr)) == NULL
+     || (code->names = mem_malloc(MEM_VARS, 2 * (len + 1))) == NULL) {
+    perror("Error allocating memory for an expression.");
+    code_free(code);
+    return NULL;
+  }
+  memset(&p, 0, sizeof(p));
+  p.pos = expr;
+  p.code = code;
+  next_token(&p);
+  // An empty expression is 0.
+  if(p.tok == TOK_END)
+    emit(&p, OP_NUMBER, 0, NULL, 0);
+  else if(parse(&p, BP_NONE) == 0 && p.tok != TOK_END)
+    p.error = "syntax error in expression";
+
+  if(p.error != NULL) {
+    if(p.tok != TOK_END)
+      fprintf(stderr, "tinysh: %s: %s (error token is \"%s\")\n", expr, p.error, p.tok_start);
+    else
+      fprintf(stderr, "tinysh: %s: %s\n", expr, p.error);
+    code_free(code);
+    return NULL;
+  }
+  return code;
+}
+
+/* *
+ * Compiles the expression at the current token, up to the first operator that binds no tighter
+ * than rbp.
+ *
+ * Returns - 0 on success, or -1 on an error, which is left in p->error.
+ * */
+static int parse(struct arith_parser *p, int rbp) {
+  int tok;
+  if(++p->depth > ARITH_STACK) {
+    p->error = "expression nested too deeply";
+    return -1;
+  }
+  if(parse_prefix(p, rbp) == -1)
+    return -1;
+  while(binding_power(p->tok) > rbp) {
+    tok = p->tok;
+    next_token(p);
+    if(parse_infix(p, tok) == -1)
+      return -1;
+  }
+  p->depth--;
+  return p->error == NULL ? 0 : -1;
+}
+
+/* *
+ * Compiles the operand at the current token: a number, a variable (and an assignment to it, if
+ * the operators binding tighter than rbp allow one), a parenthesized expression, or a unary
+ * operator and its operand.
+ * */
+static int parse_prefix(struct arith_parser *p, int rbp) {
+  int tok = p->tok;
+  const char *name;
+  size_t len;
+
+  if(p->error != NULL)
+    return -1;
+  switch(tok) {
+    case TOK_NUMBER:
+      emit(p, OP_NUMBER, p->num, NULL, 0);
+      next_token(p);
+      return 0;
+    case TOK_NAME:
+      name = p->tok_start;
+      len = p->tok_len;
+      next_token(p);
+      if(p->tok == TOK_INC || p->tok == TOK_DEC) {
+        emit(p, OP_POST_INC, p->tok == TOK_INC ? 1 : -1, name, len);
+        next_token(p);
+        return 0;
+      }
+      if(!IS_ASSIGN(p->tok) || rbp >= BP_ASSIGN) {
+        emit(p, OP_LOAD, 0, name, len);
+        return 0;
+      }
+      // An assignment is right associative, and a compound one also loads the variable.
+      tok = p->tok;
+      next_token(p);
+      if(tok != TOK_ASSIGN)
+        emit(p, OP_LOAD, 0, name, len);
+      if(parse(p, BP_ASSIGN - 1) == -1)
+        return -1;
+      if(tok != TOK_ASSIGN)
+        emit(p, OP_MUL + (tok - TOK_MUL_ASSIGN), 0, NULL, 0);
+      emit(p, OP_STORE, 0, name, len);
+      return 0;
+    case TOK_INC:
+    case TOK_DEC:
+      next_token(p);
+      if(p->tok != TOK_NAME) {
+        p->error = "operand of ++ or -- must be a variable";
+        return -1;
+      }
+      emit(p, OP_PRE_INC, tok == TOK_INC ? 1 : -1, p->tok_start, p->tok_len);
+      next_token(p);
+      return 0;
+    case TOK_LPAREN:
+      next_token(p);
+      if(parse(p, BP_NONE) == -1)
+        return -1;
+      if(p->tok != TOK_RPAREN) {
+        p->error = "missing )";
+        return -1;
+      }
+      next_token(p);
+      return 0;
+    case TOK_ADD:
+    case TOK_SUB:
+    case TOK_NOT:
+    case TOK_BITNOT:
+      next_token(p);
+      if(parse(p, BP_UNARY) == -1)
+        return -1;
+      if(tok != TOK_ADD)
+        emit(p, tok == TOK_SUB ? OP_NEGATE : tok == TOK_NOT ? OP_NOT : OP_BITNOT, 0, NULL, 0);
+      return 0;
+    case TOK_END:
+      p->error = "operand expected";
+      return -1;
+    default:
+      p->error = "syntax error: operand expected";
+      return -1;
+  }
+}
+
+/* *
+ * Compiles the binary operator tok, whose left operand has been compiled, and its right operand.
+ * */
+static int parse_infix(struct arith_parser *p, int tok) {
+  size_t jump, skip;
+
+  if(IS_BINARY(tok)) {
+    // Left associative: the right operand stops at the next operator of the same binding power.
+    if(parse(p, binding_power(tok)) == -1)
+      return -1;
+    emit(p, OP_MUL + (tok - TOK_MUL), 0, NULL, 0);
+    return 0;
+  }
+  switch(tok) {
+    case TOK_AND:
+    case TOK_OR:
+      jump = emit(p, tok == TOK_AND ? OP_AND_JUMP : OP_OR_JUMP, 0, NULL, 0);
+      if(parse(p, binding_power(tok)) == -1)
+        return -1;
+      emit(p, OP_BOOL, 0, NULL, 0);
+      p->code->ops[jump].num = p->code->num_ops;
+      return 0;
+    case TOK_QUESTION:
+      jump = emit(p, OP_JUMP_ZERO, 0, NULL, 0);
+      if(parse(p, BP_NONE) == -1)
+        return -1;
+      if(p->tok != TOK_COLON) {
+        p->error = "expected : for conditional expression";
+        return -1;
+      }
+      next_token(p);
+      skip = emit(p, OP_JUMP, 0, NULL, 0);
+      p->code->ops[jump].num = p->code->num_ops;
+      // Only one of the branches leaves its value on the stack.
+      p->stack--;
+      if(parse(p, BP_TERNARY - 1) == -1)
+        return -1;
+      p->code->ops[skip].num = p->code->num_ops;
+      return 0;
+    case TOK_COMMA:
+      emit(p, OP_POP, 0, NULL, 0);
+      return parse(p, BP_COMMA);
+    default:
+      p->error = "attempted assignment to non-variable";
+      return -1;
+  }
+}
+
+/* *
+ * Returns - The binding power of tok as an infix operator, or BP_NONE if it is not one.
+ * */
+static int binding_power(int tok) {
+  switch(tok) {
+    case TOK_COMMA:    return BP_COMMA;
+    case TOK_QUESTION: return BP_TERNARY;
+    case TOK_OR:       return BP_OR;
+    case TOK_AND:      return BP_AND;
+    case TOK_BITOR:    return BP_BITOR;
+    case TOK_XOR:      return BP_XOR;
+    case TOK_BITAND:   return BP_BITAND;
+    case TOK_EQ:
+    case TOK_NE:       return BP_EQUAL;
+    case TOK_LT:
+    case TOK_LE:
+    case TOK_GT:
+    case TOK_GE:       return BP_COMPARE;
+    case TOK_SHL:
+    case TOK_SHR:      return BP_SHIFT;
+    case TOK_ADD:
+    case TOK_SUB:      return BP_ADD;
+    case TOK_MUL:
+    case TOK_DIV:
+    case TOK_MOD:      return BP_MULTIPLY;
+    default:           return IS_ASSIGN(tok) ? BP_ASSIGN : BP_NONE;
+  }
+}
+
+/* *
+ * Reads the next token of the expression into p.
+ * */
+static void next_token(struct arith_parser *p) {
+  size_t i, len;
+  while(*p->pos == ' ' || *p->pos == '\t' || *p->pos == '\n')
+    p->pos++;
+  p->tok_start = p->pos;
+  if(*p->pos == '\0') {
+    p->tok = TOK_END;
+    p->tok_len = 0;
+    return;
+  }
+  if(*p->pos >= '0' && *p->pos <= '9') {
+    for(len = 1; (p->pos[len] >= '0' && p->pos[len] <= '9') || (p->pos[len] >= 'a' && p->pos[len]
+        <= 'z') || (p->pos[len] >= 'A' && p->pos[len] <= 'Z') || p->pos[len] == '#'; len++)
+      ;
+    p->tok = TOK_NUMBER;
+    p->tok_len = len;
+    p->pos += len;
+    if(arith_number(p->tok_start, len, &p->num) == -1) {
+      p->tok = TOK_INVALID;
+      if(p->error == NULL)
+        p->error = "invalid number";
+    }
+    return;
+  }
+  if((len = vars_name_len(p->pos)) > 0) {
+    p->tok = TOK_NAME;
+    p->tok_len = len;
+    p->pos += len;
+    return;
+  }
+  for(i = 0; operators[i].text != NULL; i++) {
+    len = strlen(operators[i].text);
+    if(strncmp(p->pos, operators[i].text, len) == 0) {
+      p->tok = operators[i].tok;
+      p->tok_len = len;
+      p->pos += len;
+      return;
+    }
+  }
+  p->tok = TOK_INVALID;
+  p->tok_len = 1;
+  if(p->error == NULL)
+    p->error = "syntax error: invalid arithmetic operator";
+}
+
+/* *
+ * Appends an instruction to the program being compiled, copying the len characters of name into
+ * the program's names, and keeps track of how many values the program leaves on the stack.
+ *
+ * Returns - The index of the instruction.
+ * */
+static size_t emit(struct arith_parser *p, int op, long long num, const char *name, size_t len) {
+  struct arith_op *ops;
+  struct arith_code *code = p->code;
+
+  if(code->num_ops == p->ops_size) {
+    p->ops_size = p->ops_size ? p->ops_size * 2 : 8;
+    if((ops = mem_realloc(MEM_VARS, code->ops, p->ops_size * sizeof(*ops))) == NULL) {
+      perror("Error allocating memory for an expression.");
+      exit(EXIT_FAILURE);
+    }
+    code->ops = ops;
+  }
+  code->ops[code->num_ops].op = op;
+  code->ops[code->num_ops].num = num;
+  code->ops[code->num_ops].name = NULL;
+  if(name != NULL && len > 0) {
+    memcpy(code->names + p->names_len, name, len);
+    code->names[p->names_len + len] = '\0';
+    code->ops[code->num_ops].name = code->names + p->names_len;
+    p->names_len += len + 1;
+  }
+
+  switch(op) {
+    case OP_NUMBER:
+    case OP_LOAD:
+    case OP_PRE_INC:
+    case OP_POST_INC:
+      p->stack++;
+      break;
+    case OP_AND_JUMP:
+    case OP_OR_JUMP:
+    case OP_JUMP_ZERO:
+    case OP_POP:
+      p->stack--;
+      break;
+    default:
+      if(op >= OP_MUL && op <= OP_BITOR)
+        p->stack--;
+  }
+  if(p->stack > ARITH_STACK && p->error == NULL)
+    p->error = "expression too complex";
+  return code->num_ops++;
+}
+
+/* *
+ * Frees the compiled expression code.
+ * */
+static void code_free(struct arith_code *code) {
+  if(code == NULL)
+    return;
+  mem_free(MEM_VARS, code->text);
+  mem_free(MEM_VARS, code->ops);
+  mem_free(MEM_VARS, code->names);
+  mem_free(MEM_VARS, code);
+}
+
+/* *
+ * Runs the compiled expression code, leaving its value in result.  Errors are printed.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int run(const struct arith_code *code, long long *result) {
+  long long stack[ARITH_STACK + 1];
+  long long a, b, num;
+  size_t pc;
+  int sp = 0;
+  const struct arith_op *op;
+
+  for(pc = 0; pc < code->num_ops; pc++) {
+    op = &code->ops[pc];
+    switch(op->op) {
+      case OP_NUMBER:
+        stack[sp++] = op->num;
+        continue;
+      case OP_LOAD:
+        if(load(code, op->name, &stack[sp++]) == -1)
+          return -1;
+        continue;
+      case OP_STORE:
+        if(vars_set_int(op->name, stack[sp - 1]) == -1)
+          return -1;
+        continue;
+      case OP_PRE_INC:
+      case OP_POST_INC:
+        if(load(code, op->name, &num) == -1
+           || vars_set_int(op->name, (long long) ((unsigned long long) num + op->num)) == -1)
+          return -1;
+        stack[sp++] = op->op == OP_PRE_INC ? (long long) ((unsigned long long) num + op->num) : num;
+        continue;
+      case OP_NEGATE:
+        stack[sp - 1] = (long long) -(unsigned long long) stack[sp - 1];
+        continue;
+      case OP_NOT:
+        stack[sp - 1] = !stack[sp - 1];
+        continue;
+      case OP_BITNOT:
+        stack[sp - 1] = ~stack[sp - 1];
+        continue;
+      case OP_BOOL:
+        stack[sp - 1] = stack[sp - 1] != 0;
+        continue;
+      case OP_AND_JUMP:
+      case OP_OR_JUMP:
+        if((stack[sp - 1] != 0) == (op->op == OP_OR_JUMP)) {
+          stack[sp - 1] = op->op == OP_OR_JUMP;
+          pc = op->num - 1;
+        }
+        else {
+          sp--;
+        }
+        continue;
+      case OP_JUMP_ZERO:
+        if(stack[--sp] == 0)
+          pc = op->num - 1;
+        continue;
+      case OP_JUMP:
+        pc = op->num - 1;
+        continue;
+      case OP_POP:
+        sp--;
+        continue;
+    }
+
+    // Binary operators.
+    b = stack[--sp];
+    a = stack[sp - 1];
+    switch(op->op) {
+      case OP_MUL:    a = (long long) ((unsigned long long) a * (unsigned long long) b); break;
+      case OP_ADD:    a = (long long) ((unsigned long long) a + (unsigned long long) b); break;
+      case OP_SUB:    a = (long long) ((unsigned long long) a - (unsigned long long) b); break;
+      case OP_SHL:    a = (long long) ((unsigned long long) a << (b & 63)); break;
+      case OP_SHR:    a >>= b & 63; break;
+      case OP_LT:     a = a < b; break;
+      case OP_LE:     a = a <= b; break;
+      case OP_GT:     a = a > b; break;
+      case OP_GE:     a = a >= b; break;
+      case OP_EQ:     a = a == b; break;
+      case OP_NE:     a = a != b; break;
+      case OP_BITAND: a &= b; break;
+      case OP_XOR:    a ^= b; break;
+      case OP_BITOR:  a |= b; break;
+      case OP_DIV:
+      case OP_MOD:
+        if(b == 0) {
+          fprintf(stderr, "tinysh: %s: division by 0\n", code->text);
+          return -1;
+        }
+        // The one quotient that overflows wraps around, as the others do.
+        if(b == -1)
+          a = op->op == OP_DIV ? (long long) -(unsigned long long) a : 0;
+        else
+          a = op->op == OP_DIV ? a / b : a % b;
+        break;
+    }
+    stack[sp - 1] = a;
+  }
+  *result = stack[sp - 1];
+  return 0;
+}
+
+/* *
+ * Reads the value of the variable name, used by the expression code, into num.
+ * */
+static int load(const struct arith_code *code, const char *name, long long *num) {
+  static int depth;
+  int status;
+  struct arith_code *value;
+
+  if(vars_get_int(name, num) == 0)
+    return 0;
+  // A value that is not an integer is evaluated as an expression itself.  It is compiled apart from
+  // the cache, which may not be emptied while code is running.
+  if(depth >= ARITH_MAX_RECURSION) {
+    fprintf(stderr, "tinysh: %s: %s: expression recursion level exceeded\n", code->text, name);
+    return -1;
+  }
+  if((value = compile(vars_get(name))) == NULL)
+    return -1;
+  depth++;
+  status = run(value, num);
+  depth--;
+  code_free(value);
+  return status;
+}
+
+/* *
+ * FNV-1a hash of an expression.
+ * */
+static unsigned long expr_hash(const char *expr) {
+  unsigned long h = 14695981039346656037UL;
+  while(*expr) {
+    h ^= (unsigned char) *expr++;
+    h *= 1099511628211UL;
+  }
+  return h;
+}
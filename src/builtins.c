@@ -0,0 +1,1109 @@
+/* *
+ * builtins.c
+ *
+ * The echo, printf, test ([), [[, true, and false builtins.
+ *
+ * These commands are run often and do little, so forking and executing a program for each one
+ * costs far more than the command itself.  They are implemented here as POSIX describes them, and
+ * run in the shell process, or, as a stage of a pipeline, in the stage's process without an exec
+ * (see optimize.c.)  Their output goes through the buffered writer (see writer.c), so each command
+ * makes one write, and each sets last_status to its exit status: e.g. test is 0 if the expression
+ * is true, 1 if it is false, and 2 if it is invalid.
+ *
+ * [[ ]] shares the primaries of test, and adds pattern matching (see pattern.c) and regexes.  It
+ * is dispatched on its own rather than from the table below, since its < and > are comparisons,
+ * not redirections.
+ *
+ * Builtins are looked up in a hash table keyed on the name, which is filled from the table below
+ * the first time it is needed.  Shell functions (see interp.c) are defined in the same table, so a
+ * command is resolved to a function or a builtin with one lookup, before the path is searched for
+ * a program.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "builtins.h"
+#include "tinysh.h"
+#include "writer.h"
+#include "arith.h"
+#include "read.h"
+#include "interp.h"
+#include "vars.h"
+#include "pattern.h"
+#include "mem.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define TEST_TRUE  0
+#define TEST_FALSE 1
+#define TEST_ERROR 2
+
+#define SPEC_SIZE       64   // Size of a printf conversion specification, once rebuilt.
+#define REGEX_ERROR_SIZE 128  // Size of the reason a regex does not compile.
+
+#define DEFAULT_COMMANDS_CAPACITY 64  // Must be a power of two.
+#define COMMANDS_MAX_LOAD_PCT     70
+
+#define IS_OCTAL(c) ((c) >= '0' && (c) <= '7')
+
+/*
+ * A builtin that runs without forking.  Builtins implemented elsewhere (let, in arith.c, read and
+ * mapfile, in read.c, declare and local, in vars.c, and return, in interp.c) are listed here as
+ * well, so that they are dispatched the same way.
+ */
+struct builtin {
+  const char *name;
+  builtin_handler handler;
+};
+
+static const struct builtin builtins[] = {
+  {"echo", echo_handle},
+  {"printf", printf_handle},
+  {"test", test_handle},
+  {"[", test_handle},
+  {"true", true_handle},
+  {"false", false_handle},
+  {"let", let_handle},
+  {"read", read_handle},
+  {"mapfile", mapfile_handle},
+  {"readarray", mapfile_handle},
+  {"declare", declare_handle},
+  {"local", local_handle},
+  {"return", return_handle},
+  {NULL, NULL}
+};
+
+static struct command *commands;  // The dispatch table: builtins and functions, by name.
+static size_t capacity;
+static size_t used;
+
+/*
+ * Position of the test builtin's parser in its arguments.
+ */
+struct test_parser {
+  char **argv;
+  int pos;
+  int end;
+  int error;
+  int skip;   // 1 while [[ ]] parses primaries whose result does not matter.
+};
+
+static unsigned long name_hash(const char *name);
+static struct command* find_slot(const char *name);
+static struct command* insert(const char *name);
+static int builtin_status(int status);
+static char* unescape(const char *str, int echo, size_t *len, int *stop);
+static int printf_once(const char *fmt, char ***args, int *status);
+static const char* next_arg(char ***args);
+static int to_integer(const char *str, long long *value);
+static int to_unsigned(const char *str, unsigned long long *value);
+static int to_double(const char *str, double *value);
+static void put_padded(const char *data, size_t len, int width, int left);
+static int test_args(char **argv, int argc);
+static int test_expr(struct test_parser *p);
+static int test_and(struct test_parser *p);
+static int test_not(struct test_parser *p);
+static int test_primary(struct test_parser *p);
+static int test_unary(struct test_parser *p, const char *op, const char *arg);
+static int test_binary(struct test_parser *p, const char *left, const char *op, const char *right);
+static int newer(const struct stat *a, const struct stat *b);
+static int is_unary(const char *op);
+static int is_binary(const char *op);
+static int test_integer(struct test_parser *p, const char *str, long long *value);
+static int compare(const char *op, long long a, long long b);
+static int cond_or(struct test_parser *p);
+static int cond_and(struct test_parser *p);
+static int cond_not(struct test_parser *p);
+static int cond_primary(struct test_parser *p);
+static int cond_binary(struct test_parser *p, const char *left, const char *op, const char *right);
+static int cond_regex(struct test_parser *p, const char *str, const char *regex);
+static int is_cond_binary(const char *op);
+
+/* *
+ * Returns - The handler of the builtin called name, or NULL if there is none, or if a function
+ *           of that name overrides it.
+ * */
+builtin_handler builtin_lookup(const char *name) {
+  const struct command *c;
+  if((c = command_lookup(name)) == NULL || c->func != NULL)
+    return NULL;
+  return c->handler;
+}
+
+/* *
+ * Returns - The builtin or function called name, or NULL if there is neither.
+ * */
+const struct command* command_lookup(const char *name) {
+  const struct builtin *b;
+  struct command *c;
+
+  if(commands == NULL) {
+    for(b = builtins; b->name != NULL; b++) {
+      if((c = insert(b->name)) == NULL)
+        return NULL;
+      c->handler = b->handler;
+    }
+  }
+  c = find_slot(name);
+  return c->name != NULL ? c : NULL;
+}
+
+/* *
+ * Defines the function called name as func, storing the function it replaces (or NULL) in old.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+int command_define(const char *name, struct func *func, struct func **old) {
+  struct command *c;
+  char *name_copy;
+
+  if(command_lookup(name) == NULL) {
+    if((name_copy = mem_strdup(MEM_HASH, name)) == NULL) {
+      perror("Error allocating memory for a function.");
+      return -1;
+    }
+    if(insert(name_copy) == NULL) {
+      mem_free(MEM_HASH, name_copy);
+      return -1;
+    }
+  }
+  c = find_slot(name);
+  *old = c->func;
+  c->func = func;
+  return 0;
+}
+
+/* *
+ * Forgets every builtin and function.  The functions themselves are freed by interp_clear.
+ * */
+void command_clear(void) {
+  size_t i;
+  for(i = 0; i < capacity; i++) {
+    // Builtins are named by the static table, functions by a copy of their names.
+    if(commands[i].name != NULL && commands[i].handler == NULL)
+      mem_free(MEM_HASH, (char *) commands[i].name);
+  }
+  mem_free(MEM_HASH, commands);
+  commands = NULL;
+  capacity = 0;
+  used = 0;
+}
+
+/* *
+ * FNV-1a hash of name.
+ * */
+static unsigned long name_hash(const char *name) {
+  unsigned long h = 14695981039346656037UL;
+  while(*name) {
+    h ^= (unsigned char) *name++;
+    h *= 1099511628211UL;
+  }
+  return h;
+}
+
+/* *
+ * Returns - The slot holding name, or the empty slot where it would be inserted.  The table must
+ *           be allocated.
+ * */
+static struct command* find_slot(const char *name) {
+  size_t i = name_hash(name) & (capacity - 1);
+  while(commands[i].name != NULL && strcmp(commands[i].name, name) != 0)
+    i = (i + 1) & (capacity - 1);
+  return &commands[i];
+}
+
+/* *
+ * Adds an entry for name, which must not be in the table and must outlive the entry, growing the
+ * table if needed.
+ *
+ * Returns - The new entry, or NULL on an error.
+ * */
+static struct command* insert(const char *name) {
+  size_t i, old_capacity;
+  struct command *old_commands, *slot;
+
+  if(commands == NULL || (used + 1) * 100 > capacity * COMMANDS_MAX_LOAD_PCT) {
+    old_commands = commands;
+    old_capacity = capacity;
+    capacity = capacity ? capacity * 2 : DEFAULT_COMMANDS_CAPACITY;
+    if((commands = mem_calloc(MEM_HASH, capacity, sizeof(*commands))) == NULL) {
+      perror("Error allocating memory for the builtins.");
+      commands = old_commands;
+      capacity = old_capacity;
+      return NULL;
+    }
+    for(i = 0; i < old_capacity; i++) {
+      if(old_commands[i].name != NULL)
+        *find_slot(old_commands[i].name) = old_commands[i];
+    }
+    mem_free(MEM_HASH, old_commands);
+  }
+
+  slot = find_slot(name);
+  memset(slot, 0, sizeof(*slot));
+  slot->name = name;
+  used++;
+  return slot;
+}
+
+/* *
+ * Handler for the echo builtin.
+ *
+ * echo [-n] [string ...]
+ *
+ * Writes the strings separated by spaces and followed by a newline, unless -n is given.  As in the
+ * XSI echo, backslash escapes in the strings are expanded, and \c ends the output there.
+ * */
+int echo_handle(char **cmd, size_t num_cmd) {
+  size_t i, first, len;
+  int newline, stop;
+  char *text;
+  (void) num_cmd;
+
+  newline = 1;
+  first = 1;
+  if(cmd[1] != NULL && strcmp(cmd[1], "-n") == 0) {
+    newline = 0;
+    first++;
+  }
+  for(i = first, stop = 0; cmd[i] != NULL && !stop; i++) {
+    if(i > first)
+      writer_write(STDOUT_FILENO, " ", 1);
+    if(strchr(cmd[i], '\\') == NULL) {
+      writer_puts(STDOUT_FILENO, cmd[i]);
+      continue;
+    }
+    if((text = unescape(cmd[i], 1, &len, &stop)) == NULL)
+      return builtin_status(EXIT_FAILURE);
+    writer_write(STDOUT_FILENO, text, len);
+    mem_free(MEM_EXEC, text);
+  }
+  if(newline && !stop)
+    writer_write(STDOUT_FILENO, "\n", 1);
+  return builtin_status(writer_flush(STDOUT_FILENO) == -1 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* *
+ * Handler for the printf builtin.
+ *
+ * printf format [argument ...]
+ *
+ * Writes the arguments as format describes, reusing format as long as arguments remain.  Supports
+ * the escapes and the d, i, o, u, x, X, c, s, b, e, E, f, F, g, G, a, and A conversions of POSIX
+ * printf, with flags, field widths, and precisions (which may be *.)
+ * */
+int printf_handle(char **cmd, size_t num_cmd) {
+  int status;
+  char **args, **before;
+  (void) num_cmd;
+
+  if(cmd[1] == NULL) {
+    writer_puts(STDERR_FILENO, "printf: missing format\nUsage: printf format [argument ...]\n");
+    writer_flush(STDERR_FILENO);
+    return builtin_status(TEST_ERROR);
+  }
+  status = EXIT_SUCCESS;
+  args = cmd + 2;
+  // Repeat the format while it uses up arguments and any are left.
+  do {
+    before = args;
+    if(printf_once(cmd[1], &args, &status) <= 0)
+      break;
+  } while(*args != NULL && args != before);
+  if(writer_flush(STDOUT_FILENO) == -1)
+    status = EXIT_FAILURE;
+  writer_flush(STDERR_FILENO);
+  return builtin_status(status);
+}
+
+/* *
+ * Handler for the test builtin, and for [, whose last argument must be ].
+ *
+ * test expression
+ * [ expression ]
+ *
+ * Evaluates the expression as POSIX describes: with up to four arguments their number decides
+ * how they are read, and longer expressions are parsed with !, -a, -o, and parentheses.
+ * */
+int test_handle(char **cmd, size_t num_cmd) {
+  int argc, status;
+  (void) num_cmd;
+
+  for(argc = 0; cmd[argc + 1] != NULL; argc++)
+    ;
+  if(strcmp(cmd[0], "[") == 0) {
+    if(argc == 0 || strcmp(cmd[argc], "]") != 0) {
+      writer_puts(STDERR_FILENO, "[: missing ]\n");
+      writer_flush(STDERR_FILENO);
+      return builtin_status(TEST_ERROR);
+    }
+    argc--;
+  }
+  status = test_args(cmd + 1, argc);
+  writer_flush(STDERR_FILENO);
+  return builtin_status(status);
+}
+
+/* *
+ * Handler for the [[ builtin, whose last argument must be ]].
+ *
+ * [[ expression ]]
+ *
+ * Evaluates the expression as bash does: the primaries of test, with == and != matching the right
+ * side as a pattern, =~ matching it as an extended regular expression, < and > comparing strings,
+ * and the integer comparisons evaluating both sides as arithmetic.  Primaries are joined with !,
+ * &&, ||, and parentheses, and the ones whose result does not matter are not evaluated.  A =~
+ * that matches sets BASH_REMATCH to the text it matched.
+ * */
+int cond_handle(char **cmd, size_t num_cmd) {
+  int argc, result;
+  struct test_parser p;
+  (void) num_cmd;
+
+  for(argc = 0; cmd[argc + 1] != NULL; argc++)
+    ;
+  if(argc == 0 || strcmp(cmd[argc], "]]") != 0) {
+    writer_puts(STDERR_FILENO, "[[: missing ]]\n");
+    writer_flush(STDERR_FILENO);
+    return builtin_status(TEST_ERROR);
+  }
+  memset(&p, 0, sizeof(p));
+  p.argv = cmd + 1;
+  p.end = argc - 1;
+  result = cond_or(&p);
+  if(!p.error && p.pos < p.end) {
+    writer_printf(STDERR_FILENO, "[[: %s: syntax error in conditional expression\n",
+                  p.argv[p.pos]);
+    p.error = 1;
+  }
+  writer_flush(STDERR_FILENO);
+  return builtin_status(p.error ? TEST_ERROR : result ? TEST_TRUE : TEST_FALSE);
+}
+
+/* *
+ * Handler for the true builtin, which does nothing, successfully.
+ * */
+int true_handle(char **cmd, size_t num_cmd) {
+  (void) cmd;
+  (void) num_cmd;
+  return builtin_status(EXIT_SUCCESS);
+}
+
+/* *
+ * Handler for the false builtin, which does nothing, unsuccessfully.
+ * */
+int false_handle(char **cmd, size_t num_cmd) {
+  (void) cmd;
+  (void) num_cmd;
+  return builtin_status(EXIT_FAILURE);
+}
+
+/* *
+ * Records status as the exit status of a builtin.
+ *
+ * Returns - The status of the command (0 on success, -1 on failure.)
+ * */
+static int builtin_status(int status) {
+  last_status = status;
+  return status == EXIT_SUCCESS ? 0 : -1;
+}
+
+/* *
+ * Expands the backslash escapes of str: \\, \a, \b, \f, \n, \r, \t, \v, and an octal escape,
+ * which is \0 and up to three digits for echo and %b (echo is 1), or \ and up to three digits for
+ * a printf format (echo is 0).  For echo and %b, \c ends the text and sets stop to 1.
+ *
+ * Returns - The expanded text, of len bytes, allocated with mem_malloc, or NULL on failure.
+ * */
+static char* unescape(const char *str, int echo, size_t *len, int *stop) {
+  int digits, value;
+  char *text, *out;
+
+  // Escapes only ever shorten the text.
+  if((text = mem_malloc(MEM_EXEC, strlen(str) + 1)) == NULL) {
+    perror("Error allocating memory for output.");
+    return NULL;
+  }
+  for(out = text; *str != '\0'; str++) {
+    if(*str != '\\' || str[1] == '\0') {
+      *out++ = *str;
+      continue;
+    }
+    switch(*++str) {
+      case '\\': *out++ = '\\'; break;
+      case 'a':  *out++ = '\a'; break;
+      case 'b':  *out++ = '\b'; break;
+      case 'f':  *out++ = '\f'; break;
+      case 'n':  *out++ = '\n'; break;
+      case 'r':  *out++ = '\r'; break;
+      case 't':  *out++ = '\t'; break;
+      case 'v':  *out++ = '\v'; break;
+      case 'c':
+        if(echo) {
+          *stop = 1;
+          *len = out - text;
+          return text;
+        }
+        *out++ = '\\';
+        *out++ = 'c';
+        break;
+      default:
+        if(!IS_OCTAL(*str) || (echo && *str != '0')) {
+          // Not an escape, so the backslash stays.
+          *out++ = '\\';
+          *out++ = *str;
+          break;
+        }
+        if(echo)
+          str++;
+        for(value = 0, digits = 0; digits < 3 && IS_OCTAL(*str); digits++)
+          value = value * 8 + (*str++ - '0');
+        *out++ = (char) value;
+        str--;
+        break;
+    }
+  }
+  *len = out - text;
+  return text;
+}
+
+/* *
+ * Writes fmt once, converting the arguments at *args and advancing *args past those it uses.
+ * status is set to 1 if an argument is not a valid number.
+ *
+ * Returns - 1 if fmt was written in full, 0 if %b's \c ended the output, or -1 if fmt is invalid.
+ * */
+static int printf_once(const char *fmt, char ***args, int *status) {
+  int width, precision, has_width, has_precision, left, stop;
+  size_t len, n;
+  long long value;
+  unsigned long long uvalue;
+  double dvalue;
+  const char *start, *arg;
+  char spec[SPEC_SIZE], *text;
+
+  while(*fmt != '\0') {
+    // Copy literal text up to the next escape or conversion.
+    for(start = fmt; *fmt != '\0' && *fmt != '\\' && *fmt != '%'; fmt++)
+      ;
+    writer_write(STDOUT_FILENO, start, fmt - start);
+    if(*fmt == '\\') {
+      // Expand a single escape: the backslash and the character after it, or up to three octal
+      // digits.
+      n = fmt[1] != '\0' ? 2 : 1;
+      while(n > 1 && n < 4 && IS_OCTAL(fmt[n - 1]) && IS_OCTAL(fmt[n]))
+        n++;
+      memcpy(spec, fmt, n);
+      spec[n] = '\0';
+      if((text = unescape(spec, 0, &len, &stop)) == NULL)
+        return -1;
+      writer_write(STDOUT_FILENO, text, len);
+      mem_free(MEM_EXEC, text);
+      fmt += n;
+      continue;
+    }
+    if(*fmt == '\0')
+      break;
+    if(fmt[1] == '%') {
+      writer_write(STDOUT_FILENO, "%", 1);
+      fmt += 2;
+      continue;
+    }
+
+    // Parse the conversion: flags, field width, precision, and conversion character.
+    start = fmt++;
+    left = 0;
+    for(; *fmt != '\0' && strchr("-+ #0", *fmt) != NULL; fmt++)
+      left |= *fmt == '-';
+    len = fmt - start;
+    // Leave room for the width, precision, and conversion.
+    if(len > SPEC_SIZE - 32) {
+      writer_puts(STDERR_FILENO, "printf: conversion specification is too long\n");
+      *status = EXIT_FAILURE;
+      return -1;
+    }
+    memcpy(spec, start, len);
+    width = precision = 0;
+    has_width = has_precision = 0;
+    if(*fmt == '*') {
+      if(!to_integer(arg = next_arg(args), &value)) {
+        writer_printf(STDERR_FILENO, "printf: %s: invalid number\n", arg);
+        *status = EXIT_FAILURE;
+      }
+      width = (int) value;
+      has_width = 1;
+      fmt++;
+    }
+    else {
+      for(; *fmt >= '0' && *fmt <= '9'; fmt++) {
+        width = width * 10 + (*fmt - '0');
+        has_width = 1;
+      }
+    }
+    if(*fmt == '.') {
+      has_precision = 1;
+      if(*++fmt == '*') {
+        if(!to_integer(arg = next_arg(args), &value)) {
+          writer_printf(STDERR_FILENO, "printf: %s: invalid number\n", arg);
+          *status = EXIT_FAILURE;
+        }
+        // A negative precision is taken as if it were omitted.
+        precision = (int) value;
+        has_precision = precision >= 0;
+        fmt++;
+      }
+      else {
+        for(; *fmt >= '0' && *fmt <= '9'; fmt++)
+          precision = precision * 10 + (*fmt - '0');
+      }
+    }
+    if(has_width)
+      len += snprintf(spec + len, SPEC_SIZE - len, "%d", width);
+    if(has_precision)
+      len += snprintf(spec + len, SPEC_SIZE - len, ".%d", precision);
+
+    arg = next_arg(args);
+    switch(*fmt) {
+      case 'd': case 'i':
+        if(!to_integer(arg, &value)) {
+          writer_printf(STDERR_FILENO, "printf: %s: invalid number\n", arg);
+          *status = EXIT_FAILURE;
+        }
+        snprintf(spec + len, SPEC_SIZE - len, "ll%c", *fmt);
+        writer_printf(STDOUT_FILENO, spec, value);
+        break;
+      case 'o': case 'u': case 'x': case 'X':
+        if(!to_unsigned(arg, &uvalue)) {
+          writer_printf(STDERR_FILENO, "printf: %s: invalid number\n", arg);
+          *status = EXIT_FAILURE;
+        }
+        snprintf(spec + len, SPEC_SIZE - len, "ll%c", *fmt);
+        writer_printf(STDOUT_FILENO, spec, uvalue);
+        break;
+      case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        if(!to_double(arg, &dvalue)) {
+          writer_printf(STDERR_FILENO, "printf: %s: invalid number\n", arg);
+          *status = EXIT_FAILURE;
+        }
+        snprintf(spec + len, SPEC_SIZE - len, "%c", *fmt);
+        writer_printf(STDOUT_FILENO, spec, dvalue);
+        break;
+      case 'c':
+        put_padded(arg, *arg != '\0' ? 1 : 0, width, left);
+        break;
+      case 's':
+        n = strlen(arg);
+        put_padded(arg, has_precision && (size_t) precision < n ? (size_t) precision : n, width,
+                   left);
+        break;
+      case 'b':
+        stop = 0;
+        if((text = unescape(arg, 1, &n, &stop)) == NULL)
+          return -1;
+        put_padded(text, has_precision && (size_t) precision < n ? (size_t) precision : n, width,
+                   left);
+        mem_free(MEM_EXEC, text);
+        if(stop)
+          return 0;
+        break;
+      default:
+        if(*fmt == '\0')
+          writer_puts(STDERR_FILENO, "printf: missing conversion character\n");
+        else
+          writer_printf(STDERR_FILENO, "printf: %%%c: invalid conversion\n", *fmt);
+        *status = EXIT_FAILURE;
+        return -1;
+    }
+    fmt++;
+  }
+  return 1;
+}
+
+/* *
+ * Returns - The argument at *args, advancing *args past it, or "" if there are none left.
+ * */
+static const char* next_arg(char ***args) {
+  if(**args == NULL)
+    return "";
+  return *(*args)++;
+}
+
+/* *
+ * Converts str to a signed integer for printf.  A leading quote stands for the value of the
+ * character after it, and an empty string is 0.
+ *
+ * Returns - 1 if all of str was converted, 0 otherwise.
+ * */
+static int to_integer(const char *str, long long *value) {
+  char *end;
+  if(*str == '\'' || *str == '"') {
+    *value = (unsigned char) str[1];
+    return 1;
+  }
+  errno = 0;
+  *value = strtoll(str, &end, 0);
+  return errno == 0 && *end == '\0';
+}
+
+/* *
+ * Converts str to an unsigned integer for printf, as to_integer does.
+ * */
+static int to_unsigned(const char *str, unsigned long long *value) {
+  char *end;
+  if(*str == '\'' || *str == '"') {
+    *value = (unsigned char) str[1];
+    return 1;
+  }
+  errno = 0;
+  *value = strtoull(str, &end, 0);
+  return errno == 0 && *end == '\0';
+}
+
+/* *
+ * Converts str to a floating-point number for printf, as to_integer does.
+ * */
+static int to_double(const char *str, double *value) {
+  char *end;
+  if(*str == '\'' || *str == '"') {
+    *value = (unsigned char) str[1];
+    return 1;
+  }
+  errno = 0;
+  *value = strtod(str, &end);
+  return errno == 0 && *end == '\0';
+}
+
+/* *
+ * Writes len bytes of data in a field of width characters, padded with spaces on the left, or on
+ * the right if left is 1.
+ * */
+static void put_padded(const char *data, size_t len, int width, int left) {
+  static const char spaces[] = "                ";
+  size_t pad, n;
+  if(width < 0) {
+    // A negative width from * means left alignment.
+    left = 1;
+    width = -width;
+  }
+  pad = (size_t) width > len ? width - len : 0;
+  if(left)
+    writer_write(STDOUT_FILENO, data, len);
+  for(; pad > 0; pad -= n) {
+    n = pad < sizeof(spaces) - 1 ? pad : sizeof(spaces) - 1;
+    writer_write(STDOUT_FILENO, spaces, n);
+  }
+  if(!left)
+    writer_write(STDOUT_FILENO, data, len);
+}
+
+/* *
+ * Evaluates the argc arguments of test at argv.
+ *
+ * Returns - TEST_TRUE, TEST_FALSE, or TEST_ERROR.
+ * */
+static int test_args(char **argv, int argc) {
+  int result;
+  struct test_parser p = { .argv = argv, .end = argc };
+
+  // POSIX decides how up to four arguments are read from their number.
+  switch(argc) {
+    case 0:
+      return TEST_FALSE;
+    case 1:
+      return argv[0][0] != '\0' ? TEST_TRUE : TEST_FALSE;
+    case 2:
+      if(strcmp(argv[0], "!") == 0)
+        return argv[1][0] == '\0' ? TEST_TRUE : TEST_FALSE;
+      if(is_unary(argv[0]))
+        result = test_unary(&p, argv[0], argv[1]);
+      else {
+        writer_printf(STDERR_FILENO, "test: %s: unary operator expected\n", argv[0]);
+        return TEST_ERROR;
+      }
+      return p.error ? TEST_ERROR : result ? TEST_TRUE : TEST_FALSE;
+    case 3:
+      if(is_binary(argv[1]) || strcmp(argv[1], "-a") == 0 || strcmp(argv[1], "-o") == 0) {
+        if(strcmp(argv[1], "-a") == 0)
+          result = argv[0][0] != '\0' && argv[2][0] != '\0';
+        else if(strcmp(argv[1], "-o") == 0)
+          result = argv[0][0] != '\0' || argv[2][0] != '\0';
+        else
+          result = test_binary(&p, argv[0], argv[1], argv[2]);
+        return p.error ? TEST_ERROR : result ? TEST_TRUE : TEST_FALSE;
+      }
+      if(strcmp(argv[0], "!") == 0) {
+        result = test_args(argv + 1, 2);
+        return result == TEST_ERROR ? TEST_ERROR : !result;
+      }
+      if(strcmp(argv[0], "(") == 0 && strcmp(argv[2], ")") == 0)
+        return test_args(argv + 1, 1);
+      break;
+    case 4:
+      if(strcmp(argv[0], "!") == 0) {
+        result = test_args(argv + 1, 3);
+        return result == TEST_ERROR ? TEST_ERROR : !result;
+      }
+      if(strcmp(argv[0], "(") == 0 && strcmp(argv[3], ")") == 0)
+        return test_args(argv + 1, 2);
+      break;
+  }
+
+  // Longer expressions are parsed.
+  result = test_expr(&p);
+  if(!p.error && p.pos < p.end) {
+    writer_printf(STDERR_FILENO, "test: %s: unexpected argument\n", argv[p.pos]);
+    p.error = 1;
+  }
+  return p.error ? TEST_ERROR : result ? TEST_TRUE : TEST_FALSE;
+}
+
+/* *
+ * expr := and [-o expr]
+ * */
+static int test_expr(struct test_parser *p) {
+  int result = test_and(p);
+  while(!p->error && p->pos < p->end && strcmp(p->argv[p->pos], "-o") == 0) {
+    p->pos++;
+    result = test_and(p) || result;
+  }
+  return result;
+}
+
+/* *
+ * and := not [-a and]
+ * */
+static int test_and(struct test_parser *p) {
+  int result = test_not(p);
+  while(!p->error && p->pos < p->end && strcmp(p->argv[p->pos], "-a") == 0) {
+    p->pos++;
+    result = test_not(p) && result;
+  }
+  return result;
+}
+
+/* *
+ * not := ! not | primary
+ * */
+static int test_not(struct test_parser *p) {
+  if(p->pos < p->end && strcmp(p->argv[p->pos], "!") == 0) {
+    p->pos++;
+    return !test_not(p);
+  }
+  return test_primary(p);
+}
+
+/* *
+ * primary := ( expr ) | unary-op arg | arg binary-op arg | arg
+ * */
+static int test_primary(struct test_parser *p) {
+  int result;
+  char **argv = p->argv + p->pos;
+  int left = p->end - p->pos;
+
+  if(left <= 0) {
+    writer_puts(STDERR_FILENO, "test: argument expected\n");
+    p->error = 1;
+    return 0;
+  }
+  if(left >= 3 && is_binary(argv[1])) {
+    p->pos += 3;
+    return test_binary(p, argv[0], argv[1], argv[2]);
+  }
+  if(strcmp(argv[0], "(") == 0) {
+    p->pos++;
+    result = test_expr(p);
+    if(!p->error && (p->pos >= p->end || strcmp(p->argv[p->pos], ")") != 0)) {
+      writer_puts(STDERR_FILENO, "test: missing )\n");
+      p->error = 1;
+    }
+    p->pos++;
+    return result;
+  }
+  if(left >= 2 && is_unary(argv[0])) {
+    p->pos += 2;
+    return test_unary(p, argv[0], argv[1]);
+  }
+  p->pos++;
+  return argv[0][0] != '\0';
+}
+
+/* *
+ * Returns - The result of the unary primary "op arg".
+ * */
+static int test_unary(struct test_parser *p, const char *op, const char *arg) {
+  struct stat st;
+  long long fd;
+
+  switch(op[1]) {
+    case 'n': return arg[0] != '\0';
+    case 'z': return arg[0] == '\0';
+    case 't':
+      if(!test_integer(p, arg, &fd))
+        return 0;
+      return isatty((int) fd);
+    case 'r': return access(arg, R_OK) == 0;
+    case 'w': return access(arg, W_OK) == 0;
+    case 'x': return access(arg, X_OK) == 0;
+    case 'h': case 'L':
+      return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+  }
+  if(stat(arg, &st) < 0)
+    return 0;
+  switch(op[1]) {
+    case 'b': return S_ISBLK(st.st_mode);
+    case 'c': return S_ISCHR(st.st_mode);
+    case 'd': return S_ISDIR(st.st_mode);
+    case 'e': return 1;
+    case 'f': return S_ISREG(st.st_mode);
+    case 'g': return (st.st_mode & S_ISGID) != 0;
+    case 'p': return S_ISFIFO(st.st_mode);
+    case 'S': return S_ISSOCK(st.st_mode);
+    case 's': return st.st_size > 0;
+    case 'u': return (st.st_mode & S_ISUID) != 0;
+  }
+  return 0;
+}
+
+/* *
+ * Returns - The result of the binary primary "left op right".
+ * */
+static int test_binary(struct test_parser *p, const char *left, const char *op, const char *right) {
+  long long a, b;
+  int exists_a, exists_b;
+  struct stat st_a, st_b;
+
+  if(strcmp(op, "=") == 0)
+    return strcmp(left, right) == 0;
+  if(strcmp(op, "!=") == 0)
+    return strcmp(left, right) != 0;
+  if(strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0) {
+    exists_a = stat(left, &st_a) == 0;
+    exists_b = stat(right, &st_b) == 0;
+    if(op[1] == 'e')
+      return exists_a && exists_b && st_a.st_dev == st_b.st_dev && st_a.st_ino == st_b.st_ino;
+    // A file that exists is newer than one that does not.
+    if(op[1] == 'n')
+      return exists_a && (!exists_b || newer(&st_a, &st_b));
+    return exists_b && (!exists_a || newer(&st_b, &st_a));
+  }
+  if(!test_integer(p, left, &a) || !test_integer(p, right, &b))
+    return 0;
+  return compare(op, a, b);
+}
+
+/* *
+ * Returns - 1 if the file with status a was modified after the file with status b.
+ * */
+static int newer(const struct stat *a, const struct stat *b) {
+  if(a->st_mtim.tv_sec != b->st_mtim.tv_sec)
+    return a->st_mtim.tv_sec > b->st_mtim.tv_sec;
+  return a->st_mtim.tv_nsec > b->st_mtim.tv_nsec;
+}
+
+/* *
+ * Returns - 1 if op is a unary primary of test.
+ * */
+static int is_unary(const char *op) {
+  return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("bcdefghLnprSstuwxz", op[1]);
+}
+
+/* *
+ * Returns - 1 if op is a binary primary of test (other than -a and -o.)
+ * */
+static int is_binary(const char *op) {
+  static const char *ops[] = {
+    "=", "!=", "-eq", "-ne", "-gt", "-ge", "-lt", "-le", "-nt", "-ot", "-ef", NULL
+  };
+  const char **o;
+  for(o = ops; *o != NULL; o++) {
+    if(strcmp(op, *o) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+/* *
+ * Converts str, an operand of an integer comparison, to value.  Surrounding blanks are allowed.
+ *
+ * Returns - 1 on success, or 0 (flagging an error in p) if str is not an integer.
+ * */
+static int test_integer(struct test_parser *p, const char *str, long long *value) {
+  char *end;
+  errno = 0;
+  *value = strtoll(str, &end, 10);
+  while(*end == ' ' || *end == '\t')
+    end++;
+  if(errno != 0 || end == str || *end != '\0') {
+    writer_printf(STDERR_FILENO, "test: %s: integer expression expected\n", str);
+    p->error = 1;
+    return 0;
+  }
+  return 1;
+}
+
+/* *
+ * Returns - The result of the integer comparison "a op b", where op is -eq, -ne, -gt, -ge, -lt,
+ *           or -le.
+ * */
+static int compare(const char *op, long long a, long long b) {
+  if(strcmp(op, "-eq") == 0) return a == b;
+  if(strcmp(op, "-ne") == 0) return a != b;
+  if(strcmp(op, "-gt") == 0) return a > b;
+  if(strcmp(op, "-ge") == 0) return a >= b;
+  if(strcmp(op, "-lt") == 0) return a < b;
+  return a <= b;
+}
+
+/* *
+ * or := and [|| or]
+ * */
+static int cond_or(struct test_parser *p) {
+  int skip = p->skip, result = cond_and(p);
+  while(!p->error && p->pos < p->end && strcmp(p->argv[p->pos], "||") == 0) {
+    p->pos++;
+    // The right side only matters if the left side is false.
+    p->skip = skip || result;
+    result = cond_and(p) || result;
+  }
+  p->skip = skip;
+  return result;
+}
+
+/* *
+ * and := not [&& and]
+ * */
+static int cond_and(struct test_parser *p) {
+  int skip = p->skip, result = cond_not(p);
+  while(!p->error && p->pos < p->end && strcmp(p->argv[p->pos], "&&") == 0) {
+    p->pos++;
+    p->skip = skip || !result;
+    result = cond_not(p) && result;
+  }
+  p->skip = skip;
+  return result;
+}
+
+/* *
+ * not := ! not | primary
+ * */
+static int cond_not(struct test_parser *p) {
+  if(p->pos < p->end && strcmp(p->argv[p->pos], "!") == 0) {
+    p->pos++;
+    return !cond_not(p);
+  }
+  return cond_primary(p);
+}
+
+/* *
+ * primary := ( or ) | unary-op arg | -v name | arg binary-op arg | arg
+ * */
+static int cond_primary(struct test_parser *p) {
+  int result;
+  char **argv = p->argv + p->pos;
+  int left = p->end - p->pos;
+
+  if(left <= 0) {
+    writer_puts(STDERR_FILENO, "[[: expression expected\n");
+    p->error = 1;
+    return 0;
+  }
+  if(left >= 3 && is_cond_binary(argv[1])) {
+    p->pos += 3;
+    return !p->skip && cond_binary(p, argv[0], argv[1], argv[2]);
+  }
+  if(strcmp(argv[0], "(") == 0) {
+    p->pos++;
+    result = cond_or(p);
+    if(!p->error && (p->pos >= p->end || strcmp(p->argv[p->pos], ")") != 0)) {
+      writer_puts(STDERR_FILENO, "[[: missing )\n");
+      p->error = 1;
+    }
+    p->pos++;
+    return result;
+  }
+  if(left >= 2 && strcmp(argv[0], "-v") == 0) {
+    p->pos += 2;
+    return vars_get(argv[1]) != NULL;
+  }
+  if(left >= 2 && is_unary(argv[0])) {
+    p->pos += 2;
+    return !p->skip && test_unary(p, argv[0], argv[1]);
+  }
+  p->pos++;
+  return argv[0][0] != '\0';
+}
+
+/* *
+ * Returns - The result of the binary primary "left op right" of [[ ]].
+ * */
+static int cond_binary(struct test_parser *p, const char *left, const char *op, const char *right) {
+  const struct pattern *pat;
+  long long a, b;
+  int result;
+
+  if(strcmp(op, "==") == 0 || strcmp(op, "=") == 0 || strcmp(op, "!=") == 0) {
+    if((pat = pattern_compile(right, strlen(right))) == NULL) {
+      p->error = 1;
+      return 0;
+    }
+    result = pattern_match(pat, left, strlen(left));
+    return op[0] == '!' ? !result : result;
+  }
+  if(strcmp(op, "=~") == 0)
+    return cond_regex(p, left, right);
+  if(strcmp(op, "<") == 0)
+    return strcmp(left, right) < 0;
+  if(strcmp(op, ">") == 0)
+    return strcmp(left, right) > 0;
+  if(strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0)
+    return test_binary(p, left, op, right);
+  if(arith_eval(left, &a) == -1 || arith_eval(right, &b) == -1) {
+    p->error = 1;
+    return 0;
+  }
+  return compare(op, a, b);
+}
+
+/* *
+ * Returns - 1 if the extended regular expression regex matches part of str, and 0 otherwise.
+ *           The compiled regex is cached (see pattern.c), so testing many strings against one
+ *           regex compiles it once.
+ * */
+static int cond_regex(struct test_parser *p, const char *str, const char *regex) {
+  const regex_t *re;
+  char error[REGEX_ERROR_SIZE];
+  regmatch_t match;
+
+  if((re = pattern_regex(regex, error, sizeof(error))) == NULL) {
+    writer_printf(STDERR_FILENO, "[[: %s: %s\n", regex, error);
+    p->error = 1;
+    return 0;
+  }
+  if(regexec(re, str, 1, &match, 0) != 0) {
+    vars_set("BASH_REMATCH", "");
+    return 0;
+  }
+  vars_set_len("BASH_REMATCH", str + match.rm_so, match.rm_eo - match.rm_so);
+  return 1;
+}
+
+/* *
+ * Returns - 1 if op is a binary primary of [[ ]].
+ * */
+static int is_cond_binary(const char *op) {
+  static const char *ops[] = { "==", "=~", "<", ">", NULL };
+  const char **o;
+  for(o = ops; *o != NULL; o++) {
+    if(strcmp(op, *o) == 0)
+      return 1;
+  }
+  return is_binary(op);
+}
@@ -0,0 +1,115 @@
+/* *
+ * client.c
+ *
+ * tinysh-client:  runs a command line on a tinysh started in daemon mode (tinysh --serve.)
+ *
+ * usage: tinysh-client socket command [args ...]
+ *
+ * The arguments after the socket path are joined with spaces into a command line and sent to the
+ * shell.  The command's stdout and stderr are copied to the client's stdout and stderr as they
+ * arrive, and the client exits with the command's exit status.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "serve.h"
+#include "fdio.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+
+#define CLIENT_BUF_SIZE 65536
+#define CLIENT_ERROR    255  // Exit status when the command's own status is unavailable.
+
+
+int main(int argc, char *argv[]) {
+  int i, sock, out_fd;
+  uint32_t len, code;
+  size_t line_len;
+  char header[SERVE_HEADER_SIZE];
+  char buf[CLIENT_BUF_SIZE];
+  char *line;
+  struct sockaddr_un addr;
+
+  if(argc < 3) {
+    fprintf(stderr, "usage: %s socket command [args ...]\n", argv[0]);
+    return CLIENT_ERROR;
+  }
+
+  // Join the arguments into a single command line.
+  line_len = 0;
+  for(i = 2; i < argc; i++)
+    line_len += strlen(argv[i]) + 1;
+  if(line_len > SERVE_MAX_CMD) {
+    fprintf(stderr, "Error:  Command line is too long.\n");
+    return CLIENT_ERROR;
+  }
+  if((line = malloc(line_len)) == NULL) {
+    perror("Error allocating memory for the command line.");
+    return CLIENT_ERROR;
+  }
+  line[0] = '\0';
+  for(i = 2; i < argc; i++) {
+    strcat(line, argv[i]);
+    if(i < argc - 1)
+      strcat(line, " ");
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(strlen(argv[1]) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Error:  Socket path is too long: %s\n", argv[1]);
+    return CLIENT_ERROR;
+  }
+  strcpy(addr.sun_path, argv[1]);
+  if((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+     || connect(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    perror("Error connecting to tinysh.");
+    return CLIENT_ERROR;
+  }
+
+  // Send the command frame.
+  len = htonl(strlen(line));
+  header[0] = SERVE_FRAME_CMD;
+  memcpy(header + 1, &len, sizeof(len));
+  if(fd_write_all(sock, header, sizeof(header)) == -1
+      || fd_write_all(sock, line, strlen(line)) == -1) {
+    perror("Error sending the command line.");
+    return CLIENT_ERROR;
+  }
+  free(line);
+
+  // Copy output frames until the exit status arrives.
+  while(fd_read_all(sock, header, sizeof(header)) == 0) {
+    memcpy(&len, header + 1, sizeof(len));
+    len = ntohl(len);
+    if(header[0] == SERVE_FRAME_EXIT) {
+      if(len != sizeof(code) || fd_read_all(sock, &code, sizeof(code)) == -1)
+        break;
+      close(sock);
+      return ntohl(code);
+    }
+    out_fd = header[0] == SERVE_FRAME_STDERR ? STDERR_FILENO : STDOUT_FILENO;
+    while(len > 0) {
+      uint32_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+      if(fd_read_all(sock, buf, chunk) == -1) {
+        fprintf(stderr, "Error:  Connection to tinysh was lost.\n");
+        return CLIENT_ERROR;
+      }
+      fd_write_all(out_fd, buf, chunk);
+      len -= chunk;
+    }
+  }
+  fprintf(stderr, "Error:  Connection to tinysh was lost.\n");
+  return CLIENT_ERROR;
+}
+
@@ -0,0 +1,296 @@
+/* *
+ * cmdhash.c
+ *
+ * The command hash: a cache of the executables that command names resolve to.
+ *
+ * Without the hash, every command searches the path from scratch (execvp tries an exec in each
+ * path directory until one succeeds.)  The hash remembers where each command was found, so a
+ * repeated command is executed directly from its full path.  The table is an open-addressing
+ * hash table with linear probing, keyed on the command name.
+ *
+ * NOTES:
+ *   - The shell warms the hash before it forks, since anything a child adds to its own copy of
+ *     the table is lost when the child execs.  In daemon mode, the server warms it with each
+ *     request's line before forking the worker that runs it (see serve.c.)
+ *   - Commands found in relative path directories (e.g. "." in PATH) are not remembered, since
+ *     their meaning changes with the working directory.
+ *   - An entry that no longer exists is dropped when executing it fails, and "hash -r" forgets
+ *     everything, e.g. after installing a new program earlier in the path.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "cmdhash.h"
+#include "tinysh.h"
+#include "mem.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <limits.h>
+
+#define DEFAULT_HASH_CAPACITY 64    // Must be a power of two.
+#define HASH_MAX_LOAD_PCT     70
+
+struct cmdhash_entry {
+  char *name;           // Command name, or NULL if the slot is empty.
+  char *path;           // Full path of the executable.
+  unsigned long hits;   // Number of times the entry has been used.
+};
+
+static struct cmdhash_entry *table;
+static size_t capacity;
+static size_t used;
+static char uncached[PATH_MAX];  // Result of the last lookup that could not be remembered.
+
+static unsigned long name_hash(const char *name);
+static struct cmdhash_entry* find_slot(const char *name);
+static int insert(const char *name, const char *full_path);
+static int search_dir(const char *dir, size_t dir_len, const char *name, char *buf);
+static const char* search_path(const char *name, int *cacheable);
+
+/* *
+ * Looks up the executable that name resolves to, searching the path and remembering the result
+ * if name is not already in the hash.
+ *
+ * Returns - The full path of the executable, or NULL if name contains a slash (so it is not looked
+ *           up in the path) or could not be found.
+ * */
+const char* cmdhash_lookup(const char *name) {
+  int cacheable;
+  const char *found;
+  struct cmdhash_entry *entry;
+
+  if(strchr(name, '/') != NULL)
+    return NULL;
+  if(table != NULL && (entry = find_slot(name))->name != NULL) {
+    entry->hits++;
+    return entry->path;
+  }
+  if((found = search_path(name, &cacheable)) == NULL)
+    return NULL;
+  if(!cacheable || insert(name, found) == -1)
+    return found;
+  entry = find_slot(name);
+  entry->hits++;
+  return entry->path;
+}
+
+/* *
+ * Looks up every command in the command line cmd (the first word, and the first word after each
+ * pipe), so that child processes inherit a warm hash.
+ * */
+void cmdhash_warm(char **cmd) {
+  int i, at_command;
+  at_command = 1;
+  for(i = 0; cmd[i] != NULL; i++) {
+    if(at_command)
+      cmdhash_lookup(cmd[i]);
+    at_command = strcmp(cmd[i], "|") == 0;
+  }
+}
+
+/* *
+ * Removes name from the hash, if it is present.
+ * */
+void cmdhash_forget(const char *name) {
+  size_t i, j, home;
+  struct cmdhash_entry *entry;
+  if(table == NULL || (entry = find_slot(name))->name == NULL)
+    return;
+  mem_free(MEM_HASH, entry->name);
+  mem_free(MEM_HASH, entry->path);
+  entry->name = NULL;
+  used--;
+
+  // Shift later entries of the probe sequence back into the hole, so lookups don't stop early.
+  i = entry - table;
+  j = i;
+  while(1) {
+    j = (j + 1) & (capacity - 1);
+    if(table[j].name == NULL)
+      break;
+    home = name_hash(table[j].name) & (capacity - 1);
+    // Move the entry unless its home slot lies cyclically in (i, j].
+    if((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))) {
+      table[i] = table[j];
+      table[j].name = NULL;
+      i = j;
+    }
+  }
+}
+
+/* *
+ * Forgets every remembered command.
+ * */
+void cmdhash_clear(void) {
+  size_t i;
+  for(i = 0; i < capacity; i++) {
+    if(table[i].name != NULL) {
+      mem_free(MEM_HASH, table[i].name);
+      mem_free(MEM_HASH, table[i].path);
+    }
+  }
+  mem_free(MEM_HASH, table);
+  table = NULL;
+  capacity = 0;
+  used = 0;
+}
+
+/* *
+ * Handler for the hash builtin.
+ *
+ * hash          - lists the remembered commands.
+ * hash -r       - forgets all remembered commands.
+ * hash name ... - looks up and remembers each name.
+ * */
+int hash_handle(char **cmd, size_t num_cmd) {
+  size_t i;
+  int status = 0;
+  if(num_cmd == 2 && strcmp(cmd[1], "-r") == 0) {
+    if(VERBOSE(V_PROC))
+      printf("Forgetting all %zu remembered commands.\n", used);
+    cmdhash_clear();
+    return 0;
+  }
+  if(num_cmd > 1) {
+    for(i = 1; i < num_cmd; i++) {
+      if(cmdhash_lookup(cmd[i]) == NULL && strchr(cmd[i], '/') == NULL) {
+        printf("hash: %s: not found\n", cmd[i]);
+        status = -1;
+      }
+    }
+    return status;
+  }
+  if(used == 0) {
+    printf("hash: hash table empty\n");
+    return 0;
+  }
+  printf("hits\tcommand\n");
+  for(i = 0; i < capacity; i++) {
+    if(table[i].name != NULL)
+      printf("%4lu\t%s\n", table[i].hits, table[i].path);
+  }
+  return 0;
+}
+
+/* *
+ * FNV-1a hash of a command name.
+ * */
+static unsigned long name_hash(const char *name) {
+  unsigned long h = 14695981039346656037UL;
+  while(*name) {
+    h ^= (unsigned char) *name++;
+    h *= 1099511628211UL;
+  }
+  return h;
+}
+
+/* *
+ * Returns - The slot holding name, or the empty slot where it would be inserted.  The table must
+ *           be allocated.
+ * */
+static struct cmdhash_entry* find_slot(const char *name) {
+  size_t i = name_hash(name) & (capacity - 1);
+  while(table[i].name != NULL && strcmp(table[i].name, name) != 0)
+    i = (i + 1) & (capacity - 1);
+  return &table[i];
+}
+
+/* *
+ * Remembers that name resolves to full_path, growing the table if needed.
+ * */
+static int insert(const char *name, const char *full_path) {
+  size_t i, old_capacity;
+  struct cmdhash_entry *old_table, *slot;
+  char *name_copy, *path_copy;
+
+  if(table == NULL || (used + 1) * 100 > capacity * HASH_MAX_LOAD_PCT) {
+    old_table = table;
+    old_capacity = capacity;
+    capacity = capacity ? capacity * 2 : DEFAULT_HASH_CAPACITY;
+    if((table = mem_calloc(MEM_HASH, capacity, sizeof(*table))) == NULL) {
+      perror("Error allocating memory for the command hash.");
+      table = old_table;
+      capacity = old_capacity;
+      return -1;
+    }
+    for(i = 0; i < old_capacity; i++) {
+      if(old_table[i].name != NULL)
+        *find_slot(old_table[i].name) = old_table[i];
+    }
+    mem_free(MEM_HASH, old_table);
+  }
+
+  if((name_copy = mem_strdup(MEM_HASH, name)) == NULL
+     || (path_copy = mem_strdup(MEM_HASH, full_path)) == NULL) {
+    perror("Error allocating memory for the command hash.");
+    mem_free(MEM_HASH, name_copy);
+    return -1;
+  }
+  slot = find_slot(name);
+  slot->name = name_copy;
+  slot->path = path_copy;
+  slot->hits = 0;
+  used++;
+  return 0;
+}
+
+/* *
+ * Checks for an executable regular file called name in the first dir_len characters of dir,
+ * writing its path into buf.
+ * */
+static int search_dir(const char *dir, size_t dir_len, const char *name, char *buf) {
+  struct stat st;
+  // An empty path entry means the current directory.
+  if(dir_len == 0) {
+    dir = ".";
+    dir_len = 1;
+  }
+  if(snprintf(buf, PATH_MAX, "%.*s/%s", (int) dir_len, dir, name) >= PATH_MAX)
+    return 0;
+  return stat(buf, &st) == 0 && S_ISREG(st.st_mode) && access(buf, X_OK) == 0;
+}
+
+/* *
+ * Searches the path in use by the shell (the path file's paths, or else PATH) for name.
+ *
+ * Returns - The full path of the executable, stored in a static buffer, or NULL if not found.
+ *           cacheable is set to 1 if the path does not depend on the working directory.
+ * */
+static const char* search_path(const char *name, int *cacheable) {
+  size_t len;
+  char **dirs;
+  const char *env, *dir;
+
+  // Paths from the path file, one per line.
+  if((dirs = path_dirs()) != NULL) {
+    for(; *dirs != NULL; dirs++) {
+      len = strcspn(*dirs, "\n");
+      if(len > 0 && search_dir(*dirs, len, name, uncached)) {
+        *cacheable = (*dirs)[0] == '/';
+        return uncached;
+      }
+    }
+    return NULL;
+  }
+
+  // Colon-separated paths from the environment.
+  if((env = getenv("PATH")) == NULL)
+    env = "/bin:/usr/bin";
+  for(dir = env; ; dir += len + 1) {
+    len = strcspn(dir, ":");
+    if(search_dir(dir, len, name, uncached)) {
+      *cacheable = len > 0 && dir[0] == '/';
+      return uncached;
+    }
+    if(dir[len] == '\0')
+      break;
+  }
+  return NULL;
+}
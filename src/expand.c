@@ -0,0 +1,1318 @@
+/* *
+ * expand.c
+ *
+ * Expansion of the words of a command line: brace expansion, $name, ${name}, $?, $$, the
+ * positional parameters of a function ($1 ... $9, ${10}, $#, $@, and $*), $(( expression )), and
+ * the string operators of ${ }:
+ *
+ *   ${#name}                          Length of the value.
+ *   ${name#pat}, ${name##pat}         Value without the shortest (longest) prefix matching pat.
+ *   ${name%pat}, ${name%%pat}         Value without the shortest (longest) suffix matching pat.
+ *   ${name/pat/rep}, ${name//pat/rep} Value with the first (every) match of pat replaced by rep.
+ *   ${name/#pat/rep}, ${name/%pat/rep} Value with a prefix (suffix) matching pat replaced by rep.
+ *   ${name:off}, ${name:off:len}      Substring of the value (off and len are arithmetic.)
+ *   ${name:-word}, ${name:=word}, ${name:+word}, ${name:?word}, and the same without the colon.
+ *   ${name[sub]}                      Element of an array (any of the above apply to it.)
+ *   ${name[@]}, ${name[*]}            Every element; ${#name[@]} counts them.
+ *   ${!name[@]}                       Every subscript.
+ *   a{b,c}d, {1..10}, {a..e..2}       Brace expansion: abd acd, 1 2 ... 10, a c e.
+ *
+ * Words are expanded after the line is tokenized and before it is dispatched, in the shell
+ * process.  The result of each word is one word, whatever it contains (i.e. as if the expansions
+ * were quoted), except that a word that expands to nothing is removed from the line, and that
+ * ${name[@]} (and $@) makes a word of each element, as "${name[@]}" does in bash.  The
+ * expressions of $(( )) and the words of ${ } may contain blanks, so the words they span are
+ * joined back together first.
+ *
+ * NOTES:
+ *   - A word without a $ is left as it is, so a line without expansions costs one scan of its
+ *     words and no allocations.
+ *   - $ expansions within $(( )) are expanded before the expression is evaluated, but plain
+ *     variable names are cheaper: the compiled expression is cached on its text (see arith.c),
+ *     which stays the same from one evaluation to the next only if the values are not pasted in.
+ *   - The string operators work on the value in place and append only the part of it that is
+ *     kept, so ${name%.*} or ${name:0:3} costs no allocation beyond the expanded word.  Patterns
+ *     are compiled once and cached on their text (see pattern.c.)
+ *   - The elements of ${name[@]} are copied straight into the words of the line, which grows in
+ *     place, rather than joined into one word and split again.
+ *   - Brace expansion counts the words it will make before making any, so the line is allocated
+ *     once.  A for loop over a lone sequence does not expand it at all, but steps through its
+ *     values one at a time with expand_seq() (see interp.c.)
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "expand.h"
+#include "interp.h"
+#include "vars.h"
+#include "arith.h"
+#include "pattern.h"
+#include "tinysh.h"
+#include "mem.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+
+#define DEFAULT_EXPAND_CAPACITY 64  // Initial size of an expanded word.
+#define NUMBER_SIZE             24  // Size of a 64-bit integer formatted in decimal.
+#define EXPR_SIZE               64  // Longest ${name:off:len} operand kept on the stack.
+#define DEFAULT_SPLIT_CAPACITY  16  // Initial number of words split off by ${name[@]}.
+#define BRACE_MAX_WORDS  (1 << 24)  // Most words the brace expansions of a line may make.
+
+/*
+ * The words split off a word by ${name[@]}, before its last element.
+ */
+struct word_list {
+  char **words;
+  size_t num;
+  size_t capacity;
+};
+
+/*
+ * A word being expanded.
+ */
+struct expand_buf {
+  char *data;
+  size_t len;
+  size_t size;
+  struct word_list *split;  // Where ${name[@]} ends words, or NULL to join its elements.
+};
+
+/*
+ * The parameter of a ${ }: a variable name (or a special parameter, such as ? or 1), and the
+ * element of an array it names.
+ */
+struct param {
+  char name[NAME_MAX + 1];
+  long long index;
+  const char *key;  // Subscript of an associative array, or NULL.
+  size_t key_len;
+  int subscript;    // 0 without a subscript, 1 with an index or key, or @ or * for every element.
+  int keys;         // 1 for ${!name[@]}, the subscripts rather than the elements.
+};
+
+/*
+ * What remains of a word after the brace expansion being generated: a piece of text, and what
+ * follows it.
+ */
+struct brace_rest {
+  const char *text;
+  const char *end;
+  const struct brace_rest *next;
+};
+
+/*
+ * The words made by brace expansion, and the buffer each is built in.
+ */
+struct brace_out {
+  char *buf;
+  char **words;
+  size_t num;
+};
+
+static int expand_word(const char *word, struct expand_buf *out);
+static int expand_arith(const char **pos, struct expand_buf *out);
+static int expand_param(const char **pos, struct expand_buf *out);
+static int expand_brace(const char **pos, struct expand_buf *out);
+static int expand_slice(const char *text, size_t len, struct expand_buf *out);
+static int expand_number(const char *text, size_t len, long long *num);
+static int expand_value(const struct param *param, int length, struct expand_buf *out);
+static int expand_elements(const struct param *param, int length, struct expand_buf *out);
+static int split_word(struct expand_buf *out);
+static int expand_default(const struct param *param, const char *op, size_t op_len,
+                          struct expand_buf *out);
+static int expand_pattern(const struct param *param, const char *op, size_t op_len,
+                          struct expand_buf *out);
+static int expand_substring(const struct param *param, const char *arg, size_t arg_len,
+                            struct expand_buf *out);
+static const char* lookup(const struct param *param, char *number);
+static size_t special_len(const char *text, int braced);
+static const char* special_value(const char *name, char *number);
+static const char* find_char(const char *text, const char *end, char c);
+static int append(struct expand_buf *out, const char *data, size_t len);
+static int span_words(char **cmds, size_t i, size_t *last);
+static int brace_line(char ***cmds, size_t *num_cmds);
+static const char* brace_find(const char *text, const char *end, const char **close,
+                              struct expand_seq *seq, int *is_seq);
+static unsigned long long brace_count(const char *text, const char *end);
+static size_t brace_max_len(const char *text, const char *end);
+static int brace_gen(const char *text, const char *end, const struct brace_rest *rest,
+                     struct brace_out *out, size_t len);
+static int brace_emit(struct brace_out *out, size_t len);
+static int parse_seq(const char *text, size_t len, struct expand_seq *seq);
+static int parse_seq_end(const char *text, size_t len, long long *num, int *chars, int *width);
+
+/* *
+ * Expands every word of the command line *cmds, which has *num_cmds words, replacing (and
+ * freeing) the words that change.  ${name[@]} makes a word for each element, so the line may
+ * grow: *cmds must be allocated against MEM_PARSE, as the tokenizer allocates it, and may be
+ * moved.  Errors are printed.
+ *
+ * Returns - 0 on success, or -1 if an expansion failed, in which case *cmds is left as a valid
+ *           (but not fully expanded) command line.
+ * */
+int expand_line(char ***cmds, size_t *num_cmds) {
+  size_t i, j, k, out, len, extra;
+  char **words = *cmds, **grown;
+  char *word;
+  int status;
+  struct expand_buf buf;
+  struct word_list split;
+
+  // Brace expansion comes first, as in bash, so that each word it makes is expanded.
+  if(brace_line(cmds, num_cmds) == -1)
+    return -1;
+  words = *cmds;
+  for(i = 0; i < *num_cmds && strchr(words[i], '$') == NULL; i++)
+    ;
+  if(i == *num_cmds)
+    return 0;
+
+  memset(&buf, 0, sizeof(buf));
+  memset(&split, 0, sizeof(split));
+  for(out = i; i < *num_cmds; i++) {
+    if(strchr(words[i], '$') == NULL) {
+      words[out++] = words[i];
+      continue;
+    }
+    // Join the words an arithmetic expansion or a ${ } spans back into one.
+    word = words[i];
+    if(span_words(words, i, &j) == -1) {
+      fprintf(stderr, "tinysh: %s: missing )) or }\n", words[i]);
+      break;
+    }
+    if(j > i) {
+      for(len = 0, k = i; k <= j; k++)
+        len += strlen(words[k]) + 1;
+      if((word = mem_malloc(MEM_PARSE, len)) == NULL) {
+        perror("Error allocating memory for a word.");
+        break;
+      }
+      for(len = 0, k = i; k <= j; k++) {
+        strcpy(word + len, words[k]);
+        len += strlen(words[k]);
+        word[len++] = ' ';
+      }
+      word[len - 1] = '\0';
+    }
+
+    buf.len = 0;
+    buf.split = &split;
+    status = expand_word(word, &buf);
+    // The words split off by ${name[@]} go before the rest of the word, so if there are more of
+    // them than the words expanded, the rest of the line moves up to make room.
+    extra = out + split.num > j ? out + split.num - j : 0;
+    if(status == 0 && extra > 0) {
+      if((grown = mem_realloc(MEM_PARSE, words, (*num_cmds + extra + 1) * sizeof(*words)))
+         == NULL) {
+        perror("Error allocating memory for the command line.");
+        status = -1;
+      }
+      else {
+        *cmds = words = grown;
+      }
+    }
+    if(status == -1) {
+      for(k = 0; k < split.num; k++)
+        mem_free(MEM_PARSE, split.words[k]);
+      if(word != words[i])
+        mem_free(MEM_PARSE, word);
+      break;
+    }
+    if(VERBOSE_AT(V_LEVEL_DETAILS, V_PARSE) && split.num > 0)
+      printf("  Expanded %s to %zu words.\n", word, split.num + (buf.len > 0));
+    else if(VERBOSE_AT(V_LEVEL_DETAILS, V_PARSE))
+      printf("  Expanded %s to \"%s\".\n", word, buf.data);
+    if(word != words[i])
+      mem_free(MEM_PARSE, word);
+    for(k = i; k <= j; k++)
+      mem_free(MEM_PARSE, words[k]);
+    if(extra > 0) {
+      memmove(words + j + 1 + extra, words + j + 1, (*num_cmds - j) * sizeof(*words));
+      *num_cmds += extra;
+      j += extra;
+    }
+    i = j;
+    for(k = 0; k < split.num; k++)
+      words[out++] = split.words[k];
+    split.num = 0;
+    // A word that expands to nothing is removed, since the tokenizer only makes non-empty words.
+    if(buf.len > 0) {
+      words[out++] = buf.data;
+      memset(&buf, 0, sizeof(buf));
+    }
+  }
+  mem_free(MEM_PARSE, buf.data);
+  mem_free(MEM_PARSE, split.words);
+  if(i < *num_cmds) {
+    // Keep the words that were not reached, so that the line can still be freed.
+    for(; i < *num_cmds; i++)
+      words[out++] = words[i];
+    words[out] = NULL;
+    *num_cmds = out;
+    return -1;
+  }
+  words[out] = NULL;
+  *num_cmds = out;
+  return 0;
+}
+
+/* *
+ * Checks whether word, once its $ expansions are expanded, is a brace sequence, {first..last} or
+ * {first..last..incr}, and if so stores it in seq, so that its values can be generated one at a
+ * time rather than all made into words.  Errors are printed.
+ *
+ * Returns - 1 if word is a sequence, 0 if not, or -1 if an expansion failed.
+ * */
+int expand_seq(const char *word, struct expand_seq *seq) {
+  size_t len;
+  int status;
+  struct expand_buf buf;
+
+  len = strlen(word);
+  if(len < 2 || word[0] != '{' || word[len - 1] != '}')
+    return 0;
+  if(strchr(word, '$') == NULL)
+    return parse_seq(word + 1, len - 2, seq) == 0;
+  memset(&buf, 0, sizeof(buf));
+  if((status = expand_word(word, &buf)) == 0) {
+    status = buf.len >= 2 && buf.data[0] == '{' && buf.data[buf.len - 1] == '}'
+             && parse_seq(buf.data + 1, buf.len - 2, seq) == 0;
+  }
+  mem_free(MEM_PARSE, buf.data);
+  return status;
+}
+
+/* *
+ * Formats value i (counting from 0) of the sequence seq into buf, which holds EXPAND_SEQ_SIZE
+ * bytes.
+ *
+ * Returns - The length of the value.
+ * */
+size_t expand_seq_format(const struct expand_seq *seq, unsigned long long i, char *buf) {
+  unsigned long long value = (unsigned long long) seq->first + i * (unsigned long long) seq->step;
+  char digits[EXPAND_SEQ_SIZE];
+  size_t len = 0, num = 0;
+  int negative = (long long) value < 0;
+
+  if(seq->chars) {
+    buf[0] = (char) value;
+    buf[1] = '\0';
+    return 1;
+  }
+  // This makes a word per value, so it is done by hand rather than with snprintf.
+  if(negative)
+    value = -value;
+  do {
+    digits[num++] = (char) ('0' + value % 10);
+    value /= 10;
+  } while(value > 0);
+  if(negative)
+    buf[len++] = '-';
+  while(len + num < (size_t) seq->width)
+    buf[len++] = '0';
+  while(num > 0)
+    buf[len++] = digits[--num];
+  buf[len] = '\0';
+  return len;
+}
+
+/* *
+ * Expands the $ expansions of word onto the end of out.
+ *
+ * Returns - 0 on success, or -1 on an error, which is printed.
+ * */
+static int expand_word(const char *word, struct expand_buf *out) {
+  const char *pos, *dollar;
+  // Make sure out holds a string, even if word expands to nothing.
+  if(append(out, "", 0) == -1)
+    return -1;
+  for(pos = word; (dollar = strchr(pos, '$')) != NULL; ) {
+    if(append(out, pos, dollar - pos) == -1)
+      return -1;
+    pos = dollar;
+    if(strncmp(pos, "$((", 3) == 0) {
+      if(expand_arith(&pos, out) == -1)
+        return -1;
+    }
+    else if(expand_param(&pos, out) == -1) {
+      return -1;
+    }
+  }
+  return append(out, pos, strlen(pos));
+}
+
+/* *
+ * Expands the $(( expression )) at *pos onto the end of out, and moves *pos past it.
+ * */
+static int expand_arith(const char **pos, struct expand_buf *out) {
+  const char *start, *end;
+  char *expr;
+  char number[NUMBER_SIZE];
+  int depth, status;
+  long long result;
+  struct expand_buf inner;
+
+  start = *pos + 3;
+  for(end = start, depth = 0; *end != '\0'; end++) {
+    if(*end == '(')
+      depth++;
+    else if(*end == ')' && depth > 0)
+      depth--;
+    else if(*end == ')' && end[1] == ')')
+      break;
+  }
+  if(*end == '\0') {
+    fprintf(stderr, "tinysh: %s: missing )) of $((\n", *pos);
+    return -1;
+  }
+  *pos = end + 2;
+
+  if((expr = mem_malloc(MEM_PARSE, end - start + 1)) == NULL) {
+    perror("Error allocating memory for an expression.");
+    return -1;
+  }
+  memcpy(expr, start, end - start);
+  expr[end - start] = '\0';
+  memset(&inner, 0, sizeof(inner));
+  // Expand any $ expansions in the expression first.
+  if(strchr(expr, '$') != NULL) {
+    if(expand_word(expr, &inner) == -1) {
+      mem_free(MEM_PARSE, inner.data);
+      mem_free(MEM_PARSE, expr);
+      return -1;
+    }
+  }
+  status = arith_eval(inner.data != NULL ? inner.data : expr, &result);
+  mem_free(MEM_PARSE, inner.data);
+  mem_free(MEM_PARSE, expr);
+  if(status == -1)
+    return -1;
+  snprintf(number, sizeof(number), "%lld", result);
+  return append(out, number, strlen(number));
+}
+
+/* *
+ * Expands the parameter ($name, ${ }, or a special parameter such as $? or $1) at *pos onto the
+ * end of out, and moves *pos past it.  A $ that does not start a parameter is kept as it is.
+ * */
+static int expand_param(const char **pos, struct expand_buf *out) {
+  const char *start = *pos + 1, *value;
+  char number[NUMBER_SIZE], name[NAME_MAX + 1];
+  size_t len;
+  struct param param;
+
+  if(*start == '{')
+    return expand_brace(pos, out);
+  if(*start == '@' || *start == '*') {
+    // Every positional parameter, as ${name[@]} is every element.
+    memset(&param, 0, sizeof(param));
+    param.name[0] = *start;
+    param.subscript = *start;
+    *pos = start + 1;
+    return expand_elements(&param, 0, out);
+  }
+  if((len = special_len(start, 0)) > 0) {
+    name[0] = *start;
+    name[1] = '\0';
+    if((value = special_value(name, number)) == NULL)
+      value = "";
+  }
+  else if((len = vars_name_len(start)) > 0 && len <= NAME_MAX) {
+    memcpy(name, start, len);
+    name[len] = '\0';
+    if((value = vars_get(name)) == NULL)
+      value = "";
+  }
+  else {
+    *pos = start;
+    return append(out, "$", 1);
+  }
+  *pos = start + len;
+  return append(out, value, strlen(value));
+}
+
+/* *
+ * Expands the ${ } at *pos onto the end of out, and moves *pos past it.
+ * */
+static int expand_brace(const char **pos, struct expand_buf *out) {
+  const char *start = *pos + 2, *end, *op, *close;
+  size_t len;
+  int length, depth, status;
+  struct param param;
+  struct expand_buf key;
+
+  if((end = find_char(start, start + strlen(start), '}')) == NULL) {
+    fprintf(stderr, "tinysh: %s: missing }\n", *pos);
+    return -1;
+  }
+  memset(&param, 0, sizeof(param));
+  memset(&key, 0, sizeof(key));
+  // ${#name} is the length of the value, and ${!name[@]} lists the subscripts of an array.
+  length = *start == '#' && start + 1 < end;
+  param.keys = *start == '!';
+  start += length + param.keys;
+  if((len = special_len(start, 1)) == 0)
+    len = vars_name_len(start);
+  op = start + len;
+  if(len == 0 || len > NAME_MAX)
+    goto bad_substitution;
+  memcpy(param.name, start, len);
+  param.name[len] = '\0';
+  if(*start == '@' || *start == '*')
+    param.subscript = *start;
+
+  // name[@], name[*], or name[sub], where sub is a key of an associative array, or else an
+  // arithmetic index.
+  if(*op == '[' && vars_name_len(start) > 0) {
+    for(close = op + 1, depth = 0; close < end && (*close != ']' || depth > 0); close++)
+      depth += *close == '[' ? 1 : *close == ']' ? -1 : 0;
+    if(close == end)
+      goto bad_substitution;
+    if(close == op + 2 && (op[1] == '@' || op[1] == '*')) {
+      param.subscript = op[1];
+    }
+    else if(vars_is_assoc(param.name)) {
+      param.subscript = 1;
+      param.key = op + 1;
+      param.key_len = close - op - 1;
+      if(memchr(param.key, '$', param.key_len) != NULL) {
+        if(expand_slice(param.key, param.key_len, &key) == -1)
+          return -1;
+        param.key = key.data;
+        param.key_len = key.len;
+      }
+    }
+    else if(expand_number(op + 1, close - op - 1, &param.index) == -1) {
+      return -1;
+    }
+    else {
+      param.subscript = 1;
+    }
+    op = close + 1;
+  }
+  // The operators apply to a single value.
+  if((length || param.keys || param.subscript == '@' || param.subscript == '*') && op != end)
+    goto bad_substitution;
+  if(param.keys && param.subscript != '@' && param.subscript != '*')
+    goto bad_substitution;
+
+  if(param.subscript == '@' || param.subscript == '*')
+    status = expand_elements(&param, length, out);
+  else if(op == end)
+    status = expand_value(&param, length, out);
+  else if(*op == '#' || *op == '%' || *op == '/')
+    status = expand_pattern(&param, op, end - op, out);
+  else if(*op == ':' && (op + 1 == end || strchr("-=+?", op[1]) == NULL))
+    status = expand_substring(&param, op + 1, end - op - 1, out);
+  else if(strchr("-=+?:", *op) != NULL)
+    status = expand_default(&param, op, end - op, out);
+  else
+    goto bad_substitution;
+  mem_free(MEM_PARSE, key.data);
+  *pos = end + 1;
+  return status;
+
+bad_substitution:
+  mem_free(MEM_PARSE, key.data);
+  fprintf(stderr, "tinysh: %.*s: bad substitution\n", (int) (end + 1 - *pos), *pos);
+  return -1;
+}
+
+/* *
+ * Expands ${name} (or an element, ${name[sub]}) onto the end of out, or its length, if length is 1.
+ * */
+static int expand_value(const struct param *param, int length, struct expand_buf *out) {
+  const char *value;
+  char number[NUMBER_SIZE];
+  value = lookup(param, number);
+  if(!length)
+    return append(out, value != NULL ? value : "", value != NULL ? strlen(value) : 0);
+  snprintf(number, sizeof(number), "%zu", value != NULL ? strlen(value) : 0);
+  return append(out, number, strlen(number));
+}
+
+/* *
+ * Expands ${name[@]}, every element of the array name, onto the end of out, or ${!name[@]}, every
+ * subscript, or ${#name[@]}, the number of elements, if length is 1.  If out splits words, each
+ * element after the first ends the word and starts a new one, as "${name[@]}" does in bash;
+ * otherwise, and for ${name[*]}, the elements are joined by the first character of IFS.
+ * */
+static int expand_elements(const struct param *param, int length, struct expand_buf *out) {
+  char **items, **keys, number[NUMBER_SIZE];
+  const char *value, *item, *ifs;
+  size_t i, num, count;
+  int status;
+
+  // The positional parameters are the elements of $@, and a variable that is not an array is an
+  // array of its one value.
+  if(param->name[0] == '@' || param->name[0] == '*') {
+    items = interp_params(&num);
+  }
+  else if((items = vars_array_items(param->name, &num)) == NULL) {
+    value = vars_get(param->name);
+    items = (char **) &value;
+    num = value != NULL;
+  }
+  keys = param->keys ? vars_array_keys(param->name, &num) : NULL;
+  if(length) {
+    for(i = 0, count = 0; i < num; i++)
+      count += items[i] != NULL;
+    snprintf(number, sizeof(number), "%zu", count);
+    return append(out, number, strlen(number));
+  }
+  ifs = vars_get("IFS");
+  for(i = 0, count = 0, status = 0; status == 0 && i < num; i++) {
+    if(items[i] == NULL)
+      continue;
+    if(count++ > 0 && param->subscript == '@' && out->split != NULL)
+      status = split_word(out);
+    else if(count > 1 && (ifs == NULL || *ifs != '\0'))
+      status = append(out, ifs != NULL ? ifs : " ", 1);
+    if(param->keys && keys == NULL) {
+      snprintf(number, sizeof(number), "%zu", i);
+      item = number;
+    }
+    else {
+      item = param->keys ? keys[i] : items[i];
+    }
+    if(status == 0)
+      status = append(out, item, strlen(item));
+  }
+  return status;
+}
+
+/* *
+ * Ends the word being expanded into out, moving it to the end of out->split, and starts a new one.
+ * A word that is empty is dropped, as an empty word of the line is.
+ * */
+static int split_word(struct expand_buf *out) {
+  char **words;
+  size_t capacity;
+  struct word_list *split = out->split;
+  if(out->len == 0)
+    return 0;
+  if(split->num == split->capacity) {
+    capacity = split->capacity ? split->capacity * 2 : DEFAULT_SPLIT_CAPACITY;
+    if((words = mem_realloc(MEM_PARSE, split->words, capacity * sizeof(*words))) == NULL) {
+      perror("Error allocating memory for a word.");
+      return -1;
+    }
+    split->words = words;
+    split->capacity = capacity;
+  }
+  split->words[split->num++] = out->data;
+  out->data = NULL;
+  out->len = out->size = 0;
+  return append(out, "", 0);
+}
+
+/* *
+ * Expands ${name-word} (and =, +, and ?, with or without a colon), where op holds the op_len
+ * characters of the operator and word, onto the end of out.  Only the word that is used is
+ * expanded.
+ * */
+static int expand_default(const struct param *param, const char *op, size_t op_len,
+                          struct expand_buf *out) {
+  const char *word, *value;
+  char number[NUMBER_SIZE];
+  size_t word_len;
+  int colon, set, status;
+  struct expand_buf buf;
+
+  // With a colon, a variable that is set but empty counts as unset.
+  colon = *op == ':';
+  word = op + colon + 1;
+  word_len = op_len - colon - 1;
+  value = lookup(param, number);
+  set = value != NULL && !(colon && *value == '\0');
+  switch(op[colon]) {
+    case '-':
+      return set ? append(out, value, strlen(value)) : expand_slice(word, word_len, out);
+    case '+':
+      return set ? expand_slice(word, word_len, out) : 0;
+    case '=':
+      if(set)
+        return append(out, value, strlen(value));
+      if(vars_name_len(param->name) == 0) {
+        fprintf(stderr, "tinysh: $%s: cannot assign in this way\n", param->name);
+        return -1;
+      }
+      memset(&buf, 0, sizeof(buf));
+      status = expand_slice(word, word_len, &buf);
+      if(status == 0) {
+        if(param->key != NULL)
+          status = vars_assoc_set(param->name, param->key, param->key_len, buf.data, buf.len);
+        else if(param->subscript)
+          status = vars_array_set(param->name, param->index, buf.data, buf.len);
+        else
+          status = vars_set(param->name, buf.data);
+      }
+      if(status == 0)
+        status = append(out, buf.data, buf.len);
+      mem_free(MEM_PARSE, buf.data);
+      return status;
+    default:
+      if(set)
+        return append(out, value, strlen(value));
+      memset(&buf, 0, sizeof(buf));
+      if(word_len == 0)
+        fprintf(stderr, "tinysh: %s: parameter %snot set\n", param->name, colon ? "null or " : "");
+      else if(expand_slice(word, word_len, &buf) == 0)
+        fprintf(stderr, "tinysh: %s: %s\n", param->name, buf.data);
+      mem_free(MEM_PARSE, buf.data);
+      return -1;
+  }
+}
+
+/* *
+ * Expands ${name#pat} (and ##, %, %%, /, //, /#, and /%), where op holds the op_len characters of
+ * the operator, pattern, and replacement, onto the end of out.  The kept parts of the value are
+ * appended straight from the variable.
+ * */
+static int expand_pattern(const struct param *param, const char *op, size_t op_len,
+                          struct expand_buf *out) {
+  const char *end = op + op_len, *text, *rep, *value;
+  char number[NUMBER_SIZE], mode;
+  size_t text_len, rep_len, value_len, i, start, match;
+  int longest, global, status;
+  const struct pattern *pat;
+  struct expand_buf text_buf, rep_buf;
+
+  mode = *op;
+  text = op + 1;
+  longest = mode != '/' && text < end && *text == mode;
+  text += longest;
+  global = mode == '/' && text < end && *text == '/';
+  if(mode == '/' && text < end && (*text == '/' || *text == '#' || *text == '%'))
+    mode = *text++;
+  rep = NULL;
+  rep_len = 0;
+  if(op[0] == '/' && (rep = find_char(text, end, '/')) != NULL)
+    rep_len = end - ++rep;
+  text_len = (rep != NULL ? rep - 1 : end) - text;
+  if(rep == NULL)
+    rep = "";
+
+  // Expand the pattern and the replacement before the value is looked up, since they may set it.
+  status = -1;
+  memset(&text_buf, 0, sizeof(text_buf));
+  memset(&rep_buf, 0, sizeof(rep_buf));
+  if(memchr(text, '$', text_len) != NULL) {
+    if(expand_slice(text, text_len, &text_buf) == -1)
+      goto done;
+    text = text_buf.data;
+    text_len = text_buf.len;
+  }
+  if(rep != NULL && memchr(rep, '$', rep_len) != NULL) {
+    if(expand_slice(rep, rep_len, &rep_buf) == -1)
+      goto done;
+    rep = rep_buf.data;
+    rep_len = rep_buf.len;
+  }
+  if((pat = pattern_compile(text, text_len)) == NULL)
+    goto done;
+  if((value = lookup(param, number)) == NULL)
+    value = "";
+  value_len = strlen(value);
+
+  switch(mode) {
+    case '#':
+      if(op[0] == '#' && pattern_prefix(pat, value, value_len, longest, &match)) {
+        value += match;
+        value_len -= match;
+      }
+      else if(op[0] == '/' && pattern_prefix(pat, value, value_len, 1, &match)) {
+        if(append(out, rep, rep_len) == -1)
+          goto done;
+        value += match;
+        value_len -= match;
+      }
+      break;
+    case '%':
+      if(pattern_suffix(pat, value, value_len, op[0] == '%' ? longest : 1, &match)) {
+        value_len -= match;
+        if(op[0] == '/' && (append(out, value, value_len) == -1 || append(out, rep, rep_len) == -1))
+          goto done;
+        if(op[0] == '/')
+          value_len = 0;
+      }
+      break;
+    default:
+      // The first (or every) longest match, left to right.  An empty pattern matches nothing.
+      for(i = 0; text_len > 0 && (i < value_len || value_len == 0)
+          && pattern_find(pat, value + i, value_len - i, &start, &match); ) {
+        if(append(out, value + i, start) == -1 || append(out, rep, rep_len) == -1)
+          goto done;
+        i += start + match;
+        if(!global || (match == 0 && i >= value_len))
+          break;
+        // Step over a character after an empty match, so that the next one is further on.
+        if(match == 0 && append(out, value + i++, 1) == -1)
+          goto done;
+      }
+      value += i;
+      value_len -= i;
+  }
+  status = append(out, value, value_len);
+
+done:
+  mem_free(MEM_PARSE, text_buf.data);
+  mem_free(MEM_PARSE, rep_buf.data);
+  return status;
+}
+
+/* *
+ * Expands ${name:off} or ${name:off:len}, where arg holds the arg_len characters after the first
+ * colon, onto the end of out.  A negative offset counts from the end of the value, and a negative
+ * length is an offset from the end at which the substring stops.
+ * */
+static int expand_substring(const struct param *param, const char *arg, size_t arg_len,
+                            struct expand_buf *out) {
+  const char *colon, *value;
+  char number[NUMBER_SIZE];
+  long long off, count, value_len, stop;
+
+  colon = find_char(arg, arg + arg_len, ':');
+  if(expand_number(arg, colon != NULL ? (size_t) (colon - arg) : arg_len, &off) == -1
+     || (colon != NULL && expand_number(colon + 1, arg + arg_len - colon - 1, &count) == -1))
+    return -1;
+  if((value = lookup(param, number)) == NULL)
+    value = "";
+  value_len = strlen(value);
+
+  if(off < 0)
+    off += value_len;
+  if(off < 0 || off > value_len)
+    return 0;
+  stop = value_len;
+  if(colon != NULL) {
+    stop = count < 0 ? value_len + count : (count < value_len - off ? off + count : value_len);
+    if(stop < off) {
+      fprintf(stderr, "tinysh: %.*s: substring expression < 0\n", (int) (arg + arg_len - colon - 1),
+              colon + 1);
+      return -1;
+    }
+  }
+  return append(out, value + off, stop - off);
+}
+
+/* *
+ * Expands the $ expansions of the len characters of text onto the end of out.  Text without any
+ * is appended as it is.
+ * */
+static int expand_slice(const char *text, size_t len, struct expand_buf *out) {
+  char *copy;
+  int status;
+  if(memchr(text, '$', len) == NULL)
+    return append(out, text, len);
+  if((copy = mem_malloc(MEM_PARSE, len + 1)) == NULL) {
+    perror("Error allocating memory for a word.");
+    return -1;
+  }
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+  status = expand_word(copy, out);
+  mem_free(MEM_PARSE, copy);
+  return status;
+}
+
+/* *
+ * Expands the len characters of text and evaluates them as an arithmetic expression into num.
+ * */
+static int expand_number(const char *text, size_t len, long long *num) {
+  char expr[EXPR_SIZE];
+  int status;
+  struct expand_buf buf;
+
+  if(len < sizeof(expr) && memchr(text, '$', len) == NULL) {
+    memcpy(expr, text, len);
+    expr[len] = '\0';
+    return arith_eval(expr, num);
+  }
+  memset(&buf, 0, sizeof(buf));
+  if((status = expand_slice(text, len, &buf)) == 0)
+    status = arith_eval(buf.data, num);
+  mem_free(MEM_PARSE, buf.data);
+  return status;
+}
+
+/* *
+ * Returns - The value of param (a variable, an element of an array, or a special parameter),
+ *           formatting numbers into number, or NULL if it is not set.
+ * */
+static const char* lookup(const struct param *param, char *number) {
+  const char *name = param->name;
+  if(special_len(name, 1) > 0)
+    return special_value(name, number);
+  if(param->key != NULL)
+    return vars_assoc_get(name, param->key, param->key_len);
+  if(param->subscript)
+    return vars_array_get(name, param->index);
+  return vars_get(name);
+}
+
+/* *
+ * Returns - The length of the special parameter at the start of text (?, $, #, @, *, or a digit,
+ *           or, if braced is 1, as in ${10}, every digit), or 0 if it is a name or nothing.
+ * */
+static size_t special_len(const char *text, int braced) {
+  size_t len;
+  if(*text != '\0' && strchr("?$#@*", *text) != NULL)
+    return 1;
+  for(len = 0; isdigit((unsigned char) text[len]) && (braced || len == 0); len++)
+    ;
+  return len;
+}
+
+/* *
+ * Returns - The value of the special parameter name (?, $, #, 0, or a positional parameter),
+ *           formatting numbers into number, or NULL if it is not set.
+ * */
+static const char* special_value(const char *name, char *number) {
+  char **params;
+  size_t num;
+  unsigned long n;
+
+  if(name[0] == '?' || name[0] == '$') {
+    snprintf(number, NUMBER_SIZE, "%d", name[0] == '?' ? last_status : (int) getpid());
+    return number;
+  }
+  params = interp_params(&num);
+  if(name[0] == '#') {
+    snprintf(number, NUMBER_SIZE, "%zu", num);
+    return number;
+  }
+  // $0 is the name of the shell, even in a function.
+  if((n = strtoul(name, NULL, 10)) == 0)
+    return "tinysh";
+  return n <= num ? params[n - 1] : NULL;
+}
+
+/* *
+ * Returns - The first c from text up to end that is not quoted with \ or within a nested { }, or
+ *           NULL if there is none.
+ * */
+static const char* find_char(const char *text, const char *end, char c) {
+  int depth;
+  for(depth = 0; text < end; text++) {
+    if(*text == '\\' && text + 1 < end)
+      text++;
+    else if(*text == c && depth == 0)
+      return text;
+    else if(*text == '{')
+      depth++;
+    else if(*text == '}')
+      depth--;
+  }
+  return NULL;
+}
+
+/* *
+ * Appends the len characters of data to out, keeping it null-terminated.
+ * */
+static int append(struct expand_buf *out, const char *data, size_t len) {
+  char *buf;
+  size_t size;
+  if(out->len + len + 1 > out->size) {
+    for(size = out->size ? out->size : DEFAULT_EXPAND_CAPACITY; size < out->len + len + 1; )
+      size *= 2;
+    if((buf = mem_realloc(MEM_PARSE, out->data, size)) == NULL) {
+      perror("Error allocating memory for a word.");
+      return -1;
+    }
+    out->data = buf;
+    out->size = size;
+  }
+  memcpy(out->data + out->len, data, len);
+  out->len += len;
+  out->data[out->len] = '\0';
+  return 0;
+}
+
+/* *
+ * Finds the last of the words, starting at word i of cmds, that the first arithmetic expansion or
+ * ${ } in word i spans, by counting parentheses and braces from its $(( or ${, and stores its
+ * index in last (i if the expansions of word i are complete.)
+ *
+ * Returns - 0 on success, or -1 if the line ends first.
+ * */
+static int span_words(char **cmds, size_t i, size_t *last) {
+  const char *c, *brace;
+  int depth;
+
+  *last = i;
+  c = strstr(cmds[i], "$((");
+  if((brace = strstr(cmds[i], "${")) != NULL && (c == NULL || brace < c))
+    c = brace;
+  if(c == NULL)
+    return 0;
+  for(depth = 0; cmds[*last] != NULL; c = cmds[++*last]) {
+    for(; *c != '\0'; c++) {
+      if(*c == '(' || *c == '{')
+        depth++;
+      else if(*c == ')' || *c == '}')
+        depth--;
+    }
+    // Every expansion of the word has been closed (a later one may also be open, and span further.)
+    if(depth <= 0)
+      return 0;
+  }
+  return -1;
+}
+
+/* *
+ * Replaces each word of the command line *cmds that has brace expansions with the words they make,
+ * e.g. a{b,c}d with abd and acd, or x{1..3} with x1, x2, and x3.  Every word the line will hold is
+ * counted first, so the new line is allocated once, at its final size, and each word is built in a
+ * buffer as long as the longest.  A line of assignments is left as it is.
+ *
+ * Returns - 0 on success, or -1 on an error, in which case *cmds is left as a valid (but not fully
+ *           expanded) command line.
+ * */
+static int brace_line(char ***cmds, size_t *num_cmds) {
+  char **words = *cmds, **line;
+  const char *close;
+  size_t i, j, len, max_len, total;
+  unsigned long long count;
+  int is_seq, found, status;
+  struct expand_seq seq;
+  struct brace_out out;
+
+  for(i = 0; i < *num_cmds && strchr(words[i], '{') == NULL; i++)
+    ;
+  if(i == *num_cmds || vars_assignments(words))
+    return 0;
+
+  for(i = 0, total = 0, max_len = 0, found = 0; i < *num_cmds; i++) {
+    len = strlen(words[i]);
+    count = 1;
+    if(brace_find(words[i], words[i] + len, &close, &seq, &is_seq) != NULL) {
+      found = 1;
+      count = brace_count(words[i], words[i] + len);
+      if((len = brace_max_len(words[i], words[i] + len)) > max_len)
+        max_len = len;
+    }
+    if(count > BRACE_MAX_WORDS - total) {
+      fprintf(stderr, "tinysh: %s: brace expansion makes too many words\n", words[i]);
+      return -1;
+    }
+    total += count;
+  }
+  if(!found)
+    return 0;
+
+  memset(&out, 0, sizeof(out));
+  if((line = mem_malloc(MEM_PARSE, (total + 1) * sizeof(*line))) == NULL
+     || (out.buf = mem_malloc(MEM_PARSE, max_len + 1)) == NULL) {
+    perror("Error allocating memory for the command line.");
+    mem_free(MEM_PARSE, line);
+    return -1;
+  }
+  out.words = line;
+  for(i = 0, status = 0; i < *num_cmds && status == 0; i++) {
+    len = strlen(words[i]);
+    if(brace_find(words[i], words[i] + len, &close, &seq, &is_seq) == NULL) {
+      line[out.num++] = words[i];
+    }
+    else if((status = brace_gen(words[i], words[i] + len, NULL, &out, 0)) == 0) {
+      if(VERBOSE_AT(V_LEVEL_DETAILS, V_PARSE))
+        printf("  Expanded the braces of %s.\n", words[i]);
+      mem_free(MEM_PARSE, words[i]);
+    }
+    else {
+      line[out.num++] = words[i];
+    }
+  }
+  // Keep the words that were not reached, so that the line can still be freed.
+  for(j = i; j < *num_cmds; j++)
+    line[out.num++] = words[j];
+  line[out.num] = NULL;
+  mem_free(MEM_PARSE, out.buf);
+  mem_free(MEM_PARSE, words);
+  *cmds = line;
+  *num_cmds = out.num;
+  return status;
+}
+
+/* *
+ * Finds the first brace expansion in text, which ends at end: a { whose matching } closes a list
+ * with a comma at its top level, or a sequence.  Backslash escapes and ${...} are skipped, as is a
+ * { that opens neither.  A sequence is parsed into seq, and *is_seq set.
+ *
+ * Returns - A pointer to the {, with *close pointing to its }, or NULL if text has none.
+ * */
+static const char* brace_find(const char *text, const char *end, const char **close,
+                              struct expand_seq *seq, int *is_seq) {
+  const char *open, *p;
+  int depth, comma;
+
+  for(open = text; open < end; open++) {
+    if(*open == '\\' && open + 1 < end) {
+      open++;
+      continue;
+    }
+    if(*open == '$' && open + 1 < end && open[1] == '{') {
+      if((p = find_char(open + 2, end, '}')) == NULL)
+        return NULL;
+      open = p;
+      continue;
+    }
+    if(*open != '{')
+      continue;
+    for(p = open + 1, depth = 0, comma = 0; p < end; p++) {
+      if(*p == '\\' && p + 1 < end)
+        p++;
+      else if(*p == '$' && p + 1 < end && p[1] == '{' && (p = find_char(p + 2, end, '}')) == NULL)
+        return NULL;
+      else if(*p == '{')
+        depth++;
+      else if(*p == '}' && depth-- == 0)
+        break;
+      else if(*p == ',' && depth == 0)
+        comma = 1;
+    }
+    if(p == end)
+      return NULL;
+    *is_seq = !comma && parse_seq(open + 1, (size_t) (p - open - 1), seq) == 0;
+    if(comma || *is_seq) {
+      *close = p;
+      return open;
+    }
+  }
+  return NULL;
+}
+
+/* *
+ * Counts the words the brace expansions of text, which ends at end, make, saturating at
+ * BRACE_MAX_WORDS + 1.
+ *
+ * Returns - The number of words.
+ * */
+static unsigned long long brace_count(const char *text, const char *end) {
+  const char *open, *close, *p, *start;
+  unsigned long long count, after;
+  int is_seq, depth;
+  struct expand_seq seq;
+
+  if((open = brace_find(text, end, &close, &seq, &is_seq)) == NULL)
+    return 1;
+  if(is_seq) {
+    count = seq.count;
+  }
+  else {
+    for(p = start = open + 1, depth = 0, count = 0; p <= close; p++) {
+      if(*p == '\\')
+        p++;
+      else if(*p == '$' && p[1] == '{')
+        p = find_char(p + 2, close, '}');
+      else if(*p == '{')
+        depth++;
+      else if(*p == '}' && depth > 0)
+        depth--;
+      else if((*p == ',' && depth == 0) || p == close) {
+        count += brace_count(start, p);
+        start = p + 1;
+      }
+    }
+  }
+  after = brace_count(close + 1, end);
+  if(count > BRACE_MAX_WORDS || after > BRACE_MAX_WORDS || count * after > BRACE_MAX_WORDS)
+    return BRACE_MAX_WORDS + 1;
+  return count * after;
+}
+
+/* *
+ * Bounds the length of the longest word the brace expansions of text, which ends at end, make.
+ *
+ * Returns - The bound.
+ * */
+static size_t brace_max_len(const char *text, const char *end) {
+  const char *open, *close, *p, *start;
+  size_t len, max_len;
+  int is_seq, depth;
+  struct expand_seq seq;
+
+  if((open = brace_find(text, end, &close, &seq, &is_seq)) == NULL)
+    return (size_t) (end - text);
+  if(is_seq) {
+    max_len = EXPAND_SEQ_SIZE;
+  }
+  else {
+    for(p = start = open + 1, depth = 0, max_len = 0; p <= close; p++) {
+      if(*p == '\\')
+        p++;
+      else if(*p == '$' && p[1] == '{')
+        p = find_char(p + 2, close, '}');
+      else if(*p == '{')
+        depth++;
+      else if(*p == '}' && depth > 0)
+        depth--;
+      else if((*p == ',' && depth == 0) || p == close) {
+        if((len = brace_max_len(start, p)) > max_len)
+          max_len = len;
+        start = p + 1;
+      }
+    }
+  }
+  return (size_t) (open - text) + max_len + brace_max_len(close + 1, end);
+}
+
+/* *
+ * Generates the words the brace expansions of text, which ends at end, followed by rest, make.
+ * The first len bytes of out->buf have already been built.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int brace_gen(const char *text, const char *end, const struct brace_rest *rest,
+                     struct brace_out *out, size_t len) {
+  const char *open, *close, *p, *start;
+  unsigned long long i;
+  int is_seq, depth;
+  struct expand_seq seq;
+  struct brace_rest after;
+
+  if((open = brace_find(text, end, &close, &seq, &is_seq)) == NULL) {
+    memcpy(out->buf + len, text, (size_t) (end - text));
+    len += (size_t) (end - text);
+    if(rest == NULL)
+      return brace_emit(out, len);
+    return brace_gen(rest->text, rest->end, rest->next, out, len);
+  }
+  memcpy(out->buf + len, text, (size_t) (open - text));
+  len += (size_t) (open - text);
+  after.text = close + 1;
+  after.end = end;
+  after.next = rest;
+  if(is_seq) {
+    for(i = 0; i < seq.count; i++) {
+      if(brace_gen(close + 1, end, rest, out, len + expand_seq_format(&seq, i, out->buf + len))
+         == -1)
+        return -1;
+    }
+    return 0;
+  }
+  for(p = start = open + 1, depth = 0; p <= close; p++) {
+    if(*p == '\\')
+      p++;
+    else if(*p == '$' && p[1] == '{')
+      p = find_char(p + 2, close, '}');
+    else if(*p == '{')
+      depth++;
+    else if(*p == '}' && depth > 0)
+      depth--;
+    else if((*p == ',' && depth == 0) || p == close) {
+      if(brace_gen(start, p, &after, out, len) == -1)
+        return -1;
+      start = p + 1;
+    }
+  }
+  return 0;
+}
+
+/* *
+ * Adds the len bytes built in out->buf to out as a word, unless they are empty.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int brace_emit(struct brace_out *out, size_t len) {
+  char *word;
+  if(len == 0)
+    return 0;
+  if((word = mem_malloc(MEM_PARSE, len + 1)) == NULL) {
+    perror("Error allocating memory for a word.");
+    return -1;
+  }
+  memcpy(word, out->buf, len);
+  word[len] = '\0';
+  out->words[out->num++] = word;
+  return 0;
+}
+
+/* *
+ * Parses the len bytes at text as the inside of a brace sequence: first..last or
+ * first..last..incr, where first and last are both integers or both single letters.  Integers
+ * written with leading zeros are padded to the widest of them.
+ *
+ * Returns - 0 if text is a sequence, or -1 if not.
+ * */
+static int parse_seq(const char *text, size_t len, struct expand_seq *seq) {
+  const char *dots, *end = text + len, *incr_end;
+  long long first, last, incr = 1;
+  unsigned long long distance;
+  int first_chars, last_chars, first_width, last_width, incr_chars, incr_width;
+
+  if((dots = memchr(text, '.', len)) == NULL || dots + 1 >= end || dots[1] != '.'
+     || parse_seq_end(text, (size_t) (dots - text), &first, &first_chars, &first_width) == -1)
+    return -1;
+  text = dots + 2;
+  if((dots = memchr(text, '.', (size_t) (end - text))) == NULL) {
+    incr_end = NULL;
+    dots = end;
+  }
+  else if(dots + 1 < end && dots[1] == '.') {
+    incr_end = end;
+  }
+  else {
+    return -1;
+  }
+  if(parse_seq_end(text, (size_t) (dots - text), &last, &last_chars, &last_width) == -1
+     || last_chars != first_chars)
+    return -1;
+  if(incr_end != NULL && (parse_seq_end(dots + 2, (size_t) (incr_end - dots - 2), &incr,
+                                        &incr_chars, &incr_width) == -1 || incr_chars))
+    return -1;
+  // Keep the count within range: the step is at most the distance between the ends.
+  if(incr < 0)
+    incr = incr == LLONG_MIN ? LLONG_MAX : -incr;
+  if(incr == 0)
+    incr = 1;
+  seq->chars = first_chars;
+  seq->width = first_width > last_width ? first_width : last_width;
+  seq->first = first;
+  seq->step = first <= last ? incr : -incr;
+  distance = first <= last ? (unsigned long long) last - (unsigned long long) first
+                           : (unsigned long long) first - (unsigned long long) last;
+  seq->count = distance / (unsigned long long) incr + 1;
+  return 0;
+}
+
+/* *
+ * Parses the len bytes at text as one end of a brace sequence, a single letter or an integer.
+ * *width is set to the length of an integer written with a leading zero, and to 0 otherwise.
+ *
+ * Returns - 0 on success, or -1 if text is neither.
+ * */
+static int parse_seq_end(const char *text, size_t len, long long *num, int *chars, int *width) {
+  size_t i;
+  unsigned long long value;
+  int negative;
+
+  *chars = 0;
+  *width = 0;
+  if(len == 1 && isalpha((unsigned char) text[0])) {
+    *chars = 1;
+    *num = text[0];
+    return 0;
+  }
+  negative = len > 0 && (text[0] == '-' || text[0] == '+');
+  i = (size_t) negative;
+  // 18 digits always fit in a long long.
+  if(i == len || len - i > 18)
+    return -1;
+  for(value = 0; i < len; i++) {
+    if(!isdigit((unsigned char) text[i]))
+      return -1;
+    value = value * 10 + (unsigned long long) (text[i] - '0');
+  }
+  if(text[negative] == '0' && len - (size_t) negative > 1)
+    *width = (int) len;
+  *num = text[0] == '-' ? -(long long) value : (long long) value;
+  return 0;
+}
@@ -0,0 +1,404 @@
+/* *
+ * explain.c
+ *
+ * The explain builtin: the plan the shell would follow to run a command line, without running it.
+ *
+ * The plan walks the line the same way the shell's dispatch does: builtins run in the shell
+ * process (along with their redirections, if the line has no pipes), everything else is forked by
+ * exec_dispatch (or by the zygote), and in the child each pipe or redirection splits the line in
+ * two, with special_command forking the head and the child carrying on with the tail.  Lines the
+ * optimizer rewrites are instead run as flat pipelines, forked stage by stage by the shell, and
+ * the rewrites are listed first.  A group, a subshell, a loop, or a list runs in the shell process
+ * (see interp.c), unless it is a subshell that could change the shell, which forks.  Each step is
+ * printed with the process that takes it, and the forks, pipes, opens, dup2s, and execs of the
+ * whole line are totalled, so that fork-heavy lines stand out before they are run.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "explain.h"
+#include "tinysh.h"
+#include "cmdhash.h"
+#include "pipeline.h"
+#include "optimize.h"
+#include "zygote.h"
+#include "redirect.h"
+#include "builtins.h"
+#include "interp.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHELL_PROC  0
+#define ZYGOTE_PROC -1
+
+/*
+ * Costs of a plan, and the number of processes it has created so far.
+ */
+struct plan {
+  int procs;
+  int forks;
+  int pipes;
+  int opens;
+  int dup2s;
+  int execs;
+};
+
+static void step(int proc, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void explain_builtin(struct plan *plan, char **cmds, size_t num);
+static void explain_interp(struct plan *plan, char **cmds, size_t num);
+static void explain_redirect(struct plan *plan, int proc, const char *op, const char *file);
+static void explain_restore(struct plan *plan, int proc, const char *op);
+static void explain_child(struct plan *plan, int proc, char **cmds, size_t start, size_t end);
+static void explain_exec(struct plan *plan, int proc, char **cmds, size_t start, size_t end);
+static void explain_flat(struct plan *plan, struct pipeline *pl);
+static void explain_rewrite(const char *rewrite);
+static size_t special_index(char **cmds, size_t start, size_t end);
+
+/* *
+ * Handler for the explain builtin.
+ *
+ * explain cmd [args ...] [| cmd ...] [> file | >> file]
+ * explain ( list ) [> file | >> file]   (or a group, a loop, or a list)
+ *
+ * Prints the steps the shell would take to run the command line, and what they would cost.
+ * */
+int explain_handle(char **cmd, size_t num_cmd) {
+  size_t i;
+  int proc, routed;
+  struct plan plan;
+  struct pipeline pl;
+
+  if(num_cmd < 2) {
+    printf("Error:  Missing command.\nUsage: explain cmd [args ...]\n");
+    return -1;
+  }
+  memset(&plan, 0, sizeof(plan));
+  printf("Plan for:");
+  for(i = 1; i < num_cmd; i++)
+    printf(" %s", cmd[i]);
+  printf("\n");
+
+  if(interp_wants(cmd + 1)) {
+    explain_interp(&plan, cmd + 1, num_cmd - 1);
+  }
+  else if(is_builtin(cmd + 1)) {
+    explain_builtin(&plan, cmd + 1, num_cmd - 1);
+  }
+  else if((routed = optimize_line(cmd + 1, &pl, explain_rewrite)) != 0) {
+    // pipeline_dispatch: the optimized line runs as a flat pipeline.
+    if(routed == -1) {
+      step(SHELL_PROC, "fail: the line is not a valid pipeline");
+    }
+    else {
+      explain_flat(&plan, &pl);
+      pipeline_free(&pl);
+    }
+  }
+  else {
+    // exec_dispatch: fork (or have the zygote fork) a child to run the line.
+    proc = ++plan.procs;
+    plan.forks++;
+    if(zygote_active()) {
+      step(ZYGOTE_PROC, "fork child %d", proc);
+    }
+    else {
+      // The child holds a close-on-exec pipe, which tells the shell when it executes a program.
+      plan.pipes++;
+      step(SHELL_PROC, "pipe (to see when child %d executes a program)", proc);
+      step(SHELL_PROC, "fork child %d", proc);
+    }
+    explain_child(&plan, proc, cmd + 1, 0, num_cmd - 1);
+  }
+
+  printf("Cost:  %d fork%s, %d pipe%s, %d open%s, %d dup2%s, %d exec%s\n",
+         plan.forks, plan.forks == 1 ? "" : "s", plan.pipes, plan.pipes == 1 ? "" : "s",
+         plan.opens, plan.opens == 1 ? "" : "s", plan.dup2s, plan.dup2s == 1 ? "" : "s",
+         plan.execs, plan.execs == 1 ? "" : "s");
+  return 0;
+}
+
+/* *
+ * Prints one step of a plan, taken by process proc.
+ * */
+static void step(int proc, const char *fmt, ...) {
+  va_list args;
+  char label[32];
+  if(proc == SHELL_PROC)
+    snprintf(label, sizeof(label), "shell");
+  else if(proc == ZYGOTE_PROC)
+    snprintf(label, sizeof(label), "zygote");
+  else
+    snprintf(label, sizeof(label), "child %d", proc);
+  printf("  %-9s ", label);
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+  printf("\n");
+}
+
+/* *
+ * Explains a builtin command line, cmds, of num commands.
+ * */
+static void explain_builtin(struct plan *plan, char **cmds, size_t num) {
+  int proc;
+  size_t i;
+  const struct command *c;
+  struct pipeline pl;
+  if(strcmp(cmds[0], "time") == 0 && num > 1) {
+    if(pipeline_parse(cmds + 1, &pl, 0) == -1)
+      return;
+    explain_flat(plan, &pl);
+    pipeline_free(&pl);
+  }
+  else if(strcmp(cmds[0], "syscount") == 0 && num > 1) {
+    proc = ++plan->procs;
+    plan->pipes++;
+    plan->forks++;
+    step(SHELL_PROC, "pipe (to hold child %d until it is traced)", proc);
+    step(SHELL_PROC, "fork child %d, traced with ptrace", proc);
+    explain_child(plan, proc, cmds + 1, 0, num - 1);
+  }
+  else if(strcmp(cmds[0], "memo") == 0) {
+    step(SHELL_PROC, "run %s through memo, which forks it only if no result is recorded",
+         num > 1 ? cmds[num - 1] : "nothing");
+  }
+  else {
+    // Its redirections are made in the shell process, around it, and undone in reverse.
+    for(i = 0; i + 1 < num; i++) {
+      if(redirect_op(cmds[i]))
+        explain_redirect(plan, SHELL_PROC, cmds[i], cmds[i + 1]);
+    }
+    c = command_lookup(cmds[0]);
+    step(SHELL_PROC, "run the %s %s in the shell process",
+         c != NULL && c->func != NULL ? "function" : "builtin", cmds[0]);
+    for(i = num; i-- > 1; ) {
+      if(redirect_op(cmds[i - 1]))
+        explain_restore(plan, SHELL_PROC, cmds[i - 1]);
+    }
+  }
+}
+
+/* *
+ * Explains a command line for the interpreter, cmds, of num commands: a group, a subshell, a
+ * loop, or a list.
+ * */
+static void explain_interp(struct plan *plan, char **cmds, size_t num) {
+  int proc = SHELL_PROC, forks, redirected;
+  if((forks = interp_forks(cmds, num, &redirected)) == -1) {
+    step(SHELL_PROC, "fail: syntax error");
+    return;
+  }
+  if(forks) {
+    proc = ++plan->procs;
+    plan->forks++;
+    step(SHELL_PROC, "fork child %d for the subshell, since its list could change the shell",
+         proc);
+  }
+  if(redirected)
+    explain_redirect(plan, proc, cmds[num - 2], cmds[num - 1]);
+  step(proc, "run the list%s, each command as a line of its own",
+       forks ? "" : " in the shell process");
+  if(redirected)
+    explain_restore(plan, proc, cmds[num - 2]);
+  if(forks)
+    step(SHELL_PROC, "wait for child %d", proc);
+}
+
+/* *
+ * Explains the redirection op (see redirect_op) to file, made by process proc around a command
+ * that runs in it.
+ * */
+static void explain_redirect(struct plan *plan, int proc, const char *op, const char *file) {
+  const char *name = op[0] == '<' ? "stdin" : "stdout";
+  plan->opens++;
+  plan->dup2s++;
+  step(proc, "open %s (%s)", file, op[0] == '<' ? "read" : op[1] == '\0' ? "truncate" : "append");
+  step(proc, "save %s, then dup2 %s -> %s", name, file, name);
+}
+
+/* *
+ * Explains how process proc undoes the redirection op once the command it was made for is done.
+ * */
+static void explain_restore(struct plan *plan, int proc, const char *op) {
+  const char *name = op[0] == '<' ? "stdin" : "stdout";
+  plan->dup2s++;
+  step(proc, "dup2 saved %s -> %s", name, name);
+}
+
+/* *
+ * Explains what process proc does with the commands cmds[start] to cmds[end - 1], as
+ * child_handle and special_command would run them.
+ * */
+static void explain_child(struct plan *plan, int proc, char **cmds, size_t start, size_t end) {
+  size_t split;
+  int head;
+
+  if((split = special_index(cmds, start, end)) == end) {
+    explain_exec(plan, proc, cmds, start, end);
+    return;
+  }
+
+  head = ++plan->procs;
+  if(strcmp(cmds[split], "|") == 0) {
+    // pipe_handle: the head writes into the pipe, and proc carries on reading from it.
+    plan->pipes++;
+    plan->forks++;
+    plan->dup2s += 2;
+    step(proc, "pipe");
+    step(proc, "fork child %d", head);
+    step(head, "dup2 pipe write end -> stdout");
+    explain_exec(plan, head, cmds, start, split);
+    step(proc, "wait for child %d", head);
+    step(proc, "dup2 pipe read end -> stdin");
+    explain_child(plan, proc, cmds, split + 1, end);
+    return;
+  }
+
+  // overwrite_handle and append_handle: the head writes into the file, and proc only waits.
+  plan->forks++;
+  step(proc, "fork child %d", head);
+  if(split + 1 == end) {
+    step(head, "fail: no file to redirect to");
+    return;
+  }
+  plan->opens++;
+  plan->dup2s++;
+  step(head, "open %s (%s)", cmds[split + 1],
+       strcmp(cmds[split], ">") == 0 ? "truncate" : "append");
+  step(head, "dup2 %s -> stdout", cmds[split + 1]);
+  explain_exec(plan, head, cmds, start, split);
+  step(proc, "wait for child %d", head);
+  if(split + 2 < end)
+    step(proc, "ignore the rest of the line, from %s", cmds[split + 2]);
+}
+
+/* *
+ * Explains the execution of the command cmds[start] to cmds[end - 1] by process proc.
+ * */
+static void explain_exec(struct plan *plan, int proc, char **cmds, size_t start, size_t end) {
+  const char *resolved;
+  const struct command *c;
+
+  if(start == end) {
+    step(proc, "fail: missing command");
+    return;
+  }
+  if(strcmp(cmds[start], "memo") == 0) {
+    step(proc, "run %s through memo, which forks it only if no result is recorded",
+         end - start > 1 ? cmds[end - 1] : "nothing");
+    return;
+  }
+  if((c = command_lookup(cmds[start])) != NULL && c->func != NULL) {
+    step(proc, "run the function %s", cmds[start]);
+    return;
+  }
+  if(strchr(cmds[start], '/') != NULL) {
+    plan->execs++;
+    step(proc, "exec %s", cmds[start]);
+  }
+  else if((resolved = cmdhash_lookup(cmds[start])) != NULL) {
+    plan->execs++;
+    step(proc, "exec %s (from the command hash)", resolved);
+  }
+  else {
+    step(proc, "fail: %s is not in the path", cmds[start]);
+  }
+}
+
+/* *
+ * Explains the flat pipeline pl, as run by the time builtin and by pipeline_dispatch: every stage
+ * is forked by the shell, except the stages chained into the process of the stage after them.
+ * */
+static void explain_flat(struct plan *plan, struct pipeline *pl) {
+  size_t i, j, num, forked;
+  int proc, piped;
+
+  forked = 0;
+  piped = 0;
+  for(i = 0; i < pl->num_stages; i++) {
+    if(pl->stages[i].chained)
+      continue;
+    proc = ++plan->procs;
+    if(i + 1 < pl->num_stages) {
+      plan->pipes++;
+      step(SHELL_PROC, "pipe");
+    }
+    plan->forks++;
+    forked++;
+    step(SHELL_PROC, "fork child %d", proc);
+    if(piped) {
+      plan->dup2s++;
+      step(proc, "dup2 pipe read end -> stdin");
+    }
+    else if(pl->in_file != NULL) {
+      plan->opens++;
+      plan->dup2s++;
+      step(proc, "open %s (read)", pl->in_file);
+      step(proc, "dup2 %s -> stdin", pl->in_file);
+    }
+    if(i + 1 < pl->num_stages) {
+      plan->dup2s++;
+      step(proc, "dup2 pipe write end -> stdout");
+    }
+    else if(pl->out_fd >= 0) {
+      plan->dup2s++;
+      step(proc, "dup2 cached descriptor %d (%s) -> stdout", pl->out_fd, pl->out_file);
+    }
+    else if(pl->out_file != NULL) {
+      plan->opens++;
+      plan->dup2s++;
+      step(proc, "open %s (%s)", pl->out_file, pl->append ? "append" : "truncate");
+      step(proc, "dup2 %s -> stdout", pl->out_file);
+    }
+    piped = i + 1 < pl->num_stages;
+
+    // The stages chained to this one run first, in this process, with their output discarded.
+    for(j = i; j > 0 && pl->stages[j - 1].chained; j--)
+      ;
+    if(j < i) {
+      plan->dup2s += 2;
+      step(proc, "dup2 /dev/null -> stdout");
+      step(proc, "run the builtin %s", pl->stages[j++].argv[0]);
+      // The rest read an empty pipe, in place of the output that was discarded.
+      plan->pipes++;
+      plan->dup2s++;
+      step(proc, "pipe (empty), then dup2 its read end -> stdin");
+      for(; j < i; j++)
+        step(proc, "run the builtin %s", pl->stages[j].argv[0]);
+      step(proc, "dup2 saved stdout -> stdout");
+    }
+    if(pl->stages[i].builtin != NULL) {
+      step(proc, "run the builtin %s", pl->stages[i].argv[0]);
+      continue;
+    }
+    for(num = 0; pl->stages[i].argv[num] != NULL; num++)
+      ;
+    explain_exec(plan, proc, pl->stages[i].argv, 0, num);
+  }
+  step(SHELL_PROC, "wait for %zu %s", forked, forked == 1 ? "child" : "children");
+}
+
+/* *
+ * Lists a rewrite the optimizer made to the line being explained.
+ * */
+static void explain_rewrite(const char *rewrite) {
+  step(SHELL_PROC, "optimize: %s", rewrite);
+}
+
+/* *
+ * Returns - The index of the first pipe or redirection in cmds[start] to cmds[end - 1], or end if
+ *           there is none.
+ * */
+static size_t special_index(char **cmds, size_t start, size_t end) {
+  for(; start < end; start++) {
+    if(strcmp(cmds[start], "|") == 0 || strcmp(cmds[start], ">") == 0
+       || strcmp(cmds[start], ">>") == 0)
+      break;
+  }
+  return start;
+}
@@ -0,0 +1,55 @@
+/* *
+ * fdio.c
+ *
+ * Whole reads and writes on file descriptors, retrying on partial transfers and interrupts, for
+ * the parts of the shell (and the client) that talk to pipes, sockets, and files below stdio.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "fdio.h"
+#include <unistd.h>
+#include <errno.h>
+
+/* *
+ * Reads exactly len bytes from fd into buf.
+ *
+ * Returns - 0 on success, or -1 on an error or if the input ends first.
+ * */
+int fd_read_all(int fd, void *buf, size_t len) {
+  ssize_t n;
+  char *p = buf;
+  while(len > 0) {
+    if((n = read(fd, p, len)) <= 0) {
+      if(n < 0 && errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* *
+ * Writes all len bytes of buf to fd.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+int fd_write_all(int fd, const void *buf, size_t len) {
+  ssize_t n;
+  const char *p = buf;
+  while(len > 0) {
+    if((n = write(fd, p, len)) < 0) {
+      if(errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
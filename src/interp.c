@@ -0,0 +1,1229 @@
+/* *
+ * interp.c
+ *
+ * The interpreter for command lines that are more than one command: lists of commands separated
+ * by ;, groups, subshells, loops, and function definitions:
+ *
+ *   { list; }
+ *   ( list )
+ *   for name in word ...; do list; done
+ *   while list; do list; done
+ *   name() { list; }   (or function name { list; })
+ *
+ * with break [n], continue [n], and return [n].  A command may span several lines; the lines that
+ * finish it are read with a "> " prompt and joined to the first as if by a ;.  A group, a
+ * subshell, or a loop may be followed by < file, > file, or >> file, which redirects the input or
+ * the output of the whole of it, so that "while read line; do ...; done < file" reads the file.
+ *
+ * The tokenized line is parsed into a tree of nodes whose words point into the line, and the tree
+ * is run in the shell process: each command is copied out of the line, expanded, and dispatched
+ * just as a line of its own would be, so the line itself is expanded afresh on each iteration.
+ *
+ * The words of a for loop are expanded one at a time as the loop reaches them, rather than all
+ * before it starts.  A word that is a lone brace sequence, such as {1..10000000}, is not expanded
+ * at all: the loop steps through its values with an iterator (see expand_seq in expand.c), so it
+ * runs in constant memory however long the sequence is.
+ *
+ * Functions run in the shell process, on a call stack of frames that hold the positional
+ * parameters and the scope of the call's local variables (see vars_push_scope in vars.c.)  A
+ * definition copies the words of its body into an arena, parses them once, and enters the function
+ * in the table builtins are dispatched from (see command_define in builtins.c), so a call costs
+ * one hash lookup and no fork, exec, or parse.  A function that is redefined while it runs is
+ * freed once its last call returns.  A call with redirections runs in the shell process as well,
+ * with the redirections made around it, and a call in a pipeline runs in the process forked for
+ * its stage (see exec in tinysh.c.)
+ *
+ * A subshell forks only if it has to.  Its list is checked each time it is run, and if nothing in
+ * it can change the state of the shell (no cd, exit, break, assignment, for loop, function, or
+ * builtin other than echo, printf, test, [[ without =~, true, false, pwd, and help, and no
+ * assignment within $(( )) or ${ }), it runs in the shell process, like a group.  Its redirection
+ * then saves stdout, points it at the file, and restores it after the list, so a subshell that
+ * only groups commands for a redirection costs an open and two dup2s rather than a fork.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "interp.h"
+#include "builtins.h"
+#include "expand.h"
+#include "vars.h"
+#include "arena.h"
+#include "redirect.h"
+#include "tinysh.h"
+#include "trace.h"
+#include "mem.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define INCOMPLETE -2    // Parse status of a line that ends inside a compound command.
+#define MAX_CALL_DEPTH 1000  // Most function calls that may be run at once.
+
+enum node_type {
+  NODE_COMMAND,   // A simple command: its words.
+  NODE_GROUP,     // { body; }
+  NODE_SUBSHELL,  // ( body )
+  NODE_FOR,       // for name in words; do body; done
+  NODE_WHILE,     // while cond; do body; done
+  NODE_FUNCTION   // name() body, where words are those of the body.
+};
+
+/*
+ * A command of a parsed line.  The words point into the tokenized line.
+ */
+struct node {
+  enum node_type type;
+  char **words;
+  size_t num_words;
+  const char *name;    // Variable of a for loop, or name of a function.
+  struct node *cond;   // Condition of a while loop.
+  struct node *body;   // Body of a group, a loop, or a function.
+  struct node *next;   // Next command of the list.
+  char **redirect;     // <, >, or >> and its file, after a group, a subshell, or a loop, or NULL.
+};
+
+/*
+ * State of the parse of a tokenized line.
+ */
+struct parser {
+  char **toks;
+  size_t num;
+  size_t pos;
+  struct arena *arena;  // Where the nodes of a function body go, or NULL for a line's.
+  unsigned parens;      // Number of subshells the parse is in.
+};
+
+/*
+ * A function: the parsed { } group of its body, and the words the nodes point to, all in its
+ * arena, which holds the function itself too.
+ */
+struct func {
+  struct arena arena;
+  struct node *body;
+  unsigned refs;             // 1 while it is defined, and 1 for each call being run.
+  struct func *prev, *next;  // In the list of every function not yet freed.
+};
+
+/*
+ * A function call being run.
+ */
+struct frame {
+  char **params;              // The positional parameters, $1 onward.
+  size_t num_params;
+  struct vars_scope scope;    // Its local variables.
+  struct frame *caller;
+};
+
+static unsigned loop_depth;  // Number of loops being run by the current function call (or line.)
+static unsigned breaking;    // Number of loops left to break out of.
+static unsigned continuing;  // Number of loops left to continue out of.
+static int returning;        // 1 while the current function call is returning.
+static struct frame *frame;  // The innermost function call, or NULL.
+static unsigned call_depth;
+static struct func *funcs;
+
+static int split_semicolons(char ***cmds, size_t *num_cmds);
+static size_t semicolon_pos(const char *word);
+static int read_more(char ***cmds, size_t *num_cmds, FILE *more, char **input, size_t *size);
+static int parse_list(struct parser *ps, const char *end1, const char *end2, struct node **list);
+static int parse_command(struct parser *ps, struct node **node);
+static int parse_function(struct parser *ps, const char *name, struct node **node);
+static int parse_redirection(struct parser *ps, struct node *node);
+static int parse_end(struct parser *ps);
+static int parse_keyword(struct parser *ps, const char *word);
+static int syntax_error(struct parser *ps);
+static int is_func_name(const char *word, size_t len);
+static struct node* new_node(struct parser *ps, enum node_type type);
+static void free_nodes(struct node *node);
+static int run_list(struct node *list, int *exit_flag);
+static int run_command(struct node *node, int *exit_flag);
+static int run_group(struct node *node, int *exit_flag);
+static int open_redirect(struct node *node, struct redirect *r);
+static int run_subshell(struct node *node, int *exit_flag);
+static int changes_shell(struct node *list);
+static int command_changes_shell(struct node *node);
+static int run_define(struct node *node);
+static void release_func(struct func *func);
+static int run_loop(struct node *node, int *exit_flag);
+static int run_for(struct node *node, int *exit_flag);
+static int run_while(struct node *node, int *exit_flag);
+static int loop_done(void);
+static int loop_control(char **cmd, unsigned *flag);
+static char** copy_words(char **words, size_t num);
+static void free_words(char **words);
+
+/* *
+ * Returns - 1 if the command line cmds is for the interpreter: a list or a loop, or 0 if it is a
+ *           single simple command, for cmd_dispatch alone.
+ * */
+int interp_wants(char **cmds) {
+  size_t i, len;
+  static const char *words[] = {
+    "for", "while", "do", "done", "break", "continue", "{", "}", "(", ")", "function", NULL
+  };
+  const char **word;
+  // explain plans the whole line, lists and all, without running it.
+  if(strcmp(cmds[0], "explain") == 0)
+    return 0;
+  for(word = words; *word != NULL; word++) {
+    if(strcmp(cmds[0], *word) == 0)
+      return 1;
+  }
+  // A function definition, name() or name ().
+  len = strlen(cmds[0]);
+  if((len > 2 && strcmp(cmds[0] + len - 2, "()") == 0)
+     || (cmds[1] != NULL && strcmp(cmds[1], "()") == 0))
+    return 1;
+  // A ; on its own, or one inside a word.
+  for(i = 0; cmds[i] != NULL; i++) {
+    if(strcmp(cmds[i], ";") == 0 || semicolon_pos(cmds[i]) != strlen(cmds[i]))
+      return 1;
+  }
+  return 0;
+}
+
+/* *
+ * Parses and runs the tokenized command line *cmds, reading the lines that finish an unfinished
+ * loop from more (unless it is NULL.)  The lines are joined onto *cmds, which is left for the
+ * caller to free.  exit_flag is set to 1 if the line asks the shell to exit.
+ *
+ * Returns - The status of the last command run (0 on success, -1 on failure.)
+ * */
+int interp_line(char ***cmds, size_t *num_cmds, FILE *more, int *exit_flag) {
+  int status;
+  char *input = NULL;
+  size_t size = 0;
+  struct parser ps;
+  struct node *list;
+
+  for(;;) {
+    if(split_semicolons(cmds, num_cmds) == -1) {
+      status = -1;
+      break;
+    }
+    ps.toks = *cmds;
+    ps.num = *num_cmds;
+    ps.pos = 0;
+    ps.arena = NULL;
+    ps.parens = 0;
+    if((status = parse_list(&ps, NULL, NULL, &list)) != INCOMPLETE)
+      break;
+    if(more == NULL || (status = read_more(cmds, num_cmds, more, &input, &size)) != 0) {
+      if(status != -1)
+        fprintf(stderr, "tinysh: syntax error: unexpected end of file\n");
+      status = -1;
+      break;
+    }
+  }
+  mem_free(MEM_PARSE, input);
+  if(status == -1) {
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  if(VERBOSE_AT(V_LEVEL_DETAILS, V_PARSE))
+    printf("Parsed the command line into a list of commands.\n");
+  status = run_list(list, exit_flag);
+  free_nodes(list);
+  breaking = continuing = 0;
+  return status;
+}
+
+/* *
+ * Parses the command line cmds, of num_cmds words, for explain, without running it.  *redirected
+ * is set to 1 if the line is a single group, subshell, or loop followed by a redirection (which is
+ * then its last two words), or 0 if not.
+ *
+ * Returns - 1 if the line is a single subshell that forks to run its list (see changes_shell), 0
+ *           if the line runs in the shell process, or -1 on a syntax error.
+ * */
+int interp_forks(char **cmds, size_t num_cmds, int *redirected) {
+  int forks = -1;
+  char **words;
+  struct parser ps;
+  struct node *list = NULL;
+
+  *redirected = 0;
+  if((words = copy_words(cmds, num_cmds)) == NULL)
+    return -1;
+  memset(&ps, 0, sizeof(ps));
+  if(split_semicolons(&words, &num_cmds) == 0) {
+    ps.toks = words;
+    ps.num = num_cmds;
+    if((forks = parse_list(&ps, NULL, NULL, &list)) == INCOMPLETE) {
+      fprintf(stderr, "tinysh: syntax error: unexpected end of file\n");
+      forks = -1;
+    }
+  }
+  if(forks == 0 && list != NULL && list->next == NULL) {
+    *redirected = list->redirect != NULL;
+    forks = list->type == NODE_SUBSHELL && changes_shell(list->body);
+  }
+  free_nodes(list);
+  free_words(words);
+  return forks;
+}
+
+/* *
+ * Calls the function func (see command_lookup in builtins.c) with the command line cmds, whose
+ * words after the first are its positional parameters, in the shell process.  exit_flag is set to
+ * 1 if the function asks the shell to exit.
+ *
+ * Returns - The status of the function (0 on success, -1 on failure.)
+ * */
+int interp_call(struct func *func, char **cmds, size_t num_cmds, int *exit_flag) {
+  struct frame call;
+  unsigned saved_depth = loop_depth;
+
+  if(call_depth == MAX_CALL_DEPTH) {
+    fprintf(stderr, "tinysh: %s: maximum function nesting level exceeded (%d)\n", cmds[0],
+            MAX_CALL_DEPTH);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  if(VERBOSE(V_PROC))
+    printf("Calling the function %s in the shell process.\n", cmds[0]);
+  call.params = cmds + 1;
+  call.num_params = num_cmds - 1;
+  call.caller = frame;
+  vars_push_scope(&call.scope);
+  frame = &call;
+  call_depth++;
+  // The loops of the caller cannot be left from the function, and the function is kept until the
+  // call returns, even if it redefines itself.
+  loop_depth = 0;
+  func->refs++;
+  run_list(func->body, exit_flag);
+  release_func(func);
+  loop_depth = saved_depth;
+  returning = 0;
+  call_depth--;
+  frame = call.caller;
+  vars_pop_scope();
+  return last_status == EXIT_SUCCESS ? 0 : -1;
+}
+
+/* *
+ * Returns - The positional parameters of the innermost function call, storing their number in
+ *           num, or NULL (with num 0) outside of a function.
+ * */
+char** interp_params(size_t *num) {
+  if(frame == NULL) {
+    *num = 0;
+    return NULL;
+  }
+  *num = frame->num_params;
+  return frame->params;
+}
+
+/* *
+ * Handler for the return builtin.
+ *
+ * return [n]
+ *
+ * Returns from the function being run, with the status n, or else with the status of the last
+ * command it ran.
+ * */
+int return_handle(char **cmd, size_t num_cmd) {
+  char *end;
+  long n;
+
+  if(frame == NULL) {
+    fprintf(stderr, "tinysh: return: can only `return' from a function\n");
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  if(num_cmd > 1) {
+    n = strtol(cmd[1], &end, 10);
+    if(end == cmd[1] || *end != '\0') {
+      fprintf(stderr, "tinysh: return: %s: numeric argument required\n", cmd[1]);
+      n = 2;
+    }
+    last_status = (int) (n & 0xff);
+  }
+  returning = 1;
+  return last_status == EXIT_SUCCESS ? 0 : -1;
+}
+
+/* *
+ * Frees every function that is defined.  Called at exit, when no function is being run.
+ * */
+void interp_clear(void) {
+  struct arena arena;
+  while(funcs != NULL) {
+    arena = funcs->arena;
+    funcs = funcs->next;
+    arena_free(&arena);
+  }
+}
+
+/* *
+ * Makes each ; of the words of *cmds (outside ${ } and $(( ))) a word of its own, so that
+ * "echo a; echo b;" is parsed as echo a ; echo b ;.  *cmds grows as needed.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int split_semicolons(char ***cmds, size_t *num_cmds) {
+  char **words = *cmds, **line, *word;
+  size_t i, j, start, pos, len, num;
+
+  for(i = 0, num = 0; i < *num_cmds; i++) {
+    for(word = words[i]; *word != '\0'; word += pos + (pos < len)) {
+      pos = semicolon_pos(word);
+      len = strlen(word);
+      num += (pos > 0) + (pos < len);
+    }
+  }
+  if(num == *num_cmds)
+    return 0;
+
+  if((line = mem_malloc(MEM_PARSE, (num + 1) * sizeof(*line))) == NULL) {
+    perror("Error allocating memory for the command line.");
+    return -1;
+  }
+  for(i = 0, j = 0; i < *num_cmds; i++) {
+    start = j;
+    for(word = words[i]; *word != '\0'; word += pos + (pos < len)) {
+      pos = semicolon_pos(word);
+      len = strlen(word);
+      if(pos == len && word == words[i]) {
+        line[j++] = words[i];
+        break;
+      }
+      if(pos > 0 && (line[j++] = mem_malloc(MEM_PARSE, pos + 1)) != NULL) {
+        memcpy(line[j - 1], word, pos);
+        line[j - 1][pos] = '\0';
+      }
+      if(pos < len)
+        line[j++] = mem_strdup(MEM_PARSE, ";");
+      if(line[j - 1] == NULL) {
+        // Leave the rest of the line unsplit, so that it can still be freed.
+        perror("Error allocating memory for a word.");
+        while(--j > start)
+          mem_free(MEM_PARSE, line[j - 1]);
+        while(i < *num_cmds)
+          line[j++] = words[i++];
+        line[j] = NULL;
+        mem_free(MEM_PARSE, words);
+        *cmds = line;
+        *num_cmds = j;
+        return -1;
+      }
+    }
+    if(line[j - 1] != words[i])
+      mem_free(MEM_PARSE, words[i]);
+  }
+  line[j] = NULL;
+  mem_free(MEM_PARSE, words);
+  *cmds = line;
+  *num_cmds = j;
+  return 0;
+}
+
+/* *
+ * Finds the first ; of word outside ${ } and $(( )), skipping backslash escapes.  A word that is
+ * a ; on its own is not split any further.
+ *
+ * Returns - The offset of the ;, or the length of word if it has none.
+ * */
+static size_t semicolon_pos(const char *word) {
+  size_t i, braces, parens;
+  if(strcmp(word, ";") == 0)
+    return 1;
+  for(i = 0, braces = 0, parens = 0; word[i] != '\0'; i++) {
+    if(word[i] == '\\' && word[i + 1] != '\0')
+      i++;
+    else if(word[i] == '$' && (word[i + 1] == '{' || word[i + 1] == '(')) {
+      if(word[++i] == '{')
+        braces++;
+      else
+        parens++;
+    }
+    else if(word[i] == '}' && braces > 0)
+      braces--;
+    else if(word[i] == '(' && parens > 0)
+      parens++;
+    else if(word[i] == ')' && parens > 0)
+      parens--;
+    else if(word[i] == ';' && braces == 0 && parens == 0)
+      return i;
+  }
+  return i;
+}
+
+/* *
+ * Reads the next line from more, with a "> " prompt, and joins its words onto *cmds after a ;.
+ * Blank lines are skipped.  input and size hold the buffer the lines are read into.
+ *
+ * Returns - 0 on success, 1 at the end of the input, or -1 on an error.
+ * */
+static int read_more(char ***cmds, size_t *num_cmds, FILE *more, char **input, size_t *size) {
+  char **words, **line;
+  size_t num;
+  ssize_t chars_read;
+
+  do {
+    printf("> ");
+    fflush(stdout);
+    if((chars_read = mem_getline(MEM_PARSE, input, size, more)) < 0) {
+      if(!feof(more)) {
+        perror("Error reading user commands from standard input.");
+        return -1;
+      }
+      return 1;
+    }
+    num = (size_t) chars_read;
+    words = tokenizer(*input, CMD_DELIMITERS, &num);
+  } while(words == NULL);
+
+  if((line = mem_realloc(MEM_PARSE, *cmds, (*num_cmds + num + 2) * sizeof(*line))) == NULL
+     || (line[*num_cmds] = mem_strdup(MEM_PARSE, ";")) == NULL) {
+    perror("Error allocating memory for the command line.");
+    if(line != NULL)
+      *cmds = line;
+    free_words(words);
+    return -1;
+  }
+  memcpy(line + *num_cmds + 1, words, (num + 1) * sizeof(*line));
+  mem_free(MEM_PARSE, words);
+  *cmds = line;
+  *num_cmds += num + 1;
+  return 0;
+}
+
+/* *
+ * Parses a list of commands from ps into *list, up to the end of the line or up to a word end1 or
+ * end2 at the start of a command, which is left for the caller.  Empty commands (as between two
+ * ;s, or after do) are skipped.
+ *
+ * Returns - 0 on success, INCOMPLETE if the line ends before end1 or end2, or -1 on a syntax error.
+ * */
+static int parse_list(struct parser *ps, const char *end1, const char *end2, struct node **list) {
+  int status;
+  const char *tok;
+  struct node **tail = list;
+
+  *list = NULL;
+  for(;;) {
+    while(ps->pos < ps->num && strcmp(ps->toks[ps->pos], ";") == 0)
+      ps->pos++;
+    if(ps->pos == ps->num) {
+      if(end1 == NULL)
+        return 0;
+      status = INCOMPLETE;
+      break;
+    }
+    tok = ps->toks[ps->pos];
+    if((end1 != NULL && strcmp(tok, end1) == 0) || (end2 != NULL && strcmp(tok, end2) == 0))
+      return 0;
+    if((status = parse_command(ps, tail)) != 0)
+      break;
+    tail = &(*tail)->next;
+  }
+  // The nodes of a function body are freed with its arena.
+  if(ps->arena == NULL)
+    free_nodes(*list);
+  *list = NULL;
+  return status;
+}
+
+/* *
+ * Parses the command at ps->pos into *node.
+ *
+ * Returns - 0 on success, INCOMPLETE if the line ends inside a loop, or -1 on a syntax error.
+ * */
+static int parse_command(struct parser *ps, struct node **node) {
+  int status;
+  const char *tok = ps->toks[ps->pos];
+  struct node *n;
+  size_t len = strlen(tok);
+
+  int compound;
+
+  if(strcmp(tok, "do") == 0 || strcmp(tok, "done") == 0 || strcmp(tok, "in") == 0
+     || strcmp(tok, "}") == 0 || strcmp(tok, ")") == 0)
+    return syntax_error(ps);
+
+  if(strcmp(tok, "function") == 0) {
+    if(++ps->pos == ps->num)
+      return INCOMPLETE;
+    tok = ps->toks[ps->pos];
+    len = strlen(tok);
+    if(len > 2 && strcmp(tok + len - 2, "()") == 0)
+      len -= 2;
+    if(!is_func_name(tok, len))
+      return syntax_error(ps);
+    // The () is optional after function name.
+    if(tok[len] == '\0' && ps->pos + 1 < ps->num && strcmp(ps->toks[ps->pos + 1], "()") == 0)
+      ps->pos++;
+    return parse_function(ps, tok, node);
+  }
+  if(len > 2 && strcmp(tok + len - 2, "()") == 0 && is_func_name(tok, len - 2))
+    return parse_function(ps, tok, node);
+  if(ps->pos + 1 < ps->num && strcmp(ps->toks[ps->pos + 1], "()") == 0) {
+    if(!is_func_name(tok, len))
+      return syntax_error(ps);
+    ps->pos++;
+    return parse_function(ps, tok, node);
+  }
+
+  if(strcmp(tok, "{") == 0 || strcmp(tok, "(") == 0) {
+    if((n = *node = new_node(ps, tok[0] == '{' ? NODE_GROUP : NODE_SUBSHELL)) == NULL)
+      return -1;
+    ps->pos++;
+    ps->parens += n->type == NODE_SUBSHELL;
+    status = parse_list(ps, n->type == NODE_GROUP ? "}" : ")", NULL, &n->body);
+    ps->parens -= n->type == NODE_SUBSHELL;
+    if(status != 0)
+      return status;
+    if(n->body == NULL)
+      return syntax_error(ps);
+    ps->pos++;
+    return parse_redirection(ps, n);
+  }
+
+  if(strcmp(tok, "for") == 0 || strcmp(tok, "while") == 0) {
+    if((n = *node = new_node(ps, tok[0] == 'f' ? NODE_FOR : NODE_WHILE)) == NULL)
+      return -1;
+    ps->pos++;
+    if(n->type == NODE_FOR) {
+      if(ps->pos == ps->num)
+        return INCOMPLETE;
+      n->name = ps->toks[ps->pos];
+      if(vars_name_len(n->name) != strlen(n->name) || strcmp(n->name, ";") == 0)
+        return syntax_error(ps);
+      ps->pos++;
+      if((status = parse_keyword(ps, "in")) != 0)
+        return status;
+      n->words = ps->toks + ps->pos;
+      while(ps->pos < ps->num && strcmp(ps->toks[ps->pos], ";") != 0)
+        ps->pos++;
+      n->num_words = (size_t) (ps->toks + ps->pos - n->words);
+    }
+    else if((status = parse_list(ps, "do", NULL, &n->cond)) != 0) {
+      return status;
+    }
+    else if(n->cond == NULL) {
+      return syntax_error(ps);
+    }
+    while(ps->pos < ps->num && strcmp(ps->toks[ps->pos], ";") == 0)
+      ps->pos++;
+    if((status = parse_keyword(ps, "do")) != 0
+       || (status = parse_list(ps, "done", NULL, &n->body)) != 0)
+      return status;
+    if(n->body == NULL)
+      return syntax_error(ps);
+    ps->pos++;
+    return parse_redirection(ps, n);
+  }
+
+  if((n = *node = new_node(ps, NODE_COMMAND)) == NULL)
+    return -1;
+  n->words = ps->toks + ps->pos;
+  for(compound = 0; ps->pos < ps->num && strcmp(ps->toks[ps->pos], ";") != 0; ps->pos++) {
+    tok = ps->toks[ps->pos];
+    len = strlen(tok);
+    // A ) ends the command in a subshell, unless it closes an array, name=( value ... ).
+    if(ps->parens > 0 && !compound && strcmp(tok, ")") == 0)
+      break;
+    if(strstr(tok, "=(") != NULL)
+      compound = tok[len - 1] != ')';
+    else if(compound && tok[len - 1] == ')')
+      compound = 0;
+  }
+  n->num_words = (size_t) (ps->toks + ps->pos - n->words);
+  return 0;
+}
+
+/* *
+ * Parses the redirection that may follow the group, subshell, or loop node, < file, > file, or
+ * >> file, into its redirect.
+ *
+ * Returns - 0 on success, or -1 on a syntax error.
+ * */
+static int parse_redirection(struct parser *ps, struct node *node) {
+  const char *tok;
+  if(ps->pos < ps->num) {
+    tok = ps->toks[ps->pos];
+    if(redirect_op(tok)) {
+      node->redirect = ps->toks + ps->pos;
+      if(++ps->pos == ps->num || strcmp(ps->toks[ps->pos], ";") == 0
+         || strcmp(ps->toks[ps->pos], ")") == 0)
+        return syntax_error(ps);
+      ps->pos++;
+    }
+  }
+  return parse_end(ps);
+}
+
+/* *
+ * Checks the end of a compound command: nothing but a ;, or the ) of a subshell it is in, may
+ * follow it.
+ *
+ * Returns - 0 on success, or -1 on a syntax error.
+ * */
+static int parse_end(struct parser *ps) {
+  if(ps->pos < ps->num && strcmp(ps->toks[ps->pos], ";") != 0
+     && (ps->parens == 0 || strcmp(ps->toks[ps->pos], ")") != 0))
+    return syntax_error(ps);
+  return 0;
+}
+
+/* *
+ * Parses the definition of the function name (followed by () or not), whose body, a { } group,
+ * starts after the word at ps->pos, into *node.
+ *
+ * Returns - 0 on success, INCOMPLETE if the line ends inside the body, or -1 on a syntax error.
+ * */
+static int parse_function(struct parser *ps, const char *name, struct node **node) {
+  int status;
+  struct node *n;
+
+  if((n = *node = new_node(ps, NODE_FUNCTION)) == NULL)
+    return -1;
+  n->name = name;
+  ps->pos++;
+  // The body may start on the next line.
+  while(ps->pos < ps->num && strcmp(ps->toks[ps->pos], ";") == 0)
+    ps->pos++;
+  if(ps->pos == ps->num)
+    return INCOMPLETE;
+  if(strcmp(ps->toks[ps->pos], "{") != 0)
+    return syntax_error(ps);
+  n->words = ps->toks + ps->pos;
+  if((status = parse_command(ps, &n->body)) != 0)
+    return status;
+  n->num_words = (size_t) (ps->toks + ps->pos - n->words);
+  return 0;
+}
+
+/* *
+ * Takes the keyword word from ps.
+ *
+ * Returns - 0 on success, INCOMPLETE if the line ends first, or -1 if the next word is another.
+ * */
+static int parse_keyword(struct parser *ps, const char *word) {
+  if(ps->pos == ps->num)
+    return INCOMPLETE;
+  if(strcmp(ps->toks[ps->pos], word) != 0)
+    return syntax_error(ps);
+  ps->pos++;
+  return 0;
+}
+
+/* *
+ * Prints a syntax error at the word at ps->pos.
+ *
+ * Returns - -1.
+ * */
+static int syntax_error(struct parser *ps) {
+  if(ps->pos == ps->num)
+    fprintf(stderr, "tinysh: syntax error: unexpected end of file\n");
+  else
+    fprintf(stderr, "tinysh: syntax error near unexpected token `%s'\n", ps->toks[ps->pos]);
+  return -1;
+}
+
+/* *
+ * Returns - 1 if the len characters of word are a valid function name, 0 if not.
+ * */
+static int is_func_name(const char *word, size_t len) {
+  return len > 0 && vars_name_len(word) == len;
+}
+
+/* *
+ * Returns - A new, empty node of type type, allocated from the arena of ps if it has one, or NULL
+ *           on an error.
+ * */
+static struct node* new_node(struct parser *ps, enum node_type type) {
+  struct node *node;
+  if(ps->arena != NULL)
+    node = arena_alloc_object(ps->arena, sizeof(*node));
+  else if((node = mem_malloc(MEM_PARSE, sizeof(*node))) == NULL)
+    perror("Error allocating memory for a command.");
+  if(node == NULL)
+    return NULL;
+  memset(node, 0, sizeof(*node));
+  node->type = type;
+  return node;
+}
+
+/* *
+ * Frees the list of nodes node and everything under them.
+ * */
+static void free_nodes(struct node *node) {
+  struct node *next;
+  for(; node != NULL; node = next) {
+    next = node->next;
+    free_nodes(node->cond);
+    free_nodes(node->body);
+    mem_free(MEM_PARSE, node);
+  }
+}
+
+/* *
+ * Runs the commands of list, until one exits the shell, breaks out of a loop, or returns from a
+ * function.
+ *
+ * Returns - The status of the last command run (0 on success, -1 on failure.)
+ * */
+static int run_list(struct node *list, int *exit_flag) {
+  int status = 0;
+  for(; list != NULL && !*exit_flag && !breaking && !continuing && !returning; list = list->next) {
+    if(list->type == NODE_GROUP)
+      status = run_group(list, exit_flag);
+    else if(list->type == NODE_SUBSHELL)
+      status = run_subshell(list, exit_flag);
+    else if(list->type == NODE_FOR || list->type == NODE_WHILE)
+      status = run_loop(list, exit_flag);
+    else if(list->type == NODE_FUNCTION)
+      status = run_define(list);
+    else
+      status = run_command(list, exit_flag);
+  }
+  return status;
+}
+
+/* *
+ * Expands and dispatches the simple command node, as the driver does a line of its own.
+ *
+ * Returns - The status of the command (0 on success, -1 on failure.)
+ * */
+static int run_command(struct node *node, int *exit_flag) {
+  char **cmd;
+  size_t num;
+  int status;
+
+  if((cmd = copy_words(node->words, node->num_words)) == NULL) {
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  num = node->num_words;
+  if((status = expand_line(&cmd, &num)) == -1)
+    last_status = EXIT_FAILURE;
+  else if(cmd[0] == NULL)
+    status = 0;
+  else if(strcmp(cmd[0], "break") == 0)
+    status = loop_control(cmd, &breaking);
+  else if(strcmp(cmd[0], "continue") == 0)
+    status = loop_control(cmd, &continuing);
+  else
+    status = cmd_dispatch(cmd, num, exit_flag);
+  free_words(cmd);
+  return status;
+}
+
+/* *
+ * Runs the list of the group or subshell node in the shell process.  If it has a redirection,
+ * stdin or stdout is saved, pointed at the file for the list, and restored after it.
+ *
+ * Returns - The status of the last command run (0 on success, -1 on failure.)
+ * */
+static int run_group(struct node *node, int *exit_flag) {
+  int status;
+  struct redirect r;
+
+  if(open_redirect(node, &r) == -1)
+    return -1;
+  status = run_list(node->body, exit_flag);
+  redirect_restore(&r);
+  return status;
+}
+
+/* *
+ * Makes the redirection of the group, subshell, or loop node, if it has one, in the shell process,
+ * after expanding its file name.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int open_redirect(struct node *node, struct redirect *r) {
+  char **file;
+  size_t num = 1;
+  int status;
+
+  r->fd = -1;
+  if(node->redirect == NULL)
+    return 0;
+  if((file = copy_words(node->redirect + 1, 1)) == NULL || expand_line(&file, &num) == -1) {
+    free_words(file);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  if(num != 1) {
+    fprintf(stderr, "tinysh: %s: ambiguous redirect\n", node->redirect[1]);
+    free_words(file);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  if((status = redirect_open(node->redirect[0], file[0], r)) == -1)
+    last_status = EXIT_FAILURE;
+  free_words(file);
+  return status;
+}
+
+/* *
+ * Runs the subshell node: in the shell process, if its list cannot change the state of the shell,
+ * or else in a child process.
+ *
+ * Returns - The status of the subshell (0 on success, -1 on failure.)
+ * */
+static int run_subshell(struct node *node, int *exit_flag) {
+  pid_t pid;
+  int status, child_exit = 0;
+  uint64_t start;
+
+  if(!changes_shell(node->body)) {
+    if(VERBOSE(V_PROC))
+      printf("Running the subshell in the shell process, since it changes nothing in it.\n");
+    TRACE_MARK("subshell", "proc", "in process");
+    return run_group(node, exit_flag);
+  }
+  fflush(stdout);
+  TRACE_BEGIN(start);
+  if((pid = fork()) < 0) {
+    perror("Error forking a process.");
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  if(pid == 0) {
+    // The child is the subshell: an exit or a cd in it ends or changes only the child.
+    run_group(node, &child_exit);
+    fflush(stdout);
+    _exit(last_status);
+  }
+  TRACE_END("fork", "proc", start, "subshell");
+  if(VERBOSE(V_PROC))
+    printf("Created a child process for the subshell.\n");
+  TRACE_BEGIN(start);
+  if(waitpid(pid, &status, 0) < 0) {
+    perror("Error waiting for a process.");
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  TRACE_END("wait", "proc", start, "subshell");
+  return wait_status_handle(status);
+}
+
+/* *
+ * Returns - 1 if running list could change the state of the shell (its directory, variables,
+ *           functions, loops, or options, or whether it exits), so that a subshell must fork to
+ *           run it, or 0 if it can be run in the shell process.
+ * */
+static int changes_shell(struct node *list) {
+  for(; list != NULL; list = list->next) {
+    // A for loop sets its variable, and a definition defines a function.  A nested subshell
+    // looks after itself.
+    if((list->type == NODE_FOR || list->type == NODE_FUNCTION)
+       || (list->type == NODE_WHILE && (changes_shell(list->cond) || changes_shell(list->body)))
+       || (list->type == NODE_GROUP && changes_shell(list->body))
+       || (list->type == NODE_COMMAND && command_changes_shell(list)))
+      return 1;
+  }
+  return 0;
+}
+
+/* *
+ * Returns - 1 if running the simple command node could change the state of the shell, 0 if not.
+ * */
+static int command_changes_shell(struct node *node) {
+  static const char *harmless[] = {
+    "echo", "printf", "test", "[", "[[", "true", "false", "pwd", "help", NULL
+  };
+  const char **name, *text;
+  const struct command *c;
+  char *cmd[2];
+  size_t i, len;
+  int expanding;
+
+  // A command whose name is expanded could be anything.
+  if(node->num_words == 0 || strchr(node->words[0], '$') != NULL)
+    return 1;
+  // Assignments, and builtins (or functions) that may set something.
+  len = vars_name_len(node->words[0]);
+  if(len > 0 && (node->words[0][len] == '=' || node->words[0][len] == '['
+                 || (node->words[0][len] == '+' && node->words[0][len + 1] == '=')))
+    return 1;
+  if(strcmp(node->words[0], "break") == 0 || strcmp(node->words[0], "continue") == 0)
+    return 1;
+  cmd[0] = node->words[0];
+  cmd[1] = NULL;
+  if(is_builtin(cmd)) {
+    for(name = harmless; *name != NULL && strcmp(*name, cmd[0]) != 0; name++)
+      ;
+    if(*name == NULL || ((c = command_lookup(cmd[0])) != NULL && c->func != NULL))
+      return 1;
+  }
+  for(i = 0, expanding = 0; i < node->num_words; i++) {
+    // [[ =~ ]] sets BASH_REMATCH.
+    if(strcmp(cmd[0], "[[") == 0 && strcmp(node->words[i], "=~") == 0)
+      return 1;
+    // $(( )) may assign, as may ${name=word} and ${name:=word}, from the first $( or ${ on.
+    text = node->words[i];
+    if(!expanding) {
+      while((text = strchr(text, '$')) != NULL && text[1] != '(' && text[1] != '{')
+        text++;
+    }
+    if(text != NULL) {
+      expanding = 1;
+      if(strchr(text, '=') != NULL || strstr(text, "++") != NULL || strstr(text, "--") != NULL)
+        return 1;
+    }
+  }
+  return 0;
+}
+
+/* *
+ * Runs the for or while loop node, with its redirection, if it has one, made around the whole
+ * loop, so that each read of a while condition takes the next line of the same file.
+ *
+ * Returns - The status of the last command run (0 on success, -1 on failure.)
+ * */
+static int run_loop(struct node *node, int *exit_flag) {
+  int status;
+  struct redirect r;
+
+  if(open_redirect(node, &r) == -1)
+    return -1;
+  if(node->type == NODE_FOR)
+    status = run_for(node, exit_flag);
+  else
+    status = run_while(node, exit_flag);
+  redirect_restore(&r);
+  return status;
+}
+
+/* *
+ * Runs the for loop node, expanding its words one at a time.  A brace sequence is stepped through
+ * without being expanded.
+ *
+ * Returns - The status of the last command run (0 on success, -1 on failure.)
+ * */
+static int run_for(struct node *node, int *exit_flag) {
+  char **values, buf[EXPAND_SEQ_SIZE];
+  size_t i, j, num, len;
+  unsigned long long k;
+  int status = 0, stop = 0, ran = 0, is_seq;
+  struct expand_seq seq;
+
+  loop_depth++;
+  for(i = 0; i < node->num_words && !stop; i++) {
+    if((is_seq = expand_seq(node->words[i], &seq)) == 1) {
+      if(VERBOSE_AT(V_LEVEL_DETAILS, V_PARSE))
+        printf("  Stepping through %s without expanding it.\n", node->words[i]);
+      for(k = 0; k < seq.count && !stop; k++, ran = 1) {
+        if(!seq.chars && seq.width == 0) {
+          vars_set_int(node->name, (long long) ((unsigned long long) seq.first
+                                                + k * (unsigned long long) seq.step));
+        }
+        else {
+          len = expand_seq_format(&seq, k, buf);
+          vars_set_len(node->name, buf, len);
+        }
+        status = run_list(node->body, exit_flag);
+        stop = loop_done() || *exit_flag || returning;
+      }
+      continue;
+    }
+    num = 1;
+    if(is_seq == -1 || (values = copy_words(node->words + i, 1)) == NULL
+       || expand_line(&values, &num) == -1) {
+      if(is_seq == 0)
+        free_words(values);
+      last_status = EXIT_FAILURE;
+      loop_depth--;
+      return -1;
+    }
+    for(j = 0; j < num && !stop; j++, ran = 1) {
+      vars_set(node->name, values[j]);
+      status = run_list(node->body, exit_flag);
+      stop = loop_done() || *exit_flag || returning;
+    }
+    free_words(values);
+  }
+  loop_depth--;
+  if(!ran)
+    last_status = EXIT_SUCCESS;
+  return status;
+}
+
+/* *
+ * Runs the while loop node.
+ *
+ * Returns - The status of the last command of the body run (0 on success, -1 on failure.)
+ * */
+static int run_while(struct node *node, int *exit_flag) {
+  int status = 0, body_status = EXIT_SUCCESS;
+
+  loop_depth++;
+  for(;;) {
+    run_list(node->cond, exit_flag);
+    if(*exit_flag || returning || loop_done() || last_status != EXIT_SUCCESS)
+      break;
+    status = run_list(node->body, exit_flag);
+    body_status = last_status;
+    if(loop_done() || *exit_flag || returning)
+      break;
+  }
+  loop_depth--;
+  // The status of the loop is that of its body, not of the condition that ended it.
+  if(!*exit_flag && !returning)
+    last_status = body_status;
+  return status;
+}
+
+/* *
+ * Defines the function node: copies the words of its body into the arena of a new function,
+ * parses them there, and enters the function in the dispatch table, in place of any function of
+ * the same name.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int run_define(struct node *node) {
+  struct arena arena = { NULL, 0 };
+  struct func *func, *old;
+  struct parser ps;
+  char **words, name[NAME_MAX + 1];
+  size_t i, len = vars_name_len(node->name);
+
+  if(len > NAME_MAX) {
+    fprintf(stderr, "tinysh: %s: function name too long\n", node->name);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  memcpy(name, node->name, len);
+  name[len] = '\0';
+  if((func = arena_alloc_object(&arena, sizeof(*func))) == NULL
+     || (words = arena_alloc_object(&arena, node->num_words * sizeof(*words))) == NULL)
+    goto fail;
+  for(i = 0; i < node->num_words; i++) {
+    if((words[i] = arena_strndup(&arena, node->words[i], strlen(node->words[i]))) == NULL)
+      goto fail;
+  }
+  ps.toks = words;
+  ps.num = node->num_words;
+  ps.pos = 0;
+  ps.arena = &arena;
+  ps.parens = 0;
+  // The body parsed once already, so only running out of memory can fail here.
+  if(parse_command(&ps, &func->body) != 0)
+    goto fail;
+  func->arena = arena;
+  func->refs = 1;
+  func->prev = NULL;
+  if(command_define(name, func, &old) == -1)
+    goto fail;
+  func->next = funcs;
+  if(funcs != NULL)
+    funcs->prev = func;
+  funcs = func;
+  if(old != NULL)
+    release_func(old);
+  if(VERBOSE(V_PROC))
+    printf("Defined the function %s.\n", name);
+  last_status = EXIT_SUCCESS;
+  return 0;
+
+fail:
+  arena_free(&arena);
+  last_status = EXIT_FAILURE;
+  return -1;
+}
+
+/* *
+ * Drops a reference to func, freeing it when it is neither defined nor being run.
+ * */
+static void release_func(struct func *func) {
+  struct arena arena;
+  if(--func->refs > 0)
+    return;
+  if(func->prev != NULL)
+    func->prev->next = func->next;
+  else
+    funcs = func->next;
+  if(func->next != NULL)
+    func->next->prev = func->prev;
+  // The function is in its own arena, so the arena is copied out before it is freed.
+  arena = func->arena;
+  arena_free(&arena);
+}
+
+/* *
+ * Counts off one loop of a pending break or continue, after an iteration of the innermost loop
+ * being run.
+ *
+ * Returns - 1 if that loop is to stop, or 0 if it is to go on to its next iteration.
+ * */
+static int loop_done(void) {
+  if(breaking > 0) {
+    breaking--;
+    return 1;
+  }
+  if(continuing > 0)
+    return --continuing > 0;
+  return 0;
+}
+
+/* *
+ * The break and continue builtins, which set *flag to the number of loops to leave.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int loop_control(char **cmd, unsigned *flag) {
+  char *end;
+  long n = 1;
+
+  last_status = EXIT_SUCCESS;
+  if(loop_depth == 0) {
+    fprintf(stderr, "tinysh: %s: only meaningful in a `for' or `while' loop\n", cmd[0]);
+    return 0;
+  }
+  if(cmd[1] != NULL) {
+    n = strtol(cmd[1], &end, 10);
+    if(end == cmd[1] || *end != '\0' || n < 1) {
+      fprintf(stderr, "tinysh: %s: %s: loop count out of range\n", cmd[0], cmd[1]);
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+  }
+  *flag = n > (long) loop_depth ? loop_depth : (unsigned) n;
+  return 0;
+}
+
+/* *
+ * Returns - A NULL-terminated copy of the num words at words, or NULL on an error.
+ * */
+static char** copy_words(char **words, size_t num) {
+  char **copy;
+  size_t i;
+  if((copy = mem_malloc(MEM_PARSE, (num + 1) * sizeof(*copy))) == NULL) {
+    perror("Error allocating memory for a command.");
+    return NULL;
+  }
+  for(i = 0; i < num; i++) {
+    if((copy[i] = mem_strdup(MEM_PARSE, words[i])) == NULL) {
+      perror("Error allocating memory for a command.");
+      copy[i] = NULL;
+      free_words(copy);
+      return NULL;
+    }
+  }
+  copy[num] = NULL;
+  return copy;
+}
+
+/* *
+ * Frees the NULL-terminated vector words and each of its words.
+ * */
+static void free_words(char **words) {
+  char **word;
+  for(word = words; word != NULL && *word != NULL; word++)
+    mem_free(MEM_PARSE, *word);
+  mem_free(MEM_PARSE, words);
+}
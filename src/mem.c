@@ -0,0 +1,295 @@
+/* *
+ * mem.c
+ *
+ * Allocation accounting.
+ *
+ * Every dynamic allocation the shell makes goes through the functions here, tagged with the
+ * subsystem it belongs to.  Each subsystem counts its allocation calls, its frees, the blocks and
+ * bytes it currently holds, and the most bytes it has ever held at once.  Verbose mode reports
+ * what each command line allocated and freed, the mem builtin prints the counters, and at exit
+ * the shell reports whatever is still allocated once it has released its long-lived tables.
+ *
+ * The allocator itself is pluggable (see mem_set_allocator), defaulting to the C library's.  Sizes
+ * are taken from the allocator's usable_size rather than from the sizes requested, so that freeing
+ * a block needs no header or side table to know how much to subtract.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "mem.h"
+#include "tinysh.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <errno.h>
+
+#define MEM_LINE_CAPACITY 128  // Initial size of a line read by mem_getline.
+
+static const char *names[MEM_NUM_SUBSYSTEMS] = {
+  "parse", "path", "exec", "hash", "stats", "trace", "vars"
+};
+
+static size_t libc_usable_size(void *ptr);
+
+static const struct mem_allocator libc_allocator = {
+  malloc, realloc, free, libc_usable_size
+};
+
+static const struct mem_allocator *allocator = &libc_allocator;
+static struct mem_counters counters[MEM_NUM_SUBSYSTEMS];
+static struct mem_counters line_start[MEM_NUM_SUBSYSTEMS];  // Counters at the last line report.
+
+static void count_alloc(int subsys, size_t bytes);
+static void count_free(int subsys, size_t bytes);
+static void sum_counters(struct mem_counters *total);
+static void print_row(const char *name, const struct mem_counters *c);
+
+/* *
+ * Replaces the allocator, or restores the C library's if alloc is NULL.  Must be called before
+ * anything is allocated, since blocks have to be freed by the allocator that allocated them.
+ * */
+void mem_set_allocator(const struct mem_allocator *alloc) {
+  allocator = alloc != NULL ? alloc : &libc_allocator;
+}
+
+/* *
+ * malloc, counted against subsys.
+ * */
+void* mem_malloc(int subsys, size_t size) {
+  void *ptr;
+  if((ptr = allocator->malloc(size)) != NULL)
+    count_alloc(subsys, allocator->usable_size(ptr));
+  return ptr;
+}
+
+/* *
+ * calloc, counted against subsys.
+ * */
+void* mem_calloc(int subsys, size_t num, size_t size) {
+  void *ptr;
+  if(size != 0 && num > SIZE_MAX / size) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  if((ptr = mem_malloc(subsys, num * size)) != NULL)
+    memset(ptr, 0, num * size);
+  return ptr;
+}
+
+/* *
+ * realloc, counted against subsys as one allocation call.  As with realloc, ptr is left allocated
+ * if resizing it fails.
+ * */
+void* mem_realloc(int subsys, void *ptr, size_t size) {
+  size_t old_size;
+  void *new_ptr;
+  old_size = ptr != NULL ? allocator->usable_size(ptr) : 0;
+  if((new_ptr = allocator->realloc(ptr, size)) == NULL)
+    return NULL;
+  if(ptr != NULL) {
+    // The block lives on, so it is moved between sizes rather than freed.
+    counters[subsys].blocks--;
+    counters[subsys].bytes -= old_size;
+  }
+  count_alloc(subsys, allocator->usable_size(new_ptr));
+  return new_ptr;
+}
+
+/* *
+ * strdup, counted against subsys.
+ * */
+char* mem_strdup(int subsys, const char *str) {
+  size_t len = strlen(str) + 1;
+  char *copy;
+  if((copy = mem_malloc(subsys, len)) != NULL)
+    memcpy(copy, str, len);
+  return copy;
+}
+
+/* *
+ * free, counted against subsys, which must be the subsystem that allocated ptr.
+ * */
+void mem_free(int subsys, void *ptr) {
+  if(ptr == NULL)
+    return;
+  count_free(subsys, allocator->usable_size(ptr));
+  allocator->free(ptr);
+}
+
+/* *
+ * getline, with the line buffer allocated by mem_realloc against subsys.  The buffer is reused
+ * (and grown as needed) from call to call, as with getline.
+ *
+ * Returns - The number of characters read, or -1 on end of file or error.
+ * */
+ssize_t mem_getline(int subsys, char **line, size_t *size, FILE *fp) {
+  size_t len, new_size;
+  char *buf;
+  if(*line == NULL || *size < MEM_LINE_CAPACITY) {
+    if((buf = mem_realloc(subsys, *line, MEM_LINE_CAPACITY)) == NULL)
+      return -1;
+    *line = buf;
+    *size = MEM_LINE_CAPACITY;
+  }
+  (*line)[0] = '\0';
+  len = 0;
+  while(fgets(*line + len, *size - len, fp) != NULL) {
+    len += strlen(*line + len);
+    // fgets stops at a newline, at the end of the file, or when the buffer is full.
+    if((*line)[len - 1] == '\n' || len + 1 < *size)
+      break;
+    new_size = *size * 2;
+    if((buf = mem_realloc(subsys, *line, new_size)) == NULL)
+      return -1;
+    *line = buf;
+    *size = new_size;
+  }
+  return len > 0 ? (ssize_t) len : -1;
+}
+
+/* *
+ * Reports, in verbose mode, what was allocated and freed since the last report.  Called by the
+ * driver after each command line.
+ * */
+void mem_line_report(void) {
+  int i;
+  struct mem_counters *c, *s;
+  uint64_t calls, frees, bytes;
+  if(VERBOSE(V_MEM)) {
+    calls = frees = bytes = 0;
+    for(i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+      calls += counters[i].calls - line_start[i].calls;
+      frees += counters[i].frees - line_start[i].frees;
+      bytes += counters[i].total_bytes - line_start[i].total_bytes;
+    }
+    printf("Memory:  %llu allocations (%llu bytes) and %llu frees for this line.\n",
+           (unsigned long long) calls, (unsigned long long) bytes, (unsigned long long) frees);
+  }
+  if(VERBOSE_AT(V_LEVEL_DETAILS, V_MEM)) {
+    for(i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+      c = &counters[i];
+      s = &line_start[i];
+      if(c->calls == s->calls && c->frees == s->frees)
+        continue;
+      printf("  %-6s %llu allocations, %llu frees, %zu bytes in %zu blocks still allocated.\n",
+             names[i], (unsigned long long) (c->calls - s->calls),
+             (unsigned long long) (c->frees - s->frees), c->bytes, c->blocks);
+    }
+  }
+  memcpy(line_start, counters, sizeof(counters));
+}
+
+/* *
+ * Prints, on stderr, every subsystem that still holds memory.  Called at exit, after the shell
+ * has released the memory it keeps for its whole life.
+ *
+ * Returns - The number of blocks still allocated.
+ * */
+int mem_leak_report(void) {
+  int i;
+  size_t blocks = 0;
+  for(i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+    if(counters[i].blocks == 0)
+      continue;
+    fprintf(stderr, "tinysh: %s leaked %zu bytes in %zu blocks.\n", names[i], counters[i].bytes,
+            counters[i].blocks);
+    blocks += counters[i].blocks;
+  }
+  if(blocks == 0 && VERBOSE(V_MEM))
+    printf("All allocated memory was freed.\n");
+  return (int) blocks;
+}
+
+/* *
+ * Handler for the mem builtin.
+ *
+ * mem      - prints the allocation counters of each subsystem.
+ * mem -r   - resets the call counts and totals, and lowers each high-water mark to the memory
+ *            currently allocated.
+ * */
+int mem_handle(char **cmd, size_t num_cmd) {
+  int i;
+  struct mem_counters total;
+
+  if(num_cmd > 2 || (num_cmd == 2 && strcmp(cmd[1], "-r") != 0)) {
+    printf("Error:  Invalid argument %s.\nUsage: mem [-r]\n", cmd[1]);
+    return -1;
+  }
+  if(num_cmd == 2) {
+    if(VERBOSE(V_MEM))
+      printf("Resetting the allocation counters.\n");
+    for(i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+      counters[i].calls = counters[i].frees = counters[i].total_bytes = 0;
+      counters[i].peak_bytes = counters[i].bytes;
+    }
+    memcpy(line_start, counters, sizeof(counters));
+    return 0;
+  }
+
+  printf("%-9s %10s %10s %12s %8s %10s %10s\n",
+         "subsystem", "allocs", "frees", "total", "blocks", "bytes", "peak");
+  for(i = 0; i < MEM_NUM_SUBSYSTEMS; i++)
+    print_row(names[i], &counters[i]);
+  sum_counters(&total);
+  print_row("total", &total);
+  return 0;
+}
+
+/* *
+ * Returns - The usable size of a block from the C library's malloc.
+ * */
+static size_t libc_usable_size(void *ptr) {
+  return malloc_usable_size(ptr);
+}
+
+/* *
+ * Counts a new block of the given size against subsys.
+ * */
+static void count_alloc(int subsys, size_t bytes) {
+  struct mem_counters *c = &counters[subsys];
+  c->calls++;
+  c->total_bytes += bytes;
+  c->blocks++;
+  if((c->bytes += bytes) > c->peak_bytes)
+    c->peak_bytes = c->bytes;
+}
+
+/* *
+ * Counts the release of a block of the given size against subsys.
+ * */
+static void count_free(int subsys, size_t bytes) {
+  struct mem_counters *c = &counters[subsys];
+  c->frees++;
+  c->blocks--;
+  c->bytes -= bytes;
+}
+
+/* *
+ * Sums the counters of every subsystem into total.  The total high-water mark is the sum of the
+ * subsystems' marks, which may not all have been reached at the same time.
+ * */
+static void sum_counters(struct mem_counters *total) {
+  int i;
+  memset(total, 0, sizeof(*total));
+  for(i = 0; i < MEM_NUM_SUBSYSTEMS; i++) {
+    total->calls += counters[i].calls;
+    total->frees += counters[i].frees;
+    total->total_bytes += counters[i].total_bytes;
+    total->blocks += counters[i].blocks;
+    total->bytes += counters[i].bytes;
+    total->peak_bytes += counters[i].peak_bytes;
+  }
+}
+
+/* *
+ * Prints one row of the mem table.
+ * */
+static void print_row(const char *name, const struct mem_counters *c) {
+  printf("%-9s %10llu %10llu %12llu %8zu %10zu %10zu\n", name, (unsigned long long) c->calls,
+         (unsigned long long) c->frees, (unsigned long long) c->total_bytes, c->blocks, c->bytes,
+         c->peak_bytes);
+}
@@ -0,0 +1,653 @@
+/* *
+ * memo.c
+ *
+ * Result memoization for deterministic commands.
+ *
+ * A command prefixed with "memo" is identified by a key hashed from its arguments, the values of
+ * the environment variables declared with -e, and the contents (-i) or modification times (-m)
+ * of the input files it declares.  The first run of a key records the command's stdout, stderr,
+ * and exit status in a content-addressed store; every later run with the same key replays that
+ * recording instead of executing the command again.
+ *
+ * NOTES:
+ *   - The store lives in $TINYSH_MEMO_DIR if set, else $XDG_CACHE_HOME/tinysh/memo, else
+ *     $HOME/.cache/tinysh/memo.  Each entry is a directory named after the hex key holding the
+ *     files "stdout", "stderr", and "status".
+ *   - Entries are recorded in a temporary directory and renamed into place once the command has
+ *     exited, so a partially written entry is never replayed.
+ *   - Commands killed by a signal are not recorded.
+ *   - A replay writes all of stdout and then all of stderr, so the original interleaving of the
+ *     two streams is not preserved.
+ *   - Runs are single-flight: the shell that misses on a key takes an exclusive flock on
+ *     "<store>/.lock-<key>" while it records into "<store>/.inflight-<key>".  Any other shell
+ *     (a concurrent script, a parallel worker) that misses on the same key while the lock is held
+ *     does not run the command; it follows the in-flight recording as it is written and then
+ *     exits with the recorded status.  If the lock is released without the entry being published
+ *     (the recording shell died), the follower reclaims the key: it takes the lock, discards the
+ *     abandoned recording, and runs the command itself.  What it already copied of the abandoned
+ *     run's output has been written by then, so that part of the output appears twice.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "memo.h"
+#include "fdio.h"
+#include "tinysh.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/file.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+
+#define MEMO_BUF_SIZE   65536
+#define MEMO_FOLLOW_MIN 1000     // Initial delay between polls of an in-flight run, in us.
+#define MEMO_FOLLOW_MAX 50000    // Maximum delay between polls of an in-flight run, in us.
+#define MEMO_ABANDONED  -2       // Status of a followed run that died without publishing its entry.
+#define MEMO_KEY_HEX    32  // Number of hex digits in a 128-bit key.
+#define MEMO_TMP_MAX    (PATH_MAX + 64)       // Room for the store plus a temporary entry name.
+#define MEMO_PATH_MAX   (MEMO_TMP_MAX + 64)   // Room for an entry plus a file name.
+
+#define READ_END  0
+#define WRITE_END 1
+
+// 128-bit FNV-1a parameters.
+__extension__ typedef unsigned __int128 memo_hash;
+#define FNV128_OFFSET ((((memo_hash) 0x6c62272e07bb0142ULL) << 64) | 0x62b821756295c58dULL)
+#define FNV128_PRIME  ((((memo_hash) 0x0000000001000000ULL) << 64) | 0x000000000000013bULL)
+
+static int memo_usage(void);
+static memo_hash hash_bytes(memo_hash h, const void *buf, size_t len);
+static memo_hash hash_field(memo_hash h, char tag, const void *buf, size_t len);
+static int hash_file(memo_hash *h, const char *file, int by_content);
+static int store_dir(char *buf, size_t size);
+static int make_dirs(char *dir);
+static int copy_file(const char *file, int out_fd);
+static void remove_entry(const char *dir);
+static int memo_replay(const char *entry);
+static int memo_follow(int lock_fd, const char *tmp, const char *entry);
+static ssize_t drain_fd(int fd, int out_fd);
+static int memo_record(char **cmd, const char *tmp, const char *entry);
+
+/* *
+ * Handler for the memo builtin when it is run directly by the shell.
+ *
+ * Returns - 0 if the (possibly replayed) command exited successfully, -1 otherwise.
+ * */
+int memo_handle(char **cmd, size_t num_cmd) {
+  (void) num_cmd;
+  last_status = memo_run(cmd);
+  return last_status == EXIT_SUCCESS ? 0 : -1;
+}
+
+/* *
+ * Runs cmd, which should have the form
+ *
+ * memo [-e VAR]... [-i FILE]... [-m FILE]... [--] command [args ...]
+ *
+ * replaying a recorded result from the memo store if one exists for the command's key.
+ *
+ * Returns - The exit status of the command, or a nonzero status if the command could not be run.
+ * */
+int memo_run(char **cmd) {
+  int i, status, lock_fd;
+  char store[PATH_MAX], entry[PATH_MAX], hex[MEMO_KEY_HEX + 1];
+  char tmp[MEMO_TMP_MAX], lock[MEMO_TMP_MAX], cwd[PATH_MAX];
+  char *value;
+  char **argv;
+  memo_hash h;
+  struct stat st;
+
+  h = FNV128_OFFSET;
+  // Process options, hashing each declared environment variable and input file.
+  i = 1;
+  while(cmd[i] != NULL && cmd[i][0] == '-') {
+    if(strcmp(cmd[i], "--") == 0) {
+      i++;
+      break;
+    }
+    if(cmd[i + 1] == NULL || (strcmp(cmd[i], "-e") != 0 && strcmp(cmd[i], "-i") != 0
+                              && strcmp(cmd[i], "-m") != 0)) {
+      return memo_usage();
+    }
+    if(cmd[i][1] == 'e') {
+      // An unset variable hashes differently from a variable set to the empty string.
+      h = hash_field(h, 'e', cmd[i + 1], strlen(cmd[i + 1]));
+      if((value = getenv(cmd[i + 1])) != NULL)
+        h = hash_field(h, 'v', value, strlen(value));
+      else
+        h = hash_field(h, 'u', NULL, 0);
+    }
+    else if(hash_file(&h, cmd[i + 1], cmd[i][1] == 'i') == -1) {
+      return EXIT_FAILURE;
+    }
+    i += 2;
+  }
+  argv = &cmd[i];
+  if(argv[0] == NULL)
+    return memo_usage();
+  for(i = 0; argv[i] != NULL; i++)
+    h = hash_field(h, 'a', argv[i], strlen(argv[i]));
+  // Relative paths in the arguments mean different things in different directories, so the
+  // canonical working directory is part of the key.
+  if(getcwd(cwd, sizeof(cwd)) == NULL) {
+    perror("Error:  Getting the current working directory failed.");
+    return EXIT_FAILURE;
+  }
+  h = hash_field(h, 'c', cwd, strlen(cwd));
+
+  for(i = 0; i < MEMO_KEY_HEX; i++)
+    hex[i] = "0123456789abcdef"[(unsigned) (h >> (4 * (MEMO_KEY_HEX - 1 - i))) & 0xf];
+  hex[MEMO_KEY_HEX] = '\0';
+  if(VERBOSE_AT(V_LEVEL_DETAILS, V_PROC))
+    printf("  Memo key for %s:  %s\n", argv[0], hex);
+
+  if(store_dir(store, sizeof(store)) == -1)
+    return EXIT_FAILURE;
+  if(snprintf(entry, sizeof(entry), "%s/%s", store, hex) >= (int) sizeof(entry)) {
+    fprintf(stderr, "Error:  Memo store path is too long.\n");
+    return EXIT_FAILURE;
+  }
+
+  // A complete entry exists, so replay it.
+  if(stat(entry, &st) == 0) {
+    if(VERBOSE(V_PROC))
+      printf("  Cache hit:  replaying the recorded output of %s from %s.\n\n", argv[0], entry);
+    if((status = memo_replay(entry)) != -1)
+      return status;
+    // The entry is unreadable; discard it and fall back to running the command.
+    remove_entry(entry);
+  }
+
+  // Only one shell at a time may run a key; everyone else follows the run that is in flight.
+  snprintf(lock, sizeof(lock), "%s/.lock-%s", store, hex);
+  snprintf(tmp, sizeof(tmp), "%s/.inflight-%s", store, hex);
+  if((lock_fd = open(lock, O_CREAT | O_RDWR | O_CLOEXEC, 0666)) < 0) {
+    perror("Error opening a memo lock file.");
+    return EXIT_FAILURE;
+  }
+  while(flock(lock_fd, LOCK_EX | LOCK_NB) < 0) {
+    if(errno == EINTR)
+      continue;
+    if(errno != EWOULDBLOCK) {
+      perror("Error locking a memo entry.");
+      close(lock_fd);
+      return EXIT_FAILURE;
+    }
+    if(VERBOSE(V_PROC))
+      printf("  %s is already running in another process; following its output.\n\n", argv[0]);
+    if((status = memo_follow(lock_fd, tmp, entry)) != MEMO_ABANDONED) {
+      close(lock_fd);
+      return status;
+    }
+    // Reclaim the key, waiting out any other follower that got to it first (which then leaves a
+    // published entry to replay below.)
+    fprintf(stderr, "memo: The in-flight run of this command died; running it again.\n");
+    if(flock(lock_fd, LOCK_UN) < 0 || flock(lock_fd, LOCK_EX) < 0) {
+      perror("Error locking a memo entry.");
+      close(lock_fd);
+      return EXIT_FAILURE;
+    }
+    break;
+  }
+
+  // The entry may have been published between the stat above and taking the lock.
+  if(stat(entry, &st) == 0 && (status = memo_replay(entry)) != -1) {
+    if(VERBOSE(V_PROC))
+      printf("  Cache hit:  replaying the recorded output of %s from %s.\n\n", argv[0], entry);
+    close(lock_fd);
+    return status;
+  }
+
+  if(VERBOSE(V_PROC))
+    printf("  Cache miss:  running %s and recording its output in %s.\n\n", argv[0], entry);
+  status = memo_record(argv, tmp, entry);
+  // Closing the lock file releases the lock and wakes any followers.
+  close(lock_fd);
+  return status;
+}
+
+/* *
+ * Prints usage information for the memo builtin.
+ *
+ * Returns - The exit status for a usage error.
+ * */
+static int memo_usage(void) {
+  fprintf(stderr, "usage: memo [-e VAR]... [-i FILE]... [-m FILE]... [--] command [args ...]\n");
+  return 2;
+}
+
+/* *
+ * Folds len bytes of buf into the 128-bit FNV-1a hash h.
+ * */
+static memo_hash hash_bytes(memo_hash h, const void *buf, size_t len) {
+  const unsigned char *p = buf;
+  while(len--) {
+    h ^= *p++;
+    h *= FNV128_PRIME;
+  }
+  return h;
+}
+
+/* *
+ * Folds a tagged, length-prefixed field into h, so that distinct field sequences (e.g. the
+ * arguments "ab" "c" and "a" "bc") never hash the same byte stream.
+ * */
+static memo_hash hash_field(memo_hash h, char tag, const void *buf, size_t len) {
+  unsigned long long n = len;
+  h = hash_bytes(h, &tag, 1);
+  h = hash_bytes(h, &n, sizeof(n));
+  return hash_bytes(h, buf, len);
+}
+
+/* *
+ * Folds an input file into h, either by its full contents or by its size and modification time.
+ * */
+static int hash_file(memo_hash *h, const char *file, int by_content) {
+  int fd;
+  ssize_t n;
+  char buf[MEMO_BUF_SIZE];
+  struct stat st;
+
+  *h = hash_field(*h, by_content ? 'i' : 'm', file, strlen(file));
+  if(!by_content) {
+    if(stat(file, &st) < 0) {
+      perror("Error getting the status of a memo input file.");
+      return -1;
+    }
+    *h = hash_bytes(*h, &st.st_size, sizeof(st.st_size));
+    *h = hash_bytes(*h, &st.st_mtim, sizeof(st.st_mtim));
+    return 0;
+  }
+
+  if((fd = open(file, O_RDONLY)) < 0) {
+    perror("Error opening a memo input file.");
+    return -1;
+  }
+  while((n = read(fd, buf, sizeof(buf))) != 0) {
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      perror("Error reading a memo input file.");
+      close(fd);
+      return -1;
+    }
+    *h = hash_bytes(*h, buf, n);
+  }
+  if(close(fd) < 0)
+    perror("Error closing file descriptor.");
+  return 0;
+}
+
+/* *
+ * Writes the memo store directory into buf, creating it if it does not exist.
+ * */
+static int store_dir(char *buf, size_t size) {
+  char *dir;
+  int len;
+  if((dir = getenv("TINYSH_MEMO_DIR")) != NULL && *dir)
+    len = snprintf(buf, size, "%s", dir);
+  else if((dir = getenv("XDG_CACHE_HOME")) != NULL && *dir)
+    len = snprintf(buf, size, "%s/tinysh/memo", dir);
+  else if((dir = getenv("HOME")) != NULL && *dir)
+    len = snprintf(buf, size, "%s/.cache/tinysh/memo", dir);
+  else {
+    fprintf(stderr, "Error:  Unable to locate the memo store; set TINYSH_MEMO_DIR.\n");
+    return -1;
+  }
+  if(len < 0 || (size_t) len >= size) {
+    fprintf(stderr, "Error:  Memo store path is too long.\n");
+    return -1;
+  }
+  return make_dirs(buf);
+}
+
+/* *
+ * Creates dir and any missing parent directories, like mkdir -p.
+ * */
+static int make_dirs(char *dir) {
+  char *p;
+  for(p = dir + 1; *p; p++) {
+    if(*p != '/')
+      continue;
+    *p = '\0';
+    if(mkdir(dir, 0777) < 0 && errno != EEXIST) {
+      perror("Error creating the memo store directory.");
+      *p = '/';
+      return -1;
+    }
+    *p = '/';
+  }
+  if(mkdir(dir, 0777) < 0 && errno != EEXIST) {
+    perror("Error creating the memo store directory.");
+    return -1;
+  }
+  return 0;
+}
+
+/* *
+ * Copies the contents of file to out_fd.
+ * */
+static int copy_file(const char *file, int out_fd) {
+  int fd;
+  ssize_t n;
+  char buf[MEMO_BUF_SIZE];
+  if((fd = open(file, O_RDONLY)) < 0)
+    return -1;
+  while((n = read(fd, buf, sizeof(buf))) != 0) {
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      close(fd);
+      return -1;
+    }
+    if(fd_write_all(out_fd, buf, n) == -1) {
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+/* *
+ * Removes a (possibly partial) memo entry directory.
+ * */
+static void remove_entry(const char *dir) {
+  char file[MEMO_PATH_MAX];
+  snprintf(file, sizeof(file), "%s/stdout", dir);
+  unlink(file);
+  snprintf(file, sizeof(file), "%s/stderr", dir);
+  unlink(file);
+  snprintf(file, sizeof(file), "%s/status", dir);
+  unlink(file);
+  rmdir(dir);
+}
+
+/* *
+ * Replays the recorded stdout and stderr of entry.
+ *
+ * Returns - The recorded exit status, or -1 if the entry could not be read.
+ * */
+static int memo_replay(const char *entry) {
+  int status;
+  char file[MEMO_PATH_MAX];
+  FILE *fp;
+
+  snprintf(file, sizeof(file), "%s/status", entry);
+  if((fp = fopen(file, "r")) == NULL)
+    return -1;
+  if(fscanf(fp, "%d", &status) != 1) {
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+
+  snprintf(file, sizeof(file), "%s/stdout", entry);
+  if(copy_file(file, STDOUT_FILENO) == -1)
+    return -1;
+  snprintf(file, sizeof(file), "%s/stderr", entry);
+  if(copy_file(file, STDERR_FILENO) == -1)
+    return -1;
+  return status;
+}
+
+/* *
+ * Follows a run of the same key that is in flight in another process, copying its recorded
+ * stdout and stderr as they grow until the other process releases the key's lock.  lock_fd is the
+ * key's lock file, and tmp and entry are the in-flight and published locations of the recording.
+ *
+ * Returns - The exit status recorded by the other process, or MEMO_ABANDONED if it released the
+ *           lock without publishing its entry.
+ * */
+static int memo_follow(int lock_fd, const char *tmp, const char *entry) {
+  int i, done, status, fds[2];
+  ssize_t copied;
+  char file[MEMO_PATH_MAX];
+  const char *names[2] = { "stdout", "stderr" };
+  struct timespec delay;
+  struct stat st;
+  FILE *fp;
+
+  fds[0] = fds[1] = -1;
+  delay.tv_sec = 0;
+  delay.tv_nsec = MEMO_FOLLOW_MIN * 1000L;
+  done = 0;
+  while(1) {
+    // The recording files appear once the other process has set up its run.  Once they are open,
+    // the descriptors stay valid when the in-flight directory is renamed into place.
+    for(i = 0; i < 2; i++) {
+      if(fds[i] >= 0)
+        continue;
+      snprintf(file, sizeof(file), "%s/%s", done ? entry : tmp, names[i]);
+      fds[i] = open(file, O_RDONLY | O_CLOEXEC);
+    }
+    copied = drain_fd(fds[0], STDOUT_FILENO);
+    copied += drain_fd(fds[1], STDERR_FILENO);
+    if(copied > 0)
+      delay.tv_nsec = MEMO_FOLLOW_MIN * 1000L;
+    if(done)
+      break;
+
+    // Once the lock can be shared, the other process has finished (or died.)  Drain whatever it
+    // wrote since the last poll before reading its status.
+    if(flock(lock_fd, LOCK_SH | LOCK_NB) == 0) {
+      done = 1;
+      continue;
+    }
+    nanosleep(&delay, NULL);
+    if(delay.tv_nsec < MEMO_FOLLOW_MAX * 1000L)
+      delay.tv_nsec *= 2;
+  }
+  for(i = 0; i < 2; i++) {
+    if(fds[i] >= 0)
+      close(fds[i]);
+  }
+  if(stat(entry, &st) < 0)
+    return MEMO_ABANDONED;
+
+  snprintf(file, sizeof(file), "%s/status", entry);
+  if((fp = fopen(file, "r")) == NULL || fscanf(fp, "%d", &status) != 1) {
+    fprintf(stderr, "memo: The in-flight run of this command did not complete.\n");
+    if(fp != NULL)
+      fclose(fp);
+    return EXIT_FAILURE;
+  }
+  fclose(fp);
+  return status;
+}
+
+/* *
+ * Copies everything currently readable from fd to out_fd.  Negative fds are ignored.
+ *
+ * Returns - The number of bytes copied.
+ * */
+static ssize_t drain_fd(int fd, int out_fd) {
+  ssize_t n, total = 0;
+  char buf[MEMO_BUF_SIZE];
+  if(fd < 0)
+    return 0;
+  while((n = read(fd, buf, sizeof(buf))) != 0) {
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      break;
+    }
+    fd_write_all(out_fd, buf, n);
+    total += n;
+  }
+  return total;
+}
+
+/* *
+ * Runs cmd in a child process, passing its stdout and stderr through to the shell's while
+ * recording both into tmp, then publishes the recording as entry.  The caller must hold the key's
+ * lock.
+ *
+ * Returns - The exit status of the command.
+ * */
+static int memo_record(char **cmd, const char *tmp, const char *entry) {
+  int p_id, status, i, open_fds, failed = 0;
+  int out_pipe[2], err_pipe[2], files[2];
+  ssize_t n;
+  char file[MEMO_PATH_MAX], buf[MEMO_BUF_SIZE];
+  struct pollfd fds[2];
+  FILE *fp;
+
+  // Record into the key's in-flight directory so that a partial entry is never replayed.  Holding
+  // the lock means anything already there was left behind by a run that died.
+  remove_entry(tmp);
+  if(mkdir(tmp, 0777) < 0) {
+    perror("Error creating a memo entry.");
+    return EXIT_FAILURE;
+  }
+  snprintf(file, sizeof(file), "%s/stdout", tmp);
+  files[0] = open(file, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+  snprintf(file, sizeof(file), "%s/stderr", tmp);
+  files[1] = open(file, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+  if(files[0] < 0 || files[1] < 0) {
+    perror("Error opening a memo entry file.");
+    if(files[0] >= 0)
+      close(files[0]);
+    if(files[1] >= 0)
+      close(files[1]);
+    remove_entry(tmp);
+    return EXIT_FAILURE;
+  }
+
+  if(pipe(out_pipe) < 0) {
+    perror("Error creating pipe.");
+    close(files[0]);
+    close(files[1]);
+    remove_entry(tmp);
+    return EXIT_FAILURE;
+  }
+  if(pipe(err_pipe) < 0) {
+    perror("Error creating pipe.");
+    close(out_pipe[READ_END]);
+    close(out_pipe[WRITE_END]);
+    close(files[0]);
+    close(files[1]);
+    remove_entry(tmp);
+    return EXIT_FAILURE;
+  }
+
+  // The shell's buffered output has to come before the command's, which is teed in directly.
+  fflush(stdout);
+  if((p_id = fork()) < 0) {
+    perror("Error forking a process.");
+    close(out_pipe[READ_END]);
+    close(out_pipe[WRITE_END]);
+    close(err_pipe[READ_END]);
+    close(err_pipe[WRITE_END]);
+    close(files[0]);
+    close(files[1]);
+    remove_entry(tmp);
+    return EXIT_FAILURE;
+  }
+
+  // Child process, with stdout and stderr redirected into the recording pipes.
+  if(p_id == 0) {
+    close(files[0]);
+    close(files[1]);
+    close(out_pipe[READ_END]);
+    close(err_pipe[READ_END]);
+    if(dup2(out_pipe[WRITE_END], STDOUT_FILENO) < 0 || dup2(err_pipe[WRITE_END], STDERR_FILENO) < 0) {
+      perror("Error duplicating file descriptor.");
+      _Exit(EXIT_FAILURE);
+    }
+    close(out_pipe[WRITE_END]);
+    close(err_pipe[WRITE_END]);
+    exec(cmd);
+    _Exit(127);
+  }
+
+  // Parent process.  Tee both pipes into the shell's stdout/stderr and the entry files until the
+  // child closes them.  If the recording fails, the output still passes through, but the entry is
+  // not published.
+  close(out_pipe[WRITE_END]);
+  close(err_pipe[WRITE_END]);
+  fds[0].fd = out_pipe[READ_END];
+  fds[1].fd = err_pipe[READ_END];
+  fds[0].events = fds[1].events = POLLIN;
+  open_fds = 2;
+  while(open_fds > 0) {
+    if(poll(fds, 2, -1) < 0) {
+      if(errno == EINTR)
+        continue;
+      perror("Error polling the memo pipes.");
+      failed = 1;
+      break;
+    }
+    for(i = 0; i < 2; i++) {
+      if(fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      if((n = read(fds[i].fd, buf, sizeof(buf))) < 0 && errno == EINTR)
+        continue;
+      if(n <= 0) {
+        close(fds[i].fd);
+        fds[i].fd = -1;
+        open_fds--;
+        continue;
+      }
+      fd_write_all(i == 0 ? STDOUT_FILENO : STDERR_FILENO, buf, n);
+      if(!failed && fd_write_all(files[i], buf, n) == -1) {
+        perror("Error writing a memo entry file.");
+        failed = 1;
+      }
+    }
+  }
+  for(i = 0; i < 2; i++) {
+    if(fds[i].fd >= 0)
+      close(fds[i].fd);
+  }
+  close(files[0]);
+  close(files[1]);
+
+  if(waitpid(p_id, &status, 0) < 0) {
+    perror("Error waiting for a process.");
+    remove_entry(tmp);
+    return EXIT_FAILURE;
+  }
+  if(!WIFEXITED(status)) {
+    // A killed command has no deterministic result to remember.
+    remove_entry(tmp);
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : EXIT_FAILURE;
+  }
+  if(failed) {
+    // An incomplete recording would replay truncated output.
+    remove_entry(tmp);
+    return WEXITSTATUS(status);
+  }
+
+  // Write the status last, then publish the entry.  If another shell published the same key in
+  // the meantime, keep its entry and discard ours.
+  snprintf(file, sizeof(file), "%s/status", tmp);
+  if((fp = fopen(file, "w")) == NULL) {
+    perror("Error writing a memo entry file.");
+    remove_entry(tmp);
+    return WEXITSTATUS(status);
+  }
+  fprintf(fp, "%d\n", WEXITSTATUS(status));
+  if(fclose(fp) != 0) {
+    perror("Error writing a memo entry file.");
+    remove_entry(tmp);
+    return WEXITSTATUS(status);
+  }
+  if(rename(tmp, entry) < 0) {
+    if(errno != EEXIST && errno != ENOTEMPTY)
+      perror("Error publishing a memo entry.");
+    remove_entry(tmp);
+  }
+  return WEXITSTATUS(status);
+}
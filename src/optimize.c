@@ -0,0 +1,219 @@
+/* *
+ * optimize.c
+ *
+ * The optimizer: rewrites of a parsed pipeline that save processes before it is run.
+ *
+ *   - "cat file | cmd" becomes "cmd < file", saving the cat's fork, exec, and pipe.
+ *   - A trailing "| cat" is dropped when the pipeline's output is not a terminal, where the cat
+ *     only copies its input to its output.
+ *   - Stages that the shell implements itself (pwd, echo, printf, test, true, and false) run as
+ *     builtins in the stage's process, saving the exec, and adjacent builtin stages are chained
+ *     into the process of the last of them, saving the forks and pipes between them.
+ *   - "> /dev/null" uses a descriptor the shell keeps open, saving an open in each pipeline.
+ *
+ * Lines the optimizer rewrites are run by the flat pipeline runner (see pipeline.c) rather than
+ * by exec_dispatch.  Each rewrite is narrated in verbose mode (parse), marked in the trace, and
+ * passed to a note callback, which is how the explain builtin lists them.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "optimize.h"
+#include "tinysh.h"
+#include "trace.h"
+#include "mem.h"
+#include "builtins.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#define REWRITE_SIZE 128  // Size of a rewrite's description.
+
+static int devnull_fd = -1;
+
+static int input_cat(struct pipeline *pl, void (*note)(const char *rewrite));
+static int output_cat(struct pipeline *pl, void (*note)(const char *rewrite));
+static int builtin_stages(struct pipeline *pl, void (*note)(const char *rewrite));
+static int cached_output(struct pipeline *pl, void (*note)(const char *rewrite));
+static builtin_handler stage_builtin(const char *name);
+static void remove_stage(struct pipeline *pl, size_t i);
+static void rewrite(void (*note)(const char *rewrite), const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+/* *
+ * Decides how the command line cmds is run.  A line with pipes or redirections is parsed into pl
+ * and optimized, and if that rewrote it, or if it reads from a file (which only the flat pipeline
+ * runner supports), it is left in pl to be run by pipeline_dispatch.  note is passed every rewrite.
+ *
+ * Returns - 1 if pl holds the line to run, 0 if the line is left to exec_dispatch, or -1 if a line
+ *           that reads from a file is not a valid pipeline.
+ * */
+int optimize_line(char **cmds, struct pipeline *pl, void (*note)(const char *rewrite)) {
+  size_t i;
+  int input = 0;
+  for(i = 0; cmds[i] != NULL; i++) {
+    if(strcmp(cmds[i], "<") == 0)
+      input = 1;
+  }
+  if(!input && !is_special_feature(cmds))
+    return 0;
+  // A line the flat pipeline cannot express is still fine for exec_dispatch, unless it reads from
+  // a file.
+  if(pipeline_parse(cmds, pl, !input) == -1)
+    return input ? -1 : 0;
+  if(optimize_pipeline(pl, note) == 0 && pl->in_file == NULL) {
+    pipeline_free(pl);
+    return 0;
+  }
+  return 1;
+}
+
+/* *
+ * Applies every rewrite that fits pl, calling note (if it is not NULL) with a description of each.
+ *
+ * Returns - The number of rewrites made.
+ * */
+int optimize_pipeline(struct pipeline *pl, void (*note)(const char *rewrite)) {
+  int rewrites = 0;
+  rewrites += input_cat(pl, note);
+  rewrites += output_cat(pl, note);
+  rewrites += builtin_stages(pl, note);
+  rewrites += cached_output(pl, note);
+  return rewrites;
+}
+
+/* *
+ * Returns - A close-on-exec descriptor open on /dev/null, opened the first time it is needed and
+ *           kept for the life of the shell, or -1 if it cannot be opened.
+ * */
+int optimize_devnull(void) {
+  if(devnull_fd < 0 && (devnull_fd = open("/dev/null", O_RDWR | O_CLOEXEC)) < 0)
+    perror("Error opening /dev/null.");
+  return devnull_fd;
+}
+
+/* *
+ * Rewrites "cat file | cmd" to "cmd < file".
+ *
+ * Returns - 1 if pl was rewritten, 0 otherwise.
+ * */
+static int input_cat(struct pipeline *pl, void (*note)(const char *rewrite)) {
+  char **argv = pl->stages[0].argv;
+  // Only a cat of exactly one file, with no options, is nothing more than a redirection.  A file
+  // that cannot be read is left to cat, since the command after it still runs, on no input.
+  if(pl->num_stages < 2 || pl->in_file != NULL || strcmp(argv[0], "cat") != 0 || argv[1] == NULL
+     || argv[2] != NULL || argv[1][0] == '-' || access(argv[1], R_OK) != 0)
+    return 0;
+  pl->in_file = argv[1];
+  remove_stage(pl, 0);
+  rewrite(note, "cat %s | %s -> %s < %s", pl->in_file, pl->stages[0].argv[0],
+          pl->stages[0].argv[0], pl->in_file);
+  return 1;
+}
+
+/* *
+ * Drops a trailing "| cat" when the pipeline's output is not a terminal.
+ *
+ * Returns - 1 if pl was rewritten, 0 otherwise.
+ * */
+static int output_cat(struct pipeline *pl, void (*note)(const char *rewrite)) {
+  char **argv = pl->stages[pl->num_stages - 1].argv;
+  // A cat to a terminal is left alone, since the program before it may behave differently when
+  // its output is one.
+  if(pl->num_stages < 2 || strcmp(argv[0], "cat") != 0 || argv[1] != NULL
+     || (pl->out_file == NULL && isatty(STDOUT_FILENO)))
+    return 0;
+  remove_stage(pl, pl->num_stages - 1);
+  pl->dropped_cat = 1;
+  rewrite(note, "%s | cat -> %s", pl->stages[pl->num_stages - 1].argv[0],
+          pl->stages[pl->num_stages - 1].argv[0]);
+  return 1;
+}
+
+/* *
+ * Runs the stages the shell implements itself as builtins, and chains each builtin stage followed
+ * by another into that stage's process.
+ *
+ * Returns - The number of rewrites made.
+ * */
+static int builtin_stages(struct pipeline *pl, void (*note)(const char *rewrite)) {
+  size_t i;
+  int rewrites = 0;
+
+  for(i = 0; i < pl->num_stages; i++) {
+    if((pl->stages[i].builtin = stage_builtin(pl->stages[i].argv[0])) == NULL)
+      continue;
+    rewrites++;
+    rewrite(note, "%s -> builtin %s (no exec)", pl->stages[i].argv[0], pl->stages[i].argv[0]);
+  }
+  for(i = 0; i + 1 < pl->num_stages; i++) {
+    if(pl->stages[i].builtin == NULL || pl->stages[i + 1].builtin == NULL)
+      continue;
+    pl->stages[i].chained = 1;
+    rewrites++;
+    rewrite(note, "%s | %s -> %s; %s (one process, no pipe)", pl->stages[i].argv[0],
+            pl->stages[i + 1].argv[0], pl->stages[i].argv[0], pl->stages[i + 1].argv[0]);
+  }
+  return rewrites;
+}
+
+/* *
+ * Points output to /dev/null at the shell's cached descriptor on it.
+ *
+ * Returns - 1 if pl was rewritten, 0 otherwise.
+ * */
+static int cached_output(struct pipeline *pl, void (*note)(const char *rewrite)) {
+  if(pl->out_file == NULL || strcmp(pl->out_file, "/dev/null") != 0
+     || (pl->out_fd = optimize_devnull()) < 0)
+    return 0;
+  rewrite(note, "> /dev/null -> cached descriptor %d (no open)", pl->out_fd);
+  return 1;
+}
+
+/* *
+ * Returns - The handler of the builtin called name, if it can run as a pipeline stage, or NULL.
+ *           A stage builtin must not read its input, since the input of a chained stage is not
+ *           connected to anything.
+ * */
+static builtin_handler stage_builtin(const char *name) {
+  const struct command *c;
+  // A function of the same name takes the place of the builtin.
+  if((c = command_lookup(name)) != NULL && c->func != NULL)
+    return NULL;
+  if(strcmp(name, "pwd") == 0)
+    return pwd_handle;
+  if(strcmp(name, "read") == 0 || strcmp(name, "mapfile") == 0 || strcmp(name, "readarray") == 0)
+    return NULL;
+  return builtin_lookup(name);
+}
+
+/* *
+ * Removes stage i from pl.
+ * */
+static void remove_stage(struct pipeline *pl, size_t i) {
+  mem_free(MEM_EXEC, pl->stages[i].argv);
+  memmove(&pl->stages[i], &pl->stages[i + 1], (pl->num_stages - i - 1) * sizeof(*pl->stages));
+  pl->num_stages--;
+}
+
+/* *
+ * Reports a rewrite, described by fmt, in verbose mode, in the trace, and to note.
+ * */
+static void rewrite(void (*note)(const char *rewrite), const char *fmt, ...) {
+  char desc[REWRITE_SIZE];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(desc, sizeof(desc), fmt, args);
+  va_end(args);
+  if(VERBOSE(V_PARSE))
+    printf("Optimizer:  %s\n", desc);
+  TRACE_MARK("rewrite", "opt", desc);
+  if(note != NULL)
+    note(desc);
+}
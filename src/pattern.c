@@ -0,0 +1,498 @@
+/* *
+ * pattern.c
+ *
+ * Shell pattern matching: *, ?, [...] bracket expressions (with ranges, [:class:]es, and ! or ^
+ * to negate), and \ to quote the next character.
+ *
+ * A pattern is compiled into a list of elements (runs of literal characters, ?, sets, and *),
+ * and matched by walking the list with the string, going back to the last * whenever an element
+ * does not match.  Every element but * matches a fixed number of characters, so a pattern without
+ * a * can only match strings of one length, which is all that the prefix and suffix searches
+ * below try.  Compiled patterns are cached on their text, like compiled arithmetic (see arith.c.)
+ *
+ * Regular expressions (for =~ of [[ ]]) are compiled with regcomp, which costs far more than
+ * matching one line, so they are kept in a cache of their own, keyed on their text.  It holds
+ * the REGEX_CACHE_SIZE most recently used, so a loop that tests a few regexes against many
+ * lines compiles each once, however many other regexes come and go.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "pattern.h"
+#include "tinysh.h"
+#include "mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define PATTERN_BUCKETS     64   // Buckets of the cache.  Must be a power of two.
+#define PATTERN_CACHE_LIMIT 256  // Most patterns kept in the cache.
+#define REGEX_CACHE_SIZE    32   // Most regexes kept compiled.  The least recently used goes first.
+
+#define SET_HAS(set, c) ((set)[(unsigned char) (c) >> 3] & (1 << ((unsigned char) (c) & 7)))
+#define SET_ADD(set, c) ((set)[(unsigned char) (c) >> 3] |= 1 << ((unsigned char) (c) & 7))
+
+enum {
+  PAT_LITERAL,  // The len characters at lit.
+  PAT_ANY,      // Any one character.
+  PAT_SET,      // One character in set.
+  PAT_STAR      // Any characters.
+};
+
+/*
+ * An element of a compiled pattern.
+ */
+struct pat_elem {
+  int kind;
+  const char *lit;
+  size_t len;
+  unsigned char set[32];  // Bitmap of the characters of a PAT_SET.
+};
+
+/*
+ * A compiled pattern, in the cache.
+ */
+struct pattern {
+  char *text;              // Text of the pattern.
+  size_t text_len;
+  struct pat_elem *elems;
+  size_t num_elems;
+  char *lits;              // The literal characters of the elements, with quoting removed.
+  size_t min_len;          // Length of the shortest string the pattern matches.
+  int has_star;            // 1 if the pattern matches strings longer than min_len.
+  struct pattern *next;    // Next pattern in the same bucket.
+};
+
+/*
+ * A compiled regex, in the cache.
+ */
+struct regex_entry {
+  char *text;
+  regex_t re;
+  unsigned long bucket;
+  struct regex_entry *next;    // Next regex in the same bucket.
+  struct regex_entry *newer;   // Neighbours in the order of use.
+  struct regex_entry *older;
+};
+
+/*
+ * Character classes of bracket expressions.
+ */
+static const struct {
+  const char *name;
+  int (*is)(int c);
+} classes[] = {
+  {"alnum", isalnum}, {"alpha", isalpha}, {"blank", isblank}, {"cntrl", iscntrl},
+  {"digit", isdigit}, {"graph", isgraph}, {"lower", islower}, {"print", isprint},
+  {"punct", ispunct}, {"space", isspace}, {"upper", isupper}, {"xdigit", isxdigit}, {NULL, NULL}
+};
+
+static struct pattern *cache[PATTERN_BUCKETS];
+static size_t cached;
+static struct regex_entry *regexes[PATTERN_BUCKETS];
+static struct regex_entry *newest, *oldest;
+static size_t num_regexes;
+
+static struct pattern* compile(const char *text, size_t len);
+static size_t parse_set(const char *text, size_t len, unsigned char *set);
+static int fits_end(const struct pat_elem *elem, const char *str, size_t len);
+static void pattern_free(struct pattern *pat);
+static void regex_use(struct regex_entry *entry);
+static void regex_drop(struct regex_entry *entry);
+static unsigned long pattern_hash(const char *text, size_t len);
+
+/* *
+ * Compiles the pattern made of the len characters of text, or finds it in the cache.
+ *
+ * Returns - The compiled pattern, valid until the next call, or NULL if it could not be compiled.
+ * */
+const struct pattern* pattern_compile(const char *text, size_t len) {
+  unsigned long bucket;
+  struct pattern *pat;
+
+  bucket = pattern_hash(text, len) & (PATTERN_BUCKETS - 1);
+  for(pat = cache[bucket]; pat != NULL; pat = pat->next) {
+    if(pat->text_len == len && memcmp(pat->text, text, len) == 0)
+      return pat;
+  }
+  if(cached >= PATTERN_CACHE_LIMIT)
+    pattern_clear();
+  if((pat = compile(text, len)) == NULL)
+    return NULL;
+  pat->next = cache[bucket];
+  cache[bucket] = pat;
+  cached++;
+  return pat;
+}
+
+/* *
+ * Returns - 1 if pat matches all len characters of str, 0 otherwise.
+ * */
+int pattern_match(const struct pattern *pat, const char *str, size_t len) {
+  size_t e, s, star_e, star_s;
+  const struct pat_elem *elem;
+
+  if(len < pat->min_len || (!pat->has_star && len != pat->min_len))
+    return 0;
+  // Reject on the last element first: the searches below try many strings that end differently.
+  if(pat->num_elems > 0 && !fits_end(&pat->elems[pat->num_elems - 1], str, len))
+    return 0;
+  e = s = 0;
+  star_e = pat->num_elems;
+  star_s = 0;
+  while(e < pat->num_elems || s < len) {
+    if(e < pat->num_elems) {
+      elem = &pat->elems[e];
+      if(elem->kind == PAT_STAR) {
+        // Try the * on nothing first, and on one more character each time the rest fails.
+        star_e = e++;
+        star_s = s;
+        continue;
+      }
+      if(elem->kind == PAT_LITERAL && elem->len <= len - s
+         && memcmp(str + s, elem->lit, elem->len) == 0) {
+        e++;
+        s += elem->len;
+        continue;
+      }
+      if(s < len && (elem->kind == PAT_ANY || (elem->kind == PAT_SET && SET_HAS(elem->set, str[s])))) {
+        e++;
+        s++;
+        continue;
+      }
+    }
+    if(star_e == pat->num_elems || star_s >= len)
+      return 0;
+    e = star_e + 1;
+    s = ++star_s;
+  }
+  return 1;
+}
+
+/* *
+ * Finds the shortest (or longest, if longest is 1) prefix of the len characters of str that pat
+ * matches, and stores its length in match_len.
+ *
+ * Returns - 1 if a prefix matches, 0 otherwise.
+ * */
+int pattern_prefix(const struct pattern *pat, const char *str, size_t len, int longest,
+                   size_t *match_len) {
+  size_t k;
+  if(pat->min_len > len)
+    return 0;
+  if(!pat->has_star) {
+    *match_len = pat->min_len;
+    return pattern_match(pat, str, pat->min_len);
+  }
+  for(k = longest ? len : pat->min_len; k >= pat->min_len && k <= len; k += longest ? -1 : 1) {
+    if(pattern_match(pat, str, k)) {
+      *match_len = k;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* *
+ * Finds the shortest (or longest, if longest is 1) suffix of the len characters of str that pat
+ * matches, and stores its length in match_len.
+ *
+ * Returns - 1 if a suffix matches, 0 otherwise.
+ * */
+int pattern_suffix(const struct pattern *pat, const char *str, size_t len, int longest,
+                   size_t *match_len) {
+  size_t k;
+  if(pat->min_len > len)
+    return 0;
+  if(!pat->has_star) {
+    *match_len = pat->min_len;
+    return pattern_match(pat, str + len - pat->min_len, pat->min_len);
+  }
+  for(k = longest ? len : pat->min_len; k >= pat->min_len && k <= len; k += longest ? -1 : 1) {
+    if(pattern_match(pat, str + len - k, k)) {
+      *match_len = k;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* *
+ * Finds the first, longest substring of the len characters of str that pat matches, and stores
+ * where it starts in start and its length in match_len.
+ *
+ * Returns - 1 if a substring matches, 0 otherwise.
+ * */
+int pattern_find(const struct pattern *pat, const char *str, size_t len, size_t *start,
+                 size_t *match_len) {
+  size_t i;
+  for(i = 0; i + pat->min_len <= len; i++) {
+    if(pattern_prefix(pat, str + i, len - i, 1, match_len)) {
+      *start = i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* *
+ * Compiles the extended regular expression text, or finds it in the cache.  If it does not
+ * compile, the reason is stored in the size bytes of error.
+ *
+ * Returns - The compiled regex, valid until the next call, or NULL if it could not be compiled.
+ * */
+const regex_t* pattern_regex(const char *text, char *error, size_t size) {
+  unsigned long bucket;
+  struct regex_entry *entry;
+  int status;
+
+  bucket = pattern_hash(text, strlen(text)) & (PATTERN_BUCKETS - 1);
+  for(entry = regexes[bucket]; entry != NULL; entry = entry->next) {
+    if(strcmp(entry->text, text) == 0) {
+      regex_use(entry);
+      return &entry->re;
+    }
+  }
+  if(num_regexes >= REGEX_CACHE_SIZE)
+    regex_drop(oldest);
+  if((entry = mem_calloc(MEM_VARS, 1, sizeof(*entry))) == NULL
+     || (entry->text = mem_strdup(MEM_VARS, text)) == NULL) {
+    snprintf(error, size, "out of memory");
+    mem_free(MEM_VARS, entry);
+    return NULL;
+  }
+  if((status = regcomp(&entry->re, text, REG_EXTENDED)) != 0) {
+    regerror(status, &entry->re, error, size);
+    mem_free(MEM_VARS, entry->text);
+    mem_free(MEM_VARS, entry);
+    return NULL;
+  }
+  if(VERBOSE_AT(V_LEVEL_DETAILS, V_PARSE))
+    printf("  Compiled the regex %s.\n", text);
+  entry->bucket = bucket;
+  entry->next = regexes[bucket];
+  regexes[bucket] = entry;
+  num_regexes++;
+  regex_use(entry);
+  return &entry->re;
+}
+
+/* *
+ * Forgets every compiled pattern and regex.
+ * */
+void pattern_clear(void) {
+  size_t i;
+  struct pattern *pat, *next;
+  for(i = 0; i < PATTERN_BUCKETS; i++) {
+    for(pat = cache[i]; pat != NULL; pat = next) {
+      next = pat->next;
+      pattern_free(pat);
+    }
+    cache[i] = NULL;
+  }
+  cached = 0;
+  while(oldest != NULL)
+    regex_drop(oldest);
+}
+
+/* *
+ * Compiles the len characters of text.
+ *
+ * Returns - The compiled pattern, or NULL if it could not be allocated.
+ * */
+static struct pattern* compile(const char *text, size_t len) {
+  size_t i, used, num_lits;
+  struct pattern *pat;
+  struct pat_elem *elem;
+
+  if((pat = mem_calloc(MEM_VARS, 1, sizeof(*pat))) == NULL
+     || (pat->text = mem_malloc(MEM_VARS, len + 1)) == NULL
+     || (pat->lits = mem_malloc(MEM_VARS, len + 1)) == NULL
+     || (pat->elems = mem_malloc(MEM_VARS, (len + 1) * sizeof(*pat->elems))) == NULL) {
+    perror("Error allocating memory for a pattern.");
+    pattern_free(pat);
+    return NULL;
+  }
+  memcpy(pat->text, text, len);
+  pat->text[len] = '\0';
+  pat->text_len = len;
+
+  for(i = 0, used = 0, num_lits = 0; i < len; i++) {
+    elem = pat->num_elems > 0 ? &pat->elems[pat->num_elems - 1] : NULL;
+    if(text[i] == '*') {
+      if(elem == NULL || elem->kind != PAT_STAR)
+        pat->elems[pat->num_elems++].kind = PAT_STAR;
+      pat->has_star = 1;
+      continue;
+    }
+    if(text[i] == '?') {
+      pat->elems[pat->num_elems++].kind = PAT_ANY;
+      pat->min_len++;
+      continue;
+    }
+    if(text[i] == '[') {
+      elem = &pat->elems[pat->num_elems];
+      memset(elem->set, 0, sizeof(elem->set));
+      if((used = parse_set(text + i, len - i, elem->set)) > 0) {
+        elem->kind = PAT_SET;
+        pat->num_elems++;
+        pat->min_len++;
+        i += used - 1;
+        continue;
+      }
+      // A [ without a closing ] is an ordinary character.
+      elem = pat->num_elems > 0 ? &pat->elems[pat->num_elems - 1] : NULL;
+    }
+    else if(text[i] == '\\' && i + 1 < len) {
+      i++;
+    }
+    // Literal characters are added to the run before them, if there is one.
+    if(elem == NULL || elem->kind != PAT_LITERAL) {
+      elem = &pat->elems[pat->num_elems++];
+      elem->kind = PAT_LITERAL;
+      elem->lit = pat->lits + num_lits;
+      elem->len = 0;
+    }
+    pat->lits[num_lits++] = text[i];
+    elem->len++;
+    pat->min_len++;
+  }
+  return pat;
+}
+
+/* *
+ * Parses the bracket expression at the start of the len characters of text into set.
+ *
+ * Returns - The length of the bracket expression, or 0 if it has no closing ].
+ * */
+static size_t parse_set(const char *text, size_t len, unsigned char *set) {
+  size_t i, j, k;
+  int negate, c, hi;
+
+  i = 1;
+  negate = i < len && (text[i] == '!' || text[i] == '^');
+  if(negate)
+    i++;
+  for(j = i; j < len; j++) {
+    // A ] right after the [ (or the !) is an ordinary character.
+    if(text[j] == ']' && j > i)
+      break;
+    if(text[j] == '[' && j + 1 < len && text[j + 1] == ':') {
+      for(k = j + 2; k + 1 < len && !(text[k] == ':' && text[k + 1] == ']'); k++)
+        ;
+      for(c = 0; classes[c].name != NULL; c++) {
+        if(strlen(classes[c].name) == k - j - 2 && strncmp(classes[c].name, text + j + 2, k - j - 2)
+           == 0)
+          break;
+      }
+      if(k + 1 < len && classes[c].name != NULL) {
+        for(hi = 1; hi < 256; hi++) {
+          if(classes[c].is(hi))
+            SET_ADD(set, hi);
+        }
+        j = k + 1;
+        continue;
+      }
+    }
+    if(text[j] == '\\' && j + 1 < len)
+      j++;
+    c = (unsigned char) text[j];
+    if(j + 2 < len && text[j + 1] == '-' && text[j + 2] != ']') {
+      hi = (unsigned char) text[j + 2];
+      for(; c <= hi; c++)
+        SET_ADD(set, c);
+      j += 2;
+      continue;
+    }
+    SET_ADD(set, c);
+  }
+  if(j >= len)
+    return 0;
+  if(negate) {
+    for(k = 0; k < 32; k++)
+      set[k] = ~set[k];
+  }
+  return j + 1;
+}
+
+/* *
+ * Returns - 0 if the len characters of str cannot end with a match of elem, 1 otherwise.
+ * */
+static int fits_end(const struct pat_elem *elem, const char *str, size_t len) {
+  if(elem->kind == PAT_LITERAL)
+    return elem->len <= len && memcmp(str + len - elem->len, elem->lit, elem->len) == 0;
+  if(elem->kind == PAT_SET)
+    return len > 0 && SET_HAS(elem->set, str[len - 1]);
+  return 1;
+}
+
+/* *
+ * Frees the compiled pattern pat.
+ * */
+static void pattern_free(struct pattern *pat) {
+  if(pat == NULL)
+    return;
+  mem_free(MEM_VARS, pat->text);
+  mem_free(MEM_VARS, pat->lits);
+  mem_free(MEM_VARS, pat->elems);
+  mem_free(MEM_VARS, pat);
+}
+
+/* *
+ * Moves entry, which may be new, to the most recently used end of the order of use.
+ * */
+static void regex_use(struct regex_entry *entry) {
+  if(entry == newest)
+    return;
+  if(entry->newer != NULL)
+    entry->newer->older = entry->older;
+  if(entry->older != NULL)
+    entry->older->newer = entry->newer;
+  if(entry == oldest)
+    oldest = entry->newer;
+  entry->newer = NULL;
+  entry->older = newest;
+  if(newest != NULL)
+    newest->newer = entry;
+  newest = entry;
+  if(oldest == NULL)
+    oldest = entry;
+}
+
+/* *
+ * Removes entry from the cache and frees it.
+ * */
+static void regex_drop(struct regex_entry *entry) {
+  struct regex_entry **link;
+  for(link = &regexes[entry->bucket]; *link != entry; link = &(*link)->next)
+    ;
+  *link = entry->next;
+  if(entry->newer != NULL)
+    entry->newer->older = entry->older;
+  else
+    newest = entry->older;
+  if(entry->older != NULL)
+    entry->older->newer = entry->newer;
+  else
+    oldest = entry->newer;
+  regfree(&entry->re);
+  mem_free(MEM_VARS, entry->text);
+  mem_free(MEM_VARS, entry);
+  num_regexes--;
+}
+
+/* *
+ * FNV-1a hash of the len characters of a pattern.
+ * */
+static unsigned long pattern_hash(const char *text, size_t len) {
+  unsigned long h = 14695981039346656037UL;
+  while(len-- > 0) {
+    h ^= (unsigned char) *text++;
+    h *= 1099511628211UL;
+  }
+  return h;
+}
@@ -0,0 +1,490 @@
+/* *
+ * pipeline.c
+ *
+ * Flat pipeline execution, and the time builtin built on it.
+ *
+ * The shell's usual pipe handling (pipe_handle) is recursive: each pipe splits the line in two,
+ * and each half runs in its own subtree of processes.  That keeps the control flow easy to
+ * follow in verbose mode, but it hides the individual stages from the shell.  Here a line is
+ * instead parsed into a flat list of stages, every stage is forked directly by the shell with its
+ * pipes already connected, and every stage is reaped with wait4, so that the shell knows exactly
+ * when each stage finished and what it cost.
+ *
+ * The optimizer (see optimize.c) runs some lines here as well, since its rewrites (an input file
+ * in place of a cat, builtins run in a stage's process, a cached descriptor for the output) are
+ * only expressible on the flat list of stages.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "pipeline.h"
+#include "tinysh.h"
+#include "cmdhash.h"
+#include "stats.h"
+#include "trace.h"
+#include "mem.h"
+#include "optimize.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#define READ_END  0
+#define WRITE_END 1
+
+static void run_stage(struct pipeline *pl, size_t i, int in_fd, int out_fd);
+static void run_chain(struct pipeline *pl, size_t first, size_t i);
+static int stage_open(const char *file, int flags);
+static void stage_dup2(int fd, int target, int close_fd, const char *name);
+static size_t num_args(char **argv);
+static int reap_stages(struct pipeline *pl);
+static struct stage* find_stage(struct pipeline *pl, pid_t pid);
+static double tv_seconds(const struct timeval *tv);
+
+/* *
+ * Parses the command line cmds into pl.  The stages' arguments point into cmds, so cmds must
+ * outlive pl.  Errors are printed unless quiet is 1.
+ *
+ * Returns - 0 on success, or -1 if the line is not a valid pipeline.
+ * */
+int pipeline_parse(char **cmds, struct pipeline *pl, int quiet) {
+  size_t i, j, start, num;
+
+  memset(pl, 0, sizeof(*pl));
+  pl->out_fd = -1;
+  for(num = 0; cmds[num] != NULL; num++)
+    ;
+  // A redirection may only appear once, at the end of the line.
+  for(i = 0; i < num; i++) {
+    if(strcmp(cmds[i], ">") == 0 || strcmp(cmds[i], ">>") == 0) {
+      if(i + 2 != num || strcmp(cmds[i + 1], "|") == 0) {
+        if(!quiet)
+          fprintf(stderr, "Error:  A redirection must be followed by exactly one file name.\n");
+        return -1;
+      }
+      pl->out_file = cmds[i + 1];
+      pl->append = cmds[i][1] == '>';
+      num = i;
+      break;
+    }
+  }
+
+  // Count the stages, then collect each one's arguments.
+  pl->num_stages = 1;
+  for(i = 0; i < num; i++) {
+    if(strcmp(cmds[i], "|") == 0)
+      pl->num_stages++;
+  }
+  if((pl->stages = mem_calloc(MEM_EXEC, pl->num_stages, sizeof(*pl->stages))) == NULL) {
+    perror("Error allocating memory for a pipeline.");
+    return -1;
+  }
+  start = 0;
+  pl->num_stages = 0;
+  for(i = 0; i <= num; i++) {
+    if(i < num && strcmp(cmds[i], "|") != 0)
+      continue;
+    if((pl->stages[pl->num_stages].argv = mem_malloc(MEM_EXEC, (i - start + 1) * sizeof(char *)))
+       == NULL) {
+      perror("Error allocating memory for a pipeline.");
+      pipeline_free(pl);
+      return -1;
+    }
+    // Copy the stage's arguments, taking out an input redirection, which only the first stage
+    // may have.
+    for(j = 0; start < i; start++) {
+      if(strcmp(cmds[start], "<") != 0) {
+        pl->stages[pl->num_stages].argv[j++] = cmds[start];
+        continue;
+      }
+      if(pl->num_stages > 0 || pl->in_file != NULL || start + 1 == i) {
+        if(!quiet)
+          fprintf(stderr, "Error:  Only the first command may read from a file, with < file.\n");
+        pl->num_stages++;
+        pipeline_free(pl);
+        return -1;
+      }
+      pl->in_file = cmds[++start];
+    }
+    pl->stages[pl->num_stages].argv[j] = NULL;
+    pl->num_stages++;
+    if(j == 0) {
+      if(!quiet)
+        fprintf(stderr, "Error:  Missing command in pipeline.\n");
+      pipeline_free(pl);
+      return -1;
+    }
+    start = i + 1;
+  }
+  return 0;
+}
+
+/* *
+ * Runs every stage of pl concurrently, each connected to the next by a pipe, and waits for all of
+ * them, filling in each stage's pid, status, end time, and resource usage.
+ *
+ * Returns - The wait status of the last stage (or 0, if the optimizer dropped a cat that would have
+ *           been the last), or -1 if the pipeline could not be started.
+ * */
+int pipeline_run(struct pipeline *pl) {
+  size_t i;
+  int in_fd, pipefd[2], status;
+  uint64_t start;
+
+  // Builtin stages write with stdio, so nothing the shell has buffered may be left for them to
+  // inherit.
+  fflush(stdout);
+  pl->start_ns = stats_now();
+  in_fd = -1;
+  for(i = 0; i < pl->num_stages; i++) {
+    // A chained stage runs in the process of the stage after it, which inherits its input.
+    if(pl->stages[i].chained)
+      continue;
+    pipefd[READ_END] = pipefd[WRITE_END] = -1;
+    if(i + 1 < pl->num_stages) {
+      TRACE_BEGIN(start);
+      if(pipe(pipefd) < 0) {
+        perror("Error creating pipe.");
+        break;
+      }
+      TRACE_END("pipe", "fd", start, pl->stages[i].argv[0]);
+      if(VERBOSE(V_FD))
+        printf("  Creating a pipe from %s to %s.\n", pl->stages[i].argv[0],
+               pl->stages[i + 1].argv[0]);
+    }
+
+    TRACE_BEGIN(start);
+    if((pl->stages[i].pid = fork()) < 0) {
+      perror("Error forking a process.");
+      pl->stages[i].pid = 0;
+      if(pipefd[READ_END] >= 0) {
+        close(pipefd[READ_END]);
+        close(pipefd[WRITE_END]);
+      }
+      break;
+    }
+    // Stage process.
+    if(pl->stages[i].pid == 0) {
+      if(pipefd[READ_END] >= 0)
+        close(pipefd[READ_END]);
+      run_stage(pl, i, in_fd, pipefd[WRITE_END]);
+    }
+    TRACE_END("fork", "proc", start, pl->stages[i].argv[0]);
+    if(VERBOSE(V_PROC))
+      printf("  Created process %d for stage %zu:  %s\n", (int) pl->stages[i].pid, i + 1,
+             pl->stages[i].argv[0]);
+
+    // The stages hold their own copies of the pipe ends now.
+    if(in_fd >= 0)
+      close(in_fd);
+    if(pipefd[WRITE_END] >= 0)
+      close(pipefd[WRITE_END]);
+    in_fd = pipefd[READ_END];
+  }
+  if(in_fd >= 0)
+    close(in_fd);
+
+  if(i < pl->num_stages) {
+    // Let whatever was started finish, but report the pipeline as failed.
+    reap_stages(pl);
+    return -1;
+  }
+  status = reap_stages(pl);
+  // The cat would have ended the line successfully, whatever the stage before it did.
+  return pl->dropped_cat ? 0 : status;
+}
+
+/* *
+ * Frees the stage list of pl.
+ * */
+void pipeline_free(struct pipeline *pl) {
+  size_t i;
+  for(i = 0; pl->stages != NULL && i < pl->num_stages; i++)
+    mem_free(MEM_EXEC, pl->stages[i].argv);
+  mem_free(MEM_EXEC, pl->stages);
+  pl->stages = NULL;
+  pl->num_stages = 0;
+}
+
+/* *
+ * Runs pl as a command line of the shell, in place of exec_dispatch, recording its statistics
+ * under the name of its first command.
+ *
+ * Returns - The status of the line (0 on success, -1 on failure.)
+ * */
+int pipeline_dispatch(struct pipeline *pl) {
+  size_t i;
+  int status;
+  struct stats_sample sample;
+
+  // Resolve the stages before forking, so that the results stay in the shell's hash.
+  for(i = 0; i < pl->num_stages; i++) {
+    if(pl->stages[i].builtin == NULL)
+      cmdhash_lookup(pl->stages[i].argv[0]);
+  }
+  if((status = pipeline_run(pl)) == -1) {
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  memset(&sample, 0, sizeof(sample));
+  for(i = 0; i < pl->num_stages; i++) {
+    sample.usage.ru_utime.tv_sec += pl->stages[i].usage.ru_utime.tv_sec;
+    sample.usage.ru_utime.tv_usec += pl->stages[i].usage.ru_utime.tv_usec;
+    sample.usage.ru_stime.tv_sec += pl->stages[i].usage.ru_stime.tv_sec;
+    sample.usage.ru_stime.tv_usec += pl->stages[i].usage.ru_stime.tv_usec;
+  }
+  // As with the zygote, the time each stage took to start is not known, only the total.
+  sample.spawn_ns = sample.wall_ns = pl->end_ns - pl->start_ns;
+  stats_record(pl->stages[0].argv[0], &sample);
+  return wait_status_handle(status);
+}
+
+/* *
+ * Handler for the time builtin.
+ *
+ * time cmd1 [| cmd2 ...] [> file]
+ *
+ * Runs the pipeline and reports its total wall, user, and system time on stderr, followed by the
+ * wall time, CPU time, context switches, and maximum resident set size of each stage.
+ * */
+int time_handle(char **cmd, size_t num_cmd) {
+  size_t i;
+  int status;
+  double user, sys;
+  struct pipeline pl;
+  struct stage *st;
+
+  if(num_cmd < 2) {
+    printf("Error:  Missing command.\nUsage: time cmd [| cmd ...] [> file]\n");
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  if(pipeline_parse(cmd + 1, &pl, 0) == -1) {
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  // Resolve the stages before forking, so that the results stay in the shell's hash.
+  cmdhash_warm(cmd + 1);
+  if((status = pipeline_run(&pl)) == -1) {
+    pipeline_free(&pl);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+
+  user = sys = 0;
+  for(i = 0; i < pl.num_stages; i++) {
+    user += tv_seconds(&pl.stages[i].usage.ru_utime);
+    sys += tv_seconds(&pl.stages[i].usage.ru_stime);
+  }
+  fprintf(stderr, "\nreal\t%.3fs\nuser\t%.3fs\nsys\t%.3fs\n",
+          (pl.end_ns - pl.start_ns) / 1e9, user, sys);
+  fprintf(stderr, "\nstage  %-16s %9s %9s %9s %7s %7s %9s\n",
+          "command", "real", "user", "sys", "vcsw", "ivcsw", "maxrss");
+  for(i = 0; i < pl.num_stages; i++) {
+    st = &pl.stages[i];
+    fprintf(stderr, "%5zu  %-16.16s %8.3fs %8.3fs %8.3fs %7ld %7ld %8ldK\n",
+            i + 1, st->argv[0], (st->end_ns - pl.start_ns) / 1e9,
+            tv_seconds(&st->usage.ru_utime), tv_seconds(&st->usage.ru_stime),
+            st->usage.ru_nvcsw, st->usage.ru_nivcsw, st->usage.ru_maxrss);
+  }
+  pipeline_free(&pl);
+  return wait_status_handle(status);
+}
+
+/* *
+ * Sets up the file descriptors of stage i in its freshly forked process and executes it.  in_fd
+ * and out_fd are the pipe ends to read from and write to, or -1 for the shell's own.  Any stages
+ * chained to stage i are run first, and a builtin stage is run without executing anything.
+ * */
+static void run_stage(struct pipeline *pl, size_t i, int in_fd, int out_fd) {
+  int status;
+  size_t first;
+
+  for(first = i; first > 0 && pl->stages[first - 1].chained; first--)
+    ;
+  if(in_fd >= 0)
+    stage_dup2(in_fd, STDIN_FILENO, 1, "pipe read end");
+  else if(first == 0 && pl->in_file != NULL)
+    stage_dup2(stage_open(pl->in_file, O_RDONLY), STDIN_FILENO, 1, "input file");
+  if(out_fd >= 0)
+    stage_dup2(out_fd, STDOUT_FILENO, 1, "pipe write end");
+  else if(pl->out_fd >= 0)
+    // The cached descriptor is close-on-exec, so only the copy on stdout outlives the exec.
+    stage_dup2(pl->out_fd, STDOUT_FILENO, 0, "cached descriptor");
+  else if(pl->out_file != NULL)
+    stage_dup2(stage_open(pl->out_file, O_CREAT | O_WRONLY | (pl->append ? O_APPEND : O_TRUNC)),
+               STDOUT_FILENO, 1, "output file");
+  run_chain(pl, first, i);
+  if(pl->stages[i].builtin != NULL) {
+    // Builtins such as test record an exit status of their own; the others only succeed or fail.
+    last_status = EXIT_SUCCESS;
+    status = pl->stages[i].builtin(pl->stages[i].argv, num_args(pl->stages[i].argv));
+    if(status == -1 && last_status == EXIT_SUCCESS)
+      last_status = EXIT_FAILURE;
+    fflush(stdout);
+    _Exit(last_status);
+  }
+  exec(pl->stages[i].argv);
+  _Exit(EXIT_FAILURE);
+}
+
+/* *
+ * Runs the builtin stages first to i - 1, which are chained to stage i, in the process of stage
+ * i.  None of the builtins the optimizer chains read their input, so the output each would have
+ * piped to the next is discarded instead, and the stages after the first read an empty pipe in
+ * place of it.
+ * */
+static void run_chain(struct pipeline *pl, size_t first, size_t i) {
+  int saved, pipefd[2];
+  size_t j;
+  if(first == i)
+    return;
+  fflush(stdout);
+  if((saved = dup(STDOUT_FILENO)) < 0) {
+    perror("Error duplicating file descriptor.");
+    _Exit(EXIT_FAILURE);
+  }
+  stage_dup2(optimize_devnull(), STDOUT_FILENO, 0, "/dev/null");
+  for(j = first; j < i; j++) {
+    if(VERBOSE(V_PROC))
+      fprintf(stderr, "  Running %s in the process of %s.\n", pl->stages[j].argv[0],
+              pl->stages[i].argv[0]);
+    pl->stages[j].builtin(pl->stages[j].argv, num_args(pl->stages[j].argv));
+    fflush(stdout);
+    if(j > first)
+      continue;
+    if(pipe(pipefd) < 0) {
+      perror("Error creating pipe.");
+      _Exit(EXIT_FAILURE);
+    }
+    close(pipefd[WRITE_END]);
+    stage_dup2(pipefd[READ_END], STDIN_FILENO, 1, "empty pipe");
+  }
+  stage_dup2(saved, STDOUT_FILENO, 1, "saved stdout");
+}
+
+/* *
+ * Opens file with flags in a stage process, exiting the process on an error.
+ *
+ * Returns - The new descriptor.
+ * */
+static int stage_open(const char *file, int flags) {
+  int fd;
+  uint64_t start;
+  TRACE_BEGIN(start);
+  if((fd = open(file, flags, 0666)) < 0) {
+    perror("Error opening file.");
+    _Exit(EXIT_FAILURE);
+  }
+  TRACE_END("open", "fd", start, file);
+  return fd;
+}
+
+/* *
+ * Points stdin or stdout (target) of a stage process at fd, then closes fd unless close_fd is 0,
+ * exiting the process on an error.  name describes fd for the trace.
+ * */
+static void stage_dup2(int fd, int target, int close_fd, const char *name) {
+  char detail[64];
+  uint64_t start;
+  TRACE_BEGIN(start);
+  if(dup2(fd, target) < 0) {
+    perror("Error duplicating file descriptor.");
+    _Exit(EXIT_FAILURE);
+  }
+  snprintf(detail, sizeof(detail), "%s -> %s", name, target == STDIN_FILENO ? "stdin" : "stdout");
+  TRACE_END("dup2", "fd", start, detail);
+  if(!close_fd)
+    return;
+  TRACE_BEGIN(start);
+  close(fd);
+  TRACE_END("close", "fd", start, name);
+}
+
+/* *
+ * Returns - The number of arguments in the null-terminated list argv.
+ * */
+static size_t num_args(char **argv) {
+  size_t num;
+  for(num = 0; argv[num] != NULL; num++)
+    ;
+  return num;
+}
+
+/* *
+ * Waits for every started stage of pl, in the order they finish.
+ *
+ * Returns - The wait status of the last stage.
+ * */
+static int reap_stages(struct pipeline *pl) {
+  size_t i, remaining;
+  uint64_t start;
+  siginfo_t info;
+  struct stage *st;
+
+  remaining = 0;
+  for(i = 0; i < pl->num_stages; i++) {
+    if(pl->stages[i].pid > 0)
+      remaining++;
+  }
+  fflush(stdout);
+  TRACE_BEGIN(start);
+  while(remaining > 0) {
+    // Find out which child finished first without reaping it, so that the shell's other children
+    // (e.g. the zygote) are left alone.
+    memset(&info, 0, sizeof(info));
+    if(waitid(P_ALL, 0, &info, WEXITED | WNOWAIT) < 0) {
+      if(errno == EINTR)
+        continue;
+      perror("Error waiting for a process.");
+      break;
+    }
+    if((st = find_stage(pl, info.si_pid)) == NULL) {
+      // Someone else's child; fall back to reaping the stages in order.
+      for(i = 0; i < pl->num_stages; i++) {
+        st = &pl->stages[i];
+        if(st->pid > 0 && st->end_ns == 0) {
+          while(wait4(st->pid, &st->status, 0, &st->usage) < 0 && errno == EINTR)
+            ;
+          st->end_ns = stats_now();
+        }
+      }
+      break;
+    }
+    while(wait4(st->pid, &st->status, 0, &st->usage) < 0 && errno == EINTR)
+      ;
+    st->end_ns = stats_now();
+    remaining--;
+    if(VERBOSE(V_PROC))
+      printf("  Stage %zu (%s) terminated.\n", (size_t) (st - pl->stages) + 1, st->argv[0]);
+  }
+  TRACE_END("wait", "proc", start, pl->stages[0].argv[0]);
+  pl->end_ns = stats_now();
+  return pl->stages[pl->num_stages - 1].status;
+}
+
+/* *
+ * Returns - The unreaped stage of pl running as pid, or NULL if there is none.
+ * */
+static struct stage* find_stage(struct pipeline *pl, pid_t pid) {
+  size_t i;
+  for(i = 0; i < pl->num_stages; i++) {
+    if(pl->stages[i].pid == pid && pl->stages[i].end_ns == 0)
+      return &pl->stages[i];
+  }
+  return NULL;
+}
+
+/* *
+ * Returns - tv in seconds.
+ * */
+static double tv_seconds(const struct timeval *tv) {
+  return tv->tv_sec + tv->tv_usec / 1e6;
+}
@@ -0,0 +1,605 @@
+/* *
+ * read.c
+ *
+ * The read and mapfile builtins, which set variables from the lines of a file descriptor.
+ *
+ * read must leave the descriptor just past the line it took, since whatever runs next (another
+ * read, or a program the shell starts) reads on from there.  How it does that depends on what the
+ * descriptor is:
+ *   - Standard input is read through stdio, sharing the buffer the shell reads its own command
+ *     lines from, so a script on standard input can read the lines that follow it.  While a
+ *     command's input is redirected in the shell process (see redirect.c), standard input is read
+ *     like any other descriptor instead, leaving the shell's buffer alone.
+ *   - A regular file is read a block at a time with pread, which does not move the descriptor,
+ *     and the block is kept for the next read.  Each read then moves the descriptor past the
+ *     bytes it used with a single lseek, whose result also tells whether anything else moved it
+ *     in between (in which case the block is dropped and read again.)  A read of a line from a
+ *     file thus costs one system call, rather than one per byte.
+ *   - Anything else (a pipe, a terminal, a socket) cannot be read ahead of the line and put back,
+ *     so it is read a byte at a time.
+ * mapfile reads everything up to the end of the input with large reads, then finds the lines in
+ * one pass with memchr and makes the buffer itself the storage of the array (see vars.c), so no
+ * line is copied.
+ *
+ * NOTES:
+ *   - The block kept for a regular file is trusted to match the file; a file rewritten in place
+ *     between two reads (rather than appended to) may be read from the old block.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "read.h"
+#include "vars.h"
+#include "tinysh.h"
+#include "writer.h"
+#include "mem.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define READ_BLOCK_SIZE     65536  // Bytes read ahead from a regular file.
+#define DEFAULT_LINE_SIZE   128    // Initial size of a line buffer.
+#define DEFAULT_IFS         " \t\n"
+
+/*
+ * A growable buffer of input.
+ */
+struct line_buf {
+  char *data;
+  size_t len;
+  size_t size;
+};
+
+/*
+ * The block read ahead from a regular file.
+ */
+struct read_cache {
+  int fd;          // Descriptor the block was read from, or -1.
+  off_t pos;       // Offset of data + start in the file, where the descriptor was left.
+  char *data;
+  size_t start;    // First byte not yet used.
+  size_t len;      // Bytes left from start.
+};
+
+static struct read_cache cache = { -1, 0, NULL, 0, 0 };
+static int stdin_redirected;  // Whether standard input is a redirection rather than the shell's.
+
+static int read_record(int fd, int delim, struct line_buf *line);
+static int read_stdio(int delim, struct line_buf *line);
+static int read_cached(int fd, int delim, struct line_buf *line);
+static int read_bytes(int fd, int delim, struct line_buf *line);
+static int read_all(int fd, struct line_buf *buf);
+static int assign_fields(const char *line, size_t len, char **names, int raw);
+static int line_append(struct line_buf *line, const char *data, size_t len);
+static int parse_fd(const char *name, const char *str, int *fd);
+
+/* *
+ * Handler for the read builtin.
+ *
+ * read [-r] [-d delim] [-p prompt] [-u fd] [name ...]
+ *
+ * Reads a line from standard input (or fd) and splits it into fields on the characters of IFS,
+ * setting each name to a field and the last name to the rest of the line.  With no names, REPLY
+ * is set to the whole line.  Unless -r is given, a backslash quotes the character after it, and a
+ * backslash at the end of the line joins the next line to it.  -d ends the line at delim rather
+ * than at a newline, and -p prints prompt on stderr first if the input is a terminal.
+ *
+ * Returns - 0 if a whole line was read, -1 at the end of the input or on an error.
+ * */
+int read_handle(char **cmd, size_t num_cmd) {
+  char **arg, *opt;
+  char *reply[] = { "REPLY", NULL };
+  const char *prompt;
+  int raw, fd, delim, found;
+  size_t start, n;
+  struct line_buf line;
+  (void) num_cmd;
+
+  raw = 0;
+  fd = STDIN_FILENO;
+  delim = '\n';
+  prompt = NULL;
+  for(arg = cmd + 1; *arg != NULL && (*arg)[0] == '-' && (*arg)[1] != '\0'; arg++) {
+    if(strcmp(*arg, "--") == 0) {
+      arg++;
+      break;
+    }
+    for(opt = *arg + 1; *opt != '\0'; opt++) {
+      if(*opt == 'r') {
+        raw = 1;
+        continue;
+      }
+      // The other options take the rest of the word, or the next word, as their value.
+      if(strchr("dpu", *opt) == NULL || (opt[1] == '\0' && arg[1] == NULL)) {
+        fprintf(stderr, "read: -%c: invalid option\n"
+                "Usage: read [-r] [-d delim] [-p prompt] [-u fd] [name ...]\n", *opt);
+        last_status = 2;
+        return -1;
+      }
+      if(*opt == 'd')
+        delim = opt[1] != '\0' ? opt[1] : (*++arg)[0];
+      else if(*opt == 'p')
+        prompt = opt[1] != '\0' ? opt + 1 : *++arg;
+      else if(parse_fd("read", opt[1] != '\0' ? opt + 1 : *++arg, &fd) == -1)
+        return -1;
+      break;
+    }
+  }
+  for(n = 0; arg[n] != NULL; n++) {
+    if(vars_name_len(arg[n]) != strlen(arg[n])) {
+      fprintf(stderr, "read: `%s': not a valid identifier\n", arg[n]);
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+  }
+
+  if(prompt != NULL && isatty(fd)) {
+    writer_puts(STDERR_FILENO, prompt);
+    writer_flush(STDERR_FILENO);
+  }
+  memset(&line, 0, sizeof(line));
+  for(;;) {
+    start = line.len;
+    if((found = read_record(fd, delim, &line)) == -1) {
+      mem_free(MEM_VARS, line.data);
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+    // An odd number of backslashes at the end of the line joins the next line to it.
+    for(n = line.len; n > start && line.data[n - 1] == '\\'; n--)
+      ;
+    if(raw || !found || (line.len - n) % 2 == 0)
+      break;
+    line.len--;
+  }
+  if(VERBOSE(V_PROC))
+    printf("Read %zu bytes from descriptor %d in the shell process.\n", line.len, fd);
+  if(assign_fields(line.data, line.len, arg[0] != NULL ? arg : reply, raw) == -1)
+    found = -1;
+  mem_free(MEM_VARS, line.data);
+  last_status = found == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+  return found == 1 ? 0 : -1;
+}
+
+/* *
+ * Handler for the mapfile builtin (also called readarray.)
+ *
+ * mapfile [-t] [-d delim] [-n count] [-s count] [-u fd] [array]
+ *
+ * Reads the lines of standard input (or fd) into the elements of array (MAPFILE by default),
+ * replacing what it held.  -t removes the newline (or delim) from the end of each element, -n
+ * reads at most count lines, and -s skips the first count lines.
+ *
+ * Returns - 0 on success, -1 on an error.
+ * */
+int mapfile_handle(char **cmd, size_t num_cmd) {
+  char **arg, *opt, **items, *data, *start, *end, *record_end, *value;
+  const char *name;
+  int strip, fd, delim, found;
+  long count, skip;
+  size_t n, num, i, len;
+  struct line_buf buf;
+  (void) num_cmd;
+
+  strip = 0;
+  fd = STDIN_FILENO;
+  delim = '\n';
+  count = skip = 0;
+  for(arg = cmd + 1; *arg != NULL && (*arg)[0] == '-' && (*arg)[1] != '\0'; arg++) {
+    if(strcmp(*arg, "--") == 0) {
+      arg++;
+      break;
+    }
+    for(opt = *arg + 1; *opt != '\0'; opt++) {
+      if(*opt == 't') {
+        strip = 1;
+        continue;
+      }
+      if(strchr("dnsu", *opt) == NULL || (opt[1] == '\0' && arg[1] == NULL)) {
+        fprintf(stderr, "%s: -%c: invalid option\n"
+                "Usage: %s [-t] [-d delim] [-n count] [-s count] [-u fd] [array]\n", cmd[0], *opt,
+                cmd[0]);
+        last_status = 2;
+        return -1;
+      }
+      value = opt[1] != '\0' ? opt + 1 : *++arg;
+      if(*opt == 'd') {
+        delim = value[0];
+      }
+      else if(*opt == 'u') {
+        if(parse_fd(cmd[0], value, &fd) == -1)
+          return -1;
+      }
+      else if((*opt == 'n' ? (count = strtol(value, &end, 10)) : (skip = strtol(value, &end, 10)))
+              < 0 || *end != '\0' || end == value) {
+        fprintf(stderr, "%s: %s: invalid line count\n", cmd[0], value);
+        last_status = EXIT_FAILURE;
+        return -1;
+      }
+      break;
+    }
+  }
+  name = *arg != NULL ? *arg : "MAPFILE";
+  if(vars_name_len(name) != strlen(name)) {
+    fprintf(stderr, "%s: `%s': not a valid identifier\n", cmd[0], name);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+
+  // Everything up to the end of the input, or just the lines asked for.
+  memset(&buf, 0, sizeof(buf));
+  if(count == 0) {
+    found = read_all(fd, &buf);
+  }
+  else {
+    for(n = 0, found = 1; found == 1 && n < (size_t) (count + skip); n++) {
+      if((found = read_record(fd, delim, &buf)) == 1)
+        found = line_append(&buf, (char *) &delim, 1) == -1 ? -1 : 1;
+    }
+  }
+  // Count the lines, so that the elements are allocated once, with room for a terminator after
+  // every line.
+  for(n = 0, data = buf.data, len = buf.len; found != -1 && len > 0; n++) {
+    if((end = memchr(data, delim, len)) == NULL)
+      end = data + len - 1;
+    len -= end + 1 - data;
+    data = end + 1;
+  }
+  num = n > (size_t) skip ? n - skip : 0;
+  if(found == -1 || (data = mem_realloc(MEM_VARS, buf.data, buf.len + num + 1)) == NULL
+     || (items = mem_malloc(MEM_VARS, (num + 1) * sizeof(*items))) == NULL) {
+    if(found != -1) {
+      perror("Error allocating memory for an array.");
+      mem_free(MEM_VARS, data);
+    }
+    else {
+      mem_free(MEM_VARS, buf.data);
+    }
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+
+  // Find where each line starts, then terminate them from the last to the first.  Each line is
+  // moved up by one byte for each line kept before it, unless its delimiter is removed and
+  // becomes its terminator.
+  for(i = 0, start = data; i < n; i++, start = end + 1) {
+    if((end = memchr(start, delim, data + buf.len - start)) == NULL)
+      end = data + buf.len - 1;
+    if(i >= (size_t) skip)
+      items[i - skip] = start;
+  }
+  for(i = num, record_end = data + buf.len; i-- > 0; record_end = start) {
+    start = items[i];
+    if(strip && record_end[-1] == delim) {
+      record_end[-1] = '\0';
+    }
+    else if(strip) {
+      *record_end = '\0';
+    }
+    else {
+      memmove(start + i, start, record_end - start);
+      start[i + (record_end - start)] = '\0';
+      items[i] = start + i;
+    }
+  }
+  if(VERBOSE(V_PROC))
+    printf("Read %zu lines (%zu bytes) from descriptor %d in the shell process.\n", n, buf.len,
+           fd);
+  if(vars_array_adopt(name, items, num, data, buf.len + num + 1) == -1) {
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  last_status = EXIT_SUCCESS;
+  return 0;
+}
+
+/* *
+ * Forgets the block read ahead from a file.
+ * */
+void read_clear(void) {
+  mem_free(MEM_VARS, cache.data);
+  memset(&cache, 0, sizeof(cache));
+  cache.fd = -1;
+}
+
+/* *
+ * Sets whether standard input is redirected in the shell process, so that read and mapfile read
+ * the descriptor directly rather than through the shell's stdio buffer.  Either way, a block read
+ * ahead from the old standard input no longer matches it, and is forgotten.
+ *
+ * Returns - whether standard input was redirected before.
+ * */
+int read_redirect_stdin(int redirected) {
+  int was = stdin_redirected;
+  if(cache.fd == STDIN_FILENO)
+    cache.fd = -1;
+  stdin_redirected = redirected;
+  return was;
+}
+
+/* *
+ * Reads from fd up to and including the next delim, appending what comes before it to line.
+ *
+ * Returns - 1 if delim was read, 0 if the input ended first, or -1 on an error.
+ * */
+static int read_record(int fd, int delim, struct line_buf *line) {
+  struct stat st;
+  off_t pos;
+  if(fd == STDIN_FILENO && !stdin_redirected)
+    return read_stdio(delim, line);
+  if(cache.fd == fd)
+    return read_cached(fd, delim, line);
+  if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (pos = lseek(fd, 0, SEEK_CUR)) != -1) {
+    cache.fd = fd;
+    cache.pos = pos;
+    cache.start = cache.len = 0;
+    return read_cached(fd, delim, line);
+  }
+  return read_bytes(fd, delim, line);
+}
+
+/* *
+ * read_record for standard input, through stdio.
+ * */
+static int read_stdio(int delim, struct line_buf *line) {
+  int c;
+  char byte;
+  while((c = getc(stdin)) != EOF) {
+    if(c == delim)
+      return 1;
+    byte = (char) c;
+    if(line_append(line, &byte, 1) == -1)
+      return -1;
+  }
+  if(ferror(stdin)) {
+    perror("Error reading standard input.");
+    clearerr(stdin);
+    return -1;
+  }
+  // Let the shell see the end of its input too.
+  return 0;
+}
+
+/* *
+ * read_record for a regular file, from the block read ahead.
+ * */
+static int read_cached(int fd, int delim, struct line_buf *line) {
+  char *end;
+  size_t start_len, n, used;
+  ssize_t got;
+  off_t pos;
+  int found;
+
+  start_len = line->len;
+  used = 0;
+  found = 0;
+  for(;;) {
+    end = cache.len > 0 ? memchr(cache.data + cache.start, delim, cache.len) : NULL;
+    found = end != NULL;
+    n = found ? (size_t) (end - (cache.data + cache.start)) + 1 : cache.len;
+    if(line_append(line, cache.data + cache.start, n - found) == -1)
+      return -1;
+    cache.start += n;
+    cache.len -= n;
+    used += n;
+    if(found)
+      break;
+    if(cache.data == NULL && (cache.data = mem_malloc(MEM_VARS, READ_BLOCK_SIZE)) == NULL) {
+      perror("Error allocating memory for input.");
+      return -1;
+    }
+    while((got = pread(fd, cache.data, READ_BLOCK_SIZE, cache.pos + used)) < 0 && errno == EINTR)
+      ;
+    if(got < 0) {
+      perror("Error reading input.");
+      cache.fd = -1;
+      return -1;
+    }
+    if(got == 0)
+      break;
+    cache.start = 0;
+    cache.len = got;
+  }
+
+  // Move the descriptor past the bytes used.  If it was not where it was left, something else
+  // read from or moved it, so put it back, drop the block, and read the line again.
+  if(used > 0) {
+    if((pos = lseek(fd, used, SEEK_CUR)) == -1) {
+      perror("Error seeking input.");
+      cache.fd = -1;
+      return -1;
+    }
+    if(pos != cache.pos + (off_t) used) {
+      if(VERBOSE(V_FD))
+        printf("Descriptor %d was moved since the last read; reading it again.\n", fd);
+      cache.fd = -1;
+      line->len = start_len;
+      if(lseek(fd, pos - used, SEEK_SET) == -1) {
+        perror("Error seeking input.");
+        return -1;
+      }
+      return read_record(fd, delim, line);
+    }
+    cache.pos = pos;
+  }
+  // At the end of the input, look at the descriptor afresh next time, since it may be reopened.
+  if(!found)
+    cache.fd = -1;
+  return found;
+}
+
+/* *
+ * read_record for a descriptor that cannot be read ahead of, a byte at a time.
+ * */
+static int read_bytes(int fd, int delim, struct line_buf *line) {
+  char c;
+  ssize_t got;
+  for(;;) {
+    while((got = read(fd, &c, 1)) < 0 && errno == EINTR)
+      ;
+    if(got < 0) {
+      perror("Error reading input.");
+      return -1;
+    }
+    if(got == 0)
+      return 0;
+    if(c == delim)
+      return 1;
+    if(line_append(line, &c, 1) == -1)
+      return -1;
+  }
+}
+
+/* *
+ * Appends everything up to the end of the input on fd to buf, with large reads.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int read_all(int fd, struct line_buf *buf) {
+  char *data;
+  size_t size;
+  ssize_t got;
+
+  // The read ahead block, if it is of fd, goes first, and is then out of date.
+  if(cache.fd == fd) {
+    if(line_append(buf, cache.data + cache.start, cache.len) == -1)
+      return -1;
+    cache.fd = -1;
+    if(lseek(fd, 0, SEEK_END) == -1) {
+      perror("Error seeking input.");
+      return -1;
+    }
+  }
+  for(;;) {
+    if(buf->size - buf->len < READ_BLOCK_SIZE) {
+      size = buf->size ? buf->size * 2 : READ_BLOCK_SIZE;
+      if(size - buf->len < READ_BLOCK_SIZE)
+        size = buf->len + READ_BLOCK_SIZE;
+      if((data = mem_realloc(MEM_VARS, buf->data, size)) == NULL) {
+        perror("Error allocating memory for input.");
+        return -1;
+      }
+      buf->data = data;
+      buf->size = size;
+    }
+    if(fd == STDIN_FILENO && !stdin_redirected) {
+      got = fread(buf->data + buf->len, 1, buf->size - buf->len, stdin);
+      if(got == 0 && ferror(stdin)) {
+        perror("Error reading standard input.");
+        clearerr(stdin);
+        return -1;
+      }
+    }
+    else {
+      while((got = read(fd, buf->data + buf->len, buf->size - buf->len)) < 0 && errno == EINTR)
+        ;
+      if(got < 0) {
+        perror("Error reading input.");
+        return -1;
+      }
+    }
+    if(got == 0)
+      return 0;
+    buf->len += got;
+  }
+}
+
+/* *
+ * Splits the len characters of line into fields on the characters of IFS, and sets each of names
+ * to a field, and the last of names to the rest of the line.  Blanks in IFS around the fields
+ * are dropped, and unless raw is 1, a backslash quotes the character after it.  REPLY (alone in
+ * names) is set to the whole line, unsplit.
+ *
+ * Returns - 0 on success, or -1 if a variable could not be set.
+ * */
+static int assign_fields(const char *line, size_t len, char **names, int raw) {
+  const char *ifs, *pos, *end;
+  size_t keep;
+  int whole, status;
+  struct line_buf field;
+
+  if((ifs = vars_get("IFS")) == NULL)
+    ifs = DEFAULT_IFS;
+  whole = strcmp(names[0], "REPLY") == 0 && names[1] == NULL;
+  memset(&field, 0, sizeof(field));
+  status = line_append(&field, "", 0);
+  for(pos = line, end = line + len; status == 0 && *names != NULL; names++) {
+    while(!whole && pos < end && *pos != '\0' && strchr(ifs, *pos) && strchr(" \t\n", *pos))
+      pos++;
+    field.len = 0;
+    keep = 0;
+    for(; status == 0 && pos < end; pos++) {
+      if(!raw && *pos == '\\' && pos + 1 < end) {
+        status = line_append(&field, ++pos, 1);
+        keep = field.len;
+        continue;
+      }
+      // A field (but not the rest of the line) ends at a character of IFS.
+      if(names[1] != NULL && *pos != '\0' && strchr(ifs, *pos))
+        break;
+      status = line_append(&field, pos, 1);
+      if(whole || *pos == '\0' || !strchr(ifs, *pos) || !strchr(" \t\n", *pos))
+        keep = field.len;
+    }
+    if(names[1] != NULL) {
+      // Skip the delimiter: blanks, around at most one other character of IFS.
+      while(pos < end && *pos != '\0' && strchr(ifs, *pos) && strchr(" \t\n", *pos))
+        pos++;
+      if(pos < end && *pos != '\0' && strchr(ifs, *pos))
+        pos++;
+    }
+    if(status == 0)
+      status = vars_set_len(*names, field.data, keep);
+  }
+  mem_free(MEM_VARS, field.data);
+  return status;
+}
+
+/* *
+ * Appends the len characters of data to line, keeping it null-terminated.
+ * */
+static int line_append(struct line_buf *line, const char *data, size_t len) {
+  char *buf;
+  size_t size;
+  if(line->len + len + 1 > line->size) {
+    for(size = line->size ? line->size : DEFAULT_LINE_SIZE; size < line->len + len + 1; )
+      size *= 2;
+    if((buf = mem_realloc(MEM_VARS, line->data, size)) == NULL) {
+      perror("Error allocating memory for input.");
+      return -1;
+    }
+    line->data = buf;
+    line->size = size;
+  }
+  memcpy(line->data + line->len, data, len);
+  line->len += len;
+  line->data[line->len] = '\0';
+  return 0;
+}
+
+/* *
+ * Reads the descriptor str, an argument of the builtin name, into fd.
+ *
+ * Returns - 0 on success, or -1 (with the status set) if str is not an open descriptor.
+ * */
+static int parse_fd(const char *name, const char *str, int *fd) {
+  char *end;
+  long n;
+  n = strtol(str, &end, 10);
+  if(end == str || *end != '\0' || n < 0 || n > INT_MAX || fcntl((int) n, F_GETFD) == -1) {
+    fprintf(stderr, "%s: %s: invalid file descriptor\n", name, str);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  *fd = (int) n;
+  return 0;
+}
@@ -0,0 +1,121 @@
+/* *
+ * redirect.c
+ *
+ * Redirections made in the shell process.
+ *
+ * A builtin, or a group of commands, that runs in the shell process has no child whose
+ * descriptors can be pointed at a file before it starts.  Instead the shell saves its own
+ * descriptor, points it at the file with dup2, runs the command, and puts the saved descriptor
+ * back, so that "echo x >> log" costs an open and two dup2s rather than a fork.  The saved copy is
+ * close-on-exec, so the programs the command runs never see it.
+ *
+ * Standard input needs one more step.  The shell reads its own command lines from it through
+ * stdio, which may hold lines read ahead of the command, so while it is redirected, read and
+ * mapfile are told to read the descriptor directly instead (see read_redirect_stdin in read.c.)
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "redirect.h"
+#include "tinysh.h"
+#include "trace.h"
+#include "read.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+
+/* *
+ * Returns - 1 if word is a redirection the shell can make in its own process (<, >, or >>), 0 if
+ *           not.
+ * */
+int redirect_op(const char *word) {
+  return strcmp(word, "<") == 0 || strcmp(word, ">") == 0 || strcmp(word, ">>") == 0;
+}
+
+/* *
+ * Returns - 1 if the command line cmds has redirections (see redirect_op) but no pipes, so that a
+ *           builtin can run it in the shell process, 0 if not.
+ * */
+int redirect_only(char **cmds) {
+  size_t i;
+  int redirects = 0;
+  for(i = 0; cmds[i] != NULL; i++) {
+    if(strcmp(cmds[i], "|") == 0)
+      return 0;
+    redirects |= redirect_op(cmds[i]);
+  }
+  return redirects;
+}
+
+/* *
+ * Makes the redirection op (see redirect_op) to file in the shell process, filling in r so that
+ * redirect_restore can undo it.
+ *
+ * Returns - 0 on success, or -1 on an error, in which case nothing is left to undo.
+ * */
+int redirect_open(const char *op, const char *file, struct redirect *r) {
+  int fd, flags;
+  uint64_t start;
+
+  r->saved = -1;
+  if(op[0] == '<') {
+    r->fd = STDIN_FILENO;
+    flags = O_RDONLY | O_CLOEXEC;
+  }
+  else {
+    r->fd = STDOUT_FILENO;
+    flags = O_CREAT | O_WRONLY | O_CLOEXEC | (op[1] == '\0' ? O_TRUNC : O_APPEND);
+  }
+  if(VERBOSE(V_FD) && r->fd == STDIN_FILENO)
+    printf("Redirecting stdin from %s in the shell process.\n", file);
+  else if(VERBOSE(V_FD))
+    printf("Redirecting stdout to %s in the shell process.\n", file);
+  // Whatever the shell has buffered belongs to the old stdout.
+  fflush(stdout);
+  TRACE_BEGIN(start);
+  if((fd = open(file, flags, 0666)) < 0) {
+    perror("Error opening file.");
+    r->fd = -1;
+    return -1;
+  }
+  TRACE_END("open", "fd", start, file);
+  TRACE_BEGIN(start);
+  if((r->saved = fcntl(r->fd, F_DUPFD_CLOEXEC, 0)) < 0 || dup2(fd, r->fd) < 0) {
+    perror("Error duplicating file descriptor.");
+    if(r->saved >= 0)
+      close(r->saved);
+    close(fd);
+    r->fd = -1;
+    return -1;
+  }
+  TRACE_END("dup2", "fd", start, r->fd == STDIN_FILENO ? "input file -> stdin"
+                                                         : "output file -> stdout");
+  close(fd);
+  if(r->fd == STDIN_FILENO)
+    r->stdin_was = read_redirect_stdin(1);
+  return 0;
+}
+
+/* *
+ * Undoes the redirection r, if there is one.
+ * */
+void redirect_restore(struct redirect *r) {
+  uint64_t start;
+  if(r->fd < 0)
+    return;
+  fflush(stdout);
+  TRACE_BEGIN(start);
+  if(dup2(r->saved, r->fd) < 0)
+    perror("Error restoring a redirected descriptor.");
+  TRACE_END("dup2", "fd", start, "saved descriptor");
+  close(r->saved);
+  if(r->fd == STDIN_FILENO)
+    read_redirect_stdin(r->stdin_was);
+  if(VERBOSE(V_FD))
+    printf("Restored %s.\n", r->fd == STDIN_FILENO ? "stdin" : "stdout");
+  r->fd = -1;
+}
@@ -0,0 +1,415 @@
+/* *
+ * serve.c
+ *
+ * Daemon mode: serving command lines over a Unix domain socket.
+ *
+ * Started with "tinysh --serve /path/to/socket", the shell stops reading commands from stdin and
+ * instead accepts connections on the socket, each of which carries one command line (see serve.h
+ * for the wire protocol.)  The shell receives the command lines of all its connections at once,
+ * with poll, so that a slow client holds up no one else.  Once a line has arrived, the shell
+ * resolves its commands in its own command hash and forks a worker, which runs the line in a child
+ * with its stdout and stderr connected to pipes, streams whatever arrives on the pipes back over
+ * the connection, and finishes with the command's exit status.  A line that is a single program,
+ * with no pipes or redirections, is executed by that child directly rather than forked once more,
+ * so such a request costs two forks.  Since the workers are forked from the long-lived shell, a
+ * request pays for neither shell startup nor a cold command hash.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#define _GNU_SOURCE  // accept4
+
+#include "serve.h"
+#include "fdio.h"
+#include "tinysh.h"
+#include "cmdhash.h"
+#include "stats.h"
+#include "trace.h"
+#include "mem.h"
+#include "expand.h"
+#include "interp.h"
+#include "redirect.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+
+#define SERVE_BUF_SIZE    65536
+#define SERVE_CMD_TIMEOUT 5       // Seconds a client has to send its command line.
+#define SERVE_MAX_PENDING 64      // Connections whose command lines may be arriving at once.
+
+#define READ_END  0
+#define WRITE_END 1
+
+/*
+ * A connection whose command frame is still arriving.
+ */
+struct pending {
+  int fd;
+  char header[SERVE_HEADER_SIZE];
+  char *line;         // The command line, once its header has arrived, or NULL.
+  uint32_t len;       // Length of the command line.
+  size_t got;         // Bytes of the frame received so far, header included.
+  uint64_t deadline;  // Time (see stats_now) by which the frame must have arrived.
+};
+
+static const char *serve_path;  // Socket path, removed when the shell is stopped.
+static struct pending pending[SERVE_MAX_PENDING];
+static size_t num_pending;
+
+static void serve_stop(int sig);
+static void accept_conn(int sock);
+static int recv_more(struct pending *p);
+static void drop_pending(size_t i);
+static void start_worker(int sock, struct pending *p);
+static void serve_line(int conn, char **cmds, size_t num_cmds);
+static int send_frame(int conn, char type, const void *buf, uint32_t len);
+
+/* *
+ * Serves command lines on the Unix domain socket sock_path until the shell is killed.
+ * */
+int serve_run(const char *sock_path) {
+  int sock, timeout;
+  size_t i, num_fds;
+  uint64_t now, first;
+  struct sockaddr_un addr;
+  struct sigaction sa;
+  struct pollfd fds[SERVE_MAX_PENDING + 1];
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(strlen(sock_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Error:  Socket path is too long: %s\n", sock_path);
+    return -1;
+  }
+  strcpy(addr.sun_path, sock_path);
+
+  if((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+    perror("Error creating socket.");
+    return -1;
+  }
+  // Replace a socket left behind by an earlier shell.
+  unlink(sock_path);
+  if(bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(sock, SOMAXCONN) < 0) {
+    perror("Error listening on socket.");
+    close(sock);
+    return -1;
+  }
+  serve_path = sock_path;
+
+  // Remove the socket when stopped, and don't die when a client hangs up early.
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = serve_stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("Serving commands on %s\n", sock_path);
+  while(1) {
+    // Reap finished workers and collect the events they traced.
+    while(waitpid(-1, NULL, WNOHANG) > 0)
+      ;
+    trace_flush();
+
+    // Wait for a new connection (while there is room for one), for more of a command frame, or
+    // for the first frame that is due to time out.
+    fds[0].fd = num_pending < SERVE_MAX_PENDING ? sock : -1;
+    fds[0].events = POLLIN;
+    first = 0;
+    for(i = 0, num_fds = 1; i < num_pending; i++, num_fds++) {
+      fds[num_fds].fd = pending[i].fd;
+      fds[num_fds].events = POLLIN;
+      if(first == 0 || pending[i].deadline < first)
+        first = pending[i].deadline;
+    }
+    now = stats_now();
+    timeout = first == 0 ? -1 : first <= now ? 0 : (int) ((first - now) / 1000000 + 1);
+    if(poll(fds, num_fds, timeout) < 0) {
+      if(errno == EINTR)
+        continue;
+      perror("Error polling connections.");
+      close(sock);
+      unlink(sock_path);
+      return -1;
+    }
+
+    // Go through the pending connections backwards, since dropping one moves the last into its
+    // place.
+    now = stats_now();
+    for(i = num_pending; i-- > 0; ) {
+      if(fds[i + 1].revents == 0) {
+        if(pending[i].deadline <= now)
+          drop_pending(i);
+        continue;
+      }
+      switch(recv_more(&pending[i])) {
+        case 1:
+          start_worker(sock, &pending[i]);
+          drop_pending(i);
+          break;
+        case -1:
+          drop_pending(i);
+          break;
+      }
+    }
+    if(fds[0].revents != 0)
+      accept_conn(sock);
+  }
+}
+
+/* *
+ * Signal handler that removes the socket and exits.
+ * */
+static void serve_stop(int sig) {
+  (void) sig;
+  if(serve_path != NULL)
+    unlink(serve_path);
+  _exit(EXIT_SUCCESS);
+}
+
+/* *
+ * Accepts a new connection on sock, whose command frame is then received as it arrives.
+ * */
+static void accept_conn(int sock) {
+  int conn;
+  struct pending *p;
+  if((conn = accept4(sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) {
+    if(errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+      perror("Error accepting a connection.");
+    return;
+  }
+  p = &pending[num_pending++];
+  memset(p, 0, sizeof(*p));
+  p->fd = conn;
+  // A client that connects and never sends its command must not hold its slot forever.
+  p->deadline = stats_now() + (uint64_t) SERVE_CMD_TIMEOUT * 1000000000;
+}
+
+/* *
+ * Receives whatever has arrived of the command frame of p.
+ *
+ * Returns - 1 once the whole frame has arrived, 0 if more is to come, or -1 if the client hung
+ *           up or sent something other than a command frame.
+ * */
+static int recv_more(struct pending *p) {
+  ssize_t n;
+  uint32_t len;
+  if(p->got < SERVE_HEADER_SIZE) {
+    if((n = read(p->fd, p->header + p->got, SERVE_HEADER_SIZE - p->got)) <= 0)
+      return n < 0 && (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+    if((p->got += n) < SERVE_HEADER_SIZE)
+      return 0;
+    memcpy(&len, p->header + 1, sizeof(len));
+    if(p->header[0] != SERVE_FRAME_CMD || (p->len = ntohl(len)) > SERVE_MAX_CMD)
+      return -1;
+    if((p->line = mem_malloc(MEM_PARSE, p->len + 1)) == NULL) {
+      perror("Error allocating memory for a command line.");
+      return -1;
+    }
+  }
+  if(p->got < SERVE_HEADER_SIZE + p->len) {
+    n = read(p->fd, p->line + (p->got - SERVE_HEADER_SIZE), SERVE_HEADER_SIZE + p->len - p->got);
+    if(n <= 0)
+      return n < 0 && (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+    p->got += n;
+  }
+  if(p->got < SERVE_HEADER_SIZE + p->len)
+    return 0;
+  p->line[p->len] = '\0';
+  return 1;
+}
+
+/* *
+ * Closes the pending connection i, and moves the last one into its place.
+ * */
+static void drop_pending(size_t i) {
+  close(pending[i].fd);
+  mem_free(MEM_PARSE, pending[i].line);
+  pending[i] = pending[--num_pending];
+}
+
+/* *
+ * Tokenizes the command line received on p and forks a worker to run it.  The line's commands
+ * are resolved here rather than in the worker, so that the server's command hash stays warm for
+ * later requests.
+ * */
+static void start_worker(int sock, struct pending *p) {
+  size_t i, num_cmds;
+  char **cmds, **temp;
+
+  if(VERBOSE(V_PROC))
+    printf("Received command line: %s\n", p->line);
+  num_cmds = strlen(p->line);
+  if((cmds = tokenizer(p->line, CMD_DELIMITERS, &num_cmds)) == NULL) {
+    send_frame(p->fd, SERVE_FRAME_EXIT, "\0\0\0\0", 4);
+    return;
+  }
+  cmdhash_warm(cmds);
+
+  fflush(stdout);
+  switch(fork()) {
+    case -1:
+      perror("Error forking a process.");
+      break;
+    // Worker process.  Only the server removes the socket when stopped, and only the server
+    // waits on the other connections.
+    case 0:
+      close(sock);
+      for(i = 0; i < num_pending; i++) {
+        if(pending[i].fd != p->fd)
+          close(pending[i].fd);
+      }
+      signal(SIGINT, SIG_DFL);
+      signal(SIGTERM, SIG_DFL);
+      fcntl(p->fd, F_SETFL, 0);
+      serve_line(p->fd, cmds, num_cmds);
+      fflush(stdout);
+      _Exit(EXIT_SUCCESS);
+    default:
+      if(VERBOSE(V_PROC))
+        printf("  Created a worker process to run %s.\n", cmds[0]);
+      break;
+  }
+  temp = cmds;
+  while(temp && *temp)
+    mem_free(MEM_PARSE, *temp++);
+  mem_free(MEM_PARSE, cmds);
+}
+
+/* *
+ * Runs a command line for a client in a worker process, relaying its output and exit status.
+ * */
+static void serve_line(int conn, char **cmds, size_t num_cmds) {
+  int i, p_id, status, open_fds, exit_flag, null_fd;
+  int out_pipe[2], err_pipe[2];
+  uint32_t code;
+  ssize_t n;
+  char buf[SERVE_BUF_SIZE];
+  struct pollfd fds[2];
+
+  if(pipe(out_pipe) < 0) {
+    perror("Error creating pipe.");
+    return;
+  }
+  if(pipe(err_pipe) < 0) {
+    perror("Error creating pipe.");
+    close(out_pipe[READ_END]);
+    close(out_pipe[WRITE_END]);
+    return;
+  }
+  fflush(stdout);
+  if((p_id = fork()) < 0) {
+    perror("Error forking a process.");
+    close(out_pipe[READ_END]);
+    close(out_pipe[WRITE_END]);
+    close(err_pipe[READ_END]);
+    close(err_pipe[WRITE_END]);
+    return;
+  }
+
+  // Child process.  Run the line as the interactive shell would, with no input.
+  if(p_id == 0) {
+    close(conn);
+    close(out_pipe[READ_END]);
+    close(err_pipe[READ_END]);
+    if((null_fd = open("/dev/null", O_RDONLY)) >= 0) {
+      dup2(null_fd, STDIN_FILENO);
+      close(null_fd);
+    }
+    if(dup2(out_pipe[WRITE_END], STDOUT_FILENO) < 0 || dup2(err_pipe[WRITE_END], STDERR_FILENO) < 0) {
+      perror("Error duplicating file descriptor.");
+      _Exit(EXIT_FAILURE);
+    }
+    close(out_pipe[WRITE_END]);
+    close(err_pipe[WRITE_END]);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    exit_flag = 0;
+    // Expand the line here, so that errors go to the client.  A loop cannot read more lines.
+    if(interp_wants(cmds))
+      interp_line(&cmds, &num_cmds, NULL, &exit_flag);
+    else if(expand_line(&cmds, &num_cmds) == -1)
+      last_status = EXIT_FAILURE;
+    else if(cmds[0] == NULL)
+      last_status = EXIT_SUCCESS;
+    // This process exists only to run the line, so a single program can replace it.
+    else if(!is_builtin(cmds) && !is_special_feature(cmds) && !redirect_only(cmds))
+      _Exit((status = child_handle(cmds, num_cmds)) != -1 ? status : EXIT_FAILURE);
+    else
+      cmd_dispatch(cmds, num_cmds, &exit_flag);
+    // In buffered mode, the output of a builtin may still be waiting in the buffer.
+    fflush(stdout);
+    _Exit(last_status);
+  }
+
+  // Worker.  Relay both pipes to the client until the command closes them.
+  close(out_pipe[WRITE_END]);
+  close(err_pipe[WRITE_END]);
+  fds[0].fd = out_pipe[READ_END];
+  fds[1].fd = err_pipe[READ_END];
+  fds[0].events = fds[1].events = POLLIN;
+  open_fds = 2;
+  while(open_fds > 0) {
+    if(poll(fds, 2, -1) < 0) {
+      if(errno == EINTR)
+        continue;
+      break;
+    }
+    for(i = 0; i < 2; i++) {
+      if(fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      if((n = read(fds[i].fd, buf, sizeof(buf))) < 0 && errno == EINTR)
+        continue;
+      if(n <= 0) {
+        close(fds[i].fd);
+        fds[i].fd = -1;
+        open_fds--;
+        continue;
+      }
+      // If the client has gone away, keep draining so the command isn't blocked on a full pipe.
+      send_frame(conn, i == 0 ? SERVE_FRAME_STDOUT : SERVE_FRAME_STDERR, buf, n);
+    }
+  }
+  for(i = 0; i < 2; i++) {
+    if(fds[i].fd >= 0)
+      close(fds[i].fd);
+  }
+
+  while(waitpid(p_id, &status, 0) < 0) {
+    if(errno != EINTR) {
+      status = EXIT_FAILURE << 8;
+      break;
+    }
+  }
+  code = htonl(WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status));
+  send_frame(conn, SERVE_FRAME_EXIT, &code, sizeof(code));
+  close(conn);
+}
+
+/* *
+ * Sends a frame of the given type and payload.
+ * */
+static int send_frame(int conn, char type, const void *buf, uint32_t len) {
+  char header[SERVE_HEADER_SIZE];
+  uint32_t net_len = htonl(len);
+  header[0] = type;
+  memcpy(header + 1, &net_len, sizeof(net_len));
+  if(fd_write_all(conn, header, sizeof(header)) == -1)
+    return -1;
+  return fd_write_all(conn, buf, len);
+}
+
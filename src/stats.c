@@ -0,0 +1,403 @@
+/* *
+ * stats.c
+ *
+ * Per-command latency statistics.
+ *
+ * Every command the shell runs in a child process is measured over its whole lifecycle: the time
+ * to tokenize its line, the time to fork, the time until its program was executed, its wall time,
+ * its user and system CPU time, and its maximum resident set size.  Each measurement is added to
+ * a histogram for the command's name, and the stats builtin reports percentiles of them, so that
+ * slow tools and regressions stand out in a long-running session.
+ *
+ * The histograms are HDR-style: values below HIST_SUB_COUNT are counted exactly, and above that
+ * every power of two is split into HIST_SUB_COUNT equal buckets.  Recording a value is a couple
+ * of shifts and an increment, the memory used is fixed no matter how many values are recorded,
+ * and every percentile is accurate to within 1 / HIST_SUB_COUNT (about 3%) of its true value.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "stats.h"
+#include "tinysh.h"
+#include "mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HIST_SUB_BITS  5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS  48    // Larger values (over three days in nanoseconds) are clamped.
+#define HIST_BUCKETS   ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+#define DEFAULT_STATS_CAPACITY 32    // Must be a power of two.
+#define STATS_MAX_LOAD_PCT     70
+
+enum stat_metric {
+  STAT_PARSE,
+  STAT_SPAWN,
+  STAT_EXEC,
+  STAT_WALL,
+  STAT_USER,
+  STAT_SYS,
+  STAT_MAXRSS,
+  NUM_STATS
+};
+
+static const struct {
+  const char *name;
+  const char *json_name;
+  int is_time;            // 1 for times in nanoseconds, 0 for sizes in kilobytes.
+} metrics[NUM_STATS] = {
+  {"parse", "parse_ns", 1},
+  {"spawn", "spawn_ns", 1},
+  {"exec", "exec_ns", 1},
+  {"wall", "wall_ns", 1},
+  {"user", "user_ns", 1},
+  {"sys", "sys_ns", 1},
+  {"maxrss", "maxrss_kb", 0},
+};
+
+struct histogram {
+  uint64_t count;
+  uint64_t max;
+  uint32_t buckets[HIST_BUCKETS];
+};
+
+struct stats_entry {
+  char *name;             // Command name, or NULL if the slot is empty.
+  uint64_t runs;
+  struct histogram hists[NUM_STATS];
+};
+
+static struct stats_entry **table;
+static size_t capacity;
+static size_t used;
+static uint64_t pending_parse_ns;  // Parse time of the line being run.
+
+static void hist_record(struct histogram *hist, uint64_t value);
+static uint64_t hist_percentile(const struct histogram *hist, double pct);
+static struct stats_entry** find_slot(const char *name);
+static struct stats_entry* find_entry(const char *name);
+static int entry_cmp(const void *a, const void *b);
+static void format_value(char *buf, size_t size, uint64_t value, int is_time);
+static void print_json_string(const char *str);
+static void print_table(struct stats_entry **entries, size_t num);
+static void print_json(struct stats_entry **entries, size_t num);
+
+/* *
+ * Returns - The current time of the monotonic clock in nanoseconds.
+ * */
+uint64_t stats_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* *
+ * Remembers how long the line being run took to tokenize, for the commands it runs.
+ * */
+void stats_parsed(uint64_t parse_ns) {
+  pending_parse_ns = parse_ns;
+}
+
+/* *
+ * Adds a run of the command name to its histograms.
+ * */
+void stats_record(const char *name, const struct stats_sample *sample) {
+  struct stats_entry *entry;
+  const struct rusage *ru = &sample->usage;
+  if((entry = find_entry(name)) == NULL)
+    return;
+  entry->runs++;
+  hist_record(&entry->hists[STAT_PARSE], pending_parse_ns);
+  hist_record(&entry->hists[STAT_SPAWN], sample->spawn_ns);
+  if(sample->exec_ns != 0)
+    hist_record(&entry->hists[STAT_EXEC], sample->exec_ns);
+  hist_record(&entry->hists[STAT_WALL], sample->wall_ns);
+  hist_record(&entry->hists[STAT_USER],
+              ru->ru_utime.tv_sec * 1000000000ULL + ru->ru_utime.tv_usec * 1000ULL);
+  hist_record(&entry->hists[STAT_SYS],
+              ru->ru_stime.tv_sec * 1000000000ULL + ru->ru_stime.tv_usec * 1000ULL);
+  hist_record(&entry->hists[STAT_MAXRSS], ru->ru_maxrss);
+}
+
+/* *
+ * Forgets every recorded run.
+ * */
+void stats_clear(void) {
+  size_t i;
+  for(i = 0; i < capacity; i++) {
+    if(table[i] != NULL) {
+      mem_free(MEM_STATS, table[i]->name);
+      mem_free(MEM_STATS, table[i]);
+    }
+  }
+  mem_free(MEM_STATS, table);
+  table = NULL;
+  capacity = 0;
+  used = 0;
+}
+
+/* *
+ * Handler for the stats builtin.
+ *
+ * stats          - prints the percentiles of every measurement of every command run.
+ * stats --json   - prints the same as a JSON object, keyed by command name.
+ * stats -r       - forgets every recorded run.
+ * */
+int stats_handle(char **cmd, size_t num_cmd) {
+  size_t i, num;
+  int json = 0;
+  struct stats_entry **entries;
+
+  for(i = 1; i < num_cmd; i++) {
+    if(strcmp(cmd[i], "--json") == 0) {
+      json = 1;
+    }
+    else if(strcmp(cmd[i], "-r") == 0) {
+      if(VERBOSE(V_PROC))
+        printf("Forgetting the statistics of all %zu commands.\n", used);
+      stats_clear();
+      return 0;
+    }
+    else {
+      printf("Error:  Invalid argument %s.\nUsage: stats [--json] [-r]\n", cmd[i]);
+      return -1;
+    }
+  }
+
+  // Report the commands in alphabetical order.
+  if((entries = mem_malloc(MEM_STATS, (used + 1) * sizeof(*entries))) == NULL) {
+    perror("Error allocating memory for statistics.");
+    return -1;
+  }
+  num = 0;
+  for(i = 0; i < capacity; i++) {
+    if(table[i] != NULL)
+      entries[num++] = table[i];
+  }
+  qsort(entries, num, sizeof(*entries), entry_cmp);
+  if(json)
+    print_json(entries, num);
+  else
+    print_table(entries, num);
+  mem_free(MEM_STATS, entries);
+  return 0;
+}
+
+/* *
+ * Adds value to hist.
+ * */
+static void hist_record(struct histogram *hist, uint64_t value) {
+  int shift;
+  size_t index;
+  if(value >= (1ULL << HIST_MAX_BITS))
+    value = (1ULL << HIST_MAX_BITS) - 1;
+  if(value < HIST_SUB_COUNT) {
+    index = value;
+  }
+  else {
+    // Keep the top HIST_SUB_BITS + 1 bits of the value.
+    shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+    index = (size_t) shift * HIST_SUB_COUNT + (value >> shift);
+  }
+  hist->buckets[index]++;
+  hist->count++;
+  if(value > hist->max)
+    hist->max = value;
+}
+
+/* *
+ * Returns - The smallest value that at least pct percent of the values in hist are at most, to
+ *           within the width of its bucket.
+ * */
+static uint64_t hist_percentile(const struct histogram *hist, double pct) {
+  size_t i;
+  int shift;
+  uint64_t seen, target, high;
+  if(hist->count == 0)
+    return 0;
+  target = (uint64_t) (pct / 100.0 * hist->count + 0.5);
+  if(target == 0)
+    target = 1;
+  seen = 0;
+  for(i = 0; i < HIST_BUCKETS; i++) {
+    if((seen += hist->buckets[i]) >= target)
+      break;
+  }
+  // Report the highest value that falls in the bucket, but never more than the true maximum.
+  if(i < HIST_SUB_COUNT) {
+    high = i;
+  }
+  else {
+    shift = i / HIST_SUB_COUNT - 1;
+    high = ((uint64_t) (i - (size_t) shift * HIST_SUB_COUNT) << shift) + (1ULL << shift) - 1;
+  }
+  return high < hist->max ? high : hist->max;
+}
+
+/* *
+ * Returns - The slot holding the entry for name, or the empty slot where it would be inserted.
+ *           The table must be allocated.
+ * */
+static struct stats_entry** find_slot(const char *name) {
+  size_t i;
+  unsigned long h = 14695981039346656037UL;
+  const char *p;
+  // FNV-1a hash of the name, probed linearly.
+  for(p = name; *p; p++) {
+    h ^= (unsigned char) *p;
+    h *= 1099511628211UL;
+  }
+  i = h & (capacity - 1);
+  while(table[i] != NULL && strcmp(table[i]->name, name) != 0)
+    i = (i + 1) & (capacity - 1);
+  return &table[i];
+}
+
+/* *
+ * Returns - The entry for name, added if it is not already present, or NULL if out of memory.
+ * */
+static struct stats_entry* find_entry(const char *name) {
+  size_t i, old_capacity;
+  struct stats_entry **old_table, **slot;
+
+  if(table != NULL && *(slot = find_slot(name)) != NULL)
+    return *slot;
+
+  if(table == NULL || (used + 1) * 100 > capacity * STATS_MAX_LOAD_PCT) {
+    old_table = table;
+    old_capacity = capacity;
+    capacity = capacity ? capacity * 2 : DEFAULT_STATS_CAPACITY;
+    if((table = mem_calloc(MEM_STATS, capacity, sizeof(*table))) == NULL) {
+      perror("Error allocating memory for statistics.");
+      table = old_table;
+      capacity = old_capacity;
+      return NULL;
+    }
+    for(i = 0; i < old_capacity; i++) {
+      if(old_table[i] != NULL)
+        *find_slot(old_table[i]->name) = old_table[i];
+    }
+    mem_free(MEM_STATS, old_table);
+  }
+
+  slot = find_slot(name);
+  if((*slot = mem_calloc(MEM_STATS, 1, sizeof(**slot))) == NULL
+     || ((*slot)->name = mem_strdup(MEM_STATS, name)) == NULL) {
+    perror("Error allocating memory for statistics.");
+    mem_free(MEM_STATS, *slot);
+    *slot = NULL;
+    return NULL;
+  }
+  used++;
+  return *slot;
+}
+
+/* *
+ * Orders entries by command name.
+ * */
+static int entry_cmp(const void *a, const void *b) {
+  return strcmp((*(struct stats_entry * const *) a)->name, (*(struct stats_entry * const *) b)->name);
+}
+
+/* *
+ * Formats a time in nanoseconds, or a size in kilobytes, with a readable unit.
+ * */
+static void format_value(char *buf, size_t size, uint64_t value, int is_time) {
+  if(!is_time) {
+    if(value < 10240)
+      snprintf(buf, size, "%lluK", (unsigned long long) value);
+    else
+      snprintf(buf, size, "%.1fM", value / 1024.0);
+  }
+  else if(value < 1000) {
+    snprintf(buf, size, "%lluns", (unsigned long long) value);
+  }
+  else if(value < 1000000) {
+    snprintf(buf, size, "%.1fus", value / 1000.0);
+  }
+  else if(value < 1000000000) {
+    snprintf(buf, size, "%.1fms", value / 1000000.0);
+  }
+  else {
+    snprintf(buf, size, "%.2fs", value / 1000000000.0);
+  }
+}
+
+/* *
+ * Prints str as a JSON string.
+ * */
+static void print_json_string(const char *str) {
+  putchar('"');
+  for(; *str; str++) {
+    if(*str == '"' || *str == '\\')
+      printf("\\%c", *str);
+    else if((unsigned char) *str < 0x20)
+      printf("\\u%04x", (unsigned char) *str);
+    else
+      putchar(*str);
+  }
+  putchar('"');
+}
+
+/* *
+ * Prints the statistics of entries as a table per command.
+ * */
+static void print_table(struct stats_entry **entries, size_t num) {
+  size_t i;
+  int m;
+  char p50[32], p90[32], p99[32], max[32];
+  const struct histogram *hist;
+
+  if(num == 0) {
+    printf("stats: no commands have been run\n");
+    return;
+  }
+  for(i = 0; i < num; i++) {
+    printf("%s (%llu %s)\n", entries[i]->name, (unsigned long long) entries[i]->runs,
+           entries[i]->runs == 1 ? "run" : "runs");
+    printf("  %-8s %10s %10s %10s %10s\n", "", "p50", "p90", "p99", "max");
+    for(m = 0; m < NUM_STATS; m++) {
+      hist = &entries[i]->hists[m];
+      if(hist->count == 0)
+        continue;
+      format_value(p50, sizeof(p50), hist_percentile(hist, 50), metrics[m].is_time);
+      format_value(p90, sizeof(p90), hist_percentile(hist, 90), metrics[m].is_time);
+      format_value(p99, sizeof(p99), hist_percentile(hist, 99), metrics[m].is_time);
+      format_value(max, sizeof(max), hist->max, metrics[m].is_time);
+      printf("  %-8s %10s %10s %10s %10s\n", metrics[m].name, p50, p90, p99, max);
+    }
+  }
+}
+
+/* *
+ * Prints the statistics of entries as a JSON object keyed by command name.
+ * */
+static void print_json(struct stats_entry **entries, size_t num) {
+  size_t i;
+  int m;
+  const struct histogram *hist;
+
+  printf("{");
+  for(i = 0; i < num; i++) {
+    printf("%s\n  ", i ? "," : "");
+    print_json_string(entries[i]->name);
+    printf(": {\"runs\": %llu", (unsigned long long) entries[i]->runs);
+    for(m = 0; m < NUM_STATS; m++) {
+      hist = &entries[i]->hists[m];
+      printf(", \"%s\": {\"count\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu}",
+             metrics[m].json_name, (unsigned long long) hist->count,
+             (unsigned long long) hist_percentile(hist, 50),
+             (unsigned long long) hist_percentile(hist, 90),
+             (unsigned long long) hist_percentile(hist, 99),
+             (unsigned long long) hist->max);
+    }
+    printf("}");
+  }
+  printf("%s}\n", num ? "\n" : "");
+}
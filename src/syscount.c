@@ -0,0 +1,415 @@
+/* *
+ * syscount.c
+ *
+ * The syscount builtin: system call counts of a command, in the manner of strace -c.
+ *
+ * The command is run in a child process that the shell traces with ptrace before the child does
+ * anything, so the count covers the shell's own setup of the command in the child (the forks,
+ * pipes, opens, and dup2s of a pipeline or redirection) as well as the programs it executes.
+ * Every process the command forks is traced too.  For each system call, the tracer counts the
+ * calls, the calls that failed, the calls made before the calling process executed a program
+ * (i.e. by the shell's setup code), and the wall time from entering the call to leaving it.
+ *
+ * NOTES:
+ *   - The child is attached with PTRACE_SEIZE, so tracing it does not depend on signals, and it
+ *     waits on a pipe until the tracer is ready.  Its read of the pipe is counted as one read of
+ *     the setup.
+ *   - The time of each call is measured by the tracer, so it includes the cost of the two stops
+ *     around the call.  Compare calls, not absolute times, with an untraced run.
+ *   - Calls are named from a table of the common ones; the rest are reported by number.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#define _GNU_SOURCE  // pipe2
+
+#include "syscount.h"
+#include "tinysh.h"
+#include "cmdhash.h"
+#include "stats.h"
+#include "mem.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+
+#define READ_END  0
+#define WRITE_END 1
+
+#define SYSCOUNT_MAX_NR        512  // Calls numbered this or higher are counted together.
+#define DEFAULT_TASKS_CAPACITY 8
+
+#define SYSCOUNT_OPTIONS (PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEEXEC | PTRACE_O_TRACEFORK \
+                          | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL)
+
+#define NAME(call) [SYS_##call] = #call
+
+static const char *syscall_names[SYSCOUNT_MAX_NR] = {
+  NAME(read), NAME(write), NAME(openat), NAME(close), NAME(lseek), NAME(pread64),
+  NAME(pwrite64), NAME(readv), NAME(writev), NAME(fstat), NAME(newfstatat), NAME(statx),
+  NAME(faccessat), NAME(readlinkat), NAME(getdents64), NAME(fcntl), NAME(ioctl), NAME(dup),
+  NAME(dup3), NAME(pipe2), NAME(mmap), NAME(munmap), NAME(mprotect), NAME(mremap), NAME(madvise),
+  NAME(brk), NAME(rt_sigaction), NAME(rt_sigprocmask), NAME(rt_sigreturn), NAME(sigaltstack),
+  NAME(execve), NAME(exit), NAME(exit_group), NAME(wait4), NAME(waitid), NAME(kill), NAME(tgkill),
+  NAME(clone), NAME(getpid), NAME(getppid), NAME(gettid), NAME(getuid), NAME(geteuid),
+  NAME(getgid), NAME(getegid), NAME(setpgid), NAME(getpgid), NAME(setsid), NAME(uname),
+  NAME(getcwd), NAME(chdir), NAME(fchdir), NAME(umask), NAME(prlimit64), NAME(getrusage),
+  NAME(set_tid_address), NAME(set_robust_list), NAME(futex), NAME(getrandom), NAME(nanosleep),
+  NAME(clock_nanosleep), NAME(clock_gettime), NAME(sched_yield), NAME(sched_getaffinity),
+  NAME(socket), NAME(connect), NAME(accept), NAME(accept4), NAME(sendto), NAME(recvfrom),
+  NAME(sendmsg), NAME(recvmsg), NAME(shutdown), NAME(bind), NAME(listen), NAME(socketpair),
+  NAME(setsockopt), NAME(getsockopt), NAME(ppoll), NAME(pselect6), NAME(epoll_ctl),
+  NAME(epoll_pwait), NAME(unlinkat), NAME(mkdirat), NAME(renameat), NAME(fchmodat),
+  NAME(fchownat), NAME(utimensat), NAME(fsync), NAME(ftruncate), NAME(fadvise64), NAME(flock),
+  NAME(statfs), NAME(fstatfs), NAME(sysinfo), NAME(capget), NAME(prctl), NAME(ptrace),
+  NAME(memfd_create), NAME(copy_file_range), NAME(splice), NAME(sendfile),
+#ifdef SYS_rseq
+  NAME(rseq),
+#endif
+#ifdef SYS_clone3
+  NAME(clone3),
+#endif
+#ifdef SYS_arch_prctl
+  NAME(arch_prctl),
+#endif
+#ifdef SYS_open
+  // Calls that newer architectures only provide as the *at or generic versions above.
+  NAME(open), NAME(stat), NAME(lstat), NAME(access), NAME(readlink), NAME(getdents),
+  NAME(pipe), NAME(dup2), NAME(fork), NAME(vfork), NAME(poll), NAME(select), NAME(unlink),
+  NAME(mkdir), NAME(rmdir), NAME(rename), NAME(creat), NAME(chmod), NAME(chown), NAME(link),
+  NAME(symlink), NAME(getpgrp), NAME(epoll_wait), NAME(alarm), NAME(pause),
+#endif
+};
+
+/*
+ * Totals of one system call.
+ */
+struct syscall_count {
+  uint64_t calls;
+  uint64_t errors;
+  uint64_t setup;      // Calls made before the calling process executed a program.
+  uint64_t ns;         // Wall time spent in the call.
+};
+
+/*
+ * A traced process.
+ */
+struct task {
+  pid_t pid;           // Process ID, or 0 if the slot is free.
+  int known;           // 1 once the fork that created the task has been seen.
+  int pending;         // 1 if the task is held in its first stop until its fork is seen.
+  int exec_done;       // 1 once the task has executed a program.
+  int in_syscall;      // 1 between a call's entry and exit stops.
+  int setup;           // 1 if the current call was made before executing a program.
+  uint64_t nr;         // Number of the current call.
+  uint64_t enter_ns;   // Time the current call was entered.
+};
+
+static struct syscall_count counts[SYSCOUNT_MAX_NR + 1];
+static struct task *tasks;
+static size_t tasks_capacity;
+static size_t num_tasks;
+
+static void abandon_child(pid_t child, int sync_fd);
+static int trace_command(pid_t child, int *child_status);
+static void syscall_stop(struct task *task);
+static struct task* find_task(pid_t pid, int add);
+static void remove_task(pid_t pid);
+static int count_cmp(const void *a, const void *b);
+static void print_report(void);
+
+/* *
+ * Handler for the syscount builtin.
+ *
+ * syscount cmd [args ...] [| cmd ...] [> file | >> file]
+ *
+ * Runs the command line with every system call of the shell's child, and of every process it
+ * creates, traced and counted, then prints a table of the counts on stderr.
+ * */
+int syscount_handle(char **cmd, size_t num_cmd) {
+  int p_id, status, result, sync_pipe[2];
+  char c;
+  struct task *task;
+
+  if(num_cmd < 2) {
+    printf("Error:  Missing command.\nUsage: syscount cmd [args ...]\n");
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  // Resolve the line's commands before forking, so that the results stay in the shell's hash.
+  cmdhash_warm(cmd + 1);
+  memset(counts, 0, sizeof(counts));
+
+  // The child waits on this pipe until it is being traced.
+  if(pipe2(sync_pipe, O_CLOEXEC) < 0) {
+    perror("Error creating pipe.");
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+
+  fflush(stdout);
+  if((p_id = fork()) < 0) {
+    perror("Error forking a process.");
+    close(sync_pipe[READ_END]);
+    close(sync_pipe[WRITE_END]);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  // Child process.
+  if(p_id == 0) {
+    close(sync_pipe[WRITE_END]);
+    while(read(sync_pipe[READ_END], &c, 1) < 0 && errno == EINTR)
+      ;
+    status = child_handle(cmd + 1, num_cmd - 1);
+    fflush(stdout);
+    _Exit(status != -1 ? status : EXIT_FAILURE);
+  }
+
+  close(sync_pipe[READ_END]);
+  if(VERBOSE(V_PROC))
+    printf("Tracing the system calls of process %d:  %s\n", p_id, cmd[1]);
+  fflush(stdout);
+  // Attach to the child and stop it, so that it can be restarted with system call stops enabled.
+  if(ptrace(PTRACE_SEIZE, p_id, NULL, (void *) (long) SYSCOUNT_OPTIONS) < 0
+     || ptrace(PTRACE_INTERRUPT, p_id, NULL, NULL) < 0) {
+    perror("Error tracing the command.");
+    abandon_child(p_id, sync_pipe[WRITE_END]);
+    return -1;
+  }
+  if((task = find_task(p_id, 1)) == NULL) {
+    abandon_child(p_id, sync_pipe[WRITE_END]);
+    return -1;
+  }
+  task->known = 1;
+  close(sync_pipe[WRITE_END]);
+
+  result = trace_command(p_id, &status);
+  mem_free(MEM_EXEC, tasks);
+  tasks = NULL;
+  tasks_capacity = num_tasks = 0;
+  if(result == -1) {
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  print_report();
+  return wait_status_handle(status);
+}
+
+/* *
+ * Kills child, which could not be traced, and waits for it.  sync_fd is the write end of the
+ * pipe the child is waiting on.
+ * */
+static void abandon_child(pid_t child, int sync_fd) {
+  kill(child, SIGKILL);
+  close(sync_fd);
+  waitpid(child, NULL, 0);
+  last_status = EXIT_FAILURE;
+}
+
+/* *
+ * Runs the traced processes, starting with child, until all of them have exited, counting their
+ * system calls.  child_status is set to the wait status of child.
+ *
+ * Returns - 0 on success, or -1 if waiting for the processes failed.
+ * */
+static int trace_command(pid_t child, int *child_status) {
+  int status, sig, event;
+  unsigned long new_pid;
+  pid_t pid;
+  struct task *task, *new_task;
+
+  *child_status = 0;
+  while(num_tasks > 0) {
+    // __WALL, so that threads are waited for as well as processes.
+    if((pid = waitpid(-1, &status, __WALL)) < 0) {
+      if(errno == EINTR)
+        continue;
+      perror("Error waiting for a traced process.");
+      return -1;
+    }
+    if(WIFEXITED(status) || WIFSIGNALED(status)) {
+      if(pid == child)
+        *child_status = status;
+      remove_task(pid);
+      continue;
+    }
+    if(!WIFSTOPPED(status) || (task = find_task(pid, 1)) == NULL)
+      continue;
+
+    sig = WSTOPSIG(status);
+    event = status >> 16;
+    if(sig == (SIGTRAP | 0x80)) {
+      syscall_stop(task);
+      sig = 0;
+    }
+    else if(event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK
+            || event == PTRACE_EVENT_CLONE) {
+      // The new process belongs to the shell's setup if its parent had not executed a program.
+      if(ptrace(PTRACE_GETEVENTMSG, pid, NULL, &new_pid) == 0
+         && (new_task = find_task((pid_t) new_pid, 1)) != NULL) {
+        new_task->known = 1;
+        new_task->exec_done = task->exec_done;
+        if(new_task->pending) {
+          new_task->pending = 0;
+          ptrace(PTRACE_SYSCALL, new_task->pid, NULL, NULL);
+        }
+      }
+      sig = 0;
+    }
+    else if(event == PTRACE_EVENT_EXEC) {
+      task->exec_done = 1;
+      sig = 0;
+    }
+    else if(event == PTRACE_EVENT_STOP) {
+      // The first stop of a new process, or a group stop.  A new process is held until its
+      // parent's fork event says whose it is.
+      if(!task->known) {
+        task->pending = 1;
+        continue;
+      }
+      sig = 0;
+    }
+    // Anything else is a signal on its way to the process, which is passed along.
+    ptrace(PTRACE_SYSCALL, pid, NULL, (void *) (long) sig);
+  }
+  return 0;
+}
+
+/* *
+ * Counts the entry to or exit from a system call that task has stopped at.
+ * */
+static void syscall_stop(struct task *task) {
+  struct __ptrace_syscall_info info;
+  struct syscall_count *count;
+
+  if(ptrace(PTRACE_GET_SYSCALL_INFO, task->pid, (void *) sizeof(info), &info) < 0)
+    return;
+  if(info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+    task->nr = info.entry.nr < SYSCOUNT_MAX_NR ? info.entry.nr : SYSCOUNT_MAX_NR;
+    task->setup = !task->exec_done;
+    task->in_syscall = 1;
+    task->enter_ns = stats_now();
+    count = &counts[task->nr];
+    count->calls++;
+    if(task->setup)
+      count->setup++;
+  }
+  else if(info.op == PTRACE_SYSCALL_INFO_EXIT && task->in_syscall) {
+    count = &counts[task->nr];
+    count->ns += stats_now() - task->enter_ns;
+    if(info.exit.is_error)
+      count->errors++;
+    task->in_syscall = 0;
+  }
+}
+
+/* *
+ * Returns - The traced process pid, added if add is 1 and it is not already present, or NULL if
+ *           it is not present (or out of memory.)
+ * */
+static struct task* find_task(pid_t pid, int add) {
+  size_t i;
+  struct task *free_slot, *new_tasks;
+
+  free_slot = NULL;
+  for(i = 0; i < tasks_capacity; i++) {
+    if(tasks[i].pid == pid)
+      return &tasks[i];
+    if(tasks[i].pid == 0 && free_slot == NULL)
+      free_slot = &tasks[i];
+  }
+  if(!add)
+    return NULL;
+  if(free_slot == NULL) {
+    i = tasks_capacity ? tasks_capacity * 2 : DEFAULT_TASKS_CAPACITY;
+    if((new_tasks = mem_realloc(MEM_EXEC, tasks, i * sizeof(*tasks))) == NULL) {
+      perror("Error allocating memory for traced processes.");
+      return NULL;
+    }
+    memset(new_tasks + tasks_capacity, 0, (i - tasks_capacity) * sizeof(*tasks));
+    free_slot = new_tasks + tasks_capacity;
+    tasks = new_tasks;
+    tasks_capacity = i;
+  }
+  memset(free_slot, 0, sizeof(*free_slot));
+  free_slot->pid = pid;
+  num_tasks++;
+  return free_slot;
+}
+
+/* *
+ * Forgets the traced process pid, which has exited.
+ * */
+static void remove_task(pid_t pid) {
+  struct task *task;
+  if((task = find_task(pid, 0)) == NULL)
+    return;
+  task->pid = 0;
+  num_tasks--;
+}
+
+/* *
+ * Orders system call numbers by the time spent in them, then by their number of calls, most first.
+ * */
+static int count_cmp(const void *a, const void *b) {
+  const struct syscall_count *x = &counts[*(const int *) a], *y = &counts[*(const int *) b];
+  if(x->ns != y->ns)
+    return x->ns < y->ns ? 1 : -1;
+  return (x->calls < y->calls) - (x->calls > y->calls);
+}
+
+/* *
+ * Prints the counts as a table on stderr.
+ * */
+static void print_report(void) {
+  int i, num, order[SYSCOUNT_MAX_NR + 1];
+  char number[32];
+  const char *name;
+  struct syscall_count total;
+  const char *rule =
+    "------ ----------- ----------- --------- --------- --------- ----------------\n";
+
+  memset(&total, 0, sizeof(total));
+  num = 0;
+  for(i = 0; i <= SYSCOUNT_MAX_NR; i++) {
+    if(counts[i].calls == 0)
+      continue;
+    order[num++] = i;
+    total.calls += counts[i].calls;
+    total.errors += counts[i].errors;
+    total.setup += counts[i].setup;
+    total.ns += counts[i].ns;
+  }
+  qsort(order, num, sizeof(*order), count_cmp);
+
+  fprintf(stderr, "\n%% time     seconds  usecs/call     calls    errors     setup syscall\n%s",
+          rule);
+  for(i = 0; i < num; i++) {
+    const struct syscall_count *c = &counts[order[i]];
+    if(order[i] == SYSCOUNT_MAX_NR) {
+      name = "(other)";
+    }
+    else if((name = syscall_names[order[i]]) == NULL) {
+      snprintf(number, sizeof(number), "syscall_%d", order[i]);
+      name = number;
+    }
+    fprintf(stderr, "%6.2f %11.6f %11llu %9llu %9llu %9llu %s\n",
+            total.ns ? 100.0 * c->ns / total.ns : 0.0, c->ns / 1e9,
+            (unsigned long long) (c->ns / 1000 / c->calls), (unsigned long long) c->calls,
+            (unsigned long long) c->errors, (unsigned long long) c->setup, name);
+  }
+  fprintf(stderr, "%s%6.2f %11.6f %11s %9llu %9llu %9llu total\n", rule, 100.0, total.ns / 1e9, "",
+          (unsigned long long) total.calls, (unsigned long long) total.errors,
+          (unsigned long long) total.setup);
+}
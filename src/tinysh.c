@@ -13,7 +13,28 @@
  * */
 
 
+#define _GNU_SOURCE  // pipe2
+
 #include "tinysh.h"
+#include "memo.h"
+#include "zygote.h"
+#include "cmdhash.h"
+#include "serve.h"
+#include "trace.h"
+#include "stats.h"
+#include "pipeline.h"
+#include "mem.h"
+#include "syscount.h"
+#include "explain.h"
+#include "optimize.h"
+#include "builtins.h"
+#include "vars.h"
+#include "arith.h"
+#include "expand.h"
+#include "pattern.h"
+#include "read.h"
+#include "interp.h"
+#include "redirect.h"
 #include <stdio.h>
 #include <unistd.h>
 #include <getopt.h>
@@ -23,6 +44,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <errno.h>
 #include <limits.h>
 
@@ -37,21 +59,36 @@
 
 static char **path;
 static int path_flag;
-static int verbose_flag;
+static int zygote_flag;
+static int buffered_flag;  // 1 if stdout is fully buffered, and flushed by the shell.
+static char stdout_buf[BUFSIZ];  // Buffer for stdout in buffered mode.
+int last_status;          // Exit status of the last command.
 static int saved_stdout;  // Saved stdout file descriptor.
 static int stdout_flag;  // 1 if stdout has been saved, 0 if not.
 // TODO:  Add static context struct for stateful verbose mode.
 
+static void release_memory(void);
+static void free_cmds(char **cmds);
+static int optimized_dispatch(char **cmds, size_t num_cmds);
+static int redirected_dispatch(const struct command *c, char **cmds, size_t num_cmds,
+                               int *exit_flag);
+static int calls_function(char **cmd);
+
 /* *
  * Main function.  Handles program argument processing.  The core shell driving takes place
  * in the function "driver".
  * */
 int main(int argc, char *argv[]) {
-  int option_index, c;
+  int option_index, c, serve_status;
+  char *serve_path = NULL;  // Socket to serve commands on, if running in daemon mode.
   // Long options struct for getopt_long.
   struct option long_options[] = {
     {"path", required_argument, &path_flag, 1},
-    {"verbose", no_argument, &verbose_flag, 1},
+    {"verbose", optional_argument, 0, 'v'},
+    {"zygote", no_argument, &zygote_flag, 1},
+    {"buffered", no_argument, 0, 'b'},
+    {"serve", required_argument, 0, 's'},
+    {"trace", required_argument, 0, 't'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -61,7 +98,7 @@ int main(int argc, char *argv[]) {
   stdout_flag = 0;
 
   // Option processing.
-  while((c = getopt_long(argc, argv, "p:hv", long_options, &option_index)) != -1) {
+  while((c = getopt_long(argc, argv, "p:hv::zbs:t:", long_options, &option_index)) != -1) {
     switch(c) {
       // Option sets a flag.
       case 0:
@@ -84,8 +121,8 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
           }
         }
-        else if(verbose_flag) {
-          printf("Running in verbose mode.\n");
+        else if(zygote_flag) {
+          break;
         }
         else {
           fprintf(stderr, "Error processing shell arguments.\n");
@@ -118,9 +155,39 @@ int main(int argc, char *argv[]) {
         }
         break;
 
+      // Verbose option, optionally limited to a list of categories.
       case 'v':
-        verbose_flag = 1;
+#ifdef NVERBOSE
+        printf("Verbose mode is not available in this build of tinysh.\n");
+#else
+        if(verbose_enable(optarg, V_MAX_LEVEL) == -1) {
+          usage(argv[0]);
+          exit(EXIT_FAILURE);
+        }
         printf("Running in verbose mode.\n");
+#endif
+        break;
+
+      // Zygote short option.
+      case 'z':
+        zygote_flag = 1;
+        break;
+
+      // Buffered output option.
+      case 'b':
+        buffered_flag = 1;
+        break;
+
+      // Serve option.
+      case 's':
+        serve_path = optarg;
+        break;
+
+      // Trace option.
+      case 't':
+        if(trace_open(optarg) == -1) {
+          printf("Unable to open the trace file, so tracing is disabled.\n");
+        }
         break;
 
       // Unrecognized option character or missing option argument.
@@ -128,6 +195,12 @@ int main(int argc, char *argv[]) {
         if(optopt && (optopt == 'p')) {
           printf("Please provide a path file when using the path option.\n");
         }
+        else if(optopt && (optopt == 's')) {
+          printf("Please provide a socket path when using the serve option.\n");
+        }
+        else if(optopt && (optopt == 't')) {
+          printf("Please provide a trace file when using the trace option.\n");
+        }
         usage(argv[0]);
         exit(EXIT_FAILURE);
         break;  // Shouldn't be reached.
@@ -138,10 +211,37 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  // In buffered mode, output is only written when the buffer fills or the shell flushes it: before
+  // it forks (so that no child inherits and repeats it), before it waits for a line of input, and
+  // when it exits.
+  // stdout was made unbuffered above, so it has to be given a real buffer back.
+  if(buffered_flag)
+    setvbuf(stdout, stdout_buf, _IOFBF, sizeof(stdout_buf));
+
+  // In daemon mode, serve command lines from the socket instead of reading them from stdin.  The
+  // workers run requests concurrently, so they fork for themselves rather than share a zygote.
+  if(serve_path != NULL) {
+    serve_status = serve_run(serve_path);
+    trace_close();
+    release_memory();
+    return serve_status == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  // Start the fork server before the shell's heap grows, so that it stays small.
+  if(zygote_flag && zygote_start() == -1) {
+    printf("Unable to start the fork server, so the shell will fork commands itself.\n");
+  }
+
   // Pass off to shell driver.
   if(driver() == -1) {
+    zygote_stop();
+    trace_close();
+    release_memory();
     return EXIT_FAILURE;  
   }
+  zygote_stop();
+  trace_close();
+  release_memory();
   // If reached, user has exited the shell.
   return EXIT_SUCCESS;
 }
@@ -182,7 +282,7 @@ int set_path(char *file_path) {
     printf("Obtaining path from the following file: %s", file_path);
     capacity = DEFAULT_PATH_CAPACITY;
     // Allocate space for DEFAULT_PATH_CAPACITY path strings.
-    if((path = calloc(capacity, sizeof(*path))) == NULL) {
+    if((path = mem_calloc(MEM_PATH, capacity, sizeof(*path))) == NULL) {
       perror("Error allocating memory for path.");
       path_flag = 0;
       fclose(fp);
@@ -202,20 +302,20 @@ int set_path(char *file_path) {
 
     num_paths = 0;
     ind = 0;
-    while((num_chars = getline(&path[ind], &num_paths, fp)) != -1) {
+    while((num_chars = mem_getline(MEM_PATH, &path[ind], &num_paths, fp)) != -1) {
       if(++ind == capacity) {
-        if((path = realloc(path, (capacity *= 2) * sizeof(*path))) == NULL) {
+        if((path = mem_realloc(MEM_PATH, path, (capacity *= 2) * sizeof(*path))) == NULL) {
           perror("Error reallocating memory for path.");
           while(path && *path)
-            free(*path++);
-          free(path);
+            mem_free(MEM_PATH, *path++);
+          mem_free(MEM_PATH, path);
           /* free(num_chars); */
           path_flag = 0;
           fclose(fp);
           return -1;
         }
         else {
-          memset(&path[ind], 0, capacity - ind - 1);
+          memset(&path[ind], 0, (capacity - ind) * sizeof(*path));
         }
         /* if((num_chars = realloc(num_chars, capacity * sizeof(*num_chars))) == NULL) { */
         /*   perror("Error reallocating memory for path lengths."); */
@@ -239,6 +339,47 @@ int set_path(char *file_path) {
   }
 }
 
+/* *
+ * Returns - The paths read from the path file, or NULL if the shell is using the path defined by
+ *           the user's environment.
+ * */
+char** path_dirs(void) {
+  return path_flag ? path : NULL;
+}
+
+/* *
+ * Releases the memory the shell keeps for its whole life (the path, the command hash, the command
+ * statistics, the functions, the variables, and the compiled expressions), then reports anything
+ * that is still allocated as leaked.
+ * */
+static void release_memory(void) {
+  char **temp;
+  for(temp = path; temp && *temp; temp++)
+    mem_free(MEM_PATH, *temp);
+  mem_free(MEM_PATH, path);
+  path = NULL;
+  path_flag = 0;
+  cmdhash_clear();
+  stats_clear();
+  interp_clear();
+  command_clear();
+  vars_clear();
+  arith_clear();
+  pattern_clear();
+  read_clear();
+  mem_leak_report();
+}
+
+/* *
+ * Frees the command line cmds and each of its commands.
+ * */
+static void free_cmds(char **cmds) {
+  char **temp = cmds;
+  while(temp && *temp)
+    mem_free(MEM_PARSE, *temp++);
+  mem_free(MEM_PARSE, cmds);
+}
+
 /* *
  * The main shell driver.
  * */
@@ -246,14 +387,15 @@ int driver() {
   /* int size;                  // Holds the number of commands. */
   size_t input_size;            // Number of bytes in the input buffer.
   size_t num_cmds;              // Number of commands.
-  ssize_t chars_read;           // Number of characters read by getline.
+  ssize_t chars_read;           // Number of characters read by mem_getline.
   int exit_flag;                // Exit flag is set to 1 if we receive the "exit" command.
   int command_status;           // Status indicating the successfulness of the command.
   /* CmdList *cmd_list;            // Struct to contain list of commands and number of commmands. */
   char *input;                  // Holds the commands provided by the user.
   char **cmds;                  // Holds the list of commands.
-  char **temp;
-  const char *delim = " \t\n";  // Command and argument delimiters.
+  uint64_t start;               // Start time of the command, for tracing.
+  uint64_t parse_start;         // Start time of tokenizing, for the command statistics.
+  const char *delim = CMD_DELIMITERS;  // Command and argument delimiters.
   if(!path_flag) {
     printf("Using the path defined by your environment.\n");
   }
@@ -274,11 +416,13 @@ int driver() {
   command_status = 1;
   while(!exit_flag) {
     printf("tinysh> ");  // Prompt.
+    fflush(stdout);
 
     // Reads in a line of commands from the user, storing the commands in input and the allocated
-    // size in size.
-    if((chars_read = getline(&input, &input_size, stdin)) < 0) {
-      free(input);
+    // size in size.  The buffer is kept from line to line, so it is only reallocated for a line
+    // longer than any before it.
+    if((chars_read = mem_getline(MEM_PARSE, &input, &input_size, stdin)) < 0) {
+      mem_free(MEM_PARSE, input);
       input = NULL;
       input_size = 0;
       if(!feof(stdin)) {
@@ -287,7 +431,7 @@ int driver() {
       }
       // At this point, we've encountered an EOF signal from stdin (i.e. CTRL + D on Linux.)
       // Standard procedure here is to exit with success.
-      if(verbose_flag)
+      if(VERBOSE(V_PROC))
         printf("\nEncountered EOF, it looks like you pressed CTRL + D.\nExiting now...\n\n");
       exit_flag = 1;
       command_status = 1;
@@ -299,63 +443,58 @@ int driver() {
     num_cmds = chars_read >= 0 ? (size_t) chars_read : 0;
     
     // Get the command list and the number of commands.
+    TRACE_BEGIN(start);
+    parse_start = stats_now();
     cmds = tokenizer(input, delim, &num_cmds);
-    free(input);
+    TRACE_END("tokenize", "parse", start, input);
 
     // If no commands are provided, reprompt the user.
     if((cmds == NULL) || (cmds[0] == NULL)) {
-      input = NULL;
-      input_size = 0;
+      stats_parsed(stats_now() - parse_start);
       command_status = 0;
       if(cmds != NULL)
-        free(cmds);
+        mem_free(MEM_PARSE, cmds);
       continue;
     }
 
-    if(verbose_flag)
+    if(VERBOSE(V_ALL))
       printf("\n");
-
-    // Dispatch to the correct command handler based on the first command.
-    if(strcmp(cmds[0], "exit") == 0) {
-      exit_flag = 1;
-      command_status = 0;
-    }
-    else if(strcmp(cmds[0], "verbose") == 0) {
-      verbose_flag = 1;
-      command_status = 0;
-      if(verbose_flag)
-        printf("Verbose mode is turned on.\n\n");
-    }
-    else if(strcmp(cmds[0], "brief") == 0) {
-      if(verbose_flag)
-        printf("Turning off verbose mode.\n\n");
-      verbose_flag = 0;
-      command_status = 0;
-    }
-    else if(strcmp(cmds[0], "help") == 0) {
-      if(cmds[1] != NULL) {
-        help_handle(cmds[1]);
-        if(verbose_flag)
-          printf("Printing help information for %s...\n\n", cmds[1]);
-      }
-      else {
-        if(verbose_flag)
-          printf("Printing help information...\n\n");
-        shell_help();
-      }
-      command_status = 0;
-    }
-    else if(strcmp(cmds[0], "pwd") == 0) {
-      command_status = pwd_handle(cmds, num_cmds);
-    }
-    else if(strcmp(cmds[0], "cd") == 0) {
-      command_status = cd_handle(cmds, num_cmds);
+    if(VERBOSE_AT(V_LEVEL_DETAILS, V_PARSE))
+      printf("Tokenized the command line into %zu commands and arguments.\n", num_cmds);
+
+    // Lists and loops are run by the interpreter, which expands and dispatches each command itself,
+    // reading the rest of an unfinished loop from stdin.
+    if(interp_wants(cmds)) {
+      stats_parsed(stats_now() - parse_start);
+      TRACE_BEGIN(start);
+      command_status = interp_line(&cmds, &num_cmds, stdin, &exit_flag);
+      TRACE_END("command", "shell", start, cmds[0]);
+      trace_flush();
+      free_cmds(cmds);
+      if(!exit_flag)
+        mem_line_report();
+      continue;
     }
-    else {
-      command_status = exec_dispatch(cmds, num_cmds);
+
+    // Expand the variables and arithmetic in the commands.  A line may expand to nothing.
+    TRACE_BEGIN(start);
+    command_status = expand_line(&cmds, &num_cmds);
+    stats_parsed(stats_now() - parse_start);
+    TRACE_END("expand", "parse", start, input);
+    if(command_status == -1 || cmds[0] == NULL) {
+      if(command_status == -1)
+        last_status = EXIT_FAILURE;
+      free_cmds(cmds);
+      continue;
     }
 
-    if(verbose_flag && !exit_flag) {
+    // Dispatch to the correct command handler based on the first command.
+    TRACE_BEGIN(start);
+    command_status = cmd_dispatch(cmds, num_cmds, &exit_flag);
+    TRACE_END("command", "shell", start, cmds[0]);
+    trace_flush();
+
+    if(VERBOSE(V_PROC) && !exit_flag) {
       printf("\n");
       if(command_status == -1) {
         printf("Previous command failed.\n\n");
@@ -365,16 +504,17 @@ int driver() {
       }
     }
     
-    temp = cmds;
-    // Free each command in the command list.
-    while(temp && *temp) {
-      free(*temp++);
+    // Free each command in the command list, and the list itself.
+    free_cmds(cmds);
+    if(!exit_flag) {
+      if(VERBOSE_AT(V_LEVEL_DETAILS, V_MEM))
+        printf("Freed the list of commands and arguments.\n");
+      mem_line_report();
+      if(VERBOSE(V_MEM))
+        printf("\n");
     }
-    // Free the command list itself.
-    free(cmds);
-    input = NULL;
-    input_size = 0;
   }
+  mem_free(MEM_PARSE, input);
 
   // Exit flag must have been set, so we are exiting now.
   printf("Exiting now.  Thanks for using tinysh!\n");
@@ -382,6 +522,227 @@ int driver() {
   return 0;
 }
 
+/* *
+ * Dispatches a tokenized command line to the builtin or command handler named by its first
+ * command.  exit_flag is set to 1 if the line asks the shell to exit.
+ *
+ * Returns - The status of the command (0 on success, -1 on failure.)
+ * */
+int cmd_dispatch(char **cmds, size_t num_cmds, int *exit_flag) {
+  int command_status;
+  const struct command *c;
+
+  // A function shadows the builtin of the same name, since the two share one table (see
+  // command_lookup in builtins.c), so it is looked up before the builtins below.
+  if((c = command_lookup(cmds[0])) != NULL && c->func != NULL) {
+    if(redirect_only(cmds))
+      return redirected_dispatch(c, cmds, num_cmds, exit_flag);
+    if(!is_special_feature(cmds))
+      return interp_call(c->func, cmds, num_cmds, exit_flag);
+    // With pipes, the function runs in the process forked for its stage (see exec.)
+    return optimized_dispatch(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "exit") == 0) {
+    *exit_flag = 1;
+    command_status = 0;
+  }
+  else if(vars_assignments(cmds)) {
+    command_status = assign_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "verbose") == 0) {
+    command_status = verbose_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "brief") == 0) {
+    command_status = brief_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "help") == 0) {
+    if(cmds[1] != NULL) {
+      help_handle(cmds[1]);
+      if(VERBOSE(V_PROC))
+        printf("Printing help information for %s...\n\n", cmds[1]);
+    }
+    else {
+      if(VERBOSE(V_PROC))
+        printf("Printing help information...\n\n");
+      shell_help();
+    }
+    command_status = 0;
+  }
+  else if(strcmp(cmds[0], "pwd") == 0 && !is_special_feature(cmds)) {
+    command_status = pwd_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "cd") == 0) {
+    command_status = cd_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "hash") == 0) {
+    command_status = hash_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "stats") == 0) {
+    command_status = stats_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "mem") == 0) {
+    command_status = mem_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "explain") == 0) {
+    command_status = explain_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "syscount") == 0) {
+    // syscount_handle records the exit status of the command itself.
+    return syscount_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "time") == 0) {
+    // time_handle records the exit status of the pipeline itself.
+    return time_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "memo") == 0 && !is_special_feature(cmds)) {
+    // memo_handle records the exit status of the command itself.
+    return memo_handle(cmds, num_cmds);
+  }
+  else if(strcmp(cmds[0], "[[") == 0) {
+    // [[ ]] records its exit status itself.  Its < and > are comparisons, so it never redirects.
+    if(VERBOSE(V_PROC))
+      printf("Running the builtin %s in the shell process.\n", cmds[0]);
+    return cond_handle(cmds, num_cmds);
+  }
+  else if(redirect_only(cmds) && (c = command_lookup(cmds[0])) != NULL) {
+    // A builtin or function with redirections, but no pipes, runs in the shell process,
+    // with its < file, > file, and >> file made there (see redirect.c.)
+    return redirected_dispatch(c, cmds, num_cmds, exit_flag);
+  }
+  else if(!is_special_feature(cmds) && (c = command_lookup(cmds[0])) != NULL) {
+    // Functions, and echo, printf, test, true, false, etc., record their exit status themselves.
+    // With pipes, builtins are run as pipeline stages instead (see optimize.c.)
+    if(c->func != NULL)
+      return interp_call(c->func, cmds, num_cmds, exit_flag);
+    if(VERBOSE(V_PROC))
+      printf("Running the builtin %s in the shell process.\n", cmds[0]);
+    return c->handler(cmds, num_cmds);
+  }
+  else {
+    // pipeline_dispatch and exec_dispatch record the exit status of the command themselves.
+    return optimized_dispatch(cmds, num_cmds);
+  }
+  last_status = command_status == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+  return command_status;
+}
+
+/* *
+ * Runs the command line cmds, as optimized by optimize_line, with pipeline_dispatch if it was
+ * rewritten, or with exec_dispatch if not.
+ * */
+static int optimized_dispatch(char **cmds, size_t num_cmds) {
+  int status;
+  struct pipeline pl;
+  if((status = optimize_line(cmds, &pl, NULL)) == 0)
+    return exec_dispatch(cmds, num_cmds);
+  if(status == -1) {
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  status = pipeline_dispatch(&pl);
+  pipeline_free(&pl);
+  return status;
+}
+
+/* *
+ * Runs the builtin or function c for the command line cmds in the shell process, with the
+ * redirections of the line taken out of its arguments, made before it runs, and undone after it.
+ * exit_flag is set to 1 if a function asks the shell to exit.
+ *
+ * Returns - The status of the command (0 on success, -1 on failure.)
+ * */
+static int redirected_dispatch(const struct command *c, char **cmds, size_t num_cmds,
+                               int *exit_flag) {
+  char **argv, *file;
+  size_t i, argc, num;
+  int status = 0;
+  struct redirect *redirs;
+
+  argv = mem_malloc(MEM_EXEC, (num_cmds + 1) * sizeof(*argv));
+  redirs = mem_malloc(MEM_EXEC, num_cmds * sizeof(*redirs));
+  if(argv == NULL || redirs == NULL) {
+    perror("Error allocating memory.");
+    mem_free(MEM_EXEC, argv);
+    mem_free(MEM_EXEC, redirs);
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  for(i = 0, argc = 0, num = 0; status == 0 && cmds[i] != NULL; i++) {
+    if(!redirect_op(cmds[i])) {
+      argv[argc++] = cmds[i];
+      continue;
+    }
+    if(cmds[i + 1] == NULL || redirect_op(cmds[i + 1])) {
+      fprintf(stderr, "Error:  A redirection must be followed by a file name.\n");
+      status = -1;
+      break;
+    }
+    file = cmds[++i];
+    if((status = redirect_open(cmds[i - 1], file, &redirs[num])) == 0)
+      num++;
+  }
+  argv[argc] = NULL;
+  if(status == 0 && c->func != NULL) {
+    status = interp_call(c->func, argv, argc, exit_flag);
+  }
+  else if(status == 0) {
+    if(VERBOSE(V_PROC))
+      printf("Running the builtin %s in the shell process.\n", argv[0]);
+    status = c->handler(argv, argc);
+  }
+  else {
+    last_status = EXIT_FAILURE;
+  }
+  // Undo the redirections in reverse, so that the shell's own descriptors come back last.
+  while(num > 0)
+    redirect_restore(&redirs[--num]);
+  mem_free(MEM_EXEC, redirs);
+  mem_free(MEM_EXEC, argv);
+  return status;
+}
+
+/* *
+ * Returns - 1 if cmd_dispatch runs the command line cmds as a builtin or a function, 0 if it hands
+ *           the line to exec_dispatch.
+ * */
+int is_builtin(char **cmds) {
+  static const char *builtins[] = {
+    "exit", "verbose", "brief", "help", "cd", "hash", "stats", "mem", "explain", "syscount",
+    "time", "[[", NULL
+  };
+  const char **name;
+  const struct command *c;
+  if((c = command_lookup(cmds[0])) != NULL && c->func != NULL)
+    return redirect_only(cmds) || !is_special_feature(cmds);
+  for(name = builtins; *name != NULL; name++) {
+    if(strcmp(cmds[0], *name) == 0)
+      return 1;
+  }
+  if(vars_assignments(cmds))
+    return 1;
+  // A builtin or function with redirections, but no pipes, runs in the shell around them.
+  if(redirect_only(cmds) && command_lookup(cmds[0]) != NULL)
+    return 1;
+  // These builtins run in the shell only when the line has no pipes or redirections.
+  return (strcmp(cmds[0], "memo") == 0 || strcmp(cmds[0], "pwd") == 0
+          || command_lookup(cmds[0]) != NULL) && !is_special_feature(cmds);
+}
+
+/* *
+ * Returns - 1 if a command of the line cmd (its first word, or one after a pipe) is a function,
+ *           0 if not.
+ * */
+static int calls_function(char **cmd) {
+  size_t i;
+  const struct command *c;
+  for(i = 0; cmd[i] != NULL; i++) {
+    if((i == 0 || strcmp(cmd[i - 1], "|") == 0) && (c = command_lookup(cmd[i])) != NULL
+       && c->func != NULL)
+      return 1;
+  }
+  return 0;
+}
+
 /* *
  * Tokenizer with the following features:
  *   - Thread-safe
@@ -401,16 +762,16 @@ char** tokenizer(const char *input, const char *delim, size_t *tok_num) {
   capacity = *tok_num > 0 ? (*tok_num / TOKEN_FACTOR_HEURISTIC) + 1 : DEFAULT_TOKENS_CAPACITY;
   
   // Duplicate the input string so the provided input string is not modified.
-  if((str = strdup(input)) == NULL) {
+  if((str = mem_strdup(MEM_PARSE, input)) == NULL) {
     perror("Error allocating memory for input string copy.");
     exit(EXIT_FAILURE);
   }
   // Set context equal to the input string.
   context = str;
   // Allocate space for (capacity) number of commands in the token list.
-  if((tokens = malloc(capacity * sizeof(*tokens))) == NULL) {
+  if((tokens = mem_malloc(MEM_PARSE, capacity * sizeof(*tokens))) == NULL) {
     perror("Error allocating memory.");
-    free(str);
+    mem_free(MEM_PARSE, str);
     exit(EXIT_FAILURE);
   }
 
@@ -431,13 +792,13 @@ char** tokenizer(const char *input, const char *delim, size_t *tok_num) {
     // Check if our list of tokens is at capacity.
     if(tok_used == capacity) {
       // If so, reallocate tokens with twice the capacity.
-      if((tokens = realloc(tokens, (capacity *= 2) * sizeof(*tokens))) == NULL) {
+      if((tokens = mem_realloc(MEM_PARSE, tokens, (capacity *= 2) * sizeof(*tokens))) == NULL) {
         perror("Error reallocating memory for tokens.");
         int i = tok_used;
         while((--i >= 0) && (tokens[i]))
-          free(tokens[i]);
-        free(tokens);
-        free(str);
+          mem_free(MEM_PARSE, tokens[i]);
+        mem_free(MEM_PARSE, tokens);
+        mem_free(MEM_PARSE, str);
         exit(EXIT_FAILURE);
       }
     }
@@ -448,21 +809,21 @@ char** tokenizer(const char *input, const char *delim, size_t *tok_num) {
     //       context string, terminated by the null byte ('\0') where the token-terminating
     //       delimiter was before the previous execution of strtok_r (or, if tok is the last
     //       token in context, then it will already be terminated by the null byte.)
-    tokens[tok_used++] = strdup(tok);
+    tokens[tok_used++] = mem_strdup(MEM_PARSE, tok);
   }
 
   if(tok_used == 0) {
-    free(tokens);
+    mem_free(MEM_PARSE, tokens);
     tokens = NULL;
   }
   else {
-    if((tokens = realloc(tokens, (tok_used + 1) * sizeof(*tokens))) == NULL) {
+    if((tokens = mem_realloc(MEM_PARSE, tokens, (tok_used + 1) * sizeof(*tokens))) == NULL) {
         perror("Error reallocating memory for tokens.");
         int i = tok_used;
         while((--i >= 0) && (tokens[i]))
-          free(tokens[i]);
-        free(tokens);
-        free(str);
+          mem_free(MEM_PARSE, tokens[i]);
+        mem_free(MEM_PARSE, tokens);
+        mem_free(MEM_PARSE, str);
         exit(EXIT_FAILURE);
     }
     tokens[tok_used] = NULL; 
@@ -470,7 +831,7 @@ char** tokenizer(const char *input, const char *delim, size_t *tok_num) {
   
   *tok_num = tok_used;  // Doesn't include null-terminating pointer.
 
-  free(str);
+  mem_free(MEM_PARSE, str);
   return tokens;
 }
 
@@ -479,57 +840,123 @@ char** tokenizer(const char *input, const char *delim, size_t *tok_num) {
  * command handler.
  * */
 int exec_dispatch(char **cmd, size_t num_cmd) {
-  int p_id, status, type;
+  int p_id, status, exec_pipe[2];
+  char c;
+  uint64_t start, spawn_start;
+  struct stats_sample sample;
+  // Resolve the line's commands before forking, so that the results stay in the shell's hash.
+  cmdhash_warm(cmd);
+  memset(&sample, 0, sizeof(sample));
+  // Write out buffered output before the child (or the zygote's child) starts writing its own.
+  fflush(stdout);
+  // In zygote mode, the fork server forks the child on the shell's behalf.
+  TRACE_BEGIN(start);
+  spawn_start = stats_now();
+  // The zygote was forked before any function was defined, so it cannot run one.
+  if(zygote_active() && !calls_function(cmd) && zygote_spawn(cmd, &status, &sample.usage) == 0) {
+    TRACE_END("zygote_spawn", "proc", start, cmd[0]);
+    // The zygote does not report when the child started, so only the totals are known.
+    sample.spawn_ns = sample.wall_ns = stats_now() - spawn_start;
+    stats_record(cmd[0], &sample);
+    return wait_status_handle(status);
+  }
+
+  // The child holds the write end of this pipe until it executes a program (or exits), at which
+  // point the read end sees EOF, telling the shell how long the command took to start.
+  if(pipe2(exec_pipe, O_CLOEXEC) < 0) {
+    perror("Error creating pipe.");
+    return -1;
+  }
+
+  TRACE_BEGIN(start);
+  spawn_start = stats_now();
   if((p_id = fork()) < 0) {
     perror("Error forking a process.");
+    close(exec_pipe[READ_END]);
+    close(exec_pipe[WRITE_END]);
     return -1;
   }
+  if(p_id != 0) {
+    sample.spawn_ns = stats_now() - spawn_start;
+    TRACE_END("fork", "proc", start, cmd[0]);
+  }
 
-  if(verbose_flag && p_id != 0) 
+  if(VERBOSE(V_PROC) && p_id != 0) 
     printf("Creating a child process to run the command: %s\n", cmd[0]);
 
   // Child process
   if(p_id == 0) {
-    if(verbose_flag)
+    close(exec_pipe[READ_END]);
+    if(VERBOSE(V_PROC))
       printf("Child:\n");
-    if((type = is_special_feature(cmd)) > 0) {
-      status = special_command(cmd, num_cmd, type);
-    }
-    else {
-      if(verbose_flag) {
-        printf("  Executing %s...\n\n", cmd[0]);
-        printf("Program Output:\n\n");
-      }
-      status = exec(cmd);
-    }
+    status = child_handle(cmd, num_cmd);
 
     char** temp = cmd;
     // Free each command in the command list.
     while(temp && *temp) {
-      free(*temp++);
+      mem_free(MEM_PARSE, *temp++);
     }
     // Free the command list itself.
-    free(cmd);
-    _Exit(status != -1 ? EXIT_SUCCESS : EXIT_FAILURE);
+    mem_free(MEM_PARSE, cmd);
+    fflush(stdout);
+    _Exit(status != -1 ? status : EXIT_FAILURE);
   }
   // Parent process
   else {
-    if(verbose_flag) {
+    if(VERBOSE(V_PROC)) {
       printf("Parent:\n  Waiting for child process to terminate.\n");
     }
-    if(wait(&status) < 0) {
+    close(exec_pipe[WRITE_END]);
+    // Write out the parent's messages before waiting, so they are not held back until after the
+    // child's output.
+    fflush(stdout);
+    while(read(exec_pipe[READ_END], &c, 1) < 0 && errno == EINTR)
+      ;
+    sample.exec_ns = stats_now() - spawn_start;
+    close(exec_pipe[READ_END]);
+    TRACE_BEGIN(start);
+    if(wait4(p_id, &status, 0, &sample.usage) < 0) {
       perror("Error waiting for a process.");
       return -1;
     }
-    
-    if(WIFSIGNALED(status) && ((WTERMSIG(status) == SIGINT) || (WTERMSIG(status) == SIGQUIT))) {
-      printf("Process executing a command was killed by the user.\n");
-      return -1;
-    }
+    TRACE_END("wait", "proc", start, cmd[0]);
+    sample.wall_ns = stats_now() - spawn_start;
+    stats_record(cmd[0], &sample);
+    return wait_status_handle(status);
+  }
+}
 
-    // Return status information.
-    return WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS) ? EXIT_SUCCESS : -1;
+/* *
+ * Runs cmd in a child process of the shell, either by dispatching to the special feature handlers
+ * or by executing it directly.
+ *
+ * Returns - The exit status for the child process (that of the command, for a redirection or a
+ *           pipe into one), or -1 on failure.
+ * */
+int child_handle(char **cmd, size_t num_cmd) {
+  int type;
+  if((type = is_special_feature(cmd)) > 0) {
+    return special_command(cmd, num_cmd, type);
   }
+  if(VERBOSE(V_PROC)) {
+    printf("  Executing %s...\n\n", cmd[0]);
+    printf("Program Output:\n\n");
+  }
+  return exec(cmd);
+}
+
+/* *
+ * Translates the wait status of a command's child process into a command status.
+ * */
+int wait_status_handle(int status) {
+  last_status = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+  if(WIFSIGNALED(status) && ((WTERMSIG(status) == SIGINT) || (WTERMSIG(status) == SIGQUIT))) {
+    printf("Process executing a command was killed by the user.\n");
+    return -1;
+  }
+
+  // Return status information.
+  return WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS) ? EXIT_SUCCESS : -1;
 }
 
 
@@ -562,68 +989,66 @@ int is_special_feature(char **cmd) {
  * Executes program specified by the cmd string array.
  * */
 int exec(char **cmd) {
-  int i;
-  char *curr_path;
-  // Check for existence of specified path.
-  if(!path_flag) {
-    if(verbose_flag) {
-      if(stdout_flag) {
-        //  Using 4-space indent since this should only happen on 2-depth forks (piping.)
-        /* dprintf(saved_stdout, "    Using execvp to execute the command: %s\n", cmd[0]); */
-        /* dup2(saved_stdout, STDOUT_FILENO); */
-        close(saved_stdout);
-        stdout_flag = 0;
-      }
-      else {
-        /* printf("  Using execvp to execute the command: %s\n", cmd[0]); */
-      }
+  const char *resolved;
+  const struct command *c;
+  size_t num;
+  int exit_flag = 0, status;
+  // The memo builtin can also appear as the head or tail of a special feature, in which case it
+  // runs here in place of the program it wraps.  _Exit would drop whatever is still buffered.
+  if(strcmp(cmd[0], "memo") == 0) {
+    status = memo_run(cmd);
+    fflush(stdout);
+    fflush(stderr);
+    _Exit(status);
+  }
+  // So can a function, or a stage of a pipeline be one, in which case it runs here, in the process
+  // that would have executed a program.
+  if((c = command_lookup(cmd[0])) != NULL && c->func != NULL) {
+    for(num = 0; cmd[num] != NULL; num++)
+      ;
+    interp_call(c->func, cmd, num, &exit_flag);
+    fflush(stdout);
+    _Exit(last_status);
+  }
+  // Whatever is still buffered would be lost by the exec.
+  fflush(stdout);
+
+  if(stdout_flag) {
+    //  Using 4-space indent since this should only happen on 2-depth forks (piping.)
+    /* dprintf(saved_stdout, "    Executing the command: %s\n", cmd[0]); */
+    close(saved_stdout);
+    stdout_flag = 0;
+  }
+
+  // If the command hash knows where the program lives, execute it directly instead of searching
+  // the path again.
+  if((resolved = cmdhash_lookup(cmd[0])) != NULL) {
+    TRACE_MARK("exec", "proc", resolved);
+    if(execv(resolved, cmd) == -1 && errno != ENOENT) {
+      perror("Error executing program.");
+      return -1;
     }
+    // The program has moved since it was remembered; search the path again.
+    cmdhash_forget(cmd[0]);
+  }
+
+  // Check for existence of specified path.
+  if(!path_flag || strchr(cmd[0], '/') != NULL) {
     // execvp, given a string without slashes, will search for said executable using
     // the user's path defined by their environment.
+    TRACE_MARK("exec", "proc", cmd[0]);
     if(execvp(cmd[0], cmd) == -1) {
       if(errno != ENOENT) {
         perror("Error executing program.");
       }
-      if(verbose_flag)
+      if(VERBOSE(V_PROC))
         printf("%s is not a valid command or program.\n\n", cmd[0]);
       return -1;
     }
     return -1;  // Should never be reached.
   }
-  else {
-    if(verbose_flag) {
-      if(stdout_flag) {
-        /* dprintf(saved_stdout, "    Searching the paths provided in the path file for the command: %s\n", cmd[0]); */
-        close(saved_stdout);
-        stdout_flag = 0;
-      }
-      else {
-        /* printf("  Searching the paths provided in the path file for the command: %s\n", cmd[0]); */
-      }
-    }
 
-    i = 0;
-    while((curr_path = path[i++]) != NULL) {
-      strcat(curr_path, cmd[0]);
-      if(verbose_flag) {
-        if(stdout_flag) {
-          //  Using 4-space indent since this should only happen on 2-depth forks (piping.)
-          /* dprintf(saved_stdout, "    Using execvp to execute the command: %s\n", cmd[0]); */
-          /* dup2(saved_stdout, STDOUT_FILENO); */
-          close(saved_stdout);
-          stdout_flag = 0;
-        }
-        else {
-          /* printf("  Using execvp to execute the command: %s\n", cmd[0]); */
-        }
-      }
-      if(execvp(curr_path, cmd) == -1) {
-        perror("Error executing program.");
-        return -1;
-      }
-    }
-  }
-  //  Should not be reached.
+  // The command hash has already searched the paths provided in the path file.
   fprintf(stderr, "Error:  Invalid command.\n");
   return -1;
 }
@@ -639,22 +1064,24 @@ int special_command(char **cmd, size_t num_cmd, int type) {
   // Set capacity to half the number of commands, if provided; else, default.
   capacity = num_cmd > 0 ? (num_cmd / 2) + 1 : DEFAULT_TOKENS_CAPACITY;
   char **head, **tail;
-  if((head = malloc(capacity * sizeof(*head))) == NULL) {
+  if((head = mem_malloc(MEM_EXEC, capacity * sizeof(*head))) == NULL) {
     perror("Error allocating memory.");
     return -1;
   }
-  if((tail = malloc(capacity * sizeof(*tail))) == NULL) {
+  if((tail = mem_malloc(MEM_EXEC, capacity * sizeof(*tail))) == NULL) {
     perror("Error allocating memory.");
-    free(head);
+    mem_free(MEM_EXEC, head);
     return -1;
   }
+  if(VERBOSE_AT(V_LEVEL_DETAILS, V_MEM))
+    printf("  Allocated lists for the commands before and after the special feature.\n");
   // Add cmds to head until special feature is encountered.
   while((strcmp(cmd[i], "|") != 0) && (strcmp(cmd[i], ">") != 0) && (strcmp(cmd[i], ">>") != 0)) {
     if(j >= capacity - 1) {
-      if((head = realloc(head, (capacity *= 2) * sizeof(*head))) == NULL) {
+      if((head = mem_realloc(MEM_EXEC, head, (capacity *= 2) * sizeof(*head))) == NULL) {
         perror("Error reallocating memory for head.");
-        free(head);
-        free(tail);
+        mem_free(MEM_EXEC, head);
+        mem_free(MEM_EXEC, tail);
         return -1;
       }
     }
@@ -666,10 +1093,10 @@ int special_command(char **cmd, size_t num_cmd, int type) {
   // Add the remaining cmds to tail.
   while(cmd[i] != NULL) {
     if(k >= capacity - 1) {
-      if((tail = realloc(tail, (capacity *= 2) * sizeof(*tail))) == NULL) {
+      if((tail = mem_realloc(MEM_EXEC, tail, (capacity *= 2) * sizeof(*tail))) == NULL) {
         perror("Error reallocating memory for tail.");
-        free(head);
-        free(tail);
+        mem_free(MEM_EXEC, head);
+        mem_free(MEM_EXEC, tail);
         return -1;
       }
     }
@@ -692,8 +1119,8 @@ int special_command(char **cmd, size_t num_cmd, int type) {
       handle_status = -1;
       fprintf(stderr, "Error:  Should not be reached!");
   }
-  free(head);
-  free(tail);
+  mem_free(MEM_EXEC, head);
+  mem_free(MEM_EXEC, tail);
   return handle_status;
 }
 
@@ -702,16 +1129,21 @@ int special_command(char **cmd, size_t num_cmd, int type) {
  * */
 int pipe_handle(char **head, char **tail) {
   int p_id, status, pipefd[2], tail_type;
-  if(verbose_flag)
+  uint64_t start;
+  if(VERBOSE(V_PARSE))
     printf("  Piping:  %s --> %s\n", head[0], tail[0]);
   // Successful piping.
+  TRACE_BEGIN(start);
   if(pipe(pipefd) < 0) {
     perror("Error creating pipe.");
     return -1;
   } 
-  if(verbose_flag)
+  TRACE_END("pipe", "fd", start, head[0]);
+  if(VERBOSE(V_FD))
     printf("  Creating a pipe for interprocess communication.\n");
   // Create child process for executing command in head.
+  fflush(stdout);
+  TRACE_BEGIN(start);
   if((p_id = fork()) < 0) {
     perror("Error forking a process.");
     if(close(pipefd[READ_END]) < 0)
@@ -720,24 +1152,28 @@ int pipe_handle(char **head, char **tail) {
       perror("Error closing file descriptor.");
     return -1;
   }
-  if(verbose_flag && p_id != 0)
+  if(p_id != 0)
+    TRACE_END("fork", "proc", start, head[0]);
+  if(VERBOSE(V_PROC) && p_id != 0)
     printf("  Creating a child process for the command:  %s\n", head[0]);
 
   // Child process used to execute the head command.
   if(p_id == 0) {
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       printf("  Child:\n");
     // Close unused read end of the pipe.
+    TRACE_BEGIN(start);
     if(close(pipefd[READ_END]) < 0) {
       perror("Error closing file descriptor.");
       if(close(pipefd[WRITE_END]) < 0)
         perror("Error closing file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("close", "fd", start, "pipe read end");
+    if(VERBOSE(V_FD))
       printf("    Closing the read end of the pipe.\n");
     // Save stdout so we can continue to print in verbose mode.
-    if(verbose_flag && !stdout_flag) {
+    if(VERBOSE(V_FD | V_PROC) && !stdout_flag) {
       if((saved_stdout = dup(STDOUT_FILENO)) == -1) {
         perror("Error duplicating stdout file descriptor.");
         if(close(pipefd[WRITE_END]) < 0)
@@ -746,22 +1182,28 @@ int pipe_handle(char **head, char **tail) {
       }
       stdout_flag = 1;
     }
-    // Redirect standard output to the write end of the pipe.
+    // Redirect standard output to the write end of the pipe, once the child's own messages are
+    // out of the buffer.
+    fflush(stdout);
+    TRACE_BEGIN(start);
     if(dup2(pipefd[WRITE_END], STDOUT_FILENO) < 0) {
       perror("Error duplicating file descriptor.");
       if(close(pipefd[WRITE_END]) < 0)
         perror("Error closing file descriptor.");
       return -1;
     }
-    if(verbose_flag) {
+    TRACE_END("dup2", "fd", start, "pipe write end -> stdout");
+    if(VERBOSE(V_FD))
       dprintf(saved_stdout, "    Duplicating the file descriptor of the write end of the pipe as stdout.\n");
+    if(VERBOSE(V_PROC))
       dprintf(saved_stdout, "    Executing the head command:  %s\n", head[0]);
-    }
     // Close write end of the pipe.
+    TRACE_BEGIN(start);
     if(close(pipefd[WRITE_END]) < 0) {
       perror("Error closing file descriptor.");
       return -1;
     }
+    TRACE_END("close", "fd", start, "pipe write end");
     // Execute head command, which will output into the write end of the pipe.
     exec(head);
     return -1;  // Shouldn't be reached.
@@ -769,6 +1211,8 @@ int pipe_handle(char **head, char **tail) {
   // Parent process.
   else {
     // Wait for child process to finish.
+    fflush(stdout);
+    TRACE_BEGIN(start);
     if(waitpid(p_id, &status, 0) < 0) {
       perror("Error waiting for child process.");
       if(close(pipefd[READ_END]) < 0)
@@ -777,10 +1221,12 @@ int pipe_handle(char **head, char **tail) {
         perror("Error closing file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("wait", "proc", start, head[0]);
+    if(VERBOSE(V_PROC))
       printf("  Parent:\n    Waiting for child process to terminate.\n");
 
     // Redirect standard input to the read end of the pipe.
+    TRACE_BEGIN(start);
     if(dup2(pipefd[READ_END], STDIN_FILENO) < 0) {
       perror("Error duplicating file descriptor.");
       if(close(pipefd[READ_END]) < 0)
@@ -789,34 +1235,37 @@ int pipe_handle(char **head, char **tail) {
         perror("Error closing file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("dup2", "fd", start, "pipe read end -> stdin");
+    if(VERBOSE(V_FD))
       printf("    Duplicating the file descriptor of the read end of the pipe as stdin.\n");
 
     // Close read end of pipe.
+    TRACE_BEGIN(start);
     if(close(pipefd[READ_END]) < 0) {
       perror("Error closing file descriptor.");
       if(close(pipefd[WRITE_END]) < 0)
         perror("Error closing file descriptor.");
       return -1;
     }
+    TRACE_END("close", "fd", start, "pipe read end");
 
     // Close write end of pipe.
+    TRACE_BEGIN(start);
     if(close(pipefd[WRITE_END]) < 0) {
       perror("Error closing file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("close", "fd", start, "pipe write end");
+    if(VERBOSE(V_FD))
       printf("    Closing both ends of the pipe.\n");
 
     // If tail consists of a special feature, route tail to special_command.
     if((tail_type = is_special_feature(tail)) > 0) {
-      if(verbose_flag)
+      if(VERBOSE(V_PARSE))
         printf("    Tail command consists of special feature.\n");
-      if(special_command(tail, 0, tail_type) == -1)
-        return -1;
-      return 0;
+      return special_command(tail, 0, tail_type);
     }
-    if(verbose_flag) {
+    if(VERBOSE(V_PROC)) {
       printf("    Executing the tail command:  %s\n\n", tail[0]);
       printf("Program Output:\n\n");
     }
@@ -835,32 +1284,39 @@ int pipe_handle(char **head, char **tail) {
 int overwrite_handle(char **head, char **tail) {
   /* return redirection_write_handle(head, tail, 1); */
   int p_id, fd, status;
-  if(verbose_flag)
+  uint64_t start;
+  if(VERBOSE(V_PARSE))
     printf("  Overwriting the output of %s onto %s\n", head[0], tail[0]);
 
   // Creating a child process for executing the head command.
+  fflush(stdout);
+  TRACE_BEGIN(start);
   if((p_id = fork()) < 0) {
     perror("Error forking a process.");
     return -1;
   }
-  if(verbose_flag && p_id != 0)
+  if(p_id != 0)
+    TRACE_END("fork", "proc", start, head[0]);
+  if(VERBOSE(V_PROC) && p_id != 0)
     printf("  Creating a child process for the command:  %s\n", head[0]);
 
   // Child process.
   if(p_id == 0) {
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       printf("  Child:\n");
 
     // Open file for writing.
+    TRACE_BEGIN(start);
     if((fd = open(tail[0], O_CREAT | O_WRONLY | O_TRUNC, 0666)) < 0) {
       perror("Error opening file.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("open", "fd", start, tail[0]);
+    if(VERBOSE(V_FD))
       printf("    Opening %s for writing (overwrite).\n", tail[0]);
     
     // Save stdout so we can continue to print in verbose mode.
-    if(verbose_flag && !stdout_flag) {
+    if(VERBOSE(V_FD | V_PROC) && !stdout_flag) {
       if((saved_stdout = dup(STDOUT_FILENO)) == -1) {
         perror("Error duplicating stdout file descriptor.");
         return -1;
@@ -868,22 +1324,28 @@ int overwrite_handle(char **head, char **tail) {
       stdout_flag = 1;
     }
 
-    // Duplicate output file descriptor to stdout file descriptor.
+    // Duplicate output file descriptor to stdout file descriptor, once the child's own messages
+    // are out of the buffer.
+    fflush(stdout);
+    TRACE_BEGIN(start);
     if(dup2(fd, STDOUT_FILENO) < 0) {
       perror("Error duplicating file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("dup2", "fd", start, "output file -> stdout");
+    if(VERBOSE(V_FD))
       dprintf(saved_stdout, "    Duplicating the file descriptor for file %s as stdout.\n", tail[0]);
 
     // Close output file descriptor.
+    TRACE_BEGIN(start);
     if(close(fd) < 0) {
       perror("Error closing a file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("close", "fd", start, "output file");
+    if(VERBOSE(V_FD))
       dprintf(saved_stdout, "    Closing output file descriptor.\n");
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       dprintf(saved_stdout, "    Executing the head command:  %s\n", head[0]);
     
     // Execute the head command.
@@ -894,15 +1356,19 @@ int overwrite_handle(char **head, char **tail) {
   // Parent process.
   else {
     // Wait for child process to finish.
+    fflush(stdout);
+    TRACE_BEGIN(start);
     if(waitpid(p_id, &status, 0) < 0) {
       perror("Error waiting for a process.");
       return -1;
     }
-    if(verbose_flag) {
+    TRACE_END("wait", "proc", start, head[0]);
+    if(VERBOSE(V_PROC)) {
       printf("  Parent:\n    Waiting for child process to terminate.\n");
     }
 
-    return 0;  // Successful child process, so return success flag, 0.
+    // The head command's exit status is the child's own.
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
   }
 }
 
@@ -912,32 +1378,39 @@ int overwrite_handle(char **head, char **tail) {
 int append_handle(char **head, char **tail) {
   /* return redirection_write_handle(head, tail, 0); */
   int p_id, fd, status;
-  if(verbose_flag)
+  uint64_t start;
+  if(VERBOSE(V_PARSE))
     printf("  Appending the output of %s onto the end of %s\n", head[0], tail[0]);
 
   // Creating a child process for executing the head command.
+  fflush(stdout);
+  TRACE_BEGIN(start);
   if((p_id = fork()) < 0) {
     perror("Error forking a process.");
     return -1;
   }
-  if(verbose_flag && p_id != 0)
+  if(p_id != 0)
+    TRACE_END("fork", "proc", start, head[0]);
+  if(VERBOSE(V_PROC) && p_id != 0)
     printf("  Creating a child process for the command:  %s\n", head[0]);
 
   // Child process.
   if(p_id == 0) {
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       printf("  Child:\n");
 
     // Open file for writing.
+    TRACE_BEGIN(start);
     if((fd = open(tail[0], O_CREAT | O_WRONLY | O_APPEND, 0666)) < 0) {
       perror("Error opening file.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("open", "fd", start, tail[0]);
+    if(VERBOSE(V_FD))
       printf("    Opening %s for writing (append).\n", tail[0]);
     
     // Save stdout so we can continue to print in verbose mode.
-    if(verbose_flag && !stdout_flag) {
+    if(VERBOSE(V_FD | V_PROC) && !stdout_flag) {
       if((saved_stdout = dup(STDOUT_FILENO)) == -1) {
         perror("Error duplicating stdout file descriptor.");
         return -1;
@@ -945,22 +1418,28 @@ int append_handle(char **head, char **tail) {
       stdout_flag = 1;
     }
 
-    // Duplicate output file descriptor to stdout file descriptor.
+    // Duplicate output file descriptor to stdout file descriptor, once the child's own messages
+    // are out of the buffer.
+    fflush(stdout);
+    TRACE_BEGIN(start);
     if(dup2(fd, STDOUT_FILENO) < 0) {
       perror("Error duplicating file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("dup2", "fd", start, "output file -> stdout");
+    if(VERBOSE(V_FD))
       dprintf(saved_stdout, "    Duplicating the file descriptor for file %s as stdout.\n", tail[0]);
 
     // Close output file descriptor.
+    TRACE_BEGIN(start);
     if(close(fd) < 0) {
       perror("Error closing a file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("close", "fd", start, "output file");
+    if(VERBOSE(V_FD))
       dprintf(saved_stdout, "    Closing output file descriptor.\n");
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       dprintf(saved_stdout, "    Executing the head command:  %s\n", head[0]);
     
     // Execute the head command.
@@ -971,15 +1450,19 @@ int append_handle(char **head, char **tail) {
   // Parent process.
   else {
     // Wait for child process to finish.
+    fflush(stdout);
+    TRACE_BEGIN(start);
     if(waitpid(p_id, &status, 0) < 0) {
       perror("Error waiting for a process.");
       return -1;
     }
-    if(verbose_flag) {
+    TRACE_END("wait", "proc", start, head[0]);
+    if(VERBOSE(V_PROC)) {
       printf("  Parent:\n    Waiting for child process to terminate.\n");
     }
 
-    return 0;  // Successful child process, so return success flag, 0.
+    // The head command's exit status is the child's own.
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
   }
 }
 
@@ -988,37 +1471,44 @@ int append_handle(char **head, char **tail) {
  * */
 int redirection_write_handle(char **head, char **tail, int type) {
   int p_id, fd, status, flags;
+  uint64_t start;
   char *verb, *verb2;
   verb = type ? "  Overwriting the output of %s onto %s\n"
               : "  Appending the output of %s onto the end of %s\n";
   verb2 = type ? "overwrite.)\n" : "append.)\n";
   flags = O_CREAT | O_WRONLY | (type ? O_TRUNC : O_APPEND);
-  if(verbose_flag)
+  if(VERBOSE(V_PARSE))
       printf(verb, head[0], tail[0]);
 
   // Creating a child process for executing the head command.
+  fflush(stdout);
+  TRACE_BEGIN(start);
   if((p_id = fork()) < 0) {
     perror("Error forking a process.");
     return -1;
   }
-  if(verbose_flag && p_id != 0)
+  if(p_id != 0)
+    TRACE_END("fork", "proc", start, head[0]);
+  if(VERBOSE(V_PROC) && p_id != 0)
     printf("  Creating a child process for the command:  %s\n", head[0]);
 
   // Child process.
   if(p_id == 0) {
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       printf("  Child:\n");
 
     // Open file for writing.
+    TRACE_BEGIN(start);
     if((fd = open(tail[0], flags, 0666)) < 0) {
       perror("Error opening file.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("open", "fd", start, tail[0]);
+    if(VERBOSE(V_FD))
       printf(strcat("    Opening %s for writing ", verb2), tail[0]);
 
     // Save stdout so we can continue to print in verbose mode.
-    if(verbose_flag && !stdout_flag) {
+    if(VERBOSE(V_FD | V_PROC) && !stdout_flag) {
       if((saved_stdout = dup(STDOUT_FILENO)) == -1) {
         perror("Error duplicating stdout file descriptor.");
         return -1;
@@ -1026,22 +1516,28 @@ int redirection_write_handle(char **head, char **tail, int type) {
       stdout_flag = 1;
     }
 
-    // Duplicate output file descriptor to stdout file descriptor.
+    // Duplicate output file descriptor to stdout file descriptor, once the child's own messages
+    // are out of the buffer.
+    fflush(stdout);
+    TRACE_BEGIN(start);
     if(dup2(fd, STDOUT_FILENO) < 0) {
       perror("Error duplicating file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("dup2", "fd", start, "output file -> stdout");
+    if(VERBOSE(V_FD))
       printf("    Duplicating the file descriptor for file %s as stdout.\n", tail[0]);
 
     // Close output file descriptor.
+    TRACE_BEGIN(start);
     if(close(fd) < 0) {
       perror("Error closing a file descriptor.");
       return -1;
     }
-    if(verbose_flag)
+    TRACE_END("close", "fd", start, "output file");
+    if(VERBOSE(V_FD))
       printf("    Closing output file descriptor.\n");
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       printf("    Executing the head command:  %s\n", head[0]);
     
     // Execute the head command.
@@ -1052,11 +1548,14 @@ int redirection_write_handle(char **head, char **tail, int type) {
   // Parent process.
   else {
     // Wait for child process to finish.
+    fflush(stdout);
+    TRACE_BEGIN(start);
     if(waitpid(p_id, &status, 0) < 0) {
       perror("Error waiting for a process.");
       return -1;
     }
-    if(verbose_flag) {
+    TRACE_END("wait", "proc", start, head[0]);
+    if(VERBOSE(V_PROC)) {
       printf("  Parent:\n    Waiting for child process to terminate.\n");
     }
 
@@ -1069,7 +1568,7 @@ int redirection_write_handle(char **head, char **tail, int type) {
  * */
 int cd_handle(char **cmd, size_t num_cmd) {
   char *home;
-  if(verbose_flag)
+  if(VERBOSE(V_PROC))
     printf("Changing current directory...\n");
   // cd with no argument, change to home directory.
   if(num_cmd == 1) {
@@ -1077,13 +1576,13 @@ int cd_handle(char **cmd, size_t num_cmd) {
       printf("Error:  There is no home environment variable defined in your environment.");
       return -1;
     }
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       printf("Obtained home environment variable via call to getenv.\n");
     if(chdir(home) < 0) {
       perror("Error:  Unable to change to your home directory.");
       return -1;
     }
-    if(verbose_flag)
+    if(VERBOSE(V_PROC))
       printf("Changed current directory to your home directory: %s\n", home);
   }
   // cd with one argument.
@@ -1092,7 +1591,7 @@ int cd_handle(char **cmd, size_t num_cmd) {
       perror("Error:  Changing directory failed.\n");
       return -1;
     }
-    if(verbose_flag) {
+    if(VERBOSE(V_PROC)) {
       char cwd[PATH_MAX];
       if(getcwd(cwd, PATH_MAX) == NULL) {
         perror("Error:  Getting the current working directory failed.");
@@ -1113,7 +1612,7 @@ int cd_handle(char **cmd, size_t num_cmd) {
  * Handler for pwd command.
  * */
 int pwd_handle(char **cmd, size_t num_cmd) {
-  if(verbose_flag)
+  if(VERBOSE(V_PROC))
     printf("Getting current working directory...\n");
   // pwd should not have more than one argument unless the argument is actually a special feature.
   if(num_cmd != 1 && !is_special_feature(cmd)) {
@@ -1125,7 +1624,7 @@ int pwd_handle(char **cmd, size_t num_cmd) {
     perror("Error:  Getting the current working directory failed.");
     return -1;
   }
-  if(verbose_flag) {
+  if(VERBOSE(V_PROC)) {
     printf("Obtained current working directory via call to getcwd.\n");
     printf("Program Output:\n\n");
   }
@@ -1135,8 +1634,8 @@ int pwd_handle(char **cmd, size_t num_cmd) {
 
 void help_handle(char *cmd) {
   if(strcmp(cmd, "brief") == 0) {
-    printf("brief: brief\n"
-           "    Disables verbose mode.\n");
+    printf("brief: brief [category[,category...]]\n"
+           "    Disables verbose mode, or only the given categories of it.\n");
   }
   if(strcmp(cmd, "cd") == 0) {
     printf("cd: cd [DIR]\n"
@@ -1150,6 +1649,260 @@ void help_handle(char *cmd) {
     printf("help: help [pattern ...]\n"
            "    Displays information about builtin commands.");
   }
+  else if(strcmp(cmd, "echo") == 0) {
+    printf("echo: echo [-n] [arg ...]\n"
+           "    Write arguments to the standard output.\n\n"
+           "    Prints the arguments separated by spaces and followed by a newline.  Backslash\n"
+           "    escapes in the arguments are interpreted: \\a, \\b, \\f, \\n, \\r, \\t, \\v,\n"
+           "    \\\\, \\0nnn (the octal byte nnn), and \\c, which ends the output.\n\n"
+           "    Options:\n"
+           "      -n    do not print the trailing newline\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless a write error occurs.\n");
+  }
+  else if(strcmp(cmd, "explain") == 0) {
+    printf("explain: explain cmd [args ...] [< file] [| cmd ...] [> file]\n"
+           "    Show how the shell would run a command line, without running it.\n\n"
+           "    Lists the optimizer's rewrites of the line, if any, then prints each step the\n"
+           "    shell would take, with the process taking it: which commands run in the shell\n"
+           "    and which are forked, the pipes, opens, and dup2s that connect them, and the\n"
+           "    program each executes, as found in the command hash.  A group, a subshell,\n"
+           "    a loop, or a list is shown running in the shell, or forked for a subshell\n"
+           "    that could change the shell.\n"
+           "    Ends with the total number of forks, pipes, opens, dup2s, and execs.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless no command is given.\n");
+  }
+  else if(strcmp(cmd, "false") == 0) {
+    printf("false: false\n"
+           "    Return an unsuccessful result.\n\n"
+           "    Exit Status:\n"
+           "    Always fails.\n");
+  }
+  else if(strcmp(cmd, "declare") == 0) {
+    printf("declare: declare [-aAp] [name[=value] ...]\n"
+           "    Set variable values and attributes.\n\n"
+           "    Declares each name, and sets it to value, as an assignment would.  The value may\n"
+           "    be a list, name=(value ...), whose values may be [subscript]=value.  With no\n"
+           "    names, displays every variable.\n\n"
+           "    Options:\n"
+           "      -a    make each name an indexed array\n"
+           "      -A    make each name an associative array\n"
+           "      -p    display each name and its value\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless an invalid option is given, a name is not found (with -p), or an\n"
+           "    assignment fails.\n");
+  }
+  else if(strcmp(cmd, "hash") == 0) {
+    printf("hash: hash [-r] [name ...]\n"
+           "    Remember or display program locations.\n\n"
+           "    Each name is looked up in the path and remembered, so that later commands run it\n"
+           "    without searching the path.  With no names, lists the remembered programs and how\n"
+           "    many times each has been used.\n\n"
+           "    Options:\n"
+           "      -r    forget all remembered locations\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless a name is not found.\n");
+  }
+  else if(strcmp(cmd, "let") == 0) {
+    printf("let: let expr [expr ...]\n"
+           "    Evaluate arithmetic expressions.\n\n"
+           "    Evaluates each expr as $(( expr )) would, with the operators of C on 64-bit\n"
+           "    integers.  Variables are named without a $, and assignments (=, +=, ++, etc.)\n"
+           "    set them.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 if the last expr is not 0, and 1 if it is 0 or an expr is invalid.\n");
+  }
+  else if(strcmp(cmd, "for") == 0) {
+    printf("for: for name in word ...; do list; done\n"
+           "    Execute commands for each member in a list.\n\n"
+           "    Expands the words, and runs list once for each word they make, with name set\n"
+           "    to it.  A word that is a brace sequence, {first..last} or {first..last..incr},\n"
+           "    is not expanded: its values are made one at a time, as the loop reaches them.\n\n"
+           "    Exit Status:\n"
+           "    Returns the status of the last command run.\n");
+  }
+  else if(strcmp(cmd, "while") == 0) {
+    printf("while: while list; do list; done\n"
+           "    Execute commands as long as a test succeeds.\n\n"
+           "    Runs the second list as long as the last command of the first exits with 0.\n\n"
+           "    Exit Status:\n"
+           "    Returns the status of the last command run.\n");
+  }
+  else if(strcmp(cmd, "break") == 0) {
+    printf("break: break [n]\n"
+           "    Exit for or while loops.\n\n"
+           "    Exits the innermost loop, or the n innermost loops.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless n is not 1 or greater.\n");
+  }
+  else if(strcmp(cmd, "continue") == 0) {
+    printf("continue: continue [n]\n"
+           "    Resume for or while loops.\n\n"
+           "    Goes on to the next iteration of the innermost loop, or of the n-th innermost\n"
+           "    loop.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless n is not 1 or greater.\n");
+  }
+  else if(strcmp(cmd, "(") == 0 || strcmp(cmd, "{") == 0) {
+    printf("( list ) [> file]\n"
+           "{ list; } [> file]\n"
+           "    Group commands.\n\n"
+           "    Runs list as one command, whose output may be redirected with > file or\n"
+           "    >> file.  ( ) runs list in a subshell, so that a cd, an assignment, or an exit\n"
+           "    in it does not affect the shell.  The subshell forks only if list might do\n"
+           "    such a thing; otherwise it runs in the shell process.\n\n"
+           "    Exit Status:\n"
+           "    Returns the status of the last command of list.\n");
+  }
+  else if(strcmp(cmd, "function") == 0) {
+    printf("function: function name { list; } or name() { list; }\n"
+           "    Define a shell function.\n\n"
+           "    Defines name as a command that runs list in the shell process, with its\n"
+           "    arguments as the positional parameters $1, $2, ..., $#, and $@.  A function is\n"
+           "    found before a builtin or a program of the same name.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless the definition fails.\n");
+  }
+  else if(strcmp(cmd, "local") == 0) {
+    printf("local: local [name[=value] ...]\n"
+           "    Define local variables.\n\n"
+           "    Makes each name local to the function being run, and sets it to value, as an\n"
+           "    assignment would.  The variable is restored when the function returns, and is\n"
+           "    seen by the functions it calls.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless a name is invalid, an assignment fails, or the shell is not\n"
+           "    running a function.\n");
+  }
+  else if(strcmp(cmd, "return") == 0) {
+    printf("return: return [n]\n"
+           "    Return from a shell function.\n\n"
+           "    Returns from the function being run with the status n, or with the status of\n"
+           "    the last command it ran.\n\n"
+           "    Exit Status:\n"
+           "    Returns n, or fails if the shell is not running a function.\n");
+  }
+  else if(strcmp(cmd, "mem") == 0) {
+    printf("mem: mem [-r]\n"
+           "    Display the shell's memory allocation counters.\n\n"
+           "    For each part of the shell (parse, path, exec, hash, stats, trace, and vars),\n"
+           "    prints the number of allocations and frees, the total bytes allocated, the blocks\n"
+           "    and bytes still allocated, and the most bytes allocated at once (peak.)\n\n"
+           "    Options:\n"
+           "      -r    reset the counts and totals, and lower each peak to the current bytes\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless an invalid option is given.\n");
+  }
+  else if(strcmp(cmd, "memo") == 0) {
+    printf("memo: memo [-e VAR]... [-i FILE]... [-m FILE]... [--] command [args ...]\n"
+           "    Run a command, remembering its result.\n\n"
+           "    The first run of a command records its output and exit status.  Later runs with\n"
+           "    the same arguments, the same values of each environment variable VAR, and the\n"
+           "    same contents (-i) or modification times (-m) of each input FILE replay the\n"
+           "    recording instead of running the command again.\n\n"
+           "    If the same command is already running in the same directory in another shell,\n"
+           "    memo follows that run's output instead of starting a second copy.\n\n"
+           "    Results are stored in $TINYSH_MEMO_DIR, defaulting to ~/.cache/tinysh/memo.\n\n"
+           "    Exit Status:\n"
+           "    Returns the exit status of the command.\n");
+  }
+  else if(strcmp(cmd, "mapfile") == 0 || strcmp(cmd, "readarray") == 0) {
+    printf("mapfile: mapfile [-t] [-d delim] [-n count] [-s count] [-u fd] [array]\n"
+           "readarray: readarray [-t] [-d delim] [-n count] [-s count] [-u fd] [array]\n"
+           "    Read lines into an indexed array.\n\n"
+           "    Reads the lines of the standard input (or fd) into the elements of array,\n"
+           "    defaulting to MAPFILE, starting at index 0.\n\n"
+           "    Options:\n"
+           "      -t        remove the delimiter from the end of each line\n"
+           "      -d delim  end lines with the first character of delim instead of a newline\n"
+           "      -n count  read at most count lines (all of them if count is 0)\n"
+           "      -s count  discard the first count lines\n"
+           "      -u fd     read from the file descriptor fd\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless an invalid option is given or fd cannot be read.\n");
+  }
+  else if(strcmp(cmd, "printf") == 0) {
+    printf("printf: printf format [arguments ...]\n"
+           "    Format and print arguments under the control of format.\n\n"
+           "    Supports the conversions d, i, o, u, x, X, e, E, f, F, g, G, a, A, c, s, and b\n"
+           "    (a string with echo's escapes), with flags, widths, and precisions, which may be\n"
+           "    given as * to take them from the arguments.  The format is reused until every\n"
+           "    argument is consumed.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless an argument is not a valid number or no format is given.\n");
+  }
+  else if(strcmp(cmd, "read") == 0) {
+    printf("read: read [-r] [-d delim] [-p prompt] [-u fd] [name ...]\n"
+           "    Read a line from the standard input and split it into fields.\n\n"
+           "    The line is split on the characters of IFS, the first field is assigned to the\n"
+           "    first name, the second to the second, and so on, with the rest of the line\n"
+           "    assigned to the last name.  With no names, the line is assigned to REPLY.\n"
+           "    Unless -r is given, a backslash escapes the next character, and a backslash at\n"
+           "    the end of the line continues it on the next.\n\n"
+           "    Options:\n"
+           "      -r         do not treat backslashes as escapes\n"
+           "      -d delim   end the line at the first character of delim instead of a newline\n"
+           "      -p prompt  print prompt on stderr before reading from a terminal\n"
+           "      -u fd      read from the file descriptor fd\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless end of file is reached, an invalid option is given, or fd\n"
+           "    cannot be read.\n");
+  }
+  else if(strcmp(cmd, "stats") == 0) {
+    printf("stats: stats [--json] [-r]\n"
+           "    Display statistics of the commands run by the shell.\n\n"
+           "    For every command name, prints the 50th, 90th, and 99th percentiles and the\n"
+           "    maximum of the time taken to parse its line (parse), to fork (spawn), to start\n"
+           "    its program (exec), and to run (wall), its user and system CPU time (user,\n"
+           "    sys), and its maximum resident set size (maxrss.)\n\n"
+           "    Options:\n"
+           "      --json  print the statistics as a JSON object keyed by command name\n"
+           "      -r      forget all recorded statistics\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 unless an invalid option is given.\n");
+  }
+  else if(strcmp(cmd, "syscount") == 0) {
+    printf("syscount: syscount cmd [args ...] [| cmd ...] [> file]\n"
+           "    Count the system calls made to run a command.\n\n"
+           "    Runs the command line with its process, and every process it creates, traced, then\n"
+           "    prints on stderr the number of calls of each system call, how many failed, how\n"
+           "    many were made by the shell while setting up the command (before a program was\n"
+           "    executed, e.g. for pipes and redirections), and the time spent in them.\n\n"
+           "    Exit Status:\n"
+           "    Returns the exit status of the command.\n");
+  }
+  else if(strcmp(cmd, "test") == 0 || strcmp(cmd, "[") == 0) {
+    printf("test: test [expr]\n"
+           "[: [ expr ]\n"
+           "    Evaluate a conditional expression.\n\n"
+           "    Supports the file tests -b, -c, -d, -e, -f, -g, -h, -L, -p, -r, -S, -s, -u, -w,\n"
+           "    and -x, the string tests -n, -z, =, and !=, the integer comparisons -eq, -ne,\n"
+           "    -gt, -ge, -lt, and -le, the file comparisons -nt, -ot, and -ef, -t fd, and the\n"
+           "    operators !, -a, -o, and parentheses.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 if expr is true, 1 if it is false or missing, and 2 if it is invalid.\n");
+  }
+  else if(strcmp(cmd, "[[") == 0) {
+    printf("[[: [[ expr ]]\n"
+           "    Evaluate a conditional expression.\n\n"
+           "    Supports the tests of test, and also == and != (the right side is a pattern),\n"
+           "    =~ (the right side is an extended regular expression, and BASH_REMATCH is set to\n"
+           "    the text it matched), < and > (string order), -v name (the variable is set), and\n"
+           "    the operators !, &&, ||, and parentheses.  The operands of -eq, -ne, -gt, -ge,\n"
+           "    -lt, and -le are arithmetic expressions.\n\n"
+           "    Exit Status:\n"
+           "    Returns 0 if expr is true, 1 if it is false, and 2 if it is invalid.\n");
+  }
+  else if(strcmp(cmd, "time") == 0) {
+    printf("time: time cmd [| cmd ...] [> file]\n"
+           "    Report the time taken by a pipeline.\n\n"
+           "    Runs the pipeline, then prints its total real, user, and system time on stderr,\n"
+           "    followed by a breakdown per stage: when the stage finished (real), its user and\n"
+           "    system CPU time, its voluntary and involuntary context switches (vcsw, ivcsw),\n"
+           "    and its maximum resident set size.  The stages run concurrently.\n\n"
+           "    Exit Status:\n"
+           "    Returns the exit status of the last stage of the pipeline.\n");
+  }
   else if(strcmp(cmd, "pwd") == 0) {
     printf("pwd: pwd\n"
            "    Print the name of the current working directory.\n\n"
@@ -1158,8 +1911,23 @@ void help_handle(char *cmd) {
            "    returns -1.\n"); 
   }
   else if(strcmp(cmd, "verbose") == 0) {
-    printf("verbose: verbose\n"
-           "    Enables verbose mode.\n");
+    printf("verbose: verbose [-l level] [category[,category...]]\n"
+           "    Enables verbose mode.\n\n"
+           "    With a list of categories, only messages in those categories are printed:\n"
+           "      proc     forks, waits, execs, and builtins\n"
+           "      fd       pipes, opens, dup2s, and closes\n"
+           "      mem      allocations and deallocations\n"
+           "      parse    tokenizing and splitting command lines\n"
+           "      all      every category (the default)\n\n"
+           "    Options:\n"
+           "      -l 1  narrate each step only\n"
+           "      -l 2  also narrate the details of each step (the default)\n");
+  }
+  else if(strcmp(cmd, "true") == 0) {
+    printf("true: true\n"
+           "    Return a successful result.\n\n"
+           "    Exit Status:\n"
+           "    Always succeeds.\n");
   }
   else {
     printf("help: No help topics match %s.  Try 'help help' to see more about the help command,\n"
@@ -1178,7 +1946,14 @@ void prog_help() {
   printf("Options:\n"
          "    -p, --path=PATH:  use PATH as path for commands and program\n"
          "    -h, --help:       display this help message\n"
-         "    -v, --verbose:    enables verbose mode\n");
+         "    -v, --verbose[=CATEGORIES]:\n"
+         "                      enables verbose mode, optionally for a comma-separated list of\n"
+         "                      CATEGORIES (proc, fd, mem, parse)\n"
+         "    -z, --zygote:     launch commands from a pre-forked fork server\n"
+         "    -b, --buffered:   buffer the shell's output, writing it out only before a fork,\n"
+         "                      before reading a line, and at exit\n"
+         "    -s, --serve=SOCK: serve command lines on the Unix domain socket SOCK\n"
+         "    -t, --trace=FILE: write a Chrome trace of forks, execs, and fd operations to FILE\n");
 }
 
 void shell_help() {
@@ -1186,11 +1961,39 @@ void shell_help() {
   print_desc();
   printf("The commands listed below are defined internally, type 'help' to see this list.\n"
          "Type 'help name' to find out more about the command 'name'.\n"
+         "  (\n"
+         "  [\n"
+         "  [[\n"
+         "  break\n"
          "  brief\n"
          "  cd\n"
+         "  continue\n"
+         "  declare\n"
+         "  echo\n"
+         "  explain\n"
+         "  false\n"
+         "  for\n"
+         "  function\n"
+         "  hash\n"
          "  help\n"
+         "  let\n"
+         "  local\n"
+         "  mapfile\n"
+         "  mem\n"
+         "  memo\n"
+         "  printf\n"
          "  pwd\n"
-         "  verbose\n");
+         "  read\n"
+         "  readarray\n"
+         "  return\n"
+         "  stats\n"
+         "  syscount\n"
+         "  test\n"
+         "  time\n"
+         "  true\n"
+         "  verbose\n"
+         "  while\n"
+         "  {\n");
 }
 
 void print_desc() {
@@ -1204,5 +2007,7 @@ void print_desc() {
  * Displays usage information.
  * */
 void usage() {
-  fprintf(stderr, "usage: %s [-p|--path file] [-h|--help] [-v|--verbose]\n", PROGNAME);
+  fprintf(stderr, "usage: %s [-p|--path file] [-h|--help] [-v|--verbose] [-z|--zygote]\n"
+                  "              [-b|--buffered] [-s|--serve socket] [-t|--trace file]\n",
+          PROGNAME);
 }
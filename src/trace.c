@@ -0,0 +1,377 @@
+/* *
+ * trace.c
+ *
+ * Structured tracing of the shell's system calls.
+ *
+ * Started with "tinysh --trace=FILE", the shell records each fork, exec, dup2, pipe, open, close,
+ * and wait it (or one of its children) performs as an event with a monotonic timestamp, duration,
+ * and process id.  FILE is written in the Chrome trace event format, so it can be loaded into
+ * chrome://tracing or Perfetto to see exactly where the time in a pipeline goes.
+ *
+ * Recording an event must be cheap enough not to disturb the timings being measured, so events
+ * are not written to the file as they happen.  Instead, when tracing starts, the shell maps a
+ * shared memory region (inherited by every child it forks) holding a fixed set of ring buffers.
+ * The first time a process records an event, it claims a ring for itself; after that, recording
+ * an event is a handful of stores into memory with no locks and no system calls, since each ring
+ * has exactly one writer (its process) and one reader (the shell.)  After each command, the shell
+ * drains every ring, merges the events by timestamp, and appends them to FILE.
+ *
+ * NOTES:
+ *   - A process that records more events than fit in its ring before the shell drains it loses
+ *     the excess; the number of lost events is reported in the trace's metadata.
+ *   - Event names and categories must be string literals, since only the pointers are stored and
+ *     they are read back by the shell.  This works because every writer is a fork of the shell.
+ *   - A ring is returned to the pool once its process has exited and the shell has drained it.
+ *   - The trace file descriptor is close-on-exec, so programs run by the shell never see it.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "trace.h"
+#include "mem.h"
+#include "fdio.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+#define TRACE_MAX_RINGS   64      // Most processes that can hold a ring at once.
+#define TRACE_RING_SIZE   1024    // Events per ring.  Must be a power of two.
+#define TRACE_DETAIL_SIZE 48
+#define TRACE_LINE_SIZE   512
+#define TRACE_OUT_LINES   64      // Lines of JSON written to the trace file at a time.
+
+struct trace_record {
+  uint64_t start;                   // Start time, in nanoseconds.
+  uint64_t end;                     // End time, equal to start for instant events.
+  const char *name;
+  const char *cat;
+  int32_t pid;
+  char phase;                       // 'X' for complete events, 'i' for instant events.
+  char detail[TRACE_DETAIL_SIZE];
+};
+
+struct trace_ring {
+  _Atomic int32_t owner;            // Process id of the writer, or 0 if the ring is free.
+  _Atomic uint32_t head;            // Next slot to write; only the owner advances it.
+  _Atomic uint32_t tail;            // Next slot to read; only the shell advances it.
+  struct trace_record records[TRACE_RING_SIZE];
+};
+
+struct trace_shm {
+  _Atomic uint64_t dropped;         // Events lost to full rings or a lack of free rings.
+  struct trace_ring rings[TRACE_MAX_RINGS];
+};
+
+int trace_fd = -1;                   // Trace file descriptor, or -1 if tracing is off.
+static pid_t trace_owner;            // The shell, which drains the rings and writes the file.
+static struct trace_shm *shm;        // Shared region holding the rings.
+static struct trace_ring *own_ring;  // This process's ring, or NULL if it has not claimed one.
+static struct trace_record *drained; // Records drained by trace_flush, kept between flushes.
+static size_t drained_size;          // Capacity of drained, in records.
+
+static void trace_atfork_child(void);
+static struct trace_ring* claim_ring(void);
+static struct trace_record* reserve(struct trace_ring **ring);
+static size_t drain_ring(struct trace_ring *ring, struct trace_record *out);
+static int grow_drained(size_t num);
+static int record_cmp(const void *a, const void *b);
+static void json_escape(char *buf, size_t size, const char *str);
+
+/* *
+ * Opens file for tracing, writes the start of the trace, and maps the ring buffers.  This must be
+ * called before the shell forks anything that should be traced.
+ * */
+int trace_open(const char *file) {
+  shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(shm == MAP_FAILED) {
+    perror("Error mapping trace buffers.");
+    shm = NULL;
+    return -1;
+  }
+  if((trace_fd = open(file, O_CREAT | O_WRONLY | O_TRUNC | O_APPEND | O_CLOEXEC, 0666)) < 0) {
+    perror("Error opening trace file.");
+    munmap(shm, sizeof(*shm));
+    shm = NULL;
+    return -1;
+  }
+  trace_owner = getpid();
+  if(write(trace_fd, "[\n", 2) != 2) {
+    perror("Error writing trace file.");
+    close(trace_fd);
+    trace_fd = -1;
+    return -1;
+  }
+  // A forked child must claim a ring of its own rather than write into its parent's.
+  pthread_atfork(NULL, NULL, trace_atfork_child);
+  return 0;
+}
+
+/* *
+ * Drains the rings and finishes the trace.  Only the shell writes the end of the trace, so a child
+ * exiting early leaves the file open for the rest of the shell's events.
+ * */
+void trace_close(void) {
+  char line[TRACE_LINE_SIZE];
+  int len;
+  if(trace_fd < 0)
+    return;
+  if(getpid() == trace_owner) {
+    trace_flush();
+    len = snprintf(line, sizeof(line),
+                   "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"name\":\"tinysh\",\"dropped_events\":%llu}}\n]\n",
+                   (int) trace_owner, (int) trace_owner,
+                   (unsigned long long) atomic_load(&shm->dropped));
+    if(write(trace_fd, line, len) != len)
+      perror("Error writing trace file.");
+  }
+  mem_free(MEM_TRACE, drained);
+  drained = NULL;
+  drained_size = 0;
+  close(trace_fd);
+  trace_fd = -1;
+}
+
+/* *
+ * Returns - The current time of the monotonic clock in nanoseconds.
+ * */
+uint64_t trace_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* *
+ * Records a complete event that began at start (from trace_now) and ends now.  detail, which may
+ * be NULL, is attached as the event's argument.
+ * */
+void trace_event(const char *name, const char *cat, uint64_t start, const char *detail) {
+  struct trace_ring *ring;
+  struct trace_record *rec;
+  if((rec = reserve(&ring)) == NULL)
+    return;
+  rec->start = start;
+  rec->end = trace_now();
+  rec->name = name;
+  rec->cat = cat;
+  rec->phase = 'X';
+  rec->pid = ring->owner;
+  strncpy(rec->detail, detail ? detail : "", sizeof(rec->detail) - 1);
+  rec->detail[sizeof(rec->detail) - 1] = '\0';
+  // Publish the record to the shell.
+  atomic_store_explicit(&ring->head, ring->head + 1, memory_order_release);
+}
+
+/* *
+ * Records an instant event, for operations that do not return (e.g. a successful exec.)
+ * */
+void trace_instant(const char *name, const char *cat, const char *detail) {
+  struct trace_ring *ring;
+  struct trace_record *rec;
+  if((rec = reserve(&ring)) == NULL)
+    return;
+  rec->start = rec->end = trace_now();
+  rec->name = name;
+  rec->cat = cat;
+  rec->phase = 'i';
+  rec->pid = ring->owner;
+  strncpy(rec->detail, detail ? detail : "", sizeof(rec->detail) - 1);
+  rec->detail[sizeof(rec->detail) - 1] = '\0';
+  atomic_store_explicit(&ring->head, ring->head + 1, memory_order_release);
+}
+
+/* *
+ * Drains every ring, writing the events to the trace file in timestamp order, and returns the
+ * rings of exited processes to the pool.  Only the shell may call this.
+ * */
+void trace_flush(void) {
+  int i, len;
+  size_t num, total, off;
+  int32_t owner;
+  char line[TRACE_LINE_SIZE], escaped[TRACE_DETAIL_SIZE * 6];
+  static char out[TRACE_OUT_LINES * TRACE_LINE_SIZE];
+  struct trace_ring *ring;
+
+  if(trace_fd < 0 || getpid() != trace_owner)
+    return;
+  // A ring holds at most TRACE_RING_SIZE records at a time, and it is drained at most twice, so
+  // the buffer only has to grow when that many more records could arrive.
+  total = 0;
+  for(i = 0; i < TRACE_MAX_RINGS; i++) {
+    ring = &shm->rings[i];
+    if((owner = atomic_load_explicit(&ring->owner, memory_order_acquire)) == 0)
+      continue;
+    if(grow_drained(total + 2 * TRACE_RING_SIZE) == -1)
+      break;
+    total += drain_ring(ring, drained + total);
+    // Once the writer has exited, nothing more can arrive; drain anything it wrote after the
+    // first pass, then free the ring.
+    if(owner != trace_owner && kill(owner, 0) < 0 && errno == ESRCH) {
+      total += drain_ring(ring, drained + total);
+      atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+      atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+      atomic_store_explicit(&ring->owner, 0, memory_order_release);
+    }
+  }
+  if(total == 0)
+    return;
+
+  // Each ring is in completion order; merge them all into start order, then write the events out
+  // a block of lines at a time.
+  qsort(drained, total, sizeof(*drained), record_cmp);
+  off = 0;
+  for(num = 0; num < total; num++) {
+    struct trace_record *rec = &drained[num];
+    json_escape(escaped, sizeof(escaped), rec->detail);
+    if(rec->phase == 'X') {
+      len = snprintf(line, sizeof(line),
+                     "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                     "\"pid\":%d,\"tid\":%d,\"args\":{\"detail\":\"%s\"}},\n",
+                     rec->name, rec->cat, rec->start / 1000.0, (rec->end - rec->start) / 1000.0,
+                     (int) rec->pid, (int) rec->pid, escaped);
+    }
+    else {
+      len = snprintf(line, sizeof(line),
+                     "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                     "\"pid\":%d,\"tid\":%d,\"args\":{\"detail\":\"%s\"}},\n",
+                     rec->name, rec->cat, rec->start / 1000.0, (int) rec->pid, (int) rec->pid,
+                     escaped);
+    }
+    if(len <= 0 || len >= (int) sizeof(line))
+      continue;
+    if(off + len > sizeof(out)) {
+      if(fd_write_all(trace_fd, out, off) == -1)
+        perror("Error writing trace file.");
+      off = 0;
+    }
+    memcpy(out + off, line, len);
+    off += len;
+  }
+  if(off > 0 && fd_write_all(trace_fd, out, off) == -1)
+    perror("Error writing trace file.");
+}
+
+/* *
+ * Grows the buffer trace_flush drains records into to hold at least num records.
+ *
+ * Returns - 0 on success, -1 on failure.
+ * */
+static int grow_drained(size_t num) {
+  size_t size;
+  struct trace_record *records;
+  if(num <= drained_size)
+    return 0;
+  for(size = drained_size ? drained_size : TRACE_RING_SIZE; size < num; size *= 2)
+    ;
+  if((records = mem_realloc(MEM_TRACE, drained, size * sizeof(*records))) == NULL) {
+    perror("Error allocating memory for trace events.");
+    return -1;
+  }
+  drained = records;
+  drained_size = size;
+  return 0;
+}
+
+/* *
+ * Fork handler run in every new child: forget the parent's ring.
+ * */
+static void trace_atfork_child(void) {
+  own_ring = NULL;
+}
+
+/* *
+ * Claims a free ring for the calling process.
+ *
+ * Returns - The ring, or NULL if every ring is taken.
+ * */
+static struct trace_ring* claim_ring(void) {
+  int i;
+  int32_t expected, pid;
+  pid = getpid();
+  for(i = 0; i < TRACE_MAX_RINGS; i++) {
+    expected = 0;
+    if(atomic_compare_exchange_strong(&shm->rings[i].owner, &expected, pid))
+      return &shm->rings[i];
+  }
+  return NULL;
+}
+
+/* *
+ * Reserves the next slot of the calling process's ring, claiming a ring first if needed.  The
+ * caller fills in the slot and then publishes it by advancing the ring's head.
+ *
+ * Returns - The slot, or NULL if the event has to be dropped.
+ * */
+static struct trace_record* reserve(struct trace_ring **ring) {
+  uint32_t head, tail;
+  if(own_ring == NULL && (own_ring = claim_ring()) == NULL) {
+    atomic_fetch_add_explicit(&shm->dropped, 1, memory_order_relaxed);
+    return NULL;
+  }
+  head = atomic_load_explicit(&own_ring->head, memory_order_relaxed);
+  tail = atomic_load_explicit(&own_ring->tail, memory_order_acquire);
+  if(head - tail >= TRACE_RING_SIZE) {
+    atomic_fetch_add_explicit(&shm->dropped, 1, memory_order_relaxed);
+    return NULL;
+  }
+  *ring = own_ring;
+  return &own_ring->records[head & (TRACE_RING_SIZE - 1)];
+}
+
+/* *
+ * Copies every published record out of ring into out and marks them consumed.
+ *
+ * Returns - The number of records copied.
+ * */
+static size_t drain_ring(struct trace_ring *ring, struct trace_record *out) {
+  uint32_t head, tail;
+  size_t num = 0;
+  head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  for(; tail != head; tail++)
+    out[num++] = ring->records[tail & (TRACE_RING_SIZE - 1)];
+  atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  return num;
+}
+
+/* *
+ * Orders records by start time.
+ * */
+static int record_cmp(const void *a, const void *b) {
+  const struct trace_record *x = a, *y = b;
+  return (x->start > y->start) - (x->start < y->start);
+}
+
+/* *
+ * Copies str into buf as the contents of a JSON string, truncating it to fit.
+ * */
+static void json_escape(char *buf, size_t size, const char *str) {
+  size_t i = 0;
+  for(; *str && i + 7 < size; str++) {
+    unsigned char c = *str;
+    if(c == '"' || c == '\\') {
+      buf[i++] = '\\';
+      buf[i++] = c;
+    }
+    else if(c < 0x20) {
+      i += snprintf(buf + i, size - i, "\\u%04x", c);
+    }
+    else {
+      buf[i++] = c;
+    }
+  }
+  buf[i] = '\0';
+}
@@ -0,0 +1,1370 @@
+/* *
+ * vars.c
+ *
+ * The variable store: the shell's variables, set with name=value and read with $name.
+ *
+ * Variables live in an open-addressing hash table with linear probing, keyed on the name, like
+ * the command hash.  A variable that is not in the table is looked up in the environment, and a
+ * variable that was in the environment when it was first set stays exported, so that programs the
+ * shell runs see its new value.
+ *
+ * NOTES:
+ *   - A variable holds an integer as well as a string.  Arithmetic (see arith.c) stores only the
+ *     integer, and the string is formatted the first time it is needed, so a loop counter that is
+ *     only ever used in arithmetic is never formatted or parsed.
+ *   - A variable's value buffer is reused when it is set again, so reassigning a variable costs
+ *     an allocation only when the value grows.
+ *   - An array variable keeps its elements in a vector indexed by subscript, and their strings in
+ *     an arena (see arena.c), so filling an array costs an allocation per block of strings rather
+ *     than per element.  Replaced strings stay in the arena until the waste outweighs the live
+ *     strings, when they are copied to a fresh arena.  Assigning to an array without a subscript
+ *     sets element 0, and reading it without one reads element 0, as in bash.
+ *   - An associative array (declare -A) keeps its keys and values in two vectors, in the order
+ *     the keys were first set, with an open-addressing index of positions in them, and its
+ *     strings in an arena, as an indexed array does.  Its elements are listed in that order.
+ *   - local saves the variable it makes local to a function call by moving it, value, elements,
+ *     and all, into the arena of the scopes, and the call moves it back when it returns, so a
+ *     local costs no copy of the value it hides.  The arena is used as a stack: each call marks
+ *     it, and releases it back to the mark, so calls in a loop reuse the same memory.  Scoping
+ *     is dynamic, as in bash: a function sees the locals of the functions that called it.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "vars.h"
+#include "arith.h"
+#include "arena.h"
+#include "tinysh.h"
+#include "writer.h"
+#include "mem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_VARS_CAPACITY 64    // Must be a power of two.
+#define VARS_MAX_LOAD_PCT     70
+#define NUMBER_SIZE           24    // Size of a 64-bit integer formatted in decimal.
+#define DEFAULT_ARRAY_CAPACITY 8
+#define ARRAY_COMPACT_BYTES   4096  // Least waste in an array's arena worth compacting.
+#define DEFAULT_MAP_CAPACITY  8     // Must be a power of two.
+#define INDEX_SIZE            64    // Longest subscript evaluated on the stack.
+
+#define VAR_NUMBER   0x1  // num holds the value.
+#define VAR_STALE    0x2  // value is out of date, and has to be formatted from num.
+#define VAR_EXPORTED 0x4  // The variable is in the environment.
+
+/*
+ * The elements of an array variable.
+ */
+struct array {
+  char **items;        // Values by index, NULL where an index is unset.
+  size_t num;          // One more than the highest index set.
+  size_t capacity;
+  size_t wasted;       // Bytes of the arena held by values since replaced.
+  struct arena arena;  // Storage of the values.
+};
+
+/*
+ * The elements of an associative array.
+ */
+struct map {
+  char **keys;         // Keys, in the order they were first set.
+  char **values;       // Values, by the position of their keys.
+  size_t num;
+  size_t capacity;     // Of keys and values.  A power of two.
+  size_t *index;       // Positions in keys plus one (0 if the slot is empty), 2 * capacity slots.
+  size_t wasted;       // Bytes of the arena held by values since replaced.
+  struct arena arena;  // Storage of the keys and values.
+};
+
+/*
+ * An assignment word: name=value or name[sub]=value, with += to append, where value may be a
+ * compound (value ...) spanning several words.
+ */
+struct assignment {
+  size_t name_len;
+  const char *sub;     // Subscript, between the brackets, or NULL.
+  size_t sub_len;
+  int append;          // 1 for +=.
+  int compound;        // 1 if value starts a (value ...) list.
+  const char *value;   // After the =, or NULL if the word is only a name.
+};
+
+struct var {
+  char *name;           // Variable name, or NULL if the slot is empty.
+  char *value;          // Value, unless it is stale.
+  size_t size;          // Bytes allocated for value.
+  long long num;        // Value as an integer, if VAR_NUMBER is set.
+  int flags;
+  struct array *array;  // Elements, if the variable is an array (value is then unused.)
+  struct map *map;      // Elements, if the variable is an associative array.
+};
+
+/*
+ * A variable as it was before local made it local to a function call, followed in the arena of the
+ * call's scope by its name.
+ */
+struct saved_var {
+  char *name;
+  int set;                 // 0 if the variable was not set.
+  struct var var;          // Its value, flags, and elements, if it was.
+  struct saved_var *next;  // The variable saved before it.
+};
+
+static struct var *table;
+static size_t capacity;
+static size_t used;
+static struct vars_scope *scope;  // Scope of the innermost function call, or NULL.
+static struct arena scope_arena;  // The saved variables of every scope.
+
+static unsigned long name_hash(const char *name, size_t len);
+static struct var* find_slot(const char *name, size_t len);
+static struct var* find(const char *name, size_t len);
+static struct var* insert(const char *name, size_t len);
+static void remove_var(struct var *v);
+static int save_var(const char *name, size_t len);
+static int store(struct var *v, const char *value, size_t len);
+static int store_append(struct var *v, const char *value, size_t len);
+static const char* format(struct var *v);
+static const char* value_of(struct var *v);
+static struct array* make_array(struct var *v);
+static int array_set(struct var *v, long long index, const char *value, size_t len);
+static int array_store(struct array *a, size_t index, const char *value, size_t len);
+static void array_reset(struct array *a);
+static void array_compact(struct array *a);
+static void array_free(struct array *a);
+static struct map* make_map(struct var *v);
+static size_t* map_slot(const struct map *m, const char *key, size_t len);
+static const char* map_get(const struct map *m, const char *key, size_t len);
+static int map_store(struct map *m, const char *key, size_t key_len, const char *value,
+                     size_t len);
+static void map_reset(struct map *m);
+static void map_compact(struct map *m);
+static void map_free(struct map *m);
+static int replace(struct arena *arena, size_t *wasted, char **item, const char *value,
+                   size_t len);
+static int parse_assignment(const char *word, struct assignment *as);
+static int compound_end(char **cmd, size_t i, const struct assignment *as, size_t *last);
+static int assign(char **cmd, size_t i, const struct assignment *as, size_t *last);
+static int assign_element(struct var *v, const char *sub, size_t sub_len, const char *value,
+                          size_t len, int append);
+static int assign_compound(struct var *v, char **cmd, size_t num, const struct assignment *as);
+static int eval_index(const char *sub, size_t len, long long *index);
+static int declare_kind(struct var *v, int kind);
+static void declare_print(struct var *v);
+
+/* *
+ * Returns - The value of the variable name, or NULL if it is not set, in the shell or in the
+ *           environment.  The value is valid until the variable is next set.
+ * */
+const char* vars_get(const char *name) {
+  struct var *v;
+  if((v = find(name, strlen(name))) == NULL)
+    return getenv(name);
+  return value_of(v);
+}
+
+/* *
+ * Reads the value of the variable name as an integer into num.  A variable that is not set, or is
+ * empty, is 0.
+ *
+ * Returns - 0 on success, or -1 if the value is not an integer.
+ * */
+int vars_get_int(const char *name, long long *num) {
+  const char *value;
+  struct var *v;
+  if((v = find(name, strlen(name))) != NULL && (v->flags & VAR_NUMBER)) {
+    *num = v->num;
+    return 0;
+  }
+  value = v != NULL ? value_of(v) : getenv(name);
+  if(value == NULL || *value == '\0') {
+    *num = 0;
+    return 0;
+  }
+  if(arith_number(value, strlen(value), num) == -1)
+    return -1;
+  // Remember the integer, so that the string is parsed once.
+  if(v != NULL && v->array == NULL && v->map == NULL) {
+    v->num = *num;
+    v->flags |= VAR_NUMBER;
+  }
+  return 0;
+}
+
+/* *
+ * Sets the variable name to value.
+ *
+ * Returns - 0 on success, or -1 if the variable could not be set.
+ * */
+int vars_set(const char *name, const char *value) {
+  return vars_set_len(name, value, strlen(value));
+}
+
+/* *
+ * Sets the variable name to the len characters of value.
+ *
+ * Returns - 0 on success, or -1 if the variable could not be set.
+ * */
+int vars_set_len(const char *name, const char *value, size_t len) {
+  struct var *v;
+  if((v = insert(name, strlen(name))) == NULL)
+    return -1;
+  return store(v, value, len);
+}
+
+/* *
+ * Sets the variable name to the integer num.  The value is only formatted as a string when it is
+ * read as one (or at once, if the variable is exported.)
+ *
+ * Returns - 0 on success, or -1 if the variable could not be set.
+ * */
+int vars_set_int(const char *name, long long num) {
+  struct var *v;
+  char number[NUMBER_SIZE];
+  if((v = insert(name, strlen(name))) == NULL)
+    return -1;
+  if(v->array != NULL || v->map != NULL) {
+    snprintf(number, sizeof(number), "%lld", num);
+    return store(v, number, strlen(number));
+  }
+  v->num = num;
+  v->flags |= VAR_NUMBER | VAR_STALE;
+  if((v->flags & VAR_EXPORTED) && (format(v) == NULL || setenv(v->name, v->value, 1) == -1))
+    return -1;
+  return 0;
+}
+
+/* *
+ * Returns - Element index of the array name (counting back from the end if index is negative), or
+ *           NULL if it is not set.  A variable that is not an array is element 0.  The value is
+ *           valid until the variable is next set.
+ * */
+const char* vars_array_get(const char *name, long long index) {
+  struct var *v;
+  char key[NUMBER_SIZE];
+  if((v = find(name, strlen(name))) == NULL)
+    return index == 0 || index == -1 ? getenv(name) : NULL;
+  if(v->map != NULL) {
+    snprintf(key, sizeof(key), "%lld", index);
+    return map_get(v->map, key, strlen(key));
+  }
+  if(v->array == NULL)
+    return index == 0 || index == -1 ? value_of(v) : NULL;
+  if(index < 0)
+    index += (long long) v->array->num;
+  if(index < 0 || (size_t) index >= v->array->num)
+    return NULL;
+  return v->array->items[index];
+}
+
+/* *
+ * Returns - The elements of the array name, indexed by subscript (NULL where an index is unset),
+ *           or the values of the associative array name, in the order of vars_array_keys, storing
+ *           the number of them in num, or NULL if name is not an array.  The elements are valid
+ *           until the variable is next set.
+ * */
+char** vars_array_items(const char *name, size_t *num) {
+  struct var *v;
+  if((v = find(name, strlen(name))) == NULL || (v->array == NULL && v->map == NULL))
+    return NULL;
+  if(v->map != NULL) {
+    *num = v->map->num;
+    return v->map->values;
+  }
+  *num = v->array->num;
+  return v->array->items;
+}
+
+/* *
+ * Returns - The keys of the associative array name, in the order they were first set, storing
+ *           the number of them in num, or NULL if name is not an associative array.
+ * */
+char** vars_array_keys(const char *name, size_t *num) {
+  struct var *v;
+  if((v = find(name, strlen(name))) == NULL || v->map == NULL)
+    return NULL;
+  *num = v->map->num;
+  return v->map->keys;
+}
+
+/* *
+ * Returns - 1 if the variable name is an associative array, 0 if not.
+ * */
+int vars_is_assoc(const char *name) {
+  struct var *v;
+  return (v = find(name, strlen(name))) != NULL && v->map != NULL;
+}
+
+/* *
+ * Returns - The value of the key_len characters of key in the associative array name, or NULL if
+ *           it is not set.  The value is valid until the variable is next set.
+ * */
+const char* vars_assoc_get(const char *name, const char *key, size_t key_len) {
+  struct var *v;
+  if((v = find(name, strlen(name))) == NULL || v->map == NULL)
+    return NULL;
+  return map_get(v->map, key, key_len);
+}
+
+/* *
+ * Sets the key_len characters of key in the associative array name to the len characters of
+ * value.
+ *
+ * Returns - 0 on success, or -1 if name is not an associative array or the element could not be
+ *           set.
+ * */
+int vars_assoc_set(const char *name, const char *key, size_t key_len, const char *value,
+                   size_t len) {
+  struct var *v;
+  if((v = find(name, strlen(name))) == NULL || v->map == NULL) {
+    fprintf(stderr, "tinysh: %s: not an associative array\n", name);
+    return -1;
+  }
+  return map_store(v->map, key, key_len, value, len);
+}
+
+/* *
+ * Sets element index of the array name (counting back from the end if index is negative) to the
+ * len characters of value, making name an array if it is not one.
+ *
+ * Returns - 0 on success, or -1 if the element could not be set.
+ * */
+int vars_array_set(const char *name, long long index, const char *value, size_t len) {
+  struct var *v;
+  char key[NUMBER_SIZE];
+  if((v = insert(name, strlen(name))) == NULL)
+    return -1;
+  if(v->map != NULL) {
+    snprintf(key, sizeof(key), "%lld", index);
+    return map_store(v->map, key, strlen(key), value, len);
+  }
+  return array_set(v, index, value, len);
+}
+
+/* *
+ * Replaces the array name (or the variable, if it is not one) with the num elements of items,
+ * whose strings lie within data, a block of size bytes.  items and data must be allocated with
+ * mem_malloc against MEM_VARS, and belong to the array from then on, so a file read into one
+ * buffer becomes an array without copying its lines.
+ *
+ * Returns - 0 on success, or -1 (with items and data freed) on failure.
+ * */
+int vars_array_adopt(const char *name, char **items, size_t num, char *data, size_t size) {
+  struct var *v;
+  struct array *a;
+  if((v = insert(name, strlen(name))) == NULL || (a = make_array(v)) == NULL) {
+    mem_free(MEM_VARS, items);
+    mem_free(MEM_VARS, data);
+    return -1;
+  }
+  arena_free(&a->arena);
+  mem_free(MEM_VARS, a->items);
+  memset(a, 0, sizeof(*a));
+  a->items = items;
+  a->num = num;
+  a->capacity = num;
+  return arena_adopt(&a->arena, data, size);
+}
+
+/* *
+ * Returns - The length of the variable name at the start of str, or 0 if str does not start with
+ *           one.  A name is a letter or underscore, followed by letters, digits, and underscores.
+ * */
+size_t vars_name_len(const char *str) {
+  size_t len;
+  if(!(str[0] == '_' || (str[0] >= 'a' && str[0] <= 'z') || (str[0] >= 'A' && str[0] <= 'Z')))
+    return 0;
+  for(len = 1; str[len] == '_' || (str[len] >= 'a' && str[len] <= 'z')
+      || (str[len] >= 'A' && str[len] <= 'Z') || (str[len] >= '0' && str[len] <= '9'); len++)
+    ;
+  return len;
+}
+
+/* *
+ * Returns - 1 if every word of the command line cmd is an assignment (name=value, name[sub]=value,
+ *           or name=(value ...) over several words, each with = or +=), 0 otherwise.
+ * */
+int vars_assignments(char **cmd) {
+  size_t i;
+  struct assignment as;
+  for(i = 0; cmd[i] != NULL; i++) {
+    if(parse_assignment(cmd[i], &as) == -1 || as.value == NULL
+       || compound_end(cmd, i, &as, &i) == -1)
+      return 0;
+  }
+  return 1;
+}
+
+/* *
+ * Forgets every variable.
+ * */
+void vars_clear(void) {
+  size_t i;
+  for(i = 0; i < capacity; i++) {
+    if(table[i].name != NULL) {
+      mem_free(MEM_VARS, table[i].name);
+      mem_free(MEM_VARS, table[i].value);
+      array_free(table[i].array);
+      map_free(table[i].map);
+    }
+  }
+  mem_free(MEM_VARS, table);
+  table = NULL;
+  capacity = 0;
+  used = 0;
+  arena_free(&scope_arena);
+}
+
+/* *
+ * Handler for a command line of assignments.
+ *
+ * name=value [name[sub]=value] [name=(value ...)] [name+=value] ...
+ *
+ * Sets each variable, in order, in the shell process.  name[sub]=value sets an element of an array
+ * (sub is a key, if name is an associative array, or else an arithmetic index), and
+ * name=(value ...) replaces the elements of an array, where a value may be [sub]=value.  += appends
+ * to a value, or adds elements to an array.
+ * */
+int assign_handle(char **cmd, size_t num_cmd) {
+  size_t i;
+  struct assignment as;
+  for(i = 0; i < num_cmd; i++) {
+    if(parse_assignment(cmd[i], &as) == -1 || assign(cmd, i, &as, &i) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+/* *
+ * Handler for the declare builtin.
+ *
+ * declare [-aAp] [name[=value] ...]
+ *
+ * Makes each name an indexed array (-a) or an associative array (-A), and runs its assignment, if
+ * it has one, as assign_handle would.  With -p, or with no names, prints the variables instead:
+ * each name, or every variable set in the shell.
+ * */
+int declare_handle(char **cmd, size_t num_cmd) {
+  size_t i;
+  int kind, print;
+  char *opt;
+  struct assignment as;
+  struct var *v;
+
+  kind = 0;
+  print = 0;
+  for(i = 1; i < num_cmd && cmd[i][0] == '-' && cmd[i][1] != '\0'; i++) {
+    if(strcmp(cmd[i], "--") == 0) {
+      i++;
+      break;
+    }
+    for(opt = cmd[i] + 1; *opt != '\0'; opt++) {
+      if(*opt == 'p')
+        print = 1;
+      else if(*opt == 'a' || *opt == 'A')
+        kind = *opt;
+      else {
+        fprintf(stderr, "declare: -%c: invalid option\n"
+                "Usage: declare [-aAp] [name[=value] ...]\n", *opt);
+        last_status = 2;
+        return -1;
+      }
+    }
+  }
+
+  if(i == num_cmd) {
+    for(i = 0; i < capacity; i++) {
+      if(table[i].name != NULL)
+        declare_print(&table[i]);
+    }
+  }
+  for(; i < num_cmd; i++) {
+    if(parse_assignment(cmd[i], &as) == -1 || (print && as.value != NULL)) {
+      fprintf(stderr, "declare: `%s': not a valid identifier\n", cmd[i]);
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+    if(print && (v = find(cmd[i], as.name_len)) == NULL) {
+      fprintf(stderr, "declare: %s: not found\n", cmd[i]);
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+    if(print) {
+      declare_print(v);
+      continue;
+    }
+    // A name with no kind and no value is left unset.
+    if(kind != 0 && ((v = insert(cmd[i], as.name_len)) == NULL || declare_kind(v, kind) == -1)) {
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+    if(as.value != NULL && assign(cmd, i, &as, &i) == -1) {
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+  }
+  last_status = writer_flush(STDOUT_FILENO) == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+  return last_status == EXIT_SUCCESS ? 0 : -1;
+}
+
+/* *
+ * Starts the scope of a function call, s, whose locals are restored by vars_pop_scope.
+ * */
+void vars_push_scope(struct vars_scope *s) {
+  s->saved = NULL;
+  // Marked with a block, the arena keeps it when the scope is released.
+  if(scope_arena.blocks == NULL)
+    arena_alloc(&scope_arena, 0);
+  arena_mark(&scope_arena, &s->mark);
+  s->outer = scope;
+  scope = s;
+}
+
+/* *
+ * Ends the scope of the innermost function call, putting back the variables it made local, last
+ * saved first, and releasing the arena they were saved in.
+ * */
+void vars_pop_scope(void) {
+  struct saved_var *sv;
+  struct var *v;
+  const char *value;
+  char *name;
+
+  for(sv = scope->saved; sv != NULL; sv = sv->next) {
+    v = sv->set ? insert(sv->name, strlen(sv->name)) : find(sv->name, strlen(sv->name));
+    if(v != NULL) {
+      mem_free(MEM_VARS, v->value);
+      array_free(v->array);
+      map_free(v->map);
+    }
+    if(!sv->set) {
+      if(v != NULL)
+        remove_var(v);
+      continue;
+    }
+    if(v == NULL) {
+      mem_free(MEM_VARS, sv->var.value);
+      array_free(sv->var.array);
+      map_free(sv->var.map);
+      continue;
+    }
+    name = v->name;
+    *v = sv->var;
+    v->name = name;
+    if((v->flags & VAR_EXPORTED) && (value = value_of(v)) != NULL && setenv(name, value, 1) == -1)
+      perror("Error exporting a variable.");
+  }
+  arena_release(&scope_arena, &scope->mark);
+  scope = scope->outer;
+}
+
+/* *
+ * Handler for the local builtin.
+ *
+ * local [name[=value] ...]
+ *
+ * Makes each name local to the function being run, and runs its assignment, if it has one, as
+ * assign_handle would.  A local without a value starts out empty.  The variable is put back as it
+ * was when the function returns.
+ * */
+int local_handle(char **cmd, size_t num_cmd) {
+  size_t i;
+  struct assignment as;
+
+  if(scope == NULL) {
+    fprintf(stderr, "local: can only be used in a function\n");
+    last_status = EXIT_FAILURE;
+    return -1;
+  }
+  for(i = 1; i < num_cmd; i++) {
+    if(parse_assignment(cmd[i], &as) == -1 || as.sub != NULL) {
+      fprintf(stderr, "local: `%s': not a valid identifier\n", cmd[i]);
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+    if(save_var(cmd[i], as.name_len) == -1
+       || (as.value != NULL && assign(cmd, i, &as, &i) == -1)) {
+      last_status = EXIT_FAILURE;
+      return -1;
+    }
+  }
+  last_status = EXIT_SUCCESS;
+  return 0;
+}
+
+/* *
+ * FNV-1a hash of the first len characters of name.
+ * */
+static unsigned long name_hash(const char *name, size_t len) {
+  unsigned long h = 14695981039346656037UL;
+  while(len-- > 0) {
+    h ^= (unsigned char) *name++;
+    h *= 1099511628211UL;
+  }
+  return h;
+}
+
+/* *
+ * Returns - The slot holding the first len characters of name, or the empty slot where they would
+ *           be inserted.  The table must be allocated.
+ * */
+static struct var* find_slot(const char *name, size_t len) {
+  size_t i = name_hash(name, len) & (capacity - 1);
+  while(table[i].name != NULL
+        && (strncmp(table[i].name, name, len) != 0 || table[i].name[len] != '\0'))
+    i = (i + 1) & (capacity - 1);
+  return &table[i];
+}
+
+/* *
+ * Returns - The variable called by the first len characters of name, or NULL if it is not set.
+ * */
+static struct var* find(const char *name, size_t len) {
+  struct var *v;
+  if(table == NULL || (v = find_slot(name, len))->name == NULL)
+    return NULL;
+  return v;
+}
+
+/* *
+ * Returns - The variable called by the first len characters of name, added to the table (with no
+ *           value) if it is not there, or NULL if it could not be added.
+ * */
+static struct var* insert(const char *name, size_t len) {
+  size_t i, old_capacity;
+  struct var *old_table, *slot;
+  char *name_copy;
+
+  if((slot = find(name, len)) != NULL)
+    return slot;
+  if(table == NULL || (used + 1) * 100 > capacity * VARS_MAX_LOAD_PCT) {
+    old_table = table;
+    old_capacity = capacity;
+    capacity = capacity ? capacity * 2 : DEFAULT_VARS_CAPACITY;
+    if((table = mem_calloc(MEM_VARS, capacity, sizeof(*table))) == NULL) {
+      perror("Error allocating memory for the variables.");
+      table = old_table;
+      capacity = old_capacity;
+      return NULL;
+    }
+    for(i = 0; i < old_capacity; i++) {
+      if(old_table[i].name != NULL)
+        *find_slot(old_table[i].name, strlen(old_table[i].name)) = old_table[i];
+    }
+    mem_free(MEM_VARS, old_table);
+  }
+
+  if((name_copy = mem_malloc(MEM_VARS, len + 1)) == NULL) {
+    perror("Error allocating memory for a variable.");
+    return NULL;
+  }
+  memcpy(name_copy, name, len);
+  name_copy[len] = '\0';
+  slot = find_slot(name, len);
+  memset(slot, 0, sizeof(*slot));
+  slot->name = name_copy;
+  if(getenv(name_copy) != NULL)
+    slot->flags = VAR_EXPORTED;
+  used++;
+  return slot;
+}
+
+/* *
+ * Removes v, whose value and elements have been freed, from the table, moving back each variable
+ * after it in its run that would no longer be found.
+ * */
+static void remove_var(struct var *v) {
+  size_t hole = (size_t) (v - table), i, home;
+
+  mem_free(MEM_VARS, v->name);
+  for(i = (hole + 1) & (capacity - 1); table[i].name != NULL; i = (i + 1) & (capacity - 1)) {
+    home = name_hash(table[i].name, strlen(table[i].name)) & (capacity - 1);
+    // The variable at i can fill the hole unless its home slot lies after the hole, up to i.
+    if(hole < i ? (home <= hole || home > i) : (home <= hole && home > i)) {
+      table[hole] = table[i];
+      hole = i;
+    }
+  }
+  memset(&table[hole], 0, sizeof(table[hole]));
+  used--;
+}
+
+/* *
+ * Saves the variable called by the first len characters of name in the innermost scope, and
+ * leaves it empty, unless the scope has saved it already.  A variable that is only in the
+ * environment is first set in the shell, so that it is put back there.
+ *
+ * Returns - 0 on success, or -1 on an error.
+ * */
+static int save_var(const char *name, size_t len) {
+  struct saved_var *sv;
+  struct var *v;
+  const char *env;
+
+  for(sv = scope->saved; sv != NULL; sv = sv->next) {
+    if(strncmp(sv->name, name, len) == 0 && sv->name[len] == '\0')
+      return 0;
+  }
+  if((sv = arena_alloc_object(&scope_arena, sizeof(*sv) + len + 1)) == NULL)
+    return -1;
+  memset(sv, 0, sizeof(*sv));
+  sv->name = (char *) (sv + 1);
+  memcpy(sv->name, name, len);
+  sv->name[len] = '\0';
+  if((v = find(name, len)) == NULL && (env = getenv(sv->name)) != NULL
+     && ((v = insert(name, len)) == NULL || store(v, env, strlen(env)) == -1))
+    return -1;
+  if(v != NULL) {
+    sv->set = 1;
+    sv->var = *v;
+    v->value = NULL;
+    v->size = 0;
+    v->num = 0;
+    v->flags &= VAR_EXPORTED;
+    v->array = NULL;
+    v->map = NULL;
+    if((v->flags & VAR_EXPORTED) && unsetenv(v->name) == -1) {
+      perror("Error exporting a variable.");
+      return -1;
+    }
+  }
+  sv->next = scope->saved;
+  scope->saved = sv;
+  return 0;
+}
+
+/* *
+ * Stores the len characters of value as the value of v.
+ * */
+static int store(struct var *v, const char *value, size_t len) {
+  char *buf;
+  if(v->array != NULL)
+    return array_store(v->array, 0, value, len);
+  if(v->map != NULL)
+    return map_store(v->map, "0", 1, value, len);
+  if(len + 1 > v->size) {
+    if((buf = mem_realloc(MEM_VARS, v->value, len + 1)) == NULL) {
+      perror("Error allocating memory for a variable.");
+      return -1;
+    }
+    v->value = buf;
+    v->size = len + 1;
+  }
+  memcpy(v->value, value, len);
+  v->value[len] = '\0';
+  v->flags &= ~(VAR_NUMBER | VAR_STALE);
+  if((v->flags & VAR_EXPORTED) && setenv(v->name, v->value, 1) == -1) {
+    perror("Error exporting a variable.");
+    return -1;
+  }
+  return 0;
+}
+
+/* *
+ * Appends the len characters of value to the value of v (element 0, if it is an array.)
+ * */
+static int store_append(struct var *v, const char *value, size_t len) {
+  const char *old;
+  char *buf;
+  size_t old_len;
+  if(v->array != NULL || v->map != NULL)
+    return assign_element(v, "0", 1, value, len, 1);
+  // A variable from the environment is not in the table until it is set.
+  if(v->value == NULL && (old = getenv(v->name)) != NULL && store(v, old, strlen(old)) == -1)
+    return -1;
+  if((old = format(v)) == NULL)
+    return -1;
+  old_len = strlen(old);
+  if(old_len + len + 1 > v->size) {
+    if((buf = mem_realloc(MEM_VARS, v->value, old_len + len + 1)) == NULL) {
+      perror("Error allocating memory for a variable.");
+      return -1;
+    }
+    v->value = buf;
+    v->size = old_len + len + 1;
+  }
+  memcpy(v->value + old_len, value, len);
+  v->value[old_len + len] = '\0';
+  v->flags &= ~(VAR_NUMBER | VAR_STALE);
+  if((v->flags & VAR_EXPORTED) && setenv(v->name, v->value, 1) == -1) {
+    perror("Error exporting a variable.");
+    return -1;
+  }
+  return 0;
+}
+
+/* *
+ * Returns - The value of v as a string, formatting it from the integer if it is stale, or NULL if
+ *           it could not be formatted.
+ * */
+static const char* format(struct var *v) {
+  char *buf;
+  if(!(v->flags & VAR_STALE))
+    return v->value != NULL ? v->value : "";
+  if(v->size < NUMBER_SIZE) {
+    if((buf = mem_realloc(MEM_VARS, v->value, NUMBER_SIZE)) == NULL) {
+      perror("Error allocating memory for a variable.");
+      return NULL;
+    }
+    v->value = buf;
+    v->size = NUMBER_SIZE;
+  }
+  snprintf(v->value, v->size, "%lld", v->num);
+  v->flags &= ~VAR_STALE;
+  return v->value;
+}
+
+/* *
+ * Returns - The value of v (element 0, if it is an array), or NULL if it has none.
+ * */
+static const char* value_of(struct var *v) {
+  if(v->map != NULL)
+    return map_get(v->map, "0", 1);
+  if(v->array != NULL)
+    return v->array->num > 0 ? v->array->items[0] : NULL;
+  return format(v);
+}
+
+/* *
+ * Returns - The elements of v, turning it into an array (whose element 0 is its value) if it is
+ *           not one, or NULL if it could not be.
+ * */
+static struct array* make_array(struct var *v) {
+  const char *value;
+  struct array *a;
+  if(v->array != NULL)
+    return v->array;
+  if(v->map != NULL) {
+    fprintf(stderr, "tinysh: %s: not an indexed array\n", v->name);
+    return NULL;
+  }
+  if((a = mem_calloc(MEM_VARS, 1, sizeof(*a))) == NULL) {
+    perror("Error allocating memory for an array.");
+    return NULL;
+  }
+  if(v->value != NULL && (value = format(v)) != NULL && array_store(a, 0, value, strlen(value))
+     == -1) {
+    array_free(a);
+    return NULL;
+  }
+  mem_free(MEM_VARS, v->value);
+  v->value = NULL;
+  v->size = 0;
+  v->flags &= ~(VAR_NUMBER | VAR_STALE);
+  v->array = a;
+  return a;
+}
+
+/* *
+ * Sets element index of v (counting back from the end if index is negative) to the len characters
+ * of value, making v an array if it is not one.
+ * */
+static int array_set(struct var *v, long long index, const char *value, size_t len) {
+  struct array *a;
+  if((a = make_array(v)) == NULL)
+    return -1;
+  if(index < 0 && (index += (long long) a->num) < 0) {
+    fprintf(stderr, "tinysh: %s: bad array subscript\n", v->name);
+    return -1;
+  }
+  return array_store(a, index, value, len);
+}
+
+/* *
+ * Stores the len characters of value as element index of a.
+ * */
+static int array_store(struct array *a, size_t index, const char *value, size_t len) {
+  char **items;
+  size_t capacity;
+
+  if(index >= a->capacity) {
+    for(capacity = a->capacity ? a->capacity : DEFAULT_ARRAY_CAPACITY; capacity <= index; )
+      capacity *= 2;
+    if((items = mem_realloc(MEM_VARS, a->items, capacity * sizeof(*items))) == NULL) {
+      perror("Error allocating memory for an array.");
+      return -1;
+    }
+    memset(items + a->capacity, 0, (capacity - a->capacity) * sizeof(*items));
+    a->items = items;
+    a->capacity = capacity;
+  }
+  if(replace(&a->arena, &a->wasted, &a->items[index], value, len) == -1)
+    return -1;
+  if(index >= a->num)
+    a->num = index + 1;
+  if(a->wasted > ARRAY_COMPACT_BYTES && a->wasted * 2 > a->arena.bytes)
+    array_compact(a);
+  return 0;
+}
+
+/* *
+ * Copies the elements of a to a fresh arena, dropping the strings that were replaced.  If that
+ * fails, a is left as it was.
+ * */
+static void array_compact(struct array *a) {
+  size_t i;
+  struct arena fresh;
+  char **items;
+
+  memset(&fresh, 0, sizeof(fresh));
+  if((items = mem_malloc(MEM_VARS, a->capacity * sizeof(*items))) == NULL)
+    return;
+  for(i = 0; i < a->capacity; i++) {
+    items[i] = NULL;
+    if(a->items[i] != NULL && (items[i] = arena_strndup(&fresh, a->items[i], strlen(a->items[i])))
+       == NULL) {
+      arena_free(&fresh);
+      mem_free(MEM_VARS, items);
+      return;
+    }
+  }
+  arena_free(&a->arena);
+  mem_free(MEM_VARS, a->items);
+  a->items = items;
+  a->arena = fresh;
+  a->wasted = 0;
+}
+
+/* *
+ * Removes every element of a, keeping its vector.
+ * */
+static void array_reset(struct array *a) {
+  arena_free(&a->arena);
+  memset(a->items, 0, a->capacity * sizeof(*a->items));
+  a->num = 0;
+  a->wasted = 0;
+}
+
+/* *
+ * Frees the array a.
+ * */
+static void array_free(struct array *a) {
+  if(a == NULL)
+    return;
+  arena_free(&a->arena);
+  mem_free(MEM_VARS, a->items);
+  mem_free(MEM_VARS, a);
+}
+
+/* *
+ * Returns - The elements of v, turning it into an associative array (whose key 0 holds its value)
+ *           if it is not one, or NULL if it could not be.
+ * */
+static struct map* make_map(struct var *v) {
+  const char *value;
+  struct map *m;
+  if(v->map != NULL)
+    return v->map;
+  if((m = mem_calloc(MEM_VARS, 1, sizeof(*m))) == NULL) {
+    perror("Error allocating memory for an array.");
+    return NULL;
+  }
+  if(v->value != NULL && (value = format(v)) != NULL && map_store(m, "0", 1, value, strlen(value))
+     == -1) {
+    map_free(m);
+    return NULL;
+  }
+  mem_free(MEM_VARS, v->value);
+  v->value = NULL;
+  v->size = 0;
+  v->flags &= ~(VAR_NUMBER | VAR_STALE);
+  v->map = m;
+  return m;
+}
+
+/* *
+ * Returns - The slot of the index of m holding the position of the first len characters of key,
+ *           or the empty slot where it would be inserted.  The index must be allocated.
+ * */
+static size_t* map_slot(const struct map *m, const char *key, size_t len) {
+  size_t mask = 2 * m->capacity - 1, i = name_hash(key, len) & mask, pos;
+  while((pos = m->index[i]) != 0
+        && (strncmp(m->keys[pos - 1], key, len) != 0 || m->keys[pos - 1][len] != '\0'))
+    i = (i + 1) & mask;
+  return &m->index[i];
+}
+
+/* *
+ * Returns - The value of the first len characters of key in m, or NULL if it is not set.
+ * */
+static const char* map_get(const struct map *m, const char *key, size_t len) {
+  size_t pos;
+  if(m->index == NULL || (pos = *map_slot(m, key, len)) == 0)
+    return NULL;
+  return m->values[pos - 1];
+}
+
+/* *
+ * Sets the key_len characters of key in m to the len characters of value.
+ * */
+static int map_store(struct map *m, const char *key, size_t key_len, const char *value,
+                     size_t len) {
+  size_t i, capacity, *slot, *index;
+  char **keys, **values;
+
+  if(m->index != NULL && *(slot = map_slot(m, key, key_len)) != 0) {
+    if(replace(&m->arena, &m->wasted, &m->values[*slot - 1], value, len) == -1)
+      return -1;
+    if(m->wasted > ARRAY_COMPACT_BYTES && m->wasted * 2 > m->arena.bytes)
+      map_compact(m);
+    return 0;
+  }
+
+  // Grow the vectors and rebuild the index, which is kept at most half full.
+  if(m->num == m->capacity) {
+    capacity = m->capacity ? m->capacity * 2 : DEFAULT_MAP_CAPACITY;
+    if((keys = mem_realloc(MEM_VARS, m->keys, capacity * sizeof(*keys))) == NULL) {
+      perror("Error allocating memory for an array.");
+      return -1;
+    }
+    m->keys = keys;
+    if((values = mem_realloc(MEM_VARS, m->values, capacity * sizeof(*values))) == NULL) {
+      perror("Error allocating memory for an array.");
+      return -1;
+    }
+    m->values = values;
+    if((index = mem_calloc(MEM_VARS, 2 * capacity, sizeof(*index))) == NULL) {
+      perror("Error allocating memory for an array.");
+      return -1;
+    }
+    mem_free(MEM_VARS, m->index);
+    m->index = index;
+    m->capacity = capacity;
+    for(i = 0; i < m->num; i++)
+      *map_slot(m, m->keys[i], strlen(m->keys[i])) = i + 1;
+  }
+
+  slot = map_slot(m, key, key_len);
+  if((m->keys[m->num] = arena_strndup(&m->arena, key, key_len)) == NULL)
+    return -1;
+  m->values[m->num] = NULL;
+  if(replace(&m->arena, &m->wasted, &m->values[m->num], value, len) == -1)
+    return -1;
+  *slot = ++m->num;
+  return 0;
+}
+
+/* *
+ * Removes every element of m, keeping its vectors and index.
+ * */
+static void map_reset(struct map *m) {
+  arena_free(&m->arena);
+  if(m->index != NULL)
+    memset(m->index, 0, 2 * m->capacity * sizeof(*m->index));
+  m->num = 0;
+  m->wasted = 0;
+}
+
+/* *
+ * Copies the keys and values of m to a fresh arena, dropping the values that were replaced.  If
+ * that fails, m is left as it was.
+ * */
+static void map_compact(struct map *m) {
+  size_t i;
+  struct arena fresh;
+  char **keys, **values;
+
+  memset(&fresh, 0, sizeof(fresh));
+  keys = mem_malloc(MEM_VARS, m->capacity * sizeof(*keys));
+  values = mem_malloc(MEM_VARS, m->capacity * sizeof(*values));
+  for(i = 0; keys != NULL && values != NULL && i < m->num; i++) {
+    if((keys[i] = arena_strndup(&fresh, m->keys[i], strlen(m->keys[i]))) == NULL
+       || (values[i] = arena_strndup(&fresh, m->values[i], strlen(m->values[i]))) == NULL)
+      break;
+  }
+  if(keys == NULL || values == NULL || i < m->num) {
+    arena_free(&fresh);
+    mem_free(MEM_VARS, keys);
+    mem_free(MEM_VARS, values);
+    return;
+  }
+  arena_free(&m->arena);
+  mem_free(MEM_VARS, m->keys);
+  mem_free(MEM_VARS, m->values);
+  m->keys = keys;
+  m->values = values;
+  m->arena = fresh;
+  m->wasted = 0;
+}
+
+/* *
+ * Frees the associative array m.
+ * */
+static void map_free(struct map *m) {
+  if(m == NULL)
+    return;
+  arena_free(&m->arena);
+  mem_free(MEM_VARS, m->keys);
+  mem_free(MEM_VARS, m->values);
+  mem_free(MEM_VARS, m->index);
+  mem_free(MEM_VARS, m);
+}
+
+/* *
+ * Stores the len characters of value in *item, an element of an array whose strings are in arena.
+ * A value no longer than the one it replaces is stored in its place; otherwise the old value is
+ * added to wasted.
+ * */
+static int replace(struct arena *arena, size_t *wasted, char **item, const char *value,
+                   size_t len) {
+  char *old;
+  size_t old_len;
+  if((old = *item) != NULL && (old_len = strlen(old)) >= len) {
+    memmove(old, value, len);
+    old[len] = '\0';
+    *wasted += old_len - len;
+    return 0;
+  }
+  if(old != NULL)
+    *wasted += old_len + 1;
+  if((*item = arena_strndup(arena, value, len)) == NULL) {
+    *item = old;
+    return -1;
+  }
+  return 0;
+}
+
+/* *
+ * Splits the assignment word into as.
+ *
+ * Returns - 0 on success, or -1 if word is neither an assignment nor a name.
+ * */
+static int parse_assignment(const char *word, struct assignment *as) {
+  const char *c;
+  int depth;
+
+  memset(as, 0, sizeof(*as));
+  if((as->name_len = vars_name_len(word)) == 0)
+    return -1;
+  c = word + as->name_len;
+  if(*c == '[') {
+    for(depth = 0, c++; *c != '\0' && (*c != ']' || depth > 0); c++)
+      depth += *c == '[' ? 1 : *c == ']' ? -1 : 0;
+    if(*c != ']' || c[1] == '\0')
+      return -1;
+    as->sub = word + as->name_len + 1;
+    as->sub_len = c - as->sub;
+    c++;
+  }
+  if(*c == '+' && c[1] == '=') {
+    as->append = 1;
+    c++;
+  }
+  if(*c == '=') {
+    as->value = c + 1;
+    as->compound = as->sub == NULL && *as->value == '(';
+    return 0;
+  }
+  return *c == '\0' ? 0 : -1;
+}
+
+/* *
+ * Finds the last word of the assignment as, which starts at word i of cmd, and stores its index
+ * in last: the first word from i that ends with ) if as is a compound assignment, or else i.
+ *
+ * Returns - 0 on success, or -1 if the line ends before the ).
+ * */
+static int compound_end(char **cmd, size_t i, const struct assignment *as, size_t *last) {
+  size_t len;
+  if(!as->compound || ((len = strlen(as->value)) > 1 && as->value[len - 1] == ')')) {
+    *last = i;
+    return 0;
+  }
+  for(i++; cmd[i] != NULL; i++) {
+    if((len = strlen(cmd[i])) > 0 && cmd[i][len - 1] == ')') {
+      *last = i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/* *
+ * Runs the assignment as, which starts at word i of cmd, and stores the index of its last word in
+ * last.  Errors are printed.
+ * */
+static int assign(char **cmd, size_t i, const struct assignment *as, size_t *last) {
+  struct var *v;
+  if(compound_end(cmd, i, as, last) == -1) {
+    fprintf(stderr, "tinysh: %s: missing )\n", cmd[i]);
+    return -1;
+  }
+  if(VERBOSE(V_PROC))
+    printf("Setting the variable %.*s in the shell process.\n", (int) as->name_len, cmd[i]);
+  if((v = insert(cmd[i], as->name_len)) == NULL)
+    return -1;
+  if(as->compound)
+    return assign_compound(v, cmd + i, *last - i + 1, as);
+  if(as->sub != NULL)
+    return assign_element(v, as->sub, as->sub_len, as->value, strlen(as->value), as->append);
+  if(as->append)
+    return store_append(v, as->value, strlen(as->value));
+  return store(v, as->value, strlen(as->value));
+}
+
+/* *
+ * Sets the element of v whose subscript is the sub_len characters of sub (a key, if v is an
+ * associative array, or else an arithmetic index) to the len characters of value, or appends them
+ * to it.
+ * */
+static int assign_element(struct var *v, const char *sub, size_t sub_len, const char *value,
+                          size_t len, int append) {
+  const char *old;
+  char *joined;
+  long long index;
+  size_t old_len;
+  int status;
+
+  if(v->map == NULL && eval_index(sub, sub_len, &index) == -1)
+    return -1;
+  if(!append) {
+    if(v->map != NULL)
+      return map_store(v->map, sub, sub_len, value, len);
+    return array_set(v, index, value, len);
+  }
+  if(v->map != NULL)
+    old = map_get(v->map, sub, sub_len);
+  else if(v->array != NULL)
+    old = index < 0 && index + (long long) v->array->num < 0 ? NULL
+        : v->array->items[index < 0 ? index + (long long) v->array->num : index];
+  else
+    old = index == 0 || index == -1 ? value_of(v) : NULL;
+  old_len = old != NULL ? strlen(old) : 0;
+  if((joined = mem_malloc(MEM_VARS, old_len + len + 1)) == NULL) {
+    perror("Error allocating memory for a variable.");
+    return -1;
+  }
+  memcpy(joined, old, old_len);
+  memcpy(joined + old_len, value, len);
+  if(v->map != NULL)
+    status = map_store(v->map, sub, sub_len, joined, old_len + len);
+  else
+    status = array_set(v, index, joined, old_len + len);
+  mem_free(MEM_VARS, joined);
+  return status;
+}
+
+/* *
+ * Replaces the elements of v (or adds to them, for +=) with the values of the compound assignment
+ * as, which spans the num words of cmd.  A value may be [sub]=value, to set the element sub, after
+ * which plain values go to the indices that follow it.
+ * */
+static int assign_compound(struct var *v, char **cmd, size_t num, const struct assignment *as) {
+  const char *word, *close;
+  size_t i, len;
+  long long next;
+  int depth, status;
+  struct array *a;
+
+  a = NULL;
+  if(v->map == NULL && (a = make_array(v)) == NULL)
+    return -1;
+  if(!as->append && a != NULL)
+    array_reset(a);
+  else if(!as->append)
+    map_reset(v->map);
+  next = a != NULL ? (long long) a->num : 0;
+  for(i = 0; i < num; i++) {
+    word = i == 0 ? as->value + 1 : cmd[i];
+    len = strlen(word) - (i == num - 1);
+    if(len == 0)
+      continue;
+    for(close = word + 1, depth = 0; word[0] == '[' && close < word + len
+        && (*close != ']' || depth > 0); close++)
+      depth += *close == '[' ? 1 : *close == ']' ? -1 : 0;
+    if(word[0] == '[' && close + 1 < word + len && close[1] == '=') {
+      // [sub]=value
+      if(v->map != NULL) {
+        status = map_store(v->map, word + 1, close - word - 1, close + 2, word + len - close - 2);
+      }
+      else if((status = eval_index(word + 1, close - word - 1, &next)) == 0) {
+        status = array_set(v, next, close + 2, word + len - close - 2);
+        next = next < 0 ? next + (long long) a->num : next;
+        next++;
+      }
+    }
+    else if(v->map != NULL) {
+      fprintf(stderr, "tinysh: %s: %.*s: must use subscript when assigning associative array\n",
+              v->name, (int) len, word);
+      status = -1;
+    }
+    else {
+      status = array_store(a, next++, word, len);
+    }
+    if(status == -1)
+      return -1;
+  }
+  return 0;
+}
+
+/* *
+ * Evaluates the len characters of sub as an arithmetic expression, storing its value in index.
+ * */
+static int eval_index(const char *sub, size_t len, long long *index) {
+  char expr[INDEX_SIZE], *copy;
+  int status;
+  if(len < sizeof(expr)) {
+    memcpy(expr, sub, len);
+    expr[len] = '\0';
+    return arith_eval(expr, index);
+  }
+  if((copy = mem_malloc(MEM_VARS, len + 1)) == NULL) {
+    perror("Error allocating memory for a subscript.");
+    return -1;
+  }
+  memcpy(copy, sub, len);
+  copy[len] = '\0';
+  status = arith_eval(copy, index);
+  mem_free(MEM_VARS, copy);
+  return status;
+}
+
+/* *
+ * Makes v an indexed array, if kind is a, or an associative array, if kind is A.  An indexed array
+ * cannot become associative, or the other way around.
+ * */
+static int declare_kind(struct var *v, int kind) {
+  if(kind == 'A' && v->array != NULL) {
+    fprintf(stderr, "declare: %s: cannot convert indexed to associative array\n", v->name);
+    return -1;
+  }
+  if(kind == 'a' && v->map != NULL) {
+    fprintf(stderr, "declare: %s: cannot convert associative to indexed array\n", v->name);
+    return -1;
+  }
+  if((kind == 'A' && make_map(v) == NULL) || (kind == 'a' && make_array(v) == NULL))
+    return -1;
+  return 0;
+}
+
+/* *
+ * Prints v as declare -p does: declare, its kind, and its value, or its elements as [sub]="value"
+ * pairs.
+ * */
+static void declare_print(struct var *v) {
+  size_t i;
+  const char *value;
+  if(v->array != NULL || v->map != NULL) {
+    writer_printf(STDOUT_FILENO, "declare -%c %s=(", v->map != NULL ? 'A' : 'a', v->name);
+    for(i = 0; v->map != NULL && i < v->map->num; i++) {
+      writer_printf(STDOUT_FILENO, "%s[%s]=\"%s\"", i > 0 ? " " : "", v->map->keys[i],
+                    v->map->values[i]);
+    }
+    for(i = 0, value = ""; v->array != NULL && i < v->array->num; i++) {
+      if(v->array->items[i] == NULL)
+        continue;
+      writer_printf(STDOUT_FILENO, "%s[%zu]=\"%s\"", value, i, v->array->items[i]);
+      value = " ";
+    }
+    writer_puts(STDOUT_FILENO, ")\n");
+  }
+  else if((value = format(v)) != NULL) {
+    writer_printf(STDOUT_FILENO, "declare -%c %s=\"%s\"\n", v->flags & VAR_EXPORTED ? 'x' : '-',
+                  v->name, value);
+  }
+}
@@ -0,0 +1,154 @@
+/* *
+ * verbose.c
+ *
+ * Verbose mode settings: which categories of narration are enabled, and at what level.
+ *
+ * The messages themselves are printed where they happen, behind the VERBOSE and VERBOSE_AT macros
+ * (see verbose.h.)  This file parses category lists such as "fd,proc" and implements the verbose
+ * and brief builtins that change them.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "verbose.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int verbose_flag;  // Enabled (level, category) pairs; see VERBOSE_MASK.
+
+static const struct {
+  const char *name;
+  int cat;
+} categories[] = {
+  {"proc", V_PROC},
+  {"fd", V_FD},
+  {"mem", V_MEM},
+  {"parse", V_PARSE},
+  {"all", V_ALL},
+};
+
+static int parse_categories(const char *list);
+static int level_mask(int cats, int level);
+
+/* *
+ * Enables the comma-separated list of categories (or all categories, if NULL) at every level up
+ * to level.
+ *
+ * Returns - 0 on success, or -1 if the list names an unknown category.
+ * */
+int verbose_enable(const char *list, int level) {
+  int cats;
+  if((cats = list ? parse_categories(list) : V_ALL) == -1)
+    return -1;
+  verbose_flag |= level_mask(cats, level);
+  return 0;
+}
+
+/* *
+ * Handler for the verbose builtin.
+ *
+ * verbose [-l level] [category[,category...]]
+ *
+ * Enables verbose mode for the given categories (default: all) up to the given level (default:
+ * the most detailed.)  Categories already enabled stay enabled, and narrowing the level of a
+ * category takes effect for that category only.
+ * */
+int verbose_handle(char **cmd, size_t num_cmd) {
+  size_t i;
+  int level, cats;
+  char *end;
+  const char *list;
+
+#ifdef NVERBOSE
+  printf("Verbose mode is not available in this build of tinysh.\n");
+  return -1;
+#endif
+  level = V_MAX_LEVEL;
+  list = NULL;
+  for(i = 1; i < num_cmd; i++) {
+    if(strcmp(cmd[i], "-l") == 0 && i + 1 < num_cmd) {
+      level = strtol(cmd[++i], &end, 10);
+      if(*end != '\0' || level < 1 || level > V_MAX_LEVEL) {
+        printf("verbose: %s: level must be between 1 and %d\n", cmd[i], V_MAX_LEVEL);
+        return -1;
+      }
+    }
+    else if(list == NULL) {
+      list = cmd[i];
+    }
+    else {
+      printf("Error:  Too many arguments.\nUsage: verbose [-l level] [category[,category...]]\n");
+      return -1;
+    }
+  }
+  if((cats = list ? parse_categories(list) : V_ALL) == -1)
+    return -1;
+  // Replace the settings of the named categories, leaving the others alone.
+  verbose_flag &= ~level_mask(cats, V_MAX_LEVEL);
+  verbose_flag |= level_mask(cats, level);
+  if(VERBOSE(V_ALL))
+    printf("Verbose mode is turned on.\n\n");
+  return 0;
+}
+
+/* *
+ * Handler for the brief builtin.
+ *
+ * brief [category[,category...]]
+ *
+ * Disables verbose mode for the given categories (default: all.)
+ * */
+int brief_handle(char **cmd, size_t num_cmd) {
+  int cats;
+  if(num_cmd > 2) {
+    printf("Error:  Too many arguments.\nUsage: brief [category[,category...]]\n");
+    return -1;
+  }
+  if((cats = num_cmd == 2 ? parse_categories(cmd[1]) : V_ALL) == -1)
+    return -1;
+  if(VERBOSE(cats))
+    printf("Turning off verbose mode.\n\n");
+  verbose_flag &= ~level_mask(cats, V_MAX_LEVEL);
+  return 0;
+}
+
+/* *
+ * Parses a comma-separated list of category names.
+ *
+ * Returns - The categories' bits, or -1 (after printing an error) if a name is unknown.
+ * */
+static int parse_categories(const char *list) {
+  size_t i, len;
+  int cats = 0;
+  while(*list) {
+    len = strcspn(list, ",");
+    for(i = 0; i < sizeof(categories) / sizeof(categories[0]); i++) {
+      if(strlen(categories[i].name) == len && strncmp(categories[i].name, list, len) == 0)
+        break;
+    }
+    if(i == sizeof(categories) / sizeof(categories[0])) {
+      printf("verbose: %.*s: unknown category (expected proc, fd, mem, parse, or all)\n",
+             (int) len, list);
+      return -1;
+    }
+    cats |= categories[i].cat;
+    list += len;
+    if(*list == ',')
+      list++;
+  }
+  return cats;
+}
+
+/* *
+ * Returns - The verbose_flag bits enabling cats at every level up to level.
+ * */
+static int level_mask(int cats, int level) {
+  int mask = 0;
+  for(; level >= 1; level--)
+    mask |= VERBOSE_MASK(level, cats);
+  return mask;
+}
@@ -0,0 +1,114 @@
+/* *
+ * writer.c
+ *
+ * Buffered output for the builtins that run in the shell process.
+ *
+ * Each of stdout and stderr has its own buffer, which a builtin fills as it goes and flushes
+ * once when it is done, so that e.g. an echo of many words is one write rather than one per word.
+ * The buffers sit below stdio: they are written straight to the file descriptors, which is what a
+ * builtin run as a pipeline stage needs once its stdout has been moved onto a pipe.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "writer.h"
+#include "fdio.h"
+#include "mem.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string.h>
+
+#define WRITER_SIZE 4096  // Size of each descriptor's buffer.
+#define WRITER_FDS  3     // Descriptors with a buffer: stdin (unused), stdout, and stderr.
+
+/*
+ * Output waiting to be written to one file descriptor.
+ */
+struct writer {
+  size_t len;
+  int failed;  // 1 if a write has failed since the last flush.
+  char buf[WRITER_SIZE];
+};
+
+static struct writer writers[WRITER_FDS];
+
+/* *
+ * Appends len bytes of data to the buffer of fd (STDOUT_FILENO or STDERR_FILENO), writing out
+ * whatever no longer fits.
+ *
+ * Returns - 0 on success, or -1 if writing to fd failed.
+ * */
+int writer_write(int fd, const char *data, size_t len) {
+  struct writer *w = &writers[fd];
+  if(w->len + len > WRITER_SIZE) {
+    if(writer_flush(fd) == -1)
+      return -1;
+    // Data too large for the buffer is written directly.
+    if(len > WRITER_SIZE) {
+      if(fd_write_all(fd, data, len) == -1) {
+        w->failed = 1;
+        return -1;
+      }
+      return 0;
+    }
+  }
+  memcpy(w->buf + w->len, data, len);
+  w->len += len;
+  return 0;
+}
+
+/* *
+ * Appends the string str to the buffer of fd.
+ * */
+int writer_puts(int fd, const char *str) {
+  return writer_write(fd, str, strlen(str));
+}
+
+/* *
+ * Appends formatted output to the buffer of fd.
+ * */
+int writer_printf(int fd, const char *fmt, ...) {
+  int len;
+  char small[256], *big;
+  va_list args;
+
+  va_start(args, fmt);
+  len = vsnprintf(small, sizeof(small), fmt, args);
+  va_end(args);
+  if(len < 0)
+    return -1;
+  if((size_t) len < sizeof(small))
+    return writer_write(fd, small, len);
+
+  if((big = mem_malloc(MEM_EXEC, len + 1)) == NULL) {
+    perror("Error allocating memory for output.");
+    return -1;
+  }
+  va_start(args, fmt);
+  vsnprintf(big, len + 1, fmt, args);
+  va_end(args);
+  len = writer_write(fd, big, len);
+  mem_free(MEM_EXEC, big);
+  return len;
+}
+
+/* *
+ * Writes out the buffer of fd.  Anything the shell has buffered in stdio for the same descriptor
+ * was printed first, so it is written out first.
+ *
+ * Returns - 0 on success, or -1 if any write to fd failed since the last flush.
+ * */
+int writer_flush(int fd) {
+  int status;
+  struct writer *w = &writers[fd];
+  fflush(fd == STDERR_FILENO ? stderr : stdout);
+  status = w->failed || fd_write_all(fd, w->buf, w->len) == -1 ? -1 : 0;
+  w->len = 0;
+  w->failed = 0;
+  return status;
+}
+
@@ -0,0 +1,369 @@
+/* *
+ * zygote.c
+ *
+ * Fork server ("zygote") for launching commands.
+ *
+ * Forking copies the page tables of the forking process, so the cost of fork grows with the
+ * size of the shell's address space.  In zygote mode, the shell forks a helper process once at
+ * startup, while its heap is still small, and from then on sends every command to the helper
+ * over a Unix socket instead of forking itself.  Each request carries the command's arguments,
+ * the shell's environment and working directory, and the shell's stdin, stdout, and stderr file
+ * descriptors (passed with SCM_RIGHTS.)  The helper forks, installs the descriptors, runs the
+ * command exactly as the shell's own child would, waits for it, and replies with its wait status.
+ *
+ * Message layout (shell -> zygote):
+ *   struct zygote_request, followed by request.size bytes of null-terminated strings: the
+ *   working directory, request.argc arguments, and request.envc environment entries.
+ *
+ * Message layout (zygote -> shell):
+ *   struct zygote_reply.
+ *
+ *  Copyright (C) 2016 Clark Zinzow <clarkzinzow@gmail.com>
+ *
+ *  Distributed under terms of the MIT license.
+ * */
+
+
+#include "zygote.h"
+#include "tinysh.h"
+#include "mem.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
+
+#define ZYGOTE_NUM_FDS 3  // stdin, stdout, and stderr.
+
+struct zygote_request {
+  uint32_t size;     // Number of string bytes following the request.
+  int32_t verbose;   // Verbose flag of the shell at the time of the request.
+  int32_t argc;      // Number of arguments.
+  int32_t envc;      // Number of environment entries.
+};
+
+struct zygote_reply {
+  int32_t status;    // Wait status of the command, valid if err == 0.
+  int32_t err;       // errno value if the zygote could not run the command.
+  struct rusage usage;  // Resource usage of the command, valid if err == 0.
+};
+
+extern char **environ;
+
+static int zygote_fd = -1;   // Shell's end of the zygote socket, or -1 if there is no zygote.
+static pid_t zygote_pid;
+
+static void zygote_loop(int sock);
+static int zygote_serve(int sock);
+static int send_all(int sock, const void *buf, size_t len);
+static int recv_all(int sock, void *buf, size_t len);
+
+/* *
+ * Starts the zygote.  This should be called as early as possible, while the shell's address space
+ * is still small.
+ * */
+int zygote_start(void) {
+  int sv[2];
+  if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+    perror("Error creating the zygote socket.");
+    return -1;
+  }
+  fflush(stdout);
+  if((zygote_pid = fork()) < 0) {
+    perror("Error forking a process.");
+    close(sv[0]);
+    close(sv[1]);
+    return -1;
+  }
+  // Zygote process.
+  if(zygote_pid == 0) {
+    close(sv[0]);
+    zygote_loop(sv[1]);
+    _Exit(EXIT_SUCCESS);
+  }
+  close(sv[1]);
+  zygote_fd = sv[0];
+  if(VERBOSE(V_PROC))
+    printf("Started the fork server (zygote) with process id %d.\n", (int) zygote_pid);
+  return 0;
+}
+
+/* *
+ * Returns - 1 if commands should be sent to the zygote, 0 if the shell should fork them itself.
+ * */
+int zygote_active(void) {
+  return zygote_fd >= 0;
+}
+
+/* *
+ * Sends cmd to the zygote to be run with the shell's current stdin, stdout, stderr, environment,
+ * and working directory, and waits for it to finish.  On success, status is set to the wait
+ * status of the command, and usage (if not NULL) to its resource usage.
+ *
+ * Returns - 0 on success, -1 if the zygote could not be reached (in which case the zygote is shut
+ *           down and the caller should fork the command itself.)
+ * */
+int zygote_spawn(char **cmd, int *status, struct rusage *usage) {
+  int i;
+  size_t len, off;
+  char cwd[PATH_MAX];
+  char *payload;
+  struct zygote_request req;
+  struct zygote_reply reply;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int) * ZYGOTE_NUM_FDS)];
+    struct cmsghdr align;
+  } control;
+  int fds[ZYGOTE_NUM_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+
+  if(getcwd(cwd, sizeof(cwd)) == NULL) {
+    perror("Error:  Getting the current working directory failed.");
+    return -1;
+  }
+
+  // Pack the working directory, arguments, and environment into one buffer.
+  len = strlen(cwd) + 1;
+  for(req.argc = 0; cmd[req.argc] != NULL; req.argc++)
+    len += strlen(cmd[req.argc]) + 1;
+  for(req.envc = 0; environ[req.envc] != NULL; req.envc++)
+    len += strlen(environ[req.envc]) + 1;
+  if((payload = mem_malloc(MEM_EXEC, len)) == NULL) {
+    perror("Error allocating memory for a zygote request.");
+    return -1;
+  }
+  off = 0;
+  memcpy(payload, cwd, strlen(cwd) + 1);
+  off += strlen(cwd) + 1;
+  for(i = 0; i < req.argc; i++) {
+    memcpy(payload + off, cmd[i], strlen(cmd[i]) + 1);
+    off += strlen(cmd[i]) + 1;
+  }
+  for(i = 0; i < req.envc; i++) {
+    memcpy(payload + off, environ[i], strlen(environ[i]) + 1);
+    off += strlen(environ[i]) + 1;
+  }
+  req.size = len;
+  req.verbose = verbose_flag;
+
+  // Send the request header with the standard file descriptors attached.
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+  iov.iov_base = &req;
+  iov.iov_len = sizeof(req);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  if(VERBOSE(V_PROC))
+    printf("Sending the command to the fork server (zygote) to run: %s\n", cmd[0]);
+  // The zygote's child writes to the same stdout, so the shell's output has to go out first.
+  fflush(stdout);
+  if(sendmsg(zygote_fd, &msg, MSG_NOSIGNAL) != sizeof(req)
+     || send_all(zygote_fd, payload, len) == -1
+     || recv_all(zygote_fd, &reply, sizeof(reply)) == -1) {
+    perror("Error communicating with the zygote; falling back to fork.");
+    mem_free(MEM_EXEC, payload);
+    zygote_stop();
+    return -1;
+  }
+  mem_free(MEM_EXEC, payload);
+
+  if(reply.err != 0) {
+    errno = reply.err;
+    perror("Error forking a process in the zygote.");
+    return -1;
+  }
+  if(VERBOSE(V_PROC))
+    printf("Parent:\n  The zygote reports that the child process terminated.\n");
+  *status = reply.status;
+  if(usage != NULL)
+    *usage = reply.usage;
+  return 0;
+}
+
+/* *
+ * Shuts down the zygote, if there is one.
+ * */
+void zygote_stop(void) {
+  if(zygote_fd < 0)
+    return;
+  // Closing the socket tells the zygote to exit.
+  close(zygote_fd);
+  zygote_fd = -1;
+  waitpid(zygote_pid, NULL, 0);
+}
+
+/* *
+ * Main loop of the zygote.  Serves requests until the shell closes its end of the socket.
+ * */
+static void zygote_loop(int sock) {
+  // A terminal interrupt is meant for the command in the foreground, not for the zygote.
+  signal(SIGINT, SIG_IGN);
+  signal(SIGQUIT, SIG_IGN);
+  while(zygote_serve(sock) == 0)
+    ;
+  close(sock);
+}
+
+/* *
+ * Serves a single request.
+ *
+ * Returns - 0 if the zygote should keep serving, -1 if the shell has gone away.
+ * */
+static int zygote_serve(int sock) {
+  int i, p_id, status, received, fds[ZYGOTE_NUM_FDS];
+  ssize_t n;
+  char *payload, *p;
+  char **argv, **envp;
+  struct zygote_request req;
+  struct zygote_reply reply;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union {
+    char buf[CMSG_SPACE(sizeof(int) * ZYGOTE_NUM_FDS)];
+    struct cmsghdr align;
+  } control;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &req;
+  iov.iov_len = sizeof(req);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  while((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+    ;
+  if(n <= 0)
+    return -1;
+  received = 0;
+  for(cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+       && cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+      memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+      received = 1;
+    }
+  }
+  if(!received || (n < (ssize_t) sizeof(req) && recv_all(sock, (char *) &req + n, sizeof(req) - n) == -1))
+    return -1;
+
+  // Unpack the working directory, arguments, and environment.
+  argv = mem_malloc(MEM_EXEC, (req.argc + 1) * sizeof(*argv));
+  envp = mem_malloc(MEM_EXEC, (req.envc + 1) * sizeof(*envp));
+  payload = mem_malloc(MEM_EXEC, req.size);
+  if(argv == NULL || envp == NULL || payload == NULL || recv_all(sock, payload, req.size) == -1) {
+    mem_free(MEM_EXEC, argv);
+    mem_free(MEM_EXEC, envp);
+    mem_free(MEM_EXEC, payload);
+    for(i = 0; i < ZYGOTE_NUM_FDS; i++)
+      close(fds[i]);
+    return -1;
+  }
+  p = payload + strlen(payload) + 1;
+  for(i = 0; i < req.argc; i++, p += strlen(p) + 1)
+    argv[i] = p;
+  argv[req.argc] = NULL;
+  for(i = 0; i < req.envc; i++, p += strlen(p) + 1)
+    envp[i] = p;
+  envp[req.envc] = NULL;
+
+  reply.err = 0;
+  reply.status = 0;
+  memset(&reply.usage, 0, sizeof(reply.usage));
+  if((p_id = fork()) < 0) {
+    reply.err = errno;
+  }
+  // Child process.  Take on the shell's descriptors, directory, and environment, then run the
+  // command just as the shell's own child would.
+  else if(p_id == 0) {
+    close(sock);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    for(i = 0; i < ZYGOTE_NUM_FDS; i++) {
+      if(dup2(fds[i], i) < 0) {
+        perror("Error duplicating file descriptor.");
+        _Exit(EXIT_FAILURE);
+      }
+    }
+    if(chdir(payload) < 0) {
+      perror("Error:  Changing directory failed.");
+      _Exit(EXIT_FAILURE);
+    }
+    environ = envp;
+    verbose_flag = req.verbose;
+    if(VERBOSE(V_PROC))
+      printf("Child (forked by the zygote):\n");
+    status = child_handle(argv, req.argc);
+    fflush(stdout);
+    _Exit(status != -1 ? status : EXIT_FAILURE);
+  }
+  // Zygote.  Release our copies of the descriptors and wait for the child.
+  for(i = 0; i < ZYGOTE_NUM_FDS; i++)
+    close(fds[i]);
+  if(p_id > 0) {
+    while(wait4(p_id, &status, 0, &reply.usage) < 0) {
+      if(errno != EINTR) {
+        reply.err = errno;
+        break;
+      }
+    }
+    if(reply.err == 0)
+      reply.status = status;
+  }
+  mem_free(MEM_EXEC, argv);
+  mem_free(MEM_EXEC, envp);
+  mem_free(MEM_EXEC, payload);
+  return send_all(sock, &reply, sizeof(reply));
+}
+
+/* *
+ * Sends all len bytes of buf on sock.
+ * */
+static int send_all(int sock, const void *buf, size_t len) {
+  ssize_t n;
+  const char *p = buf;
+  while(len > 0) {
+    if((n = send(sock, p, len, MSG_NOSIGNAL)) < 0) {
+      if(errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* *
+ * Receives exactly len bytes from sock into buf.
+ * */
+static int recv_all(int sock, void *buf, size_t len) {
+  ssize_t n;
+  char *p = buf;
+  while(len > 0) {
+    if((n = recv(sock, p, len, 0)) <= 0) {
+      if(n < 0 && errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}